@@ -0,0 +1,108 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+
+// Checks that a recompiled ROM runs like the interpreter. Without `C8S_AOT_ROM` this is the
+// generator, `c8s_aot_gen <seed> <file>` writes the C++ for the random ROM of <seed> to <file>. With
+// `-DC8S_AOT_ROM=<file>` the generated code is built in and `c8s_aot_check <seed>` runs it next
+// to `Chip8Debugger` and compares the state hashes after the same budgets.
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "debugger.hpp"
+#include "program-generator.hpp"
+
+#ifdef C8S_AOT_ROM
+
+#define C8S_AOT_NO_MAIN
+#include C8S_AOT_ROM
+
+#else
+
+#include "recompiler.hpp"
+
+#endif
+
+int main(int argc, char** argv)
+{
+	const std::uint32_t seed = argc > 1 ? std::uint32_t(std::strtoul(argv[1], nullptr, 10)) : 1;
+	std::mt19937 rng{ seed };
+	const std::vector<c8s::u16> ops = c8s::generate_rom(rng, true);
+
+#ifdef C8S_AOT_ROM
+	int failures = 0;
+	for (std::uint32_t ipf : { 1u, 3u, 10u })
+	{
+		for (std::uint64_t budget : { 1ULL, 7ULL, 1000ULL, 100001ULL })
+		{
+			// The machine is too large for the stack.
+			static c8s::AotMachine machine;
+			aot_load(machine);
+			machine.random.seed(5);
+			machine.instructionsPerFrame = ipf;
+			const auto reason = aot_run(machine, budget);
+
+			// Code reached through `BNNN` or written by the ROM itself isn't translated, up to there
+			// the interpreter has to agree.
+			c8s::Chip8Debugger debugger;
+			debugger.setSeed(5);
+			debugger.setInstructionsPerFrame(ipf);
+			debugger.loadProgram(ops);
+			auto expected = debugger.run(reason == c8s::StopReason::UntranslatedCode ? machine.cycles : budget);
+			if (reason == c8s::StopReason::UntranslatedCode) expected = reason;
+
+			if (reason != expected || machine.stateHash() != debugger.stateHash())
+			{
+				std::cout << "ROM " << seed << ", " << ipf << " instructions per frame, budget " << budget << ": recompiled 0x"
+					<< std::hex << machine.stateHash() << " (" << c8s::stop_reason_name(reason) << "), interpreter 0x"
+					<< debugger.stateHash() << std::dec << " (" << c8s::stop_reason_name(expected) << ")\n";
+				++failures;
+			}
+		}
+	}
+	if (failures == 0) std::cout << "ROM " << seed << " runs like the interpreter\n";
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+	if (argc < 3)
+	{
+		std::cout << "Usage: " << argv[0] << " <seed> <output file>\n";
+		return EXIT_FAILURE;
+	}
+	std::vector<c8s::u8> rom;
+	for (c8s::u16 op : ops)
+	{
+		rom.push_back(c8s::u8(op >> 8));
+		rom.push_back(c8s::u8(op & 0xFF));
+	}
+	std::ofstream ofs{ argv[2] };
+	c8s::recompile_to_cpp(rom, ofs);
+	return ofs ? EXIT_SUCCESS : EXIT_FAILURE;
+#endif
+}
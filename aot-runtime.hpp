@@ -0,0 +1,221 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "debugger.hpp"
+
+namespace c8s
+{
+	// Machine state of a ROM that `recompile_to_cpp` translated to C++. The generated code
+	// works on the fields directly and calls the members for the larger instructions.
+	// Every member mirrors the matching instruction handler of `Chip8Debugger`.
+	struct AotMachine
+	{
+		u8  memory[MEMORY_SIZE];
+		u8  v[V_REGS_TOTAL];
+		u16 i;
+		u8  delayTimer;
+		u8  soundTimer;
+		u16 pc;
+		u8  sp;
+		u16 stack[STACK_SIZE];
+		u8  keypad[KEYPAD_SIZE];
+		std::uint64_t display[DISPLAY_H];
+		std::uint64_t cycles;
+		std::uint32_t instructionsPerFrame;
+		std::uint32_t frameCountdown;
+		Xoshiro128 random;
+
+		bool instruction[MEMORY_SIZE];	// Addresses of translated instructions.
+		bool code[MEMORY_SIZE];			// Bytes that belong to translated instructions.
+		bool codeModified;				// A write hit translated code.
+
+		// Same start state as `Chip8Debugger::loadRom`.
+		void reset(const u8* rom, std::size_t size)
+		{
+			random.seed(default_seed());
+			for (unsigned j = 0; j < MEMORY_SIZE; ++j) memory[j] = 0;
+			for (unsigned j = 0; j < FONTSET_SIZE; ++j) memory[j] = FONTSET[j];
+			for (std::size_t j = 0; j < size && PROGRAM_START + j < MEMORY_SIZE; ++j) memory[PROGRAM_START + j] = rom[j];
+			for (unsigned j = 0; j < V_REGS_TOTAL; ++j) v[j] = 0;
+			for (unsigned j = 0; j < STACK_SIZE; ++j) stack[j] = 0;
+			for (unsigned j = 0; j < KEYPAD_SIZE; ++j) keypad[j] = 0;
+			clearScreen();
+			for (unsigned j = 0; j < MEMORY_SIZE; ++j) instruction[j] = code[j] = false;
+			i = 0;
+			delayTimer = 0;
+			soundTimer = 0;
+			instructionsPerFrame = INSTRUCTIONS_PER_FRAME;
+			frameCountdown = 1;
+			pc = PROGRAM_START;
+			sp = 0;
+			cycles = 0;
+			codeModified = false;
+		}
+
+		void markInstruction(unsigned address)
+		{
+			instruction[address % MEMORY_SIZE] = true;
+			code[address % MEMORY_SIZE] = true;
+			code[(address + 1) % MEMORY_SIZE] = true;
+		}
+
+		// Advance the frame countdown by `n` instructions and tick both timers once for every frame
+		// that started, as `n` calls of `Chip8Debugger::updateTimers` would.
+		void tick(std::uint64_t n)
+		{
+			if (n < frameCountdown)
+			{
+				frameCountdown -= std::uint32_t(n);
+				return;
+			}
+			n -= frameCountdown;
+			const std::uint64_t frames = 1 + n / instructionsPerFrame;
+			frameCountdown = instructionsPerFrame - std::uint32_t(n % instructionsPerFrame);
+			delayTimer = u8(delayTimer > frames ? delayTimer - frames : 0);
+			soundTimer = u8(soundTimer > frames ? soundTimer - frames : 0);
+		}
+
+		u8 read(unsigned address) const
+		{
+			return memory[address % MEMORY_SIZE];
+		}
+
+		void write(unsigned address, u8 value)
+		{
+			address %= MEMORY_SIZE;
+			memory[address] = value;
+			codeModified |= code[address];
+		}
+
+		void push(u16 address)
+		{
+			stack[sp % STACK_SIZE] = address;
+			++sp;
+		}
+
+		u16 pop()
+		{
+			--sp;
+			return stack[sp % STACK_SIZE];
+		}
+
+		void clearScreen()
+		{
+			std::memset(display, 0, sizeof(display));
+		}
+
+		void draw(u8 x, u8 y, u8 n)
+		{
+			v[0xF] = draw_sprite(display, memory, i, v[x], v[y], n) ? 0x1 : 0x0;
+		}
+
+		// Same as `Chip8Debugger::opLdVxKey`. Returns false if no key is down.
+		bool waitKey(u8 x)
+		{
+			for (unsigned k = 0; k < KEYPAD_SIZE; ++k)
+			{
+				if (keypad[k] != 0)
+				{
+					v[x] = u8(k);
+					pc += 2;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void storeBcd(u8 x)
+		{
+			write(i, v[x] / 100);
+			write(i + 1, (v[x] / 10) % 10);
+			write(i + 2, (v[x] % 100) % 10);
+		}
+
+		void storeRegs(u8 x)
+		{
+			for (unsigned j = 0; j <= x; ++j) write(i + j, v[j]);
+		}
+
+		void loadRegs(u8 x)
+		{
+			for (unsigned j = 0; j <= x; ++j) v[j] = read(i + j);
+		}
+
+		// Same hash as `Chip8Debugger::stateHash`.
+		std::uint64_t stateHash() const
+		{
+			std::uint64_t hash = fnv1a(memory, sizeof(memory));
+			hash = fnv1a(v, sizeof(v), hash);
+			hash = fnv1a(&i, sizeof(i), hash);
+			hash = fnv1a(&pc, sizeof(pc), hash);
+			hash = fnv1a(&sp, sizeof(sp), hash);
+			hash = fnv1a(stack, sizeof(stack), hash);
+			hash = fnv1a(&delayTimer, sizeof(delayTimer), hash);
+			hash = fnv1a(&soundTimer, sizeof(soundTimer), hash);
+			hash = fnv1a(&frameCountdown, sizeof(frameCountdown), hash);
+			hash = fnv1a(keypad, sizeof(keypad), hash);
+			hash = fnv1a(display, sizeof(display), hash);
+			return fnv1a(&cycles, sizeof(cycles), hash);
+		}
+	};
+
+	typedef void(*AotLoad)(AotMachine& machine);
+	typedef StopReason(*AotRun)(AotMachine& machine, std::uint64_t max_instructions);
+
+	// Entry point of a recompiled ROM: `<binary> [instructions] [seed] [instructions per frame]`.
+	// Prints the same report as `chip8script --run`.
+	int aot_main(int argc, char** argv, AotLoad load, AotRun run)
+	{
+		std::uint64_t budget = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 100000000ULL;
+		if (budget == 0)
+		{
+			std::cout << "Usage: " << argv[0] << " [instructions] [seed] [instructions per frame]\n";
+			return EXIT_FAILURE;
+		}
+
+		static AotMachine machine;
+		load(machine);
+		if (argc > 2) machine.random.seed(std::strtoull(argv[2], nullptr, 10));
+		if (argc > 3) machine.instructionsPerFrame = std::uint32_t(std::min(std::max(std::strtoul(argv[3], nullptr, 10), 1UL), 0xFFFFUL));
+
+		auto start = std::chrono::steady_clock::now();
+		auto reason = run(machine, budget);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "Executed " << machine.cycles << " instructions in " << seconds * 1000.0 << " ms ("
+			<< (seconds > 0.0 ? machine.cycles / seconds : 0.0) << " instructions/s)\n";
+		std::cout << "Stopped at 0x" << std::hex << machine.pc << std::dec << ": " << stop_reason_name(reason) << '\n';
+		std::cout << "State hash: 0x" << std::hex << machine.stateHash() << std::dec << '\n';
+		return EXIT_SUCCESS;
+	}
+}
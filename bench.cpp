@@ -0,0 +1,739 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "compiler.hpp"
+#include "control-flow.hpp"
+#include "disassembler.hpp"
+#include "debugger.hpp"
+#include "fleet.hpp"
+#include "jit.hpp"
+#include "program-generator.hpp"
+#include "trace.hpp"
+
+namespace c8s
+{
+	// A chip-8 script program that never stops. `RAW 1200` jumps back to the start.
+	struct BenchProgram
+	{
+		const char* name;
+		const char* code;
+	};
+
+	const BenchProgram BENCH_PROGRAMS[] =
+	{
+		{ "for-loop",
+			"VAR a = 1\n"
+			"FOR i=4 TO 10 STEP 2:\n"
+			"	IF a==1:\n"
+			"		a+=2\n"
+			"	ENDIF\n"
+			"	a += 1\n"
+			"ENDFOR\n"
+			"RAW 1200\n" },
+		{ "if-chain",
+			"VAR a = 4\n"
+			"VAR b = 2\n"
+			"IF a == 4:\n"
+			"	IF a != 4:\n"
+			"		a = 8\n"
+			"	ENDIF\n"
+			"ENDIF\n"
+			"IF a == 3:\n"
+			"	IF a != b:\n"
+			"		a = b\n"
+			"	ENDIF\n"
+			"ENDIF\n"
+			"a = 1\n"
+			"b = a\n"
+			"a |= b\n"
+			"a &= b\n"
+			"a ^= b\n"
+			"a -= b\n"
+			"a <<=2\n"
+			"a >>=1\n"
+			"RAW 1200\n" },
+		{ "arithmetic",
+			"VAR a = 0\n"
+			"VAR b = 3\n"
+			"VAR c = 7\n"
+			"FOR i=0 TO 200 STEP 1:\n"
+			"	a += b\n"
+			"	a ^= c\n"
+			"	b += 1\n"
+			"	c -= b\n"
+			"ENDFOR\n"
+			"RAW 1200\n" }
+	};
+
+	// Draws the 16 digit sprites in a loop while walking across the screen, so most of
+	// them cross an edge. The script language can't express DXYN, hence raw opcodes.
+	const std::vector<u16> SPRITE_ROM =
+	{
+		0x633F,	// 200: V3 = 0x3F, x mask
+		0x641F,	// 202: V4 = 0x1F, y mask
+		0x00E0,	// 204: clear screen
+		0x6200,	// 206: V2 = 0, digit
+		0xF229,	// 208: I = sprite of V2
+		0xD015,	// 20a: draw 5 rows at (V0, V1)
+		0x7007,	// 20c: V0 += 7
+		0x8032,	// 20e: V0 &= V3
+		0x7103,	// 210: V1 += 3
+		0x8142,	// 212: V1 &= V4
+		0x7201,	// 214: V2 += 1
+		0x3210,	// 216: skip if V2 == 16
+		0x1208,	// 218: next digit
+		0x1204	// 21a: next screen
+	};
+
+	// The same on the 128x64 SUPER-CHIP screen with the 8x10 digits of FX30.
+	const std::vector<u16> HIRES_SPRITE_ROM =
+	{
+		0x00FF,	// 200: hires
+		0x637F,	// 202: V3 = 0x7F, x mask
+		0x643F,	// 204: V4 = 0x3F, y mask
+		0x00E0,	// 206: clear screen
+		0x6200,	// 208: V2 = 0, digit
+		0xF230,	// 20a: I = big sprite of V2
+		0xD01A,	// 20c: draw 10 rows at (V0, V1)
+		0x700D,	// 20e: V0 += 13
+		0x8032,	// 210: V0 &= V3
+		0x7107,	// 212: V1 += 7
+		0x8142,	// 214: V1 &= V4
+		0x7201,	// 216: V2 += 1
+		0x3210,	// 218: skip if V2 == 16
+		0x120A,	// 21a: next digit
+		0x1206	// 21c: next screen
+	};
+
+	// Branches on the bits of V5, which differ per lane of a fleet, so the lanes split up
+	// at 208 and meet again at 202.
+	const std::vector<u16> BRANCH_ROM =
+	{
+		0x6000,	// 200: V0 = 0
+		0x7001,	// 202: V0 += 1
+		0x8100,	// 204: V1 = V0
+		0x8152,	// 206: V1 &= V5
+		0x3100,	// 208: skip if V1 == 0
+		0x1210,	// 20a: taken
+		0x7201,	// 20c: V2 += 1
+		0x1202,	// 20e: loop
+		0x7301,	// 210: V3 += 1
+		0x1202	// 212: loop
+	};
+
+	// Million instructions per second of `engine` on `program`, best of `repeats` runs.
+	double measure_engine(const std::vector<u16>& program, Engine engine, std::uint64_t instructions, unsigned repeats, Target target = Target::Chip8)
+	{
+		double best = 0.0;
+		for (unsigned r = 0; r < repeats; ++r)
+		{
+			Chip8Debugger debugger;
+			debugger.setTarget(target);
+			debugger.setEngine(engine);
+			if (engine == Engine::Jit && !attach_jit(debugger))
+				return 0.0;
+			debugger.loadProgram(program);
+
+			auto start = std::chrono::steady_clock::now();
+			debugger.run(instructions);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			double mips = debugger.cycles() / seconds / 1e6;
+			if (mips > best) best = mips;
+		}
+		return best;
+	}
+
+	// Compare the switch interpreter with the pre-decoded, threaded interpreter and the JIT.
+	void bench_dispatch(std::uint64_t instructions, unsigned repeats)
+	{
+		std::cout << "== interpreter dispatch (" << instructions << " instructions, best of " << repeats << ") ==\n";
+		std::cout << std::left << std::setw(14) << "program"
+			<< std::right << std::setw(14) << "switch MIPS"
+			<< std::setw(14) << "cached MIPS"
+			<< std::setw(14) << "jit MIPS"
+			<< std::setw(10) << "speedup" << '\n';
+
+		auto print_row = [&](const char* name, const std::vector<u16>& program, Target target = Target::Chip8)
+		{
+			double switch_mips = measure_engine(program, Engine::Switch, instructions, repeats, target);
+			double cached_mips = measure_engine(program, Engine::Cached, instructions, repeats, target);
+			double jit_mips = measure_engine(program, Engine::Jit, instructions, repeats, target);
+
+			std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(14) << switch_mips
+				<< std::setw(14) << cached_mips
+				<< std::setw(14) << jit_mips
+				<< std::setw(9) << std::setprecision(2) << std::max(cached_mips, jit_mips) / switch_mips << "x\n";
+		};
+
+		for (const auto& bench : BENCH_PROGRAMS)
+		{
+			auto program = compile(bench.code);
+			if (program.empty())
+			{
+				std::cout << bench.name << ": failed to compile\n";
+				continue;
+			}
+			print_row(bench.name, program);
+		}
+		print_row("sprites", SPRITE_ROM);
+		print_row("hires sprites", HIRES_SPRITE_ROM, Target::Schip);
+	}
+
+	// Aggregate million instructions per second of `lanes` machines that run `program` for
+	// `instructions` in total, either as one fleet or one interpreter after the other.
+	void bench_fleet(std::uint64_t instructions, unsigned repeats)
+	{
+		std::cout << "== lockstep fleet (" << instructions << " instructions in total, best of " << repeats << ") ==\n";
+		std::cout << std::left << std::setw(14) << "program"
+			<< std::right << std::setw(8) << "lanes"
+			<< std::setw(14) << "interp MIPS"
+			<< std::setw(14) << "fleet MIPS"
+			<< std::setw(12) << "lanes/step"
+			<< std::setw(10) << "speedup" << '\n';
+
+		auto print_row = [&](const char* name, const std::vector<u16>& program, unsigned lanes)
+		{
+			const std::uint64_t per_lane = std::max<std::uint64_t>(instructions / lanes, 1);
+			double interp_mips = 0.0, fleet_mips = 0.0, lanes_per_step = 0.0;
+			for (unsigned r = 0; r < repeats; ++r)
+			{
+				std::vector<Chip8Debugger> machines(lanes);
+				for (unsigned k = 0; k < lanes; ++k)
+				{
+					machines[k].loadProgram(program);
+					machines[k].setV(5, u8(k));
+				}
+				auto start = std::chrono::steady_clock::now();
+				std::uint64_t executed = 0;
+				for (auto& machine : machines)
+				{
+					machine.run(per_lane);
+					executed += machine.cycles();
+				}
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				interp_mips = std::max(interp_mips, executed / seconds / 1e6);
+
+				Chip8Fleet fleet{ lanes };
+				fleet.loadProgram(program);
+				for (unsigned k = 0; k < lanes; ++k) fleet.setV(k, 5, u8(k));
+				start = std::chrono::steady_clock::now();
+				executed = fleet.run(per_lane);
+				seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				fleet_mips = std::max(fleet_mips, executed / seconds / 1e6);
+				lanes_per_step = double(executed) / double(std::max<std::uint64_t>(fleet.steps(), 1));
+			}
+
+			std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(8) << lanes
+				<< std::setw(14) << interp_mips
+				<< std::setw(14) << fleet_mips
+				<< std::setw(12) << lanes_per_step
+				<< std::setw(9) << std::setprecision(2) << fleet_mips / interp_mips << "x\n";
+		};
+
+		auto for_loop = compile(BENCH_PROGRAMS[0].code);
+		for (unsigned lanes : { 16u, 256u, 4096u })
+		{
+			if (!for_loop.empty()) print_row("for-loop", for_loop, lanes);
+			print_row("branches", BRANCH_ROM, lanes);
+		}
+	}
+
+	// Attached, but records nothing: the cost of the observed loop alone.
+	class NullTracer : public ExecutionTracer
+	{
+	public:
+		void onExecuted(const Chip8Debugger&, u16, u16) override {}
+	};
+
+	// Cost of recording a binary trace per instruction, on top of the observed loop a tracer needs.
+	void bench_trace(std::uint64_t instructions, unsigned repeats)
+	{
+		std::cout << "== trace recorder (" << instructions << " instructions, best of " << repeats << ") ==\n";
+		std::cout << std::left << std::setw(14) << "program"
+			<< std::right << std::setw(14) << "null MIPS"
+			<< std::setw(14) << "traced MIPS"
+			<< std::setw(12) << "records"
+			<< std::setw(12) << "ns/instr" << '\n';
+
+		const std::string file_name = (std::filesystem::temp_directory_path() / "c8s_bench.trace").string();
+		auto print_row = [&](const char* name, const std::vector<u16>& program)
+		{
+			double null_mips = 0.0, traced_mips = 0.0;
+			std::uint64_t records = 0;
+			for (unsigned r = 0; r < repeats; ++r)
+			{
+				NullTracer null_tracer;
+				TraceRecorder recorder;
+				if (!recorder.open(file_name))
+				{
+					std::cout << name << ": unable to write `" << file_name << "`\n";
+					return;
+				}
+				for (ExecutionTracer* tracer : { static_cast<ExecutionTracer*>(&null_tracer), static_cast<ExecutionTracer*>(&recorder) })
+				{
+					Chip8Debugger debugger;
+					debugger.setTracer(tracer);
+					debugger.loadProgram(program);
+					auto start = std::chrono::steady_clock::now();
+					debugger.run(instructions);
+					double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					double& best = (tracer == &recorder) ? traced_mips : null_mips;
+					best = std::max(best, debugger.cycles() / seconds / 1e6);
+				}
+				recorder.close();
+				records = recorder.records();
+			}
+			std::filesystem::remove(file_name);
+
+			std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(14) << null_mips
+				<< std::setw(14) << traced_mips
+				<< std::setw(12) << records
+				<< std::setw(12) << std::setprecision(2) << 1000.0 / traced_mips - 1000.0 / null_mips << '\n';
+		};
+
+		auto for_loop = compile(BENCH_PROGRAMS[0].code);
+		if (!for_loop.empty()) print_row("for-loop", for_loop);
+		print_row("sprites", SPRITE_ROM);
+	}
+
+	// Throughput of the opcode analyser, the disassembler and the assembler on a corpus of ROMs, in
+	// megabytes of ROM per second. Every ROM of the corpus has to survive the round trip.
+	void bench_disassembler(unsigned passes, unsigned repeats)
+	{
+		std::cout << "== disassembler (" << passes << " passes over the corpus, best of " << repeats << ") ==\n";
+		std::cout << std::left << std::setw(14) << "corpus"
+			<< std::right << std::setw(8) << "KiB"
+			<< std::setw(14) << "analyse MB/s"
+			<< std::setw(14) << "disasm MB/s"
+			<< std::setw(14) << "asm MB/s"
+			<< std::setw(12) << "round trip" << '\n';
+
+		auto to_rom = [](const std::vector<u16>& program)
+		{
+			std::vector<u8> rom;
+			for (u16 op : program) { rom.push_back(u8(op >> 8)); rom.push_back(u8(op)); }
+			return rom;
+		};
+
+		auto print_row = [&](const char* name, const std::vector<std::vector<u8>>& corpus, Target target)
+		{
+			std::size_t bytes = 0;
+			for (const auto& rom : corpus) bytes += rom.size();
+
+			auto measure = [&](auto&& work)
+			{
+				double best = 0.0;
+				for (unsigned r = 0; r < repeats; ++r)
+				{
+					auto start = std::chrono::steady_clock::now();
+					for (unsigned pass = 0; pass < passes; ++pass) work();
+					double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					best = std::max(best, double(bytes) * passes / seconds / 1e6);
+				}
+				return best;
+			};
+
+			std::vector<std::vector<u16>> words;
+			for (const auto& rom : corpus)
+			{
+				words.emplace_back();
+				for (std::size_t j = 0; j + 1 < rom.size(); j += 2) words.back().push_back(u16(rom[j] << 8 | rom[j + 1]));
+			}
+			std::ostringstream analysis;
+			const double analyse_mbs = measure([&]
+			{
+				analysis.str("");
+				for (const auto& program : words) analyse_opcodes(program, analysis, target);
+			});
+
+			// One buffer for the whole corpus, allocated before the clock starts.
+			std::vector<char> buffer(disassembly_capacity(bytes) + corpus.size() * DISASSEMBLY_LINE_MAX);
+			std::vector<std::string> texts;
+			for (const auto& rom : corpus) texts.push_back(disassemble(rom, target));
+			const double disassemble_mbs = measure([&]
+			{
+				char* out = buffer.data();
+				for (const auto& rom : corpus)
+					out += disassemble(rom.data(), rom.size(), out, buffer.size() - std::size_t(out - buffer.data()), target);
+			});
+
+			bool identical = true;
+			const double assemble_mbs = measure([&]
+			{
+				for (std::size_t j = 0; j < corpus.size(); ++j)
+					identical = assemble(texts[j], target) == corpus[j] && identical;
+			});
+
+			std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(8) << bytes / 1024.0
+				<< std::setw(14) << analyse_mbs
+				<< std::setw(14) << disassemble_mbs
+				<< std::setw(14) << assemble_mbs
+				<< std::setw(12) << (identical ? "ok" : "FAILED") << '\n';
+		};
+
+		std::vector<std::vector<u8>> programs;
+		for (const auto& bench : BENCH_PROGRAMS) programs.push_back(to_rom(compile(bench.code)));
+		for (const auto* program : { &SPRITE_ROM, &HIRES_SPRITE_ROM, &BRANCH_ROM }) programs.push_back(to_rom(*program));
+		print_row("programs", programs, Target::Schip);
+
+		// Full 3.5 KB ROMs of random bytes, mostly instructions with data in between.
+		std::mt19937 rng{ 0xD15A };
+		std::vector<std::vector<u8>> random(32, std::vector<u8>(MEMORY_SIZE - PROGRAM_START));
+		for (auto& rom : random)
+			for (u8& byte : rom) byte = u8(rng());
+		print_row("random", random, Target::XoChip);
+	}
+
+	// Time to recover the control flow graph of a full ROM and to run both dataflow analyses on it.
+	void bench_control_flow(unsigned repeats)
+	{
+		std::cout << "== control flow analysis (best of " << repeats << ") ==\n";
+		std::cout << std::left << std::setw(14) << "rom"
+			<< std::right << std::setw(8) << "bytes"
+			<< std::setw(8) << "blocks"
+			<< std::setw(8) << "edges"
+			<< std::setw(10) << "cfg us"
+			<< std::setw(10) << "live us"
+			<< std::setw(10) << "reach us" << '\n';
+
+		auto print_row = [&](const char* name, const std::vector<u8>& rom)
+		{
+			u8 memory[MEMORY_SIZE] = {};
+			for (unsigned j = 0; j < rom.size() && PROGRAM_START + j < MEMORY_SIZE; ++j) memory[PROGRAM_START + j] = rom[j];
+
+			double cfg_us = 1e9, live_us = 1e9, reach_us = 1e9;
+			ControlFlowGraph cfg;
+			for (unsigned r = 0; r < repeats; ++r)
+			{
+				auto start = std::chrono::steady_clock::now();
+				cfg = build_control_flow_graph(memory);
+				auto built = std::chrono::steady_clock::now();
+				const Liveness liveness = compute_liveness(cfg, memory);
+				auto live = std::chrono::steady_clock::now();
+				const ReachingDefinitions rd = compute_reaching_definitions(cfg, memory);
+				auto reached = std::chrono::steady_clock::now();
+				cfg_us = std::min(cfg_us, std::chrono::duration<double, std::micro>(built - start).count());
+				live_us = std::min(live_us, std::chrono::duration<double, std::micro>(live - built).count());
+				reach_us = std::min(reach_us, std::chrono::duration<double, std::micro>(reached - live).count());
+			}
+
+			std::cout << std::left << std::setw(14) << name << std::right
+				<< std::setw(8) << rom.size()
+				<< std::setw(8) << cfg.blocks.size()
+				<< std::setw(8) << cfg.successors.size()
+				<< std::fixed << std::setprecision(1)
+				<< std::setw(10) << cfg_us
+				<< std::setw(10) << live_us
+				<< std::setw(10) << reach_us << '\n';
+		};
+
+		// IF blocks in a loop until the ROM almost fills the memory.
+		std::string code = "VAR a = 0\nVAR b = 1\nVAR c = 2\nFOR i=0 TO 10 STEP 1:\n";
+		for (unsigned j = 0; j < 330; ++j)
+			code += "\tIF a == " + std::to_string(j % 256) + ":\n\t\tb += a\n\t\tc ^= b\n\tENDIF\n\ta += 1\n";
+		std::vector<u8> structured;
+		for (u16 op : compile(code + "ENDFOR\nRAW 1200\n"))
+		{
+			structured.push_back(u8(op >> 8));
+			structured.push_back(u8(op));
+		}
+		print_row("structured", structured);
+
+		// Random instructions with branches, calls and a few jump tables all over the memory.
+		std::mt19937 rng{ 0xCF6 };
+		std::vector<u8> random;
+		while (random.size() < MEMORY_SIZE - PROGRAM_START)
+		{
+			u16 op = u16(rng());
+			const unsigned nibble = op >> 12;
+			if (find_opcode(op, Target::Chip8) == nullptr || (nibble == 0xB && rng() % 16 != 0)) continue;
+			if (nibble == 0x1 || nibble == 0x2 || nibble == 0xB) op = u16((op & 0xF000) | (PROGRAM_START + rng() % 0x700 * 2));
+			random.push_back(u8(op >> 8));
+			random.push_back(u8(op));
+		}
+		print_row("random", random);
+	}
+
+	// Peak resident set size of the process in bytes, 0 where it is unknown.
+	std::uint64_t peak_rss_bytes()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#elif defined(__unix__) || defined(__APPLE__)
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#if defined(__APPLE__)
+		return std::uint64_t(usage.ru_maxrss);
+#else
+		return std::uint64_t(usage.ru_maxrss) * 1024;	// Linux and the BSDs count KiB.
+#endif
+#else
+		return 0;
+#endif
+	}
+
+	// Throughput of every compiler phase and of the engines on one generated program.
+	struct PipelineResult
+	{
+		unsigned statements;
+		std::size_t source_bytes;
+		std::size_t rom_bytes;
+		CompileStats stages;		// The fastest run of every phase.
+		double tokens_per_second;	// Tokenizer.
+		double nodes_per_second;	// Parser and structuring, by the nodes of the final AST.
+		double opcodes_per_second;	// Meta code generation and label resolution.
+		double instructions_per_second[3];	// Switch, cached and JIT engine on the endless variant.
+	};
+
+	const char* const PIPELINE_ENGINE_NAMES[] = { "switch", "cached", "jit" };
+
+	double phase_seconds(const CompileStats& stats, const char* name)
+	{
+		for (const PhaseStats& phase : stats.phases)
+			if (phase.name == name) return phase.milliseconds / 1000.0;
+		return 0.0;
+	}
+
+	std::size_t phase_items(const CompileStats& stats, const char* name)
+	{
+		for (const PhaseStats& phase : stats.phases)
+			if (phase.name == name) return phase.items;
+		return 0;
+	}
+
+	// Compiles programs from the generator at a quarter, half and the full number of statements
+	// of `options`, then runs them endlessly on every engine. Returns false if one fails to compile.
+	bool bench_pipeline(const GeneratorOptions& options, std::uint64_t instructions, unsigned repeats, std::vector<PipelineResult>& results)
+	{
+		std::cout << "== compiler pipeline on generated programs (seed " << options.seed << ", depth " << options.depth
+			<< ", " << options.variables << " variables, best of " << repeats << ") ==\n";
+		std::cout << std::left << std::setw(12) << "statements"
+			<< std::right << std::setw(8) << "KiB"
+			<< std::setw(12) << "Mtokens/s"
+			<< std::setw(12) << "Mnodes/s"
+			<< std::setw(12) << "Mopcodes/s"
+			<< std::setw(12) << "compile ms"
+			<< std::setw(13) << "switch MIPS"
+			<< std::setw(13) << "cached MIPS"
+			<< std::setw(10) << "jit MIPS" << '\n';
+
+		for (unsigned divisor : { 4u, 2u, 1u })
+		{
+			GeneratorOptions sized = options;
+			sized.statements = std::max(options.statements / divisor, 1u);
+			const std::string code = generate_program(sized);
+
+			PipelineResult result{ sized.statements, code.size(), 0, {}, 0.0, 0.0, 0.0, { 0.0, 0.0, 0.0 } };
+			for (unsigned r = 0; r < repeats; ++r)
+			{
+				CompileStats stats;
+				const std::vector<u16> program = compile(code, false, false, &stats);
+				if (program.empty())
+				{
+					std::cout << sized.statements << " statements: failed to compile\n";
+					for (const auto& error : compiler_log::read_errors()) std::cout << "  " << error << '\n';
+					return false;
+				}
+				result.rom_bytes = program.size() * 2;
+				if (r == 0) result.stages = stats;
+				for (std::size_t j = 0; j < stats.phases.size(); ++j)
+					result.stages.phases[j].milliseconds = std::min(result.stages.phases[j].milliseconds, stats.phases[j].milliseconds);
+			}
+			const CompileStats& best = result.stages;
+			auto per_second = [](std::size_t items, double seconds) { return seconds > 0.0 ? items / seconds : 0.0; };
+			result.tokens_per_second = per_second(phase_items(best, "tokenize"), phase_seconds(best, "tokenize"));
+			result.nodes_per_second = per_second(phase_items(best, "structure"), phase_seconds(best, "parse") + phase_seconds(best, "structure"));
+			result.opcodes_per_second = per_second(phase_items(best, "labels"), phase_seconds(best, "meta") + phase_seconds(best, "labels"));
+
+			GeneratorOptions endless = sized;
+			endless.endless = true;
+			const std::vector<u16> looping = compile(generate_program(endless));
+			const Engine engines[] = { Engine::Switch, Engine::Cached, Engine::Jit };
+			for (unsigned e = 0; e < 3; ++e)
+				result.instructions_per_second[e] = measure_engine(looping, engines[e], instructions, repeats) * 1e6;
+
+			std::cout << std::left << std::setw(12) << result.statements << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(8) << result.source_bytes / 1024.0
+				<< std::setw(12) << std::setprecision(2) << result.tokens_per_second / 1e6
+				<< std::setw(12) << result.nodes_per_second / 1e6
+				<< std::setw(12) << result.opcodes_per_second / 1e6
+				<< std::setw(12) << std::setprecision(3) << best.total_milliseconds()
+				<< std::setprecision(1)
+				<< std::setw(13) << result.instructions_per_second[0] / 1e6
+				<< std::setw(13) << result.instructions_per_second[1] / 1e6
+				<< std::setw(10) << result.instructions_per_second[2] / 1e6 << '\n';
+			results.push_back(result);
+		}
+		return true;
+	}
+
+	// Writes the generator settings, the pipeline results and the peak RSS as one JSON object.
+	void print_pipeline_json(std::ostream& os, const GeneratorOptions& options, const std::vector<PipelineResult>& results)
+	{
+		const StatementMix& mix = options.mix;
+		os << std::fixed << std::setprecision(6);
+		os << "{\"generator\":{\"seed\":" << options.seed << ",\"statements\":" << options.statements << ",\"depth\":" << options.depth
+			<< ",\"variables\":" << options.variables << ",\"mix\":{\"assign\":" << mix.assign << ",\"arithmetic\":" << mix.arithmetic
+			<< ",\"branch\":" << mix.branch << ",\"loop\":" << mix.loop << ",\"clear\":" << mix.clear << "}},\"programs\":[";
+		for (std::size_t j = 0; j < results.size(); ++j)
+		{
+			const PipelineResult& result = results[j];
+			os << (j == 0 ? "" : ",") << "{\"statements\":" << result.statements << ",\"source_bytes\":" << result.source_bytes
+				<< ",\"rom_bytes\":" << result.rom_bytes << ",\"compile_ms\":" << result.stages.total_milliseconds()
+				<< ",\"tokens_per_second\":" << result.tokens_per_second << ",\"nodes_per_second\":" << result.nodes_per_second
+				<< ",\"opcodes_per_second\":" << result.opcodes_per_second << ",\"stages\":[";
+			for (std::size_t k = 0; k < result.stages.phases.size(); ++k)
+			{
+				const PhaseStats& phase = result.stages.phases[k];
+				os << (k == 0 ? "" : ",") << "{\"name\":\"" << phase.name << "\",\"ms\":" << phase.milliseconds << ",\"items\":" << phase.items
+					<< ",\"unit\":\"" << phase.unit << "\",\"per_second\":" << (phase.milliseconds > 0.0 ? phase.items * 1000.0 / phase.milliseconds : 0.0)
+					<< ",\"allocations\":" << phase.allocations << ",\"peak_heap_bytes\":" << phase.peak_bytes << "}";
+			}
+			os << "],\"instructions_per_second\":{";
+			for (unsigned e = 0; e < 3; ++e)
+				os << (e == 0 ? "" : ",") << "\"" << PIPELINE_ENGINE_NAMES[e] << "\":" << result.instructions_per_second[e];
+			os << "}}";
+		}
+		os << "],\"peak_rss_bytes\":" << peak_rss_bytes() << "}\n";
+	}
+}
+
+// Reads `--mix=assign:4,arithmetic:4,branch:2,loop:1,clear:0`, missing kinds keep their weight.
+bool parse_mix(const std::string& text, c8s::StatementMix& mix)
+{
+	for (const std::string& item : c8s::split_list(text))
+	{
+		const std::size_t colon = item.find(':');
+		unsigned weight = 0;
+		if (colon == std::string::npos || !c8s::parse_number(item.substr(colon + 1), 1000, weight))
+			return false;
+		const std::string kind = item.substr(0, colon);
+		if (kind == "assign") mix.assign = weight;
+		else if (kind == "arithmetic") mix.arithmetic = weight;
+		else if (kind == "branch") mix.branch = weight;
+		else if (kind == "loop") mix.loop = weight;
+		else if (kind == "clear") mix.clear = weight;
+		else return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::uint64_t instructions = 50000000ULL;
+	c8s::GeneratorOptions generator;
+	generator.statements = 800;
+	std::string json_file, emit_file;
+	bool pipeline_only = false, valid = true;
+	for (int i = 1; i < argc && valid; ++i)
+	{
+		const std::string arg = argv[i];
+		auto value = [&](const char* option) { return arg.substr(std::string{ option }.size()); };
+		auto number = [&](const char* option) { return unsigned(std::strtoul(value(option).c_str(), nullptr, 10)); };
+		if (arg.find("--json=") == 0) json_file = value("--json=");
+		else if (arg.find("--emit=") == 0) emit_file = value("--emit=");
+		else if (arg == "--pipeline") pipeline_only = true;
+		else if (arg.find("--seed=") == 0) generator.seed = number("--seed=");
+		else if (arg.find("--statements=") == 0) valid = (generator.statements = number("--statements=")) != 0;
+		else if (arg.find("--depth=") == 0) generator.depth = number("--depth=");
+		else if (arg.find("--variables=") == 0) valid = (generator.variables = number("--variables=")) >= 1 && generator.variables <= 16;
+		else if (arg.find("--mix=") == 0) valid = parse_mix(value("--mix="), generator.mix);
+		else valid = (instructions = std::strtoull(arg.c_str(), nullptr, 10)) != 0;
+	}
+	if (!valid)
+	{
+		std::cout << "Usage: c8s_bench [instructions] [--pipeline] [--json=<file>] [--emit=<file>]\n"
+			"                 [--seed=<n>] [--statements=<n>] [--depth=<n>] [--variables=<1-16>]\n"
+			"                 [--mix=assign:4,arithmetic:4,branch:2,loop:1,clear:0]\n";
+		return EXIT_FAILURE;
+	}
+
+	// Only write the generated program, to reproduce a result.
+	if (!emit_file.empty())
+	{
+		std::ofstream ofs{ emit_file };
+		if (!(ofs << c8s::generate_program(generator)))
+		{
+			std::cout << "Unable to write `" << emit_file << "`\n";
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	if (!pipeline_only)
+	{
+		c8s::bench_dispatch(instructions, 3);
+		c8s::bench_fleet(instructions, 3);
+		c8s::bench_trace(std::max<std::uint64_t>(instructions / 10, 1), 3);
+		c8s::bench_control_flow(20);
+		c8s::bench_disassembler(unsigned(std::max<std::uint64_t>(instructions / 1000000, 1)), 3);
+	}
+
+	std::vector<c8s::PipelineResult> results;
+	if (!c8s::bench_pipeline(generator, instructions, 5, results))
+		return EXIT_FAILURE;
+	if (!json_file.empty())
+	{
+		std::ofstream ofs{ json_file };
+		c8s::print_pipeline_json(ofs, generator, results);
+		if (!ofs)
+		{
+			std::cout << "Unable to write `" << json_file << "`\n";
+			return EXIT_FAILURE;
+		}
+		std::cout << "Results written to `" << json_file << "`\n";
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+namespace c8s
+{
+	// The binary files (line tables, input logs) start with four magic letters and a version byte.
+	const std::size_t FILE_HEADER_SIZE = 5;
+
+	std::vector<u8> file_header(const char* magic, u8 version)
+	{
+		return std::vector<u8>{ u8(magic[0]), u8(magic[1]), u8(magic[2]), u8(magic[3]), version };
+	}
+
+	bool has_file_header(const std::vector<u8>& bytes, const char* magic, u8 version)
+	{
+		return bytes.size() >= FILE_HEADER_SIZE && bytes[0] == u8(magic[0]) && bytes[1] == u8(magic[1])
+			&& bytes[2] == u8(magic[2]) && bytes[3] == u8(magic[3]) && bytes[4] == version;
+	}
+
+	// Unsigned LEB128, seven bits per byte with the lowest first.
+	void put_varint(std::vector<u8>& bytes, std::uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			bytes.push_back(u8(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back(u8(value));
+	}
+
+	// Reads a varint at `p` and moves `p` past it. Returns false if the bytes end within it.
+	bool get_varint(const std::vector<u8>& bytes, std::size_t& p, std::uint64_t& value)
+	{
+		value = 0;
+		for (unsigned shift = 0; shift < 64 && p < bytes.size(); shift += 7)
+		{
+			const u8 byte = bytes[p++];
+			value |= std::uint64_t(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool save_bytes(const std::string& fileName, const std::vector<u8>& bytes)
+	{
+		std::ofstream ofs{ fileName, std::ofstream::binary };
+		ofs.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		return bool(ofs);
+	}
+
+	bool load_bytes(const std::string& fileName, std::vector<u8>& bytes)
+	{
+		std::ifstream ifs{ fileName, std::ifstream::binary };
+		if (!ifs.is_open())
+			return false;
+		bytes.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		return true;
+	}
+}
@@ -0,0 +1,486 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "debugger.hpp"
+
+namespace c8s
+{
+	// A condition such as `V3 == 0x10 && I > 0x300`, compiled into a short postfix program.
+	// Operands are numbers, the registers V0-VF, I, PC, SP, DT and ST, and memory bytes as
+	// `[address]`. Operators, from lowest to highest precedence: `||`, `&&`, comparisons,
+	// `|`, `^`, `&`, `+ -` and the prefix `!`.
+	class Predicate
+	{
+		enum class Code : u8
+		{
+			Number, V, I, Pc, Sp, Dt, St, Memory,
+			Not, Add, Sub, BitAnd, BitOr, BitXor,
+			Eq, Ne, Lt, Le, Gt, Ge, And, Or
+		};
+
+		struct Instruction
+		{
+			Code code;
+			std::uint32_t operand;
+		};
+
+		static const unsigned MAX_DEPTH = 16;
+
+		std::vector<Instruction> m_code;
+		std::string m_text;
+
+	public:
+		// Returns false and describes the problem in `error` if `text` is not a valid condition.
+		bool compile(const std::string& text, std::string& error)
+		{
+			Parser parser{ text, m_code };
+			m_code.clear();
+			m_text = text;
+			if (!parser.parse(error))
+				return false;
+
+			// Check the stack depth once, so `evaluate` doesn't have to.
+			unsigned depth = 0, max_depth = 0;
+			for (const Instruction& in : m_code)
+			{
+				if (in.code <= Code::St) ++depth;
+				else if (in.code >= Code::Add) --depth;
+				if (depth > max_depth) max_depth = depth;
+			}
+			if (max_depth > MAX_DEPTH)
+			{
+				error = "condition is nested too deeply";
+				return false;
+			}
+			return true;
+		}
+
+		bool evaluate(const Chip8Debugger& debugger) const
+		{
+			std::uint32_t stack[MAX_DEPTH];
+			unsigned top = 0;
+			for (const Instruction& in : m_code)
+			{
+				switch (in.code)
+				{
+				case Code::Number: stack[top++] = in.operand; break;
+				case Code::V: stack[top++] = debugger.v(in.operand); break;
+				case Code::I: stack[top++] = debugger.i(); break;
+				case Code::Pc: stack[top++] = debugger.pc(); break;
+				case Code::Sp: stack[top++] = debugger.sp(); break;
+				case Code::Dt: stack[top++] = debugger.delayTimer(); break;
+				case Code::St: stack[top++] = debugger.soundTimer(); break;
+				case Code::Memory: stack[top - 1] = debugger.memory(stack[top - 1]); break;
+				case Code::Not: stack[top - 1] = stack[top - 1] == 0; break;
+				default:
+				{
+					const std::uint32_t b = stack[--top], a = stack[top - 1];
+					std::uint32_t& result = stack[top - 1];
+					switch (in.code)
+					{
+					case Code::Add: result = a + b; break;
+					case Code::Sub: result = a - b; break;
+					case Code::BitAnd: result = a & b; break;
+					case Code::BitOr: result = a | b; break;
+					case Code::BitXor: result = a ^ b; break;
+					case Code::Eq: result = a == b; break;
+					case Code::Ne: result = a != b; break;
+					case Code::Lt: result = a < b; break;
+					case Code::Le: result = a <= b; break;
+					case Code::Gt: result = a > b; break;
+					case Code::Ge: result = a >= b; break;
+					case Code::And: result = a != 0 && b != 0; break;
+					default: result = a != 0 || b != 0; break;
+					}
+				}
+				}
+			}
+			return top == 1 && stack[0] != 0;
+		}
+
+		const std::string& text() const { return m_text; }
+
+	private:
+		// Recursive descent parser that appends the postfix program to `code`.
+		class Parser
+		{
+			const std::string& m_text;
+			std::vector<Instruction>& m_code;
+			std::size_t m_pos;
+			std::string m_error;
+
+		public:
+			Parser(const std::string& text, std::vector<Instruction>& code)
+				: m_text{ text }, m_code{ code }, m_pos{ 0 } {}
+
+			bool parse(std::string& error)
+			{
+				parseBinary(0);
+				skipSpaces();
+				if (m_error.empty() && m_pos < m_text.size())
+					fail("unexpected `" + m_text.substr(m_pos) + "`");
+				error = m_error;
+				return m_error.empty();
+			}
+
+		private:
+			struct Operator
+			{
+				const char* token;
+				Code code;
+				unsigned level;
+			};
+
+			void fail(const std::string& message)
+			{
+				if (m_error.empty()) m_error = message;
+			}
+
+			void skipSpaces()
+			{
+				while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) ++m_pos;
+			}
+
+			bool accept(const char* token)
+			{
+				skipSpaces();
+				const std::size_t length = std::char_traits<char>::length(token);
+				if (m_text.compare(m_pos, length, token) != 0)
+					return false;
+				m_pos += length;
+				return true;
+			}
+
+			// Operators of one precedence level are tried longest first, so `<=` isn't read as `<`.
+			void parseBinary(unsigned level)
+			{
+				static const Operator operators[] =
+				{
+					{ "||", Code::Or, 0 }, { "&&", Code::And, 1 },
+					{ "==", Code::Eq, 2 }, { "!=", Code::Ne, 2 }, { "<=", Code::Le, 2 }, { ">=", Code::Ge, 2 }, { "<", Code::Lt, 2 }, { ">", Code::Gt, 2 },
+					{ "|", Code::BitOr, 3 }, { "^", Code::BitXor, 4 }, { "&", Code::BitAnd, 5 },
+					{ "+", Code::Add, 6 }, { "-", Code::Sub, 6 }
+				};
+				const unsigned levels = 7;
+
+				if (level == levels)
+				{
+					parseUnary();
+					return;
+				}
+				parseBinary(level + 1);
+				for (bool matched = true; matched && m_error.empty(); )
+				{
+					matched = false;
+					for (const Operator& op : operators)
+					{
+						// `|` and `&` must not take the first half of `||` and `&&`.
+						if (op.level != level || !accept(op.token))
+							continue;
+						if ((op.code == Code::BitOr || op.code == Code::BitAnd) && m_pos < m_text.size() && m_text[m_pos] == m_text[m_pos - 1])
+						{
+							--m_pos;
+							continue;
+						}
+						parseBinary(level + 1);
+						m_code.push_back(Instruction{ op.code, 0 });
+						matched = true;
+						break;
+					}
+				}
+			}
+
+			void parseUnary()
+			{
+				if (accept("!"))
+				{
+					parseUnary();
+					m_code.push_back(Instruction{ Code::Not, 0 });
+					return;
+				}
+				if (accept("("))
+				{
+					parseBinary(0);
+					if (!accept(")")) fail("missing `)`");
+					return;
+				}
+				if (accept("["))
+				{
+					parseBinary(0);
+					if (!accept("]")) fail("missing `]`");
+					m_code.push_back(Instruction{ Code::Memory, 0 });
+					return;
+				}
+
+				skipSpaces();
+				std::size_t end = m_pos;
+				while (end < m_text.size() && std::isalnum(static_cast<unsigned char>(m_text[end]))) ++end;
+				std::string word = m_text.substr(m_pos, end - m_pos);
+				for (char& c : word) c = char(std::toupper(static_cast<unsigned char>(c)));
+				if (word.empty())
+				{
+					fail(m_pos < m_text.size() ? "unexpected `" + m_text.substr(m_pos) + "`" : "missing operand");
+					return;
+				}
+				m_pos = end;
+
+				if (std::isdigit(static_cast<unsigned char>(word[0])))
+				{
+					char* rest = nullptr;
+					const unsigned long value = std::strtoul(word.c_str(), &rest, 0);
+					if (*rest != '\0') fail("invalid number `" + word + "`");
+					m_code.push_back(Instruction{ Code::Number, std::uint32_t(value) });
+				}
+				else if (word.size() == 2 && word[0] == 'V' && std::isxdigit(static_cast<unsigned char>(word[1])))
+					m_code.push_back(Instruction{ Code::V, std::uint32_t(std::stoul(word.substr(1), nullptr, 16)) });
+				else if (word == "I") m_code.push_back(Instruction{ Code::I, 0 });
+				else if (word == "PC") m_code.push_back(Instruction{ Code::Pc, 0 });
+				else if (word == "SP") m_code.push_back(Instruction{ Code::Sp, 0 });
+				else if (word == "DT") m_code.push_back(Instruction{ Code::Dt, 0 });
+				else if (word == "ST") m_code.push_back(Instruction{ Code::St, 0 });
+				else fail("unknown operand `" + word + "`");
+			}
+		};
+	};
+
+	enum class BreakpointKind
+	{
+		Address,	// PC reached `address`, and `condition` holds if there is one.
+		Memory,		// A byte in [address, address + length) changed.
+		Register,	// V[reg] changed, or I if `reg` is 16.
+		Condition	// `condition` holds after an instruction.
+	};
+
+	struct Breakpoint
+	{
+		unsigned id;
+		BreakpointKind kind;
+		u16 address;
+		u16 length;
+		u8 reg;
+		bool conditional;
+		Predicate condition;
+		std::vector<u8> watched;	// Last seen value of a memory or register watchpoint.
+	};
+
+	// The breakpoints of a debugger. Checked after every instruction of a run while any is armed,
+	// address breakpoints also before the first one. Address breakpoints are found through a
+	// table indexed by PC. A run that only has those lets the engine stop at their addresses.
+	class BreakpointSet : public BreakCondition
+	{
+		std::vector<Breakpoint> m_breakpoints;
+		unsigned m_nextId;
+		std::vector<u8> m_atAddress;	// Address breakpoints per PC, one entry per 16-bit address.
+		bool m_checkAlways;				// Any watchpoint or condition.
+		const Breakpoint* m_hit;
+
+	public:
+		BreakpointSet() : m_nextId{ 1 }, m_atAddress(0x10000), m_checkAlways{ false }, m_hit{ nullptr } {}
+
+		// Each `add` returns the id of the new breakpoint.
+		unsigned addAddress(u16 address) { return add(BreakpointKind::Address, address, 0, 0, nullptr); }
+		unsigned addAddress(u16 address, const Predicate& condition) { return add(BreakpointKind::Address, address, 0, 0, &condition); }
+		unsigned addMemoryWatch(u16 address, u16 length) { return add(BreakpointKind::Memory, address, length == 0 ? 1 : length, 0, nullptr); }
+		unsigned addRegisterWatch(u8 reg) { return add(BreakpointKind::Register, 0, 0, reg > 16 ? 16 : reg, nullptr); }
+		unsigned addCondition(const Predicate& condition) { return add(BreakpointKind::Condition, 0, 0, 0, &condition); }
+
+		bool remove(unsigned id)
+		{
+			for (auto it = m_breakpoints.begin(); it != m_breakpoints.end(); ++it)
+			{
+				if (it->id != id)
+					continue;
+				m_breakpoints.erase(it);
+				rebuild();
+				return true;
+			}
+			return false;
+		}
+
+		const std::vector<Breakpoint>& breakpoints() const { return m_breakpoints; }
+
+		// The breakpoint that stopped the last run, or null.
+		const Breakpoint* lastHit() const { return m_hit; }
+
+		bool armed() const override { return !m_breakpoints.empty(); }
+
+		void begin(const Chip8Debugger& debugger) override
+		{
+			m_hit = nullptr;
+			for (Breakpoint& breakpoint : m_breakpoints) capture(debugger, breakpoint);
+		}
+
+		bool hit(const Chip8Debugger& debugger) override
+		{
+			if (m_atAddress[address(debugger)] == 0 && !m_checkAlways)
+				return false;
+
+			for (Breakpoint& breakpoint : m_breakpoints)
+			{
+				bool stop = false;
+				switch (breakpoint.kind)
+				{
+				case BreakpointKind::Address:
+					stop = stopsAt(breakpoint, debugger);
+					break;
+				case BreakpointKind::Condition:
+					stop = breakpoint.condition.evaluate(debugger);
+					break;
+				default:
+					// Every changed watchpoint takes its new value, only the first one is reported.
+					stop = capture(debugger, breakpoint);
+					break;
+				}
+				if (stop && !m_hit) m_hit = &breakpoint;
+			}
+			return m_hit != nullptr;
+		}
+
+		bool hitAddress(const Chip8Debugger& debugger) override
+		{
+			if (m_atAddress[address(debugger)] == 0)
+				return false;
+
+			for (Breakpoint& breakpoint : m_breakpoints)
+			{
+				if (breakpoint.kind == BreakpointKind::Address && stopsAt(breakpoint, debugger))
+				{
+					m_hit = &breakpoint;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Watchpoints and conditions can stop at any instruction. The table wraps the addresses
+		// into the memory of the debugger, like `address`.
+		bool markAddresses(std::vector<u8>& traps) const override
+		{
+			if (m_checkAlways)
+				return false;
+			for (const Breakpoint& breakpoint : m_breakpoints)
+				traps[breakpoint.address & (traps.size() - 1)] = 1;
+			return true;
+		}
+
+		// One line describing `breakpoint`.
+		static std::string describe(const Breakpoint& breakpoint)
+		{
+			std::string text = "#" + std::to_string(breakpoint.id) + " ";
+			switch (breakpoint.kind)
+			{
+			case BreakpointKind::Address:
+				text += "break at 0x" + u16_hex(breakpoint.address);
+				if (breakpoint.conditional) text += " if " + breakpoint.condition.text();
+				break;
+			case BreakpointKind::Memory:
+				text += "watch [0x" + u16_hex(breakpoint.address) + "]";
+				if (breakpoint.length > 1) text += " + " + std::to_string(breakpoint.length) + " bytes";
+				break;
+			case BreakpointKind::Register:
+				text += breakpoint.reg == 16 ? std::string("watch I") : std::string("watch V") + "0123456789ABCDEF"[breakpoint.reg];
+				break;
+			case BreakpointKind::Condition:
+				text += "stop if " + breakpoint.condition.text();
+				break;
+			}
+			return text;
+		}
+
+	private:
+		// PC wrapped into the memory of the target, where the instruction is fetched from.
+		static u16 address(const Chip8Debugger& debugger)
+		{
+			return u16(debugger.pc() & (debugger.memorySize() - 1));
+		}
+
+		static bool stopsAt(const Breakpoint& breakpoint, const Chip8Debugger& debugger)
+		{
+			return breakpoint.address == address(debugger) && (!breakpoint.conditional || breakpoint.condition.evaluate(debugger));
+		}
+
+		static std::string u16_hex(unsigned value)
+		{
+			const char* digits = "0123456789abcdef";
+			std::string text;
+			do
+			{
+				text.insert(text.begin(), digits[value & 0xF]);
+				value >>= 4;
+			} while (value != 0);
+			return text;
+		}
+
+		unsigned add(BreakpointKind kind, u16 address, u16 length, u8 reg, const Predicate* condition)
+		{
+			Breakpoint breakpoint{ m_nextId++, kind, address, length, reg, condition != nullptr, condition ? *condition : Predicate{}, {} };
+			m_breakpoints.push_back(breakpoint);
+			rebuild();
+			return breakpoint.id;
+		}
+
+		void rebuild()
+		{
+			std::fill(m_atAddress.begin(), m_atAddress.end(), u8(0));
+			m_checkAlways = false;
+			m_hit = nullptr;
+			for (const Breakpoint& breakpoint : m_breakpoints)
+			{
+				if (breakpoint.kind == BreakpointKind::Address) m_atAddress[breakpoint.address] = 1;
+				else m_checkAlways = true;
+			}
+		}
+
+		// Store the current value of a watchpoint. Returns true if it changed.
+		static bool capture(const Chip8Debugger& debugger, Breakpoint& breakpoint)
+		{
+			if (breakpoint.kind != BreakpointKind::Memory && breakpoint.kind != BreakpointKind::Register)
+				return false;
+
+			const unsigned length = breakpoint.kind == BreakpointKind::Memory ? breakpoint.length : 2;
+			breakpoint.watched.resize(length);
+			bool changed = false;
+			for (unsigned j = 0; j < length; ++j)
+			{
+				u8 value;
+				if (breakpoint.kind == BreakpointKind::Memory) value = debugger.memory(breakpoint.address + j);
+				else if (breakpoint.reg == 16) value = u8(debugger.i() >> (j == 0 ? 8 : 0));
+				else value = j == 0 ? debugger.v(breakpoint.reg) : 0;
+
+				changed |= breakpoint.watched[j] != value;
+				breakpoint.watched[j] = value;
+			}
+			return changed;
+		}
+	};
+}
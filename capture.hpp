@@ -0,0 +1,188 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+
+#include "debugger.hpp"
+
+namespace c8s
+{
+	// One line of a frame log.
+	struct CapturedFrame
+	{
+		std::uint64_t frame;
+		std::uint64_t cycle;	// Instructions executed when the frame ended.
+		std::uint64_t hash;		// See `display_hash`.
+	};
+
+	// Where a run first differed from its golden log.
+	enum class Divergence
+	{
+		None,
+		Frame,			// A frame has another hash or ended at another cycle.
+		GoldenShorter,	// The run has more frames than the golden log.
+		GoldenLonger	// The run stopped before the end of the golden log.
+	};
+
+	// Hash of the `words` std::uint64_t of a display, DISPLAY_H for 64x32 pixels.
+	std::uint64_t display_hash(const std::uint64_t* display, unsigned words = DISPLAY_H)
+	{
+		return fnv1a(display, words * sizeof(std::uint64_t));
+	}
+
+	// Write a display of `width` x `height` pixels as a binary PBM. Its rows are packed most
+	// significant bit first, which is the byte order of a display word read from the top.
+	bool write_pbm(const std::string& fileName, const std::uint64_t* display, unsigned width = DISPLAY_W, unsigned height = DISPLAY_H)
+	{
+		std::ofstream ofs{ fileName, std::ios::binary };
+		ofs << "P4\n" << width << ' ' << height << '\n';
+		for (unsigned j = 0; j < height * (width / 64); ++j)
+		{
+			for (int shift = 56; shift >= 0; shift -= 8)
+				ofs.put(char((display[j] >> shift) & 0xFF));
+		}
+		return bool(ofs);
+	}
+
+	// Hashes the display after every frame and writes a log line per frame: the frame number,
+	// the cycle and the hash, in hex. Frames not seen before are also saved as
+	// `<directory>/frame-<hash>.pbm`. Given a golden log, every frame is compared with the next
+	// line of it as it comes in, and the first difference is kept.
+	class FrameCapture
+	{
+		std::string m_directory;
+		std::ostream* m_log;
+		std::istream* m_golden;
+		std::unordered_set<std::uint64_t> m_seen;
+		std::uint64_t m_frames;
+		std::uint64_t m_written;
+		bool m_failed;
+		Divergence m_divergence;
+		CapturedFrame m_actual, m_expected;
+
+	public:
+		// Without a directory no images are written.
+		explicit FrameCapture(std::string directory = "")
+			: m_directory{ std::move(directory) }, m_log{ nullptr }, m_golden{ nullptr },
+			m_frames{ 0 }, m_written{ 0 }, m_failed{ false }, m_divergence{ Divergence::None }, m_actual{}, m_expected{} {}
+
+		void setLog(std::ostream* log) { m_log = log; }
+		void setGolden(std::istream* golden) { m_golden = golden; }
+
+		void capture(const Chip8Debugger& debugger)
+		{
+			// The first plane in the current resolution.
+			const unsigned width = debugger.displayWidth(), height = debugger.displayHeight();
+			const CapturedFrame frame{ m_frames++, debugger.cycles(), display_hash(debugger.display(), height * (width / 64)) };
+			if (m_log)
+				*m_log << std::dec << frame.frame << ' ' << frame.cycle << " 0x" << std::hex << std::setw(16) << std::setfill('0') << frame.hash << std::setfill(' ') << std::dec << '\n';
+			if (m_seen.insert(frame.hash).second && !m_directory.empty())
+			{
+				if (write_pbm(imageName(frame.hash), debugger.display(), width, height)) ++m_written;
+				else m_failed = true;
+			}
+			if (m_golden && m_divergence == Divergence::None)
+			{
+				CapturedFrame expected{};
+				if (!readFrame(*m_golden, expected)) diverge(Divergence::GoldenShorter, frame, expected);
+				else if (expected.hash != frame.hash || expected.cycle != frame.cycle) diverge(Divergence::Frame, frame, expected);
+			}
+		}
+
+		// Call after the run: a golden log with frames left over diverges as well.
+		bool finishGolden()
+		{
+			CapturedFrame expected{};
+			if (m_golden && m_divergence == Divergence::None && readFrame(*m_golden, expected))
+				diverge(Divergence::GoldenLonger, CapturedFrame{ m_frames, 0, 0 }, expected);
+			return m_divergence == Divergence::None;
+		}
+
+		std::uint64_t frames() const { return m_frames; }
+		std::uint64_t distinctFrames() const { return m_seen.size(); }
+		std::uint64_t imagesWritten() const { return m_written; }
+		bool writeFailed() const { return m_failed; }
+
+		Divergence divergence() const { return m_divergence; }
+		const CapturedFrame& divergedActual() const { return m_actual; }
+		const CapturedFrame& divergedExpected() const { return m_expected; }
+
+		void printDivergence(std::ostream& os) const
+		{
+			os << std::dec;
+			switch (m_divergence)
+			{
+			case Divergence::None: os << "All " << m_frames << " frames match the golden log\n"; break;
+			case Divergence::Frame:
+				os << "Frame " << m_actual.frame << " differs from the golden log: cycle " << m_actual.cycle << ", hash 0x" << std::hex << m_actual.hash
+					<< std::dec << ", expected cycle " << m_expected.cycle << ", hash 0x" << std::hex << m_expected.hash << std::dec << '\n';
+				break;
+			case Divergence::GoldenShorter: os << "The golden log ends before frame " << m_actual.frame << " (cycle " << m_actual.cycle << ")\n"; break;
+			case Divergence::GoldenLonger: os << "The run stopped before frame " << m_expected.frame << " of the golden log (cycle " << m_expected.cycle << ")\n"; break;
+			}
+		}
+
+		std::string imageName(std::uint64_t hash) const
+		{
+			std::ostringstream oss;
+			oss << m_directory << "/frame-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".pbm";
+			return oss.str();
+		}
+
+		// Parse the next frame line of a log. Returns false at its end.
+		static bool readFrame(std::istream& is, CapturedFrame& frame)
+		{
+			std::string line;
+			while (std::getline(is, line))
+			{
+				std::istringstream iss{ line };
+				std::string hash;
+				if (iss >> frame.frame >> frame.cycle >> hash)
+				{
+					frame.hash = std::strtoull(hash.c_str(), nullptr, 16);
+					return true;
+				}
+			}
+			return false;
+		}
+
+	private:
+		void diverge(Divergence divergence, const CapturedFrame& actual, const CapturedFrame& expected)
+		{
+			m_divergence = divergence;
+			m_actual = actual;
+			m_expected = expected;
+		}
+	};
+}
@@ -0,0 +1,250 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The allocation hooks need the real size of a heap block on `delete`.
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define C8S_ALLOCATION_SIZE(ptr) malloc_usable_size(ptr)
+#elif defined(_MSC_VER)
+#include <malloc.h>
+#define C8S_ALLOCATION_SIZE(ptr) _msize(ptr)
+#else
+#define C8S_NO_ALLOCATION_HOOKS
+#endif
+
+namespace c8s
+{
+	// Counts heap allocations while `enabled` is set. While an `AllocationScope` is open `tracking`
+	// keeps `current_bytes` up to date between phases as well, so the peak of a phase includes what
+	// earlier phases still hold. Switched off, the hooks below cost a single branch per allocation.
+	struct allocation_stats
+	{
+		static bool enabled;
+		static bool tracking;
+		static std::size_t allocations;
+		static long long current_bytes;
+		static long long peak_bytes;
+
+		// Start counting the allocations of a phase from zero.
+		static void restart()
+		{
+			allocations = 0;
+			peak_bytes = current_bytes;
+		}
+	};
+
+	bool allocation_stats::enabled = false;
+	bool allocation_stats::tracking = false;
+	std::size_t allocation_stats::allocations = 0;
+	long long allocation_stats::current_bytes = 0;
+	long long allocation_stats::peak_bytes = 0;
+
+	// Tracks the held bytes from construction to destruction, around all phases of one run.
+	// Does nothing if `active` is false.
+	class AllocationScope
+	{
+		bool m_active;
+
+	public:
+		explicit AllocationScope(bool active) : m_active{ active }
+		{
+			if (!m_active)
+				return;
+			allocation_stats::current_bytes = 0;
+			allocation_stats::tracking = true;
+		}
+
+		~AllocationScope()
+		{
+			if (!m_active)
+				return;
+			allocation_stats::tracking = false;
+			allocation_stats::current_bytes = 0;
+		}
+
+		AllocationScope(const AllocationScope&) = delete;
+		AllocationScope& operator=(const AllocationScope&) = delete;
+	};
+
+	// Measurements of a single compiler phase.
+	struct PhaseStats
+	{
+		std::string name;
+		double milliseconds;
+		std::size_t items;
+		std::string unit;
+		std::size_t allocations;
+		long long peak_bytes;
+	};
+
+	// Measurements of all phases of one compiler run.
+	struct CompileStats
+	{
+		std::vector<PhaseStats> phases;
+
+		double total_milliseconds() const
+		{
+			double total = 0.0;
+			for (const auto& phase : phases) total += phase.milliseconds;
+			return total;
+		}
+
+		// Print the phases as a human readable table.
+		void print_table(std::ostream& os) const
+		{
+			auto old_flags = os.flags();
+			auto old_precision = os.precision();
+			os << std::left << std::setw(12) << "phase"
+				<< std::right << std::setw(12) << "time [ms]"
+				<< std::setw(18) << "items"
+				<< std::setw(10) << "allocs"
+				<< std::setw(14) << "peak [bytes]" << '\n';
+			for (const auto& phase : phases)
+			{
+				os << std::left << std::setw(12) << phase.name
+					<< std::right << std::setw(12) << std::fixed << std::setprecision(3) << phase.milliseconds
+					<< std::setw(10) << std::dec << phase.items << ' ' << std::left << std::setw(7) << phase.unit
+					<< std::right << std::setw(10) << phase.allocations
+					<< std::setw(14) << phase.peak_bytes << '\n';
+			}
+			os << std::left << std::setw(12) << "total"
+				<< std::right << std::setw(12) << std::fixed << std::setprecision(3) << total_milliseconds() << '\n';
+			os.flags(old_flags);
+			os.precision(old_precision);
+		}
+
+		// Print the phases as a single JSON object.
+		void print_json(std::ostream& os) const
+		{
+			auto old_flags = os.flags();
+			auto old_precision = os.precision();
+			os << "{\"total_ms\":" << std::fixed << std::setprecision(6) << total_milliseconds() << ",\"phases\":[";
+			for (unsigned i = 0; i < phases.size(); ++i)
+			{
+				const auto& phase = phases[i];
+				os << (i == 0 ? "" : ",")
+					<< "{\"name\":\"" << phase.name << "\""
+					<< ",\"ms\":" << phase.milliseconds
+					<< ",\"items\":" << std::dec << phase.items
+					<< ",\"unit\":\"" << phase.unit << "\""
+					<< ",\"allocations\":" << phase.allocations
+					<< ",\"peak_bytes\":" << phase.peak_bytes << "}";
+			}
+			os << "]}\n";
+			os.flags(old_flags);
+			os.precision(old_precision);
+		}
+	};
+
+	// Measures a phase from construction until `stop()`.
+	class PhaseTimer
+	{
+		CompileStats& m_stats;
+		const char* m_name;
+		std::chrono::steady_clock::time_point m_start, m_end;
+
+	public:
+		PhaseTimer(CompileStats& stats, const char* name)
+			: m_stats{ stats }, m_name{ name }
+		{
+			allocation_stats::restart();
+			allocation_stats::enabled = true;
+			m_start = std::chrono::steady_clock::now();
+		}
+
+		void stop()
+		{
+			m_end = std::chrono::steady_clock::now();
+			allocation_stats::enabled = false;
+		}
+
+		// Append the measured phase to the stats.
+		void finish(std::size_t items, const char* unit)
+		{
+			double ms = std::chrono::duration<double, std::milli>(m_end - m_start).count();
+			m_stats.phases.push_back(PhaseStats{ m_name, ms, items, unit, allocation_stats::allocations, allocation_stats::peak_bytes });
+		}
+	};
+
+	// Run `phase` and return its result. If `stats` is given, the phase is measured and
+	// `count` is used to read the number of produced items from the result.
+	template<typename Phase, typename Counter>
+	auto run_phase(CompileStats* stats, const char* name, const char* unit, Phase phase, Counter count)
+	{
+		if (!stats)
+			return phase();
+
+		PhaseTimer timer{ *stats, name };
+		auto result = phase();
+		timer.stop();
+		timer.finish(count(result), unit);
+		return result;
+	}
+}
+
+#ifndef C8S_NO_ALLOCATION_HOOKS
+
+// Replacement allocation functions. Only one translation unit may include this header.
+void* operator new(std::size_t size)
+{
+	void* ptr = std::malloc(size != 0 ? size : 1);
+	if (ptr == nullptr)
+		throw std::bad_alloc{};
+
+	if (c8s::allocation_stats::tracking)
+	{
+		c8s::allocation_stats::current_bytes += C8S_ALLOCATION_SIZE(ptr);
+		if (c8s::allocation_stats::enabled)
+		{
+			++c8s::allocation_stats::allocations;
+			if (c8s::allocation_stats::current_bytes > c8s::allocation_stats::peak_bytes)
+				c8s::allocation_stats::peak_bytes = c8s::allocation_stats::current_bytes;
+		}
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (ptr != nullptr && c8s::allocation_stats::tracking)
+		c8s::allocation_stats::current_bytes -= C8S_ALLOCATION_SIZE(ptr);
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+#endif
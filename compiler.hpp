@@ -1,61 +1,95 @@
-/*
-* MIT License
-*
-* Copyright(c) 2018 Paul Bernitz
-*
-* Permission is hereby granted, free of charge, to any person obtaining a copy
-* of this software and associated documentation files(the "Software"), to deal
-* in the Software without restriction, including without limitation the rights
-* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-* copies of the Software, and to permit persons to whom the Software is
-* furnished to do so, subject to the following conditions :
-*
-* The above copyright notice and this permission notice shall be included in all
-* copies or substantial portions of the Software.
-*
-* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
-* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-* SOFTWARE.
-*/
-
-#pragma once
-
-#include "meta-gen.hpp"
-#include "opcode-gen.hpp"
-#include "compiler_log.hpp"
-#include "debug-output.hpp"
-
-namespace c8s
-{
-	// Compiles chip-8 script into chip-8 machinecode.
-	std::vector<u16> compile(std::string c8s_input_code, bool print_errors=false, bool print_intermediates=false)
-	{
-		// Reset the log.
-		compiler_log::reset_all();
-
-		// Parse.
-		auto tokens = split_code_into_tokens(c8s_input_code);
-		if(print_intermediates) print_tokens(tokens);
-		auto ast = parse_tokens_to_ast(tokens);
-		if (print_intermediates) print_ast(ast);
-
-		// Generate.
-		auto meta = generate_meta_opcodes(ast);
-		if (print_intermediates) print_meta(meta);
-		auto ops = create_opcodes_from_meta(meta);
-		if (print_intermediates) print_opcodes(ops);
-
-		// Evaluate the log.
-		if(print_errors && compiler_log::read_errors().size() != 0)
-		{
-			for (const auto& err_line : compiler_log::read_errors())
-				std::cerr << err_line << '\n';
-		}
-
-		return ops;
-	}
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include "meta-gen.hpp"
+#include "opcode-gen.hpp"
+#include "compiler_log.hpp"
+#include "compile-stats.hpp"
+#include "debug-output.hpp"
+#include "target.hpp"
+
+namespace c8s
+{
+	// Compiles chip-8 script into chip-8 machinecode.
+	// If `stats` is given, every phase is timed and its allocations are counted.
+	// If `line_table` is given, it receives the ROM address of every source statement.
+	// The ROM has to fit into the memory of `target`. Jumps and calls only reach the first 4 KB,
+	// on XO-CHIP the code after them runs on past 0x1000.
+	std::vector<u16> compile(const std::string& c8s_input_code, bool print_errors=false, bool print_intermediates=false, CompileStats* stats=nullptr, LineTable* line_table=nullptr, Target target=Target::Chip8)
+	{
+		// Reset the log.
+		compiler_log::reset_all();
+		AllocationScope allocation_scope{ stats != nullptr };
+
+		// Parse.
+		auto tokens = run_phase(stats, "tokenize", "tokens",
+			[&] { return split_code_into_tokens(c8s_input_code); },
+			[](const std::vector<Token>& t) { return t.size(); });
+		if(print_intermediates) diagnostics::write_stream(Severity::Info, [&](std::ostream& os) { print_tokens(tokens, os); });
+		auto statements = run_phase(stats, "parse", "nodes",
+			[&] { return parse_tokens_to_statements(tokens); },
+			[](const ASTNode& n) { return count_ast_nodes(n); });
+		auto ast = run_phase(stats, "structure", "nodes",
+			[&] { return structure_statements(std::move(statements)); },
+			[](const ASTNode& n) { return count_ast_nodes(n); });
+		if (print_intermediates) diagnostics::write_stream(Severity::Info, [&](std::ostream& os) { print_ast(ast, os); });
+
+		// Generate.
+		auto meta = run_phase(stats, "meta", "opcodes",
+			[&] { return generate_meta_opcodes(ast, line_table); },
+			[](const std::vector<std::string>& m) { return m.size(); });
+		if (print_intermediates) diagnostics::write_stream(Severity::Info, [&](std::ostream& os) { print_meta(meta, os); });
+		auto ops = run_phase(stats, "labels", "opcodes",
+			[&] { return create_opcodes_from_meta(meta); },
+			[](const std::vector<u16>& o) { return o.size(); });
+		if (print_intermediates) diagnostics::write_stream(Severity::Info, [&](std::ostream& os) { print_opcodes(ops, os); });
+		if (ops.size() * 2 > target_memory_size(target) - 0x200)
+		{
+			compiler_log::write_error("The program needs " + std::to_string(ops.size() * 2) + " bytes, more than fit into the memory of the target");
+			ops.clear();
+		}
+
+		// Evaluate the log.
+		if (print_errors)
+		{
+			for (const auto& warning_line : compiler_log::read_warnings())
+				diagnostics::warning([&] { return "warning: " + warning_line; });
+			for (const auto& err_line : compiler_log::read_errors())
+				diagnostics::error([&] { return err_line; });
+		}
+
+		return ops;
+	}
+
+	// Write the finished opcodes to a ROM file and add the `write` phase to `stats` if given.
+	void write_opcodes_to_file(std::vector<u16> opcodes, std::string file_path, CompileStats* stats)
+	{
+		AllocationScope allocation_scope{ stats != nullptr };
+		run_phase(stats, "write", "bytes",
+			[&] { write_opcodes_to_file(opcodes, file_path); return opcodes.size() * sizeof(u16); },
+			[](std::size_t bytes) { return bytes; });
+	}
 }
\ No newline at end of file
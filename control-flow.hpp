@@ -0,0 +1,457 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "debugger.hpp"
+
+// Index of I in a `RegisterSet`, after V0 to VF.
+#define REGISTER_I 0x10
+// `ControlFlowGraph::block_at` of addresses where no instruction starts.
+#define NO_BLOCK 0xFFFF
+
+namespace c8s
+{
+	u16 fetch_opcode(const u8* memory, unsigned address)
+	{
+		return u16(memory[address % MEMORY_SIZE] << 8 | memory[(address + 1) % MEMORY_SIZE]);
+	}
+
+	// Why control moves from one block to another.
+	enum class EdgeKind : u8
+	{
+		Fallthrough,	// Into the next instruction, also when a skip doesn't skip.
+		Jump,			// 1NNN.
+		Skip,			// Over the next instruction.
+		Call,			// 2NNN into the subroutine.
+		Return,			// 00EE to the instruction after any CALL. Returns aren't matched to their calls.
+		Table			// BNNN to one of the 256 addresses after NNN.
+	};
+
+	struct ControlFlowEdge
+	{
+		u16 from;	// Block indices.
+		u16 to;
+		EdgeKind kind;
+	};
+
+	// A run of instructions that is only entered at `start` and only left after its last instruction.
+	struct BasicBlock
+	{
+		u16 start;
+		u16 end;					// Address after the last instruction.
+		unsigned first_successor;	// Into `ControlFlowGraph::successors`.
+		unsigned successor_count;
+		unsigned first_predecessor;	// Into `ControlFlowGraph::predecessors`.
+		unsigned predecessor_count;
+	};
+
+	// The blocks of the code reachable from the program start, sorted by address. Code reached
+	// through instructions a ROM writes at run time is invisible to it.
+	struct ControlFlowGraph
+	{
+		std::bitset<MEMORY_SIZE> reachable;	// Instructions start at these addresses.
+		std::vector<BasicBlock> blocks;
+		std::vector<ControlFlowEdge> successors;	// Grouped by `from`.
+		std::vector<ControlFlowEdge> predecessors;	// Grouped by `to`.
+		std::vector<u16> block_at;			// Block of the instruction at an address, or NO_BLOCK.
+	};
+
+	// The branch that ends a block, as opposed to instructions that continue with the next one.
+	bool is_control_transfer(Op op)
+	{
+		switch (op)
+		{
+		case Op::Jp: case Op::Call: case Op::Ret: case Op::JpV0: case Op::End: case Op::Unknown:
+		case Op::SeByte: case Op::SneByte: case Op::SeReg: case Op::SneReg: case Op::Skp: case Op::Sknp:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Follows every branch from `entry`. BNNN may land on any of the 256 addresses after NNN and
+	// RET on any instruction after a CALL, so all of them start blocks.
+	ControlFlowGraph build_control_flow_graph(const u8* memory, unsigned entry = PROGRAM_START)
+	{
+		ControlFlowGraph cfg;
+		std::bitset<MEMORY_SIZE> leaders;
+		std::vector<u16> work, return_sites;
+		auto branch = [&](unsigned target)
+		{
+			if (target >= MEMORY_SIZE) return;
+			leaders.set(target);
+			work.push_back(u16(target));
+		};
+		branch(entry);
+
+		while (!work.empty())
+		{
+			unsigned address = work.back();
+			work.pop_back();
+			while (address < MEMORY_SIZE && !cfg.reachable[address])
+			{
+				cfg.reachable.set(address);
+				const DecodedInstruction d = decode_instruction(fetch_opcode(memory, address));
+				switch (d.op)
+				{
+				case Op::Jp: branch(d.nnn); break;
+				case Op::Call: branch(d.nnn); branch(address + 2); return_sites.push_back(u16(address + 2)); break;
+				case Op::JpV0: for (unsigned k = 0; k < 0x100; ++k) branch(d.nnn + k); break;
+				case Op::SeByte: case Op::SneByte: case Op::SeReg: case Op::SneReg: case Op::Skp: case Op::Sknp:
+					branch(address + 2); branch(address + 4); break;
+				default: break;
+				}
+				if (is_control_transfer(d.op))
+					break;
+				address += 2;
+
+				// Falling into code that was already visited splits the block there.
+				if (address < MEMORY_SIZE && cfg.reachable[address])
+					leaders.set(address);
+			}
+		}
+
+		// Cut the reachable code at the leaders and after every control transfer.
+		cfg.block_at.assign(MEMORY_SIZE, NO_BLOCK);
+		std::vector<Op> last_ops;
+		for (unsigned start = 0; start < MEMORY_SIZE; ++start)
+		{
+			if (!leaders[start] || !cfg.reachable[start]) continue;
+			const u16 index = u16(cfg.blocks.size());
+			unsigned address = start;
+			Op op;
+			for (;;)
+			{
+				cfg.block_at[address] = index;
+				op = decode_instruction(fetch_opcode(memory, address)).op;
+				address += 2;
+				if (is_control_transfer(op) || address >= MEMORY_SIZE || leaders[address] || !cfg.reachable[address]) break;
+			}
+			cfg.blocks.push_back(BasicBlock{ u16(start), u16(address), 0, 0, 0, 0 });
+			last_ops.push_back(op);
+		}
+
+		// Connect the blocks.
+		for (unsigned index = 0; index < cfg.blocks.size(); ++index)
+		{
+			BasicBlock& block = cfg.blocks[index];
+			block.first_successor = unsigned(cfg.successors.size());
+			auto edge = [&](unsigned target, EdgeKind kind)
+			{
+				if (target < MEMORY_SIZE && cfg.block_at[target] != NO_BLOCK)
+					cfg.successors.push_back(ControlFlowEdge{ u16(index), cfg.block_at[target], kind });
+			};
+			const unsigned last = block.end - 2;
+			const DecodedInstruction d = decode_instruction(fetch_opcode(memory, last));
+			switch (last_ops[index])
+			{
+			case Op::Jp: edge(d.nnn, EdgeKind::Jump); break;
+			case Op::Call: edge(d.nnn, EdgeKind::Call); break;
+			case Op::Ret: for (u16 site : return_sites) edge(site, EdgeKind::Return); break;
+			case Op::JpV0: for (unsigned k = 0; k < 0x100; ++k) edge(d.nnn + k, EdgeKind::Table); break;
+			case Op::End: case Op::Unknown: break;
+			case Op::SeByte: case Op::SneByte: case Op::SeReg: case Op::SneReg: case Op::Skp: case Op::Sknp:
+				edge(block.end, EdgeKind::Fallthrough);
+				edge(block.end + 2, EdgeKind::Skip);
+				break;
+			default: edge(block.end, EdgeKind::Fallthrough); break;
+			}
+			block.successor_count = unsigned(cfg.successors.size()) - block.first_successor;
+		}
+
+		// The same edges grouped by their target.
+		std::vector<unsigned> counts(cfg.blocks.size() + 1, 0);
+		for (const ControlFlowEdge& edge : cfg.successors) ++counts[edge.to + 1];
+		for (unsigned index = 0; index < cfg.blocks.size(); ++index)
+		{
+			counts[index + 1] += counts[index];
+			cfg.blocks[index].first_predecessor = counts[index];
+			cfg.blocks[index].predecessor_count = 0;
+		}
+		cfg.predecessors.resize(cfg.successors.size());
+		for (const ControlFlowEdge& edge : cfg.successors)
+		{
+			BasicBlock& target = cfg.blocks[edge.to];
+			cfg.predecessors[target.first_predecessor + target.predecessor_count++] = edge;
+		}
+		return cfg;
+	}
+
+	// A set of registers, V0 to VF are bits 0 to 15 and I is bit REGISTER_I.
+	typedef std::uint32_t RegisterSet;
+
+	// Registers an instruction reads and writes. `must_defs` are written under every quirk profile,
+	// `may_defs` under some: FX55 and FX65 only move I with the COSMAC quirks.
+	struct RegisterEffect
+	{
+		RegisterSet uses;
+		RegisterSet must_defs;
+		RegisterSet may_defs;
+	};
+
+	RegisterEffect register_effect(const DecodedInstruction& d)
+	{
+		const RegisterSet vx = 1u << d.x, vy = 1u << d.y, vf = 1u << 0xF, i = 1u << REGISTER_I;
+		const RegisterSet up_to_x = (2u << d.x) - 1;
+		RegisterEffect e{ 0, 0, 0 };
+		switch (d.op)
+		{
+		case Op::SeByte: case Op::SneByte: case Op::Skp: case Op::Sknp: case Op::LdDtVx: case Op::LdStVx: e.uses = vx; break;
+		case Op::SeReg: case Op::SneReg: e.uses = vx | vy; break;
+		case Op::LdByte: case Op::Rnd: case Op::LdVxDt: case Op::LdVxKey: e.must_defs = vx; break;
+		case Op::AddByte: e.uses = vx; e.must_defs = vx; break;
+		case Op::LdReg: e.uses = vy; e.must_defs = vx; break;
+		case Op::Or: case Op::And: case Op::Xor: e.uses = vx | vy; e.must_defs = vx; break;
+		case Op::AddReg: case Op::Sub: case Op::Subn: e.uses = vx | vy; e.must_defs = vx | vf; break;
+		case Op::Shr: case Op::Shl: e.uses = vx | vy; e.must_defs = vx | vf; break;	// VY with the COSMAC quirks.
+		case Op::LdI: e.must_defs = i; break;
+		case Op::JpV0: e.uses = 1u | vx; break;	// VX with the SUPER-CHIP quirks.
+		case Op::Drw: e.uses = vx | vy | i; e.must_defs = vf; break;
+		case Op::AddIVx: e.uses = i | vx; e.must_defs = i; break;
+		case Op::LdFVx: e.uses = vx; e.must_defs = i; break;
+		case Op::LdBcd: e.uses = vx | i; break;
+		case Op::StoreRegs: e.uses = up_to_x | i; e.may_defs = i; break;
+		case Op::LoadRegs: e.uses = i; e.must_defs = up_to_x; e.may_defs = i; break;
+		default: break;
+		}
+		e.may_defs |= e.must_defs;
+		return e;
+	}
+
+	// Registers live on entry to and exit from every block. A register is live if some path
+	// reads it before it is written.
+	struct Liveness
+	{
+		std::vector<RegisterSet> live_in;
+		std::vector<RegisterSet> live_out;
+	};
+
+	Liveness compute_liveness(const ControlFlowGraph& cfg, const u8* memory)
+	{
+		const unsigned count = unsigned(cfg.blocks.size());
+		std::vector<RegisterSet> uses(count, 0), defs(count, 0);
+		for (unsigned index = 0; index < count; ++index)
+		{
+			// Backwards through the block: a use before any write in the block is exposed.
+			const BasicBlock& block = cfg.blocks[index];
+			for (unsigned address = block.end; address > block.start;)
+			{
+				address -= 2;
+				const RegisterEffect e = register_effect(decode_instruction(fetch_opcode(memory, address)));
+				uses[index] = (uses[index] & ~e.must_defs) | e.uses;
+				defs[index] |= e.must_defs;
+			}
+		}
+
+		Liveness liveness{ std::vector<RegisterSet>(count, 0), std::vector<RegisterSet>(count, 0) };
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			for (unsigned index = count; index-- > 0;)
+			{
+				const BasicBlock& block = cfg.blocks[index];
+				RegisterSet out = 0;
+				for (unsigned j = 0; j < block.successor_count; ++j)
+					out |= liveness.live_in[cfg.successors[block.first_successor + j].to];
+				const RegisterSet in = uses[index] | (out & ~defs[index]);
+				changed = changed || in != liveness.live_in[index] || out != liveness.live_out[index];
+				liveness.live_in[index] = in;
+				liveness.live_out[index] = out;
+			}
+		}
+		return liveness;
+	}
+
+	// Registers live right before the instruction at `address`, 0 if no instruction starts there.
+	RegisterSet live_before(const ControlFlowGraph& cfg, const Liveness& liveness, const u8* memory, unsigned address)
+	{
+		if (address >= MEMORY_SIZE || cfg.block_at[address] == NO_BLOCK)
+			return 0;
+		const unsigned index = cfg.block_at[address];
+		RegisterSet live = liveness.live_out[index];
+		for (unsigned at = cfg.blocks[index].end; at > address;)
+		{
+			at -= 2;
+			const RegisterEffect e = register_effect(decode_instruction(fetch_opcode(memory, at)));
+			live = (live & ~e.must_defs) | e.uses;
+		}
+		return live;
+	}
+
+	// A write of one register by one instruction.
+	struct Definition
+	{
+		u16 address;
+		u8 reg;
+	};
+
+	// The definitions that reach the entry of every block. They are numbered by register, so the
+	// definitions of register `r` are the bits `first_of[r]` up to `first_of[r + 1]` of every set.
+	struct ReachingDefinitions
+	{
+		std::vector<Definition> definitions;
+		unsigned first_of[REGISTER_I + 2];
+		unsigned words;						// 64 bit words per set.
+		std::vector<std::uint64_t> in;		// `words` per block.
+	};
+
+	void clear_bits(std::uint64_t* set, unsigned first, unsigned last)
+	{
+		if (first >= last)
+			return;
+		const unsigned first_word = first / 64, last_word = (last - 1) / 64;
+		const std::uint64_t head = ~std::uint64_t(0) << (first % 64);
+		const std::uint64_t tail = ~std::uint64_t(0) >> (63 - (last - 1) % 64);
+		if (first_word == last_word)
+		{
+			set[first_word] &= ~(head & tail);
+			return;
+		}
+		set[first_word] &= ~head;
+		for (unsigned w = first_word + 1; w < last_word; ++w) set[w] = 0;
+		set[last_word] &= ~tail;
+	}
+
+	ReachingDefinitions compute_reaching_definitions(const ControlFlowGraph& cfg, const u8* memory)
+	{
+		ReachingDefinitions rd;
+		const unsigned count = unsigned(cfg.blocks.size());
+
+		// Number the definitions by register.
+		unsigned next[REGISTER_I + 1] = {};
+		for (const BasicBlock& block : cfg.blocks)
+		{
+			for (unsigned address = block.start; address < block.end; address += 2)
+			{
+				const RegisterSet defs = register_effect(decode_instruction(fetch_opcode(memory, address))).may_defs;
+				for (unsigned reg = 0; reg <= REGISTER_I; ++reg) next[reg] += (defs >> reg) & 1;
+			}
+		}
+		rd.first_of[0] = 0;
+		for (unsigned reg = 0; reg <= REGISTER_I; ++reg)
+		{
+			rd.first_of[reg + 1] = rd.first_of[reg] + next[reg];
+			next[reg] = rd.first_of[reg];
+		}
+		rd.definitions.resize(rd.first_of[REGISTER_I + 1]);
+		const unsigned words = rd.words = unsigned(rd.definitions.size() + 63) / 64;
+
+		// A block kills all definitions of the registers it always writes and generates its own
+		// last writes of every register.
+		std::vector<RegisterSet> kill(count, 0);
+		std::vector<unsigned> gen, first_gen(count + 1, 0);
+		for (unsigned index = 0; index < count; ++index)
+		{
+			first_gen[index] = unsigned(gen.size());
+			for (unsigned address = cfg.blocks[index].start; address < cfg.blocks[index].end; address += 2)
+			{
+				const RegisterEffect e = register_effect(decode_instruction(fetch_opcode(memory, address)));
+				kill[index] |= e.must_defs;
+				for (unsigned j = first_gen[index]; j < gen.size();)
+				{
+					if (e.must_defs & (1u << rd.definitions[gen[j]].reg)) gen.erase(gen.begin() + j);
+					else ++j;
+				}
+				for (unsigned reg = 0; reg <= REGISTER_I; ++reg)
+				{
+					if ((e.may_defs & (1u << reg)) == 0) continue;
+					rd.definitions[next[reg]] = Definition{ u16(address), u8(reg) };
+					gen.push_back(next[reg]++);
+				}
+			}
+		}
+		first_gen[count] = unsigned(gen.size());
+
+		// In = union of the predecessors' out, out = gen + (in - kill). Only blocks whose
+		// predecessors changed are visited again.
+		rd.in.assign(std::size_t(count) * words, 0);
+		std::vector<std::uint64_t> out(std::size_t(count) * words, 0), next_out(words);
+		std::vector<bool> dirty(count, true);
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			for (unsigned index = 0; index < count; ++index)
+			{
+				if (!dirty[index])
+					continue;
+				dirty[index] = false;
+
+				const BasicBlock& block = cfg.blocks[index];
+				std::uint64_t* in = &rd.in[std::size_t(index) * words];
+				for (unsigned j = 0; j < block.predecessor_count; ++j)
+				{
+					const std::uint64_t* from = &out[std::size_t(cfg.predecessors[block.first_predecessor + j].from) * words];
+					for (unsigned w = 0; w < words; ++w) in[w] |= from[w];
+				}
+
+				std::copy(in, in + words, next_out.begin());
+				for (unsigned reg = 0; reg <= REGISTER_I; ++reg)
+					if (kill[index] & (1u << reg)) clear_bits(next_out.data(), rd.first_of[reg], rd.first_of[reg + 1]);
+				for (unsigned j = first_gen[index]; j < first_gen[index + 1]; ++j)
+					next_out[gen[j] / 64] |= std::uint64_t(1) << (gen[j] % 64);
+
+				std::uint64_t* block_out = &out[std::size_t(index) * words];
+				if (std::equal(next_out.begin(), next_out.end(), block_out))
+					continue;
+				std::copy(next_out.begin(), next_out.end(), block_out);
+				for (unsigned j = 0; j < block.successor_count; ++j)
+					dirty[cfg.successors[block.first_successor + j].to] = true;
+				changed = true;
+			}
+		}
+		return rd;
+	}
+
+	// Addresses of the instructions whose write of `reg` may reach the instruction at `address`.
+	std::vector<u16> reaching_definitions(const ControlFlowGraph& cfg, const ReachingDefinitions& rd, const u8* memory, unsigned address, unsigned reg)
+	{
+		std::vector<u16> result;
+		if (address >= MEMORY_SIZE || cfg.block_at[address] == NO_BLOCK || reg > REGISTER_I)
+			return result;
+
+		// Start from the block entry and apply the instructions before `address`.
+		const unsigned index = cfg.block_at[address];
+		std::vector<std::uint64_t> reaching(rd.in.begin() + std::ptrdiff_t(index) * rd.words, rd.in.begin() + std::ptrdiff_t(index + 1) * rd.words);
+		for (unsigned at = cfg.blocks[index].start; at < address; at += 2)
+		{
+			const RegisterEffect e = register_effect(decode_instruction(fetch_opcode(memory, at)));
+			if (e.must_defs & (1u << reg))
+				clear_bits(reaching.data(), rd.first_of[reg], rd.first_of[reg + 1]);
+			if (e.may_defs & (1u << reg))
+				for (unsigned id = rd.first_of[reg]; id < rd.first_of[reg + 1]; ++id)
+					if (rd.definitions[id].address == at) reaching[id / 64] |= std::uint64_t(1) << (id % 64);
+		}
+		for (unsigned id = rd.first_of[reg]; id < rd.first_of[reg + 1]; ++id)
+			if (reaching[id / 64] & (std::uint64_t(1) << (id % 64))) result.push_back(rd.definitions[id].address);
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+}
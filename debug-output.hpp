@@ -1,109 +1,109 @@
-/*
-* MIT License
-*
-* Copyright(c) 2018 Paul Bernitz
-*
-* Permission is hereby granted, free of charge, to any person obtaining a copy
-* of this software and associated documentation files(the "Software"), to deal
-* in the Software without restriction, including without limitation the rights
-* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-* copies of the Software, and to permit persons to whom the Software is
-* furnished to do so, subject to the following conditions :
-*
-* The above copyright notice and this permission notice shall be included in all
-* copies or substantial portions of the Software.
-*
-* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
-* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-* SOFTWARE.
-*/
-
-#pragma once
-
-#include "meta-gen.hpp"
-#include "opcode-analyser.hpp"
-
-namespace c8s
-{
-	// Debug output seperator line.
-	void print_separator(bool strong = false)
-	{
-		for (unsigned i = 0; i < 65; ++i)
-			std::cout << ((strong) ? '=' : '-');
-		std::cout << '\n';
-	}
-
-	// Debug output tokens.
-	void print_tokens(const std::vector<c8s::Token>& tokens)
-	{
-		print_separator();
-		std::cout << "1] Split input code into tokens\n";
-		print_separator();
-		for (const auto& e : tokens)
-		{
-			std::cout << "T[" << e.value << "] ";
-			if (e.type == c8s::TokenType::ClosingStatement)
-				std::cout << '\n';
-		}
-		std::cout << '\n';
-	}
-
-	// Debug output ast.
-	void print_ast(c8s::ASTNode node, unsigned depth = 0)
-	{
-		if (depth == 0)
-		{
-			print_separator();
-			std::cout << "2] Parse tokens into abstract syntax tree\n";
-			print_separator();
-		}
-		for (unsigned i = 0; i < depth; ++i) std::cout << "|`\t";
-		//std::cout << "|\n";
-		//for (unsigned i = 0; i < depth; ++i) std::cout << "|\t";
-		std::cout << "+--[";
-		if (node.type == c8s::ASTNodeType::VarExpression) std::cout << "VarExpression, ";
-		if (node.type == c8s::ASTNodeType::NumberLiteral) std::cout << "NumberLiteral, ";
-		if (node.type == c8s::ASTNodeType::VarDeclaration) std::cout << "VarDeclaration, ";
-		if (node.type == c8s::ASTNodeType::Identifier) std::cout << "Identifier, ";
-		if (node.type == c8s::ASTNodeType::Operator) std::cout << "Operator, ";
-		if (node.type == c8s::ASTNodeType::IfStatement) std::cout << "IfStmt, ";
-		if (node.type == c8s::ASTNodeType::ForLoop) std::cout << "ForLoop, ";
-		if (node.type == c8s::ASTNodeType::Program) std::cout << "Program, ";
-		if (node.type == c8s::ASTNodeType::FunctionCall) std::cout << "FunctionCall, ";
-		if (node.type == c8s::ASTNodeType::OpenBrace) std::cout << "Opening brace, ";
-		if (node.type == c8s::ASTNodeType::ClosingBrace) std::cout << "Closing brace, ";
-		std::cout << node.value << "]\n";
-		for (auto& e : node.params)
-		{
-			print_ast(e, depth + 1);
-		}
-	}
-
-	// Debug output meta-opcodes.
-	void print_meta(std::vector<std::string> meta_ops)
-	{
-		print_separator();
-		std::cout << "3] Creating `meta-opcodes` from the AST\n";
-		print_separator();
-		std::cout << "(This is the last step before the finished opcodes.\n";
-		std::cout << "Now we only have to resolve the labels `<1>,<2>..`\n"; 
-		std::cout << "to their line - number at `<!1!> , <!2!>..`)\n";
-		for (auto op : meta_ops)
-		{
-			std::cout << "0x" << op << '\n';
-		}
-	}
-
-	// Debug output opcodes.
-	void print_opcodes(std::vector<u16> opcodes)
-	{
-		print_separator();
-		std::cout << "4] Creating finished opcodes from `meta`\n";
-		print_separator();
-		analyse_opcodes(opcodes);
-	}
-}
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include "meta-gen.hpp"
+#include "opcode-analyser.hpp"
+
+namespace c8s
+{
+	// Debug output seperator line.
+	void print_separator(std::ostream& os, bool strong = false)
+	{
+		for (unsigned i = 0; i < 65; ++i)
+			os << ((strong) ? '=' : '-');
+		os << '\n';
+	}
+
+	// Debug output tokens.
+	void print_tokens(const std::vector<c8s::Token>& tokens, std::ostream& os)
+	{
+		print_separator(os);
+		os << "1] Split input code into tokens\n";
+		print_separator(os);
+		for (const auto& e : tokens)
+		{
+			os << "T[" << e.value << "] ";
+			if (e.type == c8s::TokenType::ClosingStatement)
+				os << '\n';
+		}
+		os << '\n';
+	}
+
+	// Debug output ast.
+	void print_ast(const c8s::ASTNode& node, std::ostream& os, unsigned depth = 0)
+	{
+		if (depth == 0)
+		{
+			print_separator(os);
+			os << "2] Parse tokens into abstract syntax tree\n";
+			print_separator(os);
+		}
+		for (unsigned i = 0; i < depth; ++i) os << "|`\t";
+		//os << "|\n";
+		//for (unsigned i = 0; i < depth; ++i) os << "|\t";
+		os << "+--[";
+		if (node.type == c8s::ASTNodeType::VarExpression) os << "VarExpression, ";
+		if (node.type == c8s::ASTNodeType::NumberLiteral) os << "NumberLiteral, ";
+		if (node.type == c8s::ASTNodeType::VarDeclaration) os << "VarDeclaration, ";
+		if (node.type == c8s::ASTNodeType::Identifier) os << "Identifier, ";
+		if (node.type == c8s::ASTNodeType::Operator) os << "Operator, ";
+		if (node.type == c8s::ASTNodeType::IfStatement) os << "IfStmt, ";
+		if (node.type == c8s::ASTNodeType::ForLoop) os << "ForLoop, ";
+		if (node.type == c8s::ASTNodeType::Program) os << "Program, ";
+		if (node.type == c8s::ASTNodeType::FunctionCall) os << "FunctionCall, ";
+		if (node.type == c8s::ASTNodeType::OpenBrace) os << "Opening brace, ";
+		if (node.type == c8s::ASTNodeType::ClosingBrace) os << "Closing brace, ";
+		os << node.value << "]\n";
+		for (auto& e : node.params)
+		{
+			print_ast(e, os, depth + 1);
+		}
+	}
+
+	// Debug output meta-opcodes.
+	void print_meta(const std::vector<std::string>& meta_ops, std::ostream& os)
+	{
+		print_separator(os);
+		os << "3] Creating `meta-opcodes` from the AST\n";
+		print_separator(os);
+		os << "(This is the last step before the finished opcodes.\n";
+		os << "Now we only have to resolve the labels `<1>,<2>..`\n"; 
+		os << "to their line - number at `<!1!> , <!2!>..`)\n";
+		for (auto op : meta_ops)
+		{
+			os << "0x" << op << '\n';
+		}
+	}
+
+	// Debug output opcodes.
+	void print_opcodes(const std::vector<u16>& opcodes, std::ostream& os)
+	{
+		print_separator(os);
+		os << "4] Creating finished opcodes from `meta`\n";
+		print_separator(os);
+		analyse_opcodes(opcodes, os);
+	}
+}
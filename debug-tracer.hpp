@@ -0,0 +1,305 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "breakpoints.hpp"
+#include "debugger.hpp"
+#include "opcode-analyser.hpp"
+#include "rewind.hpp"
+#include "terminal-display.hpp"
+
+namespace c8s
+{
+	// How the caller should continue after the tracer returned from its prompt.
+	enum class Resume
+	{
+		Step,		// Execute the next instruction.
+		Continue,	// Run at full speed until a breakpoint is hit.
+		NextLine	// Run at full speed until the next source statement.
+	};
+
+	// Prints the registers after every instruction and waits for a command, <return> steps.
+	// With breakpoints attached, `c` runs at full speed until one is hit, and `break <address>
+	// [if <condition>]`, `break line <line>`, `watch <address> [<length>]`, `watch <register>`,
+	// `stop <condition>`, `delete <id>` and `list` manage them. With a line table loaded, `n`
+	// runs to the next source statement, `d` shows the display. With a keypad attached, `key <k>`
+	// presses and `key <k> up` releases a key. With a journal attached, `b` steps back,
+	// `g <cycle>` jumps to a cycle and `m` reports its memory use.
+	class ConsoleTracer : public DebugObserver
+	{
+		std::ostream& m_os;
+		std::istream& m_is;
+		bool m_interactive;
+		RewindJournal* m_journal;
+		BreakpointSet* m_breakpoints;
+		Chip8Debugger* m_keypad;
+		Resume m_resume;
+
+	public:
+		ConsoleTracer(std::ostream& os = std::cout, std::istream& is = std::cin, bool interactive = true)
+			: m_os{ os }, m_is{ is }, m_interactive{ interactive }, m_journal{ nullptr }, m_breakpoints{ nullptr }, m_keypad{ nullptr }, m_resume{ Resume::Step } {}
+
+		void setJournal(RewindJournal* journal) { m_journal = journal; }
+		void setBreakpoints(BreakpointSet* breakpoints) { m_breakpoints = breakpoints; }
+		void setKeypad(Chip8Debugger* debugger) { m_keypad = debugger; }
+
+		// What was requested at the last prompt. Anything but `Resume::Step` is only returned once,
+		// the caller then runs without the tracer until the machine stops again.
+		Resume takeResume()
+		{
+			const Resume resume = m_resume;
+			m_resume = Resume::Step;
+			return resume;
+		}
+
+		void onInstruction(const Chip8Debugger& debugger, u16, u16 instruction) override
+		{
+			printState(debugger, instruction);
+			prompt(debugger);
+		}
+
+		// Show where a run stopped for a breakpoint, source line or key and wait for the next command.
+		void onBreak(const Chip8Debugger& debugger)
+		{
+			if (debugger.stopReason() == StopReason::Breakpoint && m_breakpoints && m_breakpoints->lastHit())
+				m_os << "\nHit " << BreakpointSet::describe(*m_breakpoints->lastHit()) << '\n';
+			if (debugger.stopReason() == StopReason::WaitingForKey)
+				m_os << "\nWaiting for a key, press one with `key <k>`\n";
+			printState(debugger, nextInstruction(debugger));
+			prompt(debugger);
+		}
+
+		void onStop(const Chip8Debugger& debugger, StopReason reason) override
+		{
+			if (reason == StopReason::EndOfProgram)
+				m_os << "<EOP> Press `return` to quit debugging.." << std::endl;
+			else
+				m_os << "Stopped at 0x" << std::hex << debugger.pc() << std::dec << ": " << stop_reason_name(reason) << std::endl;
+			if (m_interactive) m_is.get();
+		}
+
+		void printUsage(const RewindUsage& usage)
+		{
+			m_os << std::dec << "journal: " << usage.journalUsed << " / " << usage.journalCapacity << " bytes, "
+				<< usage.snapshots << " snapshots (" << usage.snapshotBytes << " bytes), cycles "
+				<< usage.oldestCycle << " - " << usage.newestCycle << '\n';
+		}
+
+	private:
+		static u16 nextInstruction(const Chip8Debugger& debugger)
+		{
+			return u16(debugger.memory(debugger.pc()) << 8 | debugger.memory(debugger.pc() + 1));
+		}
+
+		void prompt(const Chip8Debugger& debugger)
+		{
+			std::string command;
+			while (m_interactive && std::getline(m_is, command) && !command.empty())
+			{
+				if (command == "c")
+				{
+					if (!m_breakpoints) m_os << "No breakpoints attached\n";
+					else
+					{
+						m_resume = Resume::Continue;
+						break;
+					}
+				}
+				else if (command == "n")
+				{
+					if (debugger.lineTable().empty()) m_os << "No line table loaded\n";
+					else
+					{
+						m_resume = Resume::NextLine;
+						break;
+					}
+				}
+				else if (command == "d")
+				{
+					TerminalDisplay screen{ DisplayGlyphs::HalfBlock };
+					screen.print(m_os, debugger.display(), debugger.displayWidth(), debugger.displayHeight());
+				}
+				else if (command.compare(0, 4, "key ") == 0) pressKey(command);
+				else if (command == "b" || command == "m" || command[0] == 'g') rewind(debugger, command);
+				else editBreakpoints(debugger, command);
+			}
+		}
+
+		void pressKey(const std::string& command)
+		{
+			std::istringstream iss{ command.substr(4) };
+			std::string key, state;
+			iss >> key >> state;
+			if (!m_keypad || key.size() != 1 || !std::isxdigit(static_cast<unsigned char>(key[0])) || (!state.empty() && state != "up"))
+			{
+				m_os << (m_keypad ? "Expected `key <0-F> [up]`\n" : "No keypad attached\n");
+				return;
+			}
+			m_keypad->setKey(unsigned(std::stoul(key, nullptr, 16)), state.empty());
+		}
+
+		void rewind(const Chip8Debugger& debugger, const std::string& command)
+		{
+			if (!m_journal)
+			{
+				m_os << "Rewind is not enabled (--rewind)\n";
+				return;
+			}
+			if (command == "m")
+			{
+				printUsage(m_journal->usage());
+				return;
+			}
+
+			bool moved = false;
+			if (command == "b") moved = m_journal->stepBack();
+			else moved = m_journal->jumpToCycle(std::strtoull(command.c_str() + 1, nullptr, 10));
+			if (!moved)
+			{
+				m_os << "Cycle not recorded, history covers " << std::dec << m_journal->oldestCycle() << " - " << m_journal->newestCycle() << '\n';
+				return;
+			}
+			// Show the instruction that runs next.
+			printState(debugger, nextInstruction(debugger));
+		}
+
+		void editBreakpoints(const Chip8Debugger& debugger, const std::string& command)
+		{
+			std::istringstream iss{ command };
+			std::string verb, target;
+			iss >> verb >> target;
+			if (!m_breakpoints || (verb != "break" && verb != "watch" && verb != "stop" && verb != "delete" && verb != "list"))
+			{
+				m_os << "Unknown command `" << command << "`\n";
+				return;
+			}
+
+			auto number = [](const std::string& text) { return unsigned(std::strtoul(text.c_str(), nullptr, 0)); };
+			std::string rest;
+			std::getline(iss, rest);
+
+			unsigned id = 0;
+			std::string error;
+			Predicate condition;
+			if (verb == "list")
+			{
+				for (const Breakpoint& breakpoint : m_breakpoints->breakpoints()) m_os << BreakpointSet::describe(breakpoint) << '\n';
+				return;
+			}
+			else if (verb == "delete")
+			{
+				if (!m_breakpoints->remove(number(target))) m_os << "No breakpoint #" << target << '\n';
+				return;
+			}
+			else if (verb == "break")
+			{
+				char* end = nullptr;
+				u16 address = u16(std::strtoul(target.c_str(), &end, 0));
+				if (target.empty())
+				{
+					m_os << "Missing address, enter `break <address>` or `break line <line>`\n";
+					return;
+				}
+				if (target != "line" && *end != '\0')
+				{
+					m_os << "Invalid address `" << target << "`\n";
+					return;
+				}
+				if (target == "line")
+				{
+					std::istringstream line_iss{ rest };
+					unsigned line = 0;
+					line_iss >> line;
+					if (!debugger.lineTable().addressOf(line, address))
+					{
+						m_os << "No instructions on line " << line << '\n';
+						return;
+					}
+					std::getline(line_iss, rest);
+				}
+
+				const std::size_t at = rest.find("if");
+				if (at == std::string::npos) id = m_breakpoints->addAddress(address);
+				else if (condition.compile(rest.substr(at + 2), error)) id = m_breakpoints->addAddress(address, condition);
+			}
+			else if (verb == "watch")
+			{
+				if (target == "I" || target == "i") id = m_breakpoints->addRegisterWatch(16);
+				else if (target.size() == 2 && (target[0] == 'V' || target[0] == 'v') && std::isxdigit(static_cast<unsigned char>(target[1])))
+					id = m_breakpoints->addRegisterWatch(u8(std::strtoul(target.c_str() + 1, nullptr, 16)));
+				else id = m_breakpoints->addMemoryWatch(u16(number(target)), u16(rest.empty() ? 1 : number(rest)));
+			}
+			else if (condition.compile(target + rest, error))
+				id = m_breakpoints->addCondition(condition);
+
+			if (id == 0) m_os << "Invalid condition: " << error << '\n';
+			else
+			{
+				const Breakpoint& added = m_breakpoints->breakpoints().back();
+				m_os << "Added " << BreakpointSet::describe(added) << '\n';
+			}
+		}
+
+		void printState(const Chip8Debugger& debugger, u16 instruction)
+		{
+			// Describe the instruction with the opcode analyser.
+			std::ostringstream behavior_oss;
+			analyse_opcodes({ instruction }, behavior_oss, debugger.target());
+			std::string behavior = behavior_oss.str();
+			while (!behavior.empty() && behavior.back() == '\n') behavior.pop_back();
+
+			auto old_flags = m_os.flags();
+
+			m_os << "\n--[ step #" << std::dec << debugger.cycles();
+			if (!debugger.lineTable().empty()) m_os << ", line " << debugger.sourceLine();
+			m_os << " ]\n";
+
+			m_os << "\n+-[ instruction ]-+-[ behavior ]------------------------------------------------+\n";
+			m_os << "| 0x" << std::left << std::setw(14) << std::hex << instruction;
+			m_os << "| " << std::left << std::setw(60) << behavior << "|\n";
+			m_os << "+-------------------------------------------------------------------------------+\n";
+
+			m_os << "+[program counter]+[stack pointer]+[I register]+\n";
+			m_os << "| 0x" << std::left << std::setw(14) << std::hex << debugger.pc();
+			m_os << "| 0x" << std::left << std::setw(12) << std::hex << (int)debugger.sp();
+			m_os << "| 0x" << std::left << std::setw(9) << std::hex << debugger.i() << "|\n";
+			m_os << "+-----------------+---------------+------------+\n";
+
+			m_os << "+-[ V registers ]---+----+----+----+----+----+----+----+----+----+----+----+----+\n";
+			m_os << "| 0  | 1  | 2  | 3  | 4  | 5  | 6  | 7  | 8  | 9  | a  | b  | c  | d  | e  | f  |\n";
+			for (unsigned j = 0; j < 0x10; ++j) m_os << "|0x" << std::left << std::setw(2) << (unsigned)debugger.v(j);
+			m_os << "|\n+----+----+----+----+----+----+----+----+----+----+----+----+----+----+----+----+\n";
+
+			m_os.flags(old_flags);
+		}
+	};
+}
@@ -1,446 +1,1742 @@
-/*
-*	MIT License
-*
-*	Copyright(c) 2018 Paul Bernitz
-*
-*	Permission is hereby granted, free of charge, to any person obtaining a copy
-*	of this software and associated documentation files(the "Software"), to deal
-*	in the Software without restriction, including without limitation the rights
-*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-*	copies of the Software, and to permit persons to whom the Software is
-*	furnished to do so, subject to the following conditions :
-*
-*	The above copyright notice and this permission notice shall be included in all
-*	copies or substantial portions of the Software.
-*
-*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
-*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-*	SOFTWARE.
-*/
-
-#pragma once
-
-#include <iostream>
-#include <cstdlib>
-#include <ctime>  
-#include <array>
-#include <fstream>
-#include <iomanip>
-#include <vector>
-
-#include "types.hpp"
-
-#define MEMORY_SIZE 0x1000
-#define V_REGS_TOTAL 0x10
-#define STACK_SIZE 0x10
-#define KEYPAD_SIZE 0x10
-#define DISPLAY_W 0x40
-#define DISPLAY_H 0x20
-#define FONTSET_SIZE 0x50
-#define PROGRAM_START 0x200
-#define PIXEL_SIZE 0xC
-
-namespace c8s
-{
-	const u8 FONTSET[FONTSET_SIZE] =
-	{
-		0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-		0x20, 0x60, 0x20, 0x20, 0x70, // 1
-		0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-		0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-		0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-		0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-		0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-		0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-		0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-		0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-		0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-		0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-		0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-		0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-		0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-		0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-	};
-
-	class Chip8Debugger
-	{
-		u8  m_memory[MEMORY_SIZE];
-		u8  m_v[V_REGS_TOTAL];
-		u16 m_i;
-		u8  m_delayTimer;
-		u8  m_soundTimer;
-		u16 m_pc;
-		u8  m_sp;
-		u16 m_stack[STACK_SIZE];
-		u8  m_keypad[KEYPAD_SIZE];
-		u8  m_display[DISPLAY_W * DISPLAY_H];
-		unsigned m_debug_counter;
-
-		std::array<bool, (DISPLAY_W * DISPLAY_H)> m_pixels;
-
-	public:
-		Chip8Debugger()
-		{
-			initialize();
-		}
-
-		void initialize()
-		{
-			// Seed for random.
-			srand((unsigned)time(NULL));
-
-			// Reset registers.
-			m_pc = 0;
-			m_sp = 0;
-			m_i = 0;
-			m_delayTimer = 0;
-			m_soundTimer = 0;
-			for (unsigned j = 0; j < MEMORY_SIZE; ++j) m_memory[j] = 0;
-			for (unsigned j = 0; j < V_REGS_TOTAL; ++j) m_v[j] = 0;
-			for (unsigned j = 0; j < STACK_SIZE; ++j) m_stack[j] = 0;
-			for (unsigned j = 0; j < KEYPAD_SIZE; ++j) m_keypad[j] = 0;
-			for (unsigned j = 0; j < (DISPLAY_W * DISPLAY_H); ++j) m_display[j] = 0;
-
-			m_debug_counter = 0;
-
-			// Set program-counter to the start of most Chip-8 programs (0x200). 
-			m_pc = PROGRAM_START;
-
-			// Load fontset into memory (0x0 - 0x50).
-			for (unsigned j = 0; j < FONTSET_SIZE; ++j) m_memory[j] = FONTSET[j];
-
-		}
-
-		bool loadRom(const std::string fileName)
-		{
-			initialize();
-			std::ifstream fileIn(fileName, std::ifstream::binary);
-
-			if (!fileIn.is_open())
-				return false;
-
-			if (fileIn)
-			{
-				// Get length of file.
-				fileIn.seekg(0, fileIn.end);
-				int length = (int)fileIn.tellg();
-				fileIn.seekg(0, fileIn.beg);
-
-				// Allocate memory.
-				char* buffer = new char[length];
-
-				// Read data as a block.
-				fileIn.read(buffer, length);
-				fileIn.close();
-
-				// Copy buffer to chip8-memory.
-				for (int i = 0; i < length; ++i)
-					m_memory[i + PROGRAM_START] = buffer[i];
-
-				delete[] buffer;
-			}
-			return true;
-		}
-
-		bool runCycle()
-		{
-			updateTimers();
-			return executeInstruction();
-		}
-
-	private:
-		void clearScreen()
-		{
-			for (unsigned j = 0; j < (DISPLAY_W * DISPLAY_H); ++j) m_display[j] = 0;
-			for (unsigned i = 0; i < m_pixels.size(); ++i)
-			{
-				m_pixels[i] = false;
-			}
-		}
-		void updateTimers()
-		{
-			m_delayTimer -= (m_delayTimer > 0 ? 1 : 0);
-			m_soundTimer -= (m_soundTimer > 0 ? 1 : 0);
-		}
-		bool executeInstruction()
-		{
-			u16 instruction = m_memory[m_pc] << 8 | m_memory[m_pc + 1];	// Read instruction.
-
-			u16 nnn = instruction & 0xFFF;		// nnn or addr - A 12-bit value, the lowest 12 bits of the instruction		----XXXXXXXXXXXX
-			u8 n = instruction & 0xF;			// n or nibble - A 4-bit value, the lowest 4 bits of the instruction		------------XXXX
-			u8 x = (instruction >> 8) & 0xF;	// x - A 4-bit value, the lower 4 bits of the high byte of the instruction	----XXXX--------
-			u8 y = (instruction >> 4) & 0xF;	// y - A 4-bit value, the upper 4 bits of the low byte of the instruction	--------XXXX----
-			u8 kk = instruction & 0xFF;			// kk or byte - An 8-bit value, the lowest 8 bits of the instruction		--------XXXXXXXX
-
-			if (instruction == 0x0)
-			{
-				std::cout << "<EOP> Press `return` to quit debugging.." << std::endl;
-				std::cin.get();
-				return false;
-			}
-
-			u16 op = instruction;
-			std::ostringstream behavior_oss;
-
-			switch (instruction & 0xF000)
-			{
-			case 0x0000:
-				switch (instruction & 0xF)
-				{
-				case 0x0: // Clear the screen.
-					clearScreen();
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 00E0 - Clear the screen";
-					break;
-				case 0xE: // Return from subroutine.
-					--m_sp;
-					m_pc = m_stack[m_sp];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 00EE - Return from a subroutine";
-					break;
-				default:
-					std::cout << "Unknown instruction: " << instruction << std::endl;
-				}
-				break;
-			case 0x1000: // Jump to location nnn.
-				m_pc = nnn;
-				behavior_oss << std::hex << op << " - 1NNN - Jump to location " << nnn;
-				break;
-			case 0x2000: // Call subroutine at nnn.
-				m_stack[m_sp] = m_pc;
-				++m_sp;
-				m_pc = nnn;
-				behavior_oss << std::hex << op << " - 2NNN - Call subroutine at " << nnn;
-				break;
-			case 0x3000: // Skip next instruction if Vx = kk.
-				m_pc += (m_v[x] == kk ? 4 : 2);
-				behavior_oss << std::hex << op << " - 3XNN - Skip next instruction if V[" << std::hex << (int)x << "] = " << std::hex << (int)kk;
-				break;
-			case 0x4000: // Skip next instruction if Vx != kk.
-				m_pc += (m_v[x] != kk ? 4 : 2);
-				behavior_oss << std::hex << op << " - 4XNN - Skip next instruction if V[" << std::hex << (int)x << "] != " << std::hex << (int)kk;
-				break;
-			case 0x5000: // Skip next instruction if Vx = Vy.
-				m_pc += (m_v[x] == m_v[y] ? 4 : 2);
-				behavior_oss << std::hex << op << " - 5XY0 - Skip next instruction if V[" << std::hex << (int)x << "] = V[" << std::hex << (int)y << "]";
-				break;
-			case 0x6000: // Set Vx = kk.
-				m_v[x] = kk;
-				m_pc += 2;
-				behavior_oss << std::hex << op << " - 6XNN - Set V[" << std::hex << (int)x << "] = " << std::hex << (int)kk;
-				break;
-			case 0x7000: // Set Vx = Vx + kk.
-				m_v[x] += kk;
-				m_pc += 2;
-				behavior_oss << std::hex << op << " - 7XNN - Set Vx = V[" << std::hex << (int)x << "] += " << std::hex << (int)kk;
-				break;
-			case 0x8000:
-				switch (instruction & 0xF)
-				{
-				case 0x0: // Set Vx = Vy.
-					m_v[x] = m_v[y];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY0 - Set V[" << std::hex << (int)x << "] = V[" << std::hex << (int)y << "]";
-					break;
-				case 0x1: // Set Vx = Vx OR Vy.
-					m_v[x] |= m_v[y];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY1 - Set V[" << std::hex << (int)x << "] |= V[" << std::hex << (int)y << "]";
-					break;
-				case 0x2: // Set Vx = Vx AND Vy.
-					m_v[x] &= m_v[y];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY2 - Set V[" << std::hex << (int)x << "] &= V[" << std::hex << (int)y << "]";
-					break;
-				case 0x3: // Set Vx = Vx XOR Vy.
-					m_v[x] ^= m_v[y];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY3 - Set V[" << std::hex << (int)x << "] ^= V[" << std::hex << (int)y << "]";
-					break;
-				case 0x4: // Set Vx = Vx + Vy, set VF = carry.
-					m_v[0xF] = (m_v[x] + m_v[y] > 0xFF) ? 1 : 0;
-					m_v[x] = (m_v[x] + m_v[y]) & 0xFF;
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY4 - Set V[" << std::hex << (int)x << "] += V[" << std::hex << (int)y << "]";
-					break;
-				case 0x5: // Set Vx = Vx - Vy, set VF = NOT borrow.
-					m_v[0xF] = (m_v[x] > m_v[y]) ? 1 : 0;
-					m_v[x] -= m_v[y];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY5 - Set V[" << std::hex << (int)x << "] -= V[" << std::hex << (int)y << "]";
-					break;
-				case 0x6: // Set Vx = Vx SHR 1.
-					m_v[0xF] = (m_v[x] & 0x1) != 0 ? 1 : 0;
-					m_v[x] /= 2;
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY6 - Set V[" << std::hex << (int)x << "] >>= 1";
-					break;
-				case 0x7: // Set Vx = Vy - Vx, set VF = NOT borrow.
-					m_v[0xF] = m_v[y] > m_v[x] ? 1 : 0;
-					m_v[x] = m_v[y] - m_v[x];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XY7 - Set V[" << std::hex << (int)x << "] |= V[" << std::hex << (int)y << "]";
-					break;
-				case 0xE: // Set Vx = Vx SHL 1.
-					m_v[0xF] = (m_v[x] & 0x80) != 0 ? 1 : 0;
-					m_v[x] *= 2;
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - 8XYE - Set V[" << std::hex << (int)x << "] <<= 1";
-					break;
-				default:
-					std::cout << "Unknown instruction: " << instruction << std::endl;
-				}
-				break;
-			case 0x9000: // Skip next instruction if Vx != Vy.
-				m_pc += m_v[x] != m_v[y] ? 4 : 2;
-				behavior_oss << std::hex << op << " - 9XY0 - Skip next instruction if V[" << std::hex << (int)x << "] != V[" << std::hex << (int)y << "]";
-				break;
-			case 0xA000: // Set I = nnn.
-				m_i = nnn;
-				m_pc += 2;
-				behavior_oss << std::hex << op << " - ANNN - Set I = " << nnn;
-				break;
-			case 0xB000: // Jump to location nnn + V0.
-				m_pc = nnn + m_v[0];
-				behavior_oss << std::hex << op << " - BNNN - Jump to location " << nnn << " + V[0]";
-				break;
-			case 0xC000: // Set Vx = random byte AND kk.
-				m_v[x] = kk & u8(rand() % 255);
-				m_pc += 2;
-				behavior_oss << std::hex << op << " - CXNN - Set V[" << std::hex << (int)x << "] = rand() & " << std::hex << (int)kk;
-				break;
-			case 0xD000: //  Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
-				u16 pixel;
-				m_v[0xF] = 0x0;
-
-				for (unsigned line = 0x0; line < n; line++)
-				{
-					pixel = m_memory[m_i + line];
-					for (unsigned bitCount = 0x0; bitCount < 0x8; ++bitCount)
-					{
-						if ((pixel & (0x80 >> bitCount)) != 0x0)
-						{
-							if (m_display[(m_v[x] + bitCount + ((m_v[y] + line) * DISPLAY_W))] == 0x1)
-								m_v[0xF] = 0x1;
-							m_display[m_v[x] + bitCount + ((m_v[y] + line) * DISPLAY_W)] ^= 0x1;
-						}
-					}
-				}
-
-				for (unsigned j = 0; j < (DISPLAY_W * DISPLAY_H); ++j)
-				{
-					if (m_display[j] != 0)
-						m_pixels[j] = true;
-					else
-						m_pixels[j] = false;
-				}
-				m_pc += 2;
-				behavior_oss << std::hex << op << " - DXYN - Display " << n << "-byte from `I` at (V[" << std::hex << (int)x << "], V[" << std::hex << (int)y << "]), set V[F] = collision";
-				break;
-			case 0xE000:
-				switch (instruction & 0xFF)
-				{
-				case 0x9E: // Skip next instruction if key with the value of Vx is pressed. 
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - EX9E - Skip next instruction if key with value of V[" << std::hex << (int)x << "] is pressed";
-					break;
-				case 0xA1: // Skip next instruction if key with the value of Vx is not pressed.
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - EXA1 - Skip next instruction if key with value of V[" << std::hex << (int)x << "] is not pressed";
-					break;
-				default:
-					std::cout << "Unknown instruction: " << instruction << std::endl;
-				}
-				break;
-			case 0xF000:
-				switch (instruction & 0xFF)
-				{
-				case 0x07: // Set Vx = delay timer value.
-					m_v[x] = m_delayTimer;
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX07 - Set V[" << std::hex << (int)x << "] = delay timer value";
-					break;
-				case 0x0A: // Wait for a key press, store the value of the key in Vx.
-					for (unsigned i = 0; i < 0x10; ++i)
-					{
-						if (m_keypad[i] != 0)
-						{
-							m_v[x] = i;
-							m_pc += 2;
-						}
-					}
-					behavior_oss << std::hex << op << " - FX0A - Wait for key press, store key-value in V[" << std::hex << (int)x << "]";
-					break;
-				case 0x15: // Set delay timer = Vx.
-					m_delayTimer = m_v[x];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX15 - Set delay timer = V[" << std::hex << (int)x << "]";
-					break;
-				case 0x18: // Set sound timer = Vx.
-					m_soundTimer = m_v[x];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX18 - Set sound timer = V[" << std::hex << (int)x << "]";
-					break;
-				case 0x1E: // Set I = I + Vx.
-					m_i += m_v[x];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX1E - Set I += V[" << std::hex << (int)x << "]";
-					break;
-				case 0x29: // Set I = location of sprite for digit Vx.
-					m_i = m_v[x] * 5; // Multiplied by sprite-size (5). 
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX29 - Set I = Location of sprite for digit V[" << std::hex << (int)x << "]";
-					break;
-				case 0x33: // Store BCD representation of Vx in memory locations I, I+1, and I+2.
-						   // Ref: http://www.multigesture.net/wp-content/uploads/mirror/goldroad/chip8.shtml
-					m_memory[m_i] = m_v[x] / 100;
-					m_memory[m_i + 1] = (m_v[x] / 10) % 10;
-					m_memory[m_i + 2] = (m_v[x] % 100) % 10;
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX33 - Store BCD representation of V[" << std::hex << (int)x << "] in memory locations I, I+1, I+2";
-					break;
-				case 0x55: // Store registers V0 through Vx in memory starting at location I.
-					for (unsigned j = 0; j < x; ++j) m_memory[m_i + j] = m_v[j];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX55 - Store registers V[0] -> V[" << std::hex << (int)x << "] in memory starting at location `I`";
-					break;
-				case 0x65: // Read registers V0 through Vx from memory starting at location I.
-					for (unsigned j = 0; j < x; ++j) m_v[j] = m_memory[m_i + j];
-					m_pc += 2;
-					behavior_oss << std::hex << op << " - FX65 - Read registers V[0] -> V[" << std::hex << (int)x << "] from memory starting at location `I`";
-					break;
-				default:
-					std::cout << "Unknown instruction: " << instruction << std::endl;
-				}
-				break;
-			default:
-				std::cout << "Unknown instruction: " << instruction << std::endl;
-			}
-
-			// Output.
-			std::cout << "\n--[ step #" << ++m_debug_counter << " ]\n";
-
-			std::cout << "\n+-[ instruction ]-+-[ behavior ]------------------------------------------------+\n";
-			std::cout << "| 0x" << std::left << std::setw(14) << std::hex << instruction;
-			std::cout << "| " << std::left << std::setw(60) << behavior_oss.str() << "|\n";
-			std::cout << "+-------------------------------------------------------------------------------+\n";
-
-			std::cout << "+[program counter]+[stack pointer]+[I register]+\n";
-			std::cout << "| 0x" << std::left << std::setw(14) << std::hex << m_pc;
-			std::cout << "| 0x" << std::left << std::setw(12) << std::hex << (int)m_sp;
-			std::cout << "| 0x" << std::left << std::setw(9) << std::hex << m_i << "|\n";
-			std::cout << "+-----------------+---------------+------------+\n";
-
-			std::cout << "+-[ V registers ]---+----+----+----+----+----+----+----+----+----+----+----+----+\n";
-			std::cout << "| 0  | 1  | 2  | 3  | 4  | 5  | 6  | 7  | 8  | 9  | a  | b  | c  | d  | e  | f  |\n";
-			for (unsigned j = 0; j < 0x10; ++j) std::cout << "|0x" << std::left << std::setw(2) << (unsigned)m_v[j];
-			std::cout << "|\n+----+----+----+----+----+----+----+----+----+----+----+----+----+----+----+----+\n";
-			std::cin.get();
-			return true;
-		}
-	};
-}
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <cstdlib>
+#include <ctime>  
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "types.hpp"
+#include "line-table.hpp"
+#include "target.hpp"
+
+#define MEMORY_SIZE 0x1000
+#define V_REGS_TOTAL 0x10
+#define STACK_SIZE 0x10
+#define KEYPAD_SIZE 0x10
+#define DISPLAY_W 0x40
+#define DISPLAY_H 0x20
+#define HIRES_W 0x80
+#define HIRES_H 0x40
+#define DISPLAY_PLANES 2
+#define PLANE_WORDS (HIRES_H * 2)	// std::uint64_t per plane, enough for the hires rows of two words.
+#define FONTSET_SIZE 0x50
+#define BIG_FONT_START 0x50
+#define BIG_FONTSET_SIZE 0xA0
+#define FLAG_REGS_TOTAL 0x10
+#define PROGRAM_START 0x200
+#define PIXEL_SIZE 0xC
+#define TIMER_HZ 60
+#define INSTRUCTIONS_PER_FRAME 10	// Default CPU clock of 600 Hz.
+
+namespace c8s
+{
+	const u8 FONTSET[FONTSET_SIZE] =
+	{
+		0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+		0x20, 0x60, 0x20, 0x20, 0x70, // 1
+		0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+		0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+		0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+		0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+		0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+		0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+		0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+		0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+		0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+		0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+		0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+		0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+		0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+		0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+	};
+
+	// The 8x10 digits of FX30, loaded after `FONTSET` on the SUPER-CHIP and XO-CHIP targets.
+	const u8 BIG_FONTSET[BIG_FONTSET_SIZE] =
+	{
+		0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+		0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+		0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+		0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+		0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+		0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+		0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+		0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+		0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+		0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+		0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+	};
+
+	// Why `Chip8Debugger::run()` returned. Input logs store it as a number, so new reasons go last.
+	enum class StopReason
+	{
+		EndOfProgram,		// Reached an empty (0x0000) instruction, or 00FD on SUPER-CHIP and XO-CHIP.
+		BudgetExhausted,	// Executed the maximum number of instructions.
+		UnknownInstruction,	// The instruction at PC could not be decoded.
+		UntranslatedCode,	// A recompiled ROM reached code the recompiler didn't translate.
+		Breakpoint,			// A breakpoint or watchpoint was hit (see breakpoints.hpp).
+		LineReached,		// `stepLine` reached the first instruction of a source statement.
+		WaitingForKey,		// FX0A found no key down. The attempt counted as a cycle and PC still points at it.
+		BoundsViolation		// The sanitizer caught an access outside memory or the stack (see `InterpreterPolicy`).
+	};
+
+	const char* stop_reason_name(StopReason reason)
+	{
+		switch (reason)
+		{
+		case StopReason::EndOfProgram: return "end of program";
+		case StopReason::BudgetExhausted: return "instruction budget exhausted";
+		case StopReason::UntranslatedCode: return "untranslated code";
+		case StopReason::Breakpoint: return "breakpoint";
+		case StopReason::LineReached: return "line reached";
+		case StopReason::WaitingForKey: return "waiting for a key";
+		case StopReason::BoundsViolation: return "memory or stack access out of bounds";
+		default: return "unknown instruction";
+		}
+	}
+
+	// FNV-1a hash of `size` bytes, continuing from `hash`.
+	std::uint64_t fnv1a(const void* data, std::size_t size, std::uint64_t hash = 0xcbf29ce484222325ULL)
+	{
+		const u8* bytes = static_cast<const u8*>(data);
+		for (std::size_t j = 0; j < size; ++j)
+		{
+			hash ^= bytes[j];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	// xoshiro128++ (Blackman and Vigna). Every machine owns a generator, so a run can be repeated
+	// from its seed and machines on different threads don't share state.
+	struct Xoshiro128
+	{
+		std::uint32_t s[4];
+
+		// Expand `seed` with SplitMix64, which can't produce the all-zero state.
+		void seed(std::uint64_t seed)
+		{
+			for (unsigned j = 0; j < 4; j += 2)
+			{
+				std::uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+				z ^= z >> 31;
+				s[j] = std::uint32_t(z);
+				s[j + 1] = std::uint32_t(z >> 32);
+			}
+		}
+
+		std::uint32_t next()
+		{
+			const std::uint32_t result = rotl(s[0] + s[3], 7) + s[0];
+			const std::uint32_t t = s[1] << 9;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = rotl(s[3], 11);
+			return result;
+		}
+
+		// The random byte of CXNN.
+		u8 nextByte() { return u8(next() >> 24); }
+
+	private:
+		static std::uint32_t rotl(std::uint32_t x, unsigned k) { return (x << k) | (x >> (32 - k)); }
+	};
+
+	// A different seed for every call, from the clock and a counter.
+	std::uint64_t default_seed()
+	{
+		static std::atomic<std::uint64_t> counter{ 0 };
+		return std::uint64_t(time(NULL)) * 0x9E3779B97F4A7C15ULL + counter.fetch_add(1);
+	}
+
+	static_assert(DISPLAY_W == 64, "A display row has to fit into one std::uint64_t");
+
+	std::uint64_t rotate_right(std::uint64_t value, unsigned shift)
+	{
+		shift %= 64;
+		return shift == 0 ? value : (value >> shift) | (value << (64 - shift));
+	}
+
+	// XOR an n-row sprite from `memory[i]` into a display of one row per std::uint64_t (bit 63 is
+	// column 0). Rows are rotated into place, so sprites wrap around the right and bottom edges.
+	// Returns true if a set pixel was erased.
+	bool draw_sprite(std::uint64_t* display, const u8* memory, u16 i, unsigned x, unsigned y, unsigned n)
+	{
+		std::uint64_t collision = 0;
+		for (unsigned line = 0; line < n; ++line)
+		{
+			const std::uint64_t row = rotate_right(std::uint64_t(memory[(i + line) % MEMORY_SIZE]) << 56, x % DISPLAY_W);
+			std::uint64_t& target = display[(y + line) % DISPLAY_H];
+			collision |= target & row;
+			target ^= row;
+		}
+		return collision != 0;
+	}
+
+	// Like `draw_sprite`, but the sprite starts at (x % 64, y % 32) and the pixels that would wrap
+	// around the right or bottom edge are cut off.
+	bool draw_sprite_clipped(std::uint64_t* display, const u8* memory, u16 i, unsigned x, unsigned y, unsigned n)
+	{
+		std::uint64_t collision = 0;
+		x %= DISPLAY_W;
+		y %= DISPLAY_H;
+		for (unsigned line = 0; line < n && y + line < DISPLAY_H; ++line)
+		{
+			const std::uint64_t row = (std::uint64_t(memory[(i + line) % MEMORY_SIZE]) << 56) >> x;
+			std::uint64_t& target = display[y + line];
+			collision |= target & row;
+			target ^= row;
+		}
+		return collision != 0;
+	}
+
+	// Move a row of 128 pixels in two words right by `shift` (< 128) pixels. Pixels moved past
+	// the right edge come back at the left with `wrap` and are lost without.
+	void move_row_right(std::uint64_t& high, std::uint64_t& low, unsigned shift, bool wrap)
+	{
+		if (shift >= 64)
+		{
+			const std::uint64_t h = high;
+			high = wrap ? low : 0;
+			low = h;
+			shift -= 64;
+		}
+		if (shift == 0)
+			return;
+		const std::uint64_t h = high, l = low;
+		high = (h >> shift) | (wrap ? l << (64 - shift) : 0);
+		low = (l >> shift) | (h << (64 - shift));
+	}
+
+	// XOR a sprite into one plane of word-packed rows: `words` std::uint64_t per row, 1 for 64
+	// pixels and 2 for 128, and bit 63 of the first word is column 0. The sprite has `rows` rows
+	// of `bytes` bytes (1 or 2) from `memory[i & mask]` on. It starts at (x, y) modulo the plane
+	// and is cut off at the right and bottom edges, or wraps around them with `wrap`. A sprite
+	// row touches at most two words, so every row costs the same in both resolutions.
+	// Returns true if a set pixel was erased.
+	bool draw_sprite_words(std::uint64_t* plane, unsigned words, unsigned height, const u8* memory, unsigned mask,
+		unsigned i, unsigned x, unsigned y, unsigned rows, unsigned bytes, bool wrap)
+	{
+		x %= words * 64;
+		y %= height;
+		std::uint64_t collision = 0;
+		for (unsigned line = 0; line < rows && (wrap || y + line < height); ++line)
+		{
+			std::uint64_t* target = plane + ((y + line) % height) * words;
+			std::uint64_t high = std::uint64_t(memory[(i + line * bytes) & mask]) << 56;
+			if (bytes == 2) high |= std::uint64_t(memory[(i + line * bytes + 1) & mask]) << 48;
+			if (words == 1)
+			{
+				const std::uint64_t row = wrap ? rotate_right(high, x) : high >> x;
+				collision |= target[0] & row;
+				target[0] ^= row;
+				continue;
+			}
+			std::uint64_t low = 0;
+			move_row_right(high, low, x, wrap);
+			collision |= (target[0] & high) | (target[1] & low);
+			target[0] ^= high;
+			target[1] ^= low;
+		}
+		return collision != 0;
+	}
+
+	// Instruction behaviour where CHIP-8 interpreters disagree.
+	enum class Quirks
+	{
+		Chip8,	// Shift VX in place, FX55/FX65 keep I, BNNN adds V0, sprites wrap.
+		Cosmac,	// The COSMAC VIP: shift VY into VX, FX55/FX65 leave I after VX, sprites are clipped.
+		Schip,	// SUPER-CHIP: like Chip8, but BXNN adds VX and sprites are clipped.
+		XoChip	// XO-CHIP: shift VY into VX, FX55/FX65 leave I after VX, BNNN adds V0, sprites wrap.
+	};
+
+	// Returns false if `name` is not a known set of quirks.
+	bool parse_quirks(const std::string& name, Quirks& quirks)
+	{
+		if (name == "chip8") quirks = Quirks::Chip8;
+		else if (name == "cosmac") quirks = Quirks::Cosmac;
+		else if (name == "schip") quirks = Quirks::Schip;
+		else if (name == "xochip") quirks = Quirks::XoChip;
+		else return false;
+		return true;
+	}
+
+	// Compile-time behaviour of the interpreter loops. `Chip8Debugger` instantiates its handlers
+	// and loops for every policy and picks one when the quirks or the sanitizer change, so the
+	// loops test neither per instruction.
+	template<Quirks Q, bool Sanitize>
+	struct InterpreterPolicy
+	{
+		static constexpr bool shiftVy = Q == Quirks::Cosmac || Q == Quirks::XoChip;		// 8XY6 and 8XYE shift VY into VX.
+		static constexpr bool incrementI = Q == Quirks::Cosmac || Q == Quirks::XoChip;	// FX55 and FX65 leave I = I + X + 1.
+		static constexpr bool jumpVx = Q == Quirks::Schip;								// BXNN jumps to XNN + VX.
+		static constexpr bool clipSprites = Q == Quirks::Cosmac || Q == Quirks::Schip;	// DXYN cuts sprites off at the edges.
+		static constexpr bool sanitize = Sanitize;					// Stop before an access outside memory or the stack.
+	};
+
+	// Interpreter back ends.
+	enum class Engine
+	{
+		Switch,	// Decode every instruction again before dispatching it.
+		Cached,	// Dispatch pre-decoded instructions with threaded code.
+		Jit		// Translate basic blocks to native code (see jit.hpp).
+	};
+
+	// Returns false if `name` is not a known engine.
+	bool parse_engine(const std::string& name, Engine& engine)
+	{
+		if (name == "switch") engine = Engine::Switch;
+		else if (name == "cached") engine = Engine::Cached;
+		else if (name == "jit") engine = Engine::Jit;
+		else return false;
+		return true;
+	}
+
+	// Handlers of the decoded instructions.
+	enum class Op : u8
+	{
+		Undecoded,	// Slot of the decode cache that has to be decoded first.
+		End,		// 0000
+		Unknown,
+		Cls,		// 00E0
+		Ret,		// 00EE
+		Jp,			// 1NNN
+		Call,		// 2NNN
+		SeByte,		// 3XNN
+		SneByte,	// 4XNN
+		SeReg,		// 5XY0
+		LdByte,		// 6XNN
+		AddByte,	// 7XNN
+		LdReg,		// 8XY0
+		Or,			// 8XY1
+		And,		// 8XY2
+		Xor,		// 8XY3
+		AddReg,		// 8XY4
+		Sub,		// 8XY5
+		Shr,		// 8XY6
+		Subn,		// 8XY7
+		Shl,		// 8XYE
+		SneReg,		// 9XY0
+		LdI,		// ANNN
+		JpV0,		// BNNN
+		Rnd,		// CXNN
+		Drw,		// DXYN
+		Skp,		// EX9E
+		Sknp,		// EXA1
+		LdVxDt,		// FX07
+		LdVxKey,	// FX0A
+		LdDtVx,		// FX15
+		LdStVx,		// FX18
+		AddIVx,		// FX1E
+		LdFVx,		// FX29
+		LdBcd,		// FX33
+		StoreRegs,	// FX55
+		LoadRegs,	// FX65
+		// SUPER-CHIP, see `decode_extension`.
+		ScrollDown,	// 00CN
+		ScrollRight,// 00FB
+		ScrollLeft,	// 00FC
+		Lores,		// 00FE
+		Hires,		// 00FF
+		DrwPlanes,	// DXYN in both resolutions and the selected planes, 16x16 pixels for N = 0.
+		LdHfVx,		// FX30
+		StoreFlags,	// FX75
+		LoadFlags,	// FX85
+		// XO-CHIP.
+		ScrollUp,	// 00DN
+		SaveRange,	// 5XY2
+		LoadRange,	// 5XY3
+		LdILong,	// F000 NNNN
+		Plane,		// FN01
+		Audio,		// F002, FX3A. There is no sound output, so they only move on.
+		Count
+	};
+
+	// An instruction split into its handler and operands.
+	struct DecodedInstruction
+	{
+		Op op;
+		u8 x;
+		u8 y;
+		u8 kk;	// The nibble `n` is the lower half of `kk`.
+		u16 nnn;
+	};
+
+	// Instructions SUPER-CHIP and XO-CHIP add to the ones of CHIP-8, or decode differently.
+	void decode_extension(u16 instruction, Target target, DecodedInstruction& d)
+	{
+		const bool xo = target == Target::XoChip;
+		switch (instruction & 0xF000)
+		{
+		case 0x0000:
+			if ((instruction & 0xFFF0) == 0x00C0) d.op = Op::ScrollDown;
+			else if (xo && (instruction & 0xFFF0) == 0x00D0) d.op = Op::ScrollUp;
+			else if (instruction == 0x00FB) d.op = Op::ScrollRight;
+			else if (instruction == 0x00FC) d.op = Op::ScrollLeft;
+			else if (instruction == 0x00FD) d.op = Op::End;
+			else if (instruction == 0x00FE) d.op = Op::Lores;
+			else if (instruction == 0x00FF) d.op = Op::Hires;
+			break;
+		case 0x5000:
+			if (xo && (instruction & 0xF) == 0x2) d.op = Op::SaveRange;
+			else if (xo && (instruction & 0xF) == 0x3) d.op = Op::LoadRange;
+			break;
+		case 0xD000: d.op = Op::DrwPlanes; break;
+		case 0xF000:
+			if (xo && instruction == 0xF000) d.op = Op::LdILong;
+			else if (xo && (instruction & 0xFF) == 0x01) d.op = Op::Plane;
+			else if (xo && (instruction == 0xF002 || (instruction & 0xFF) == 0x3A)) d.op = Op::Audio;
+			else if ((instruction & 0xFF) == 0x30) d.op = Op::LdHfVx;
+			else if ((instruction & 0xFF) == 0x75) d.op = Op::StoreFlags;
+			else if ((instruction & 0xFF) == 0x85) d.op = Op::LoadFlags;
+			break;
+		}
+	}
+
+	DecodedInstruction decode_instruction(u16 instruction)
+	{
+		DecodedInstruction d{ Op::Unknown, u8((instruction >> 8) & 0xF), u8((instruction >> 4) & 0xF), u8(instruction & 0xFF), u16(instruction & 0xFFF) };
+
+		switch (instruction & 0xF000)
+		{
+		case 0x0000:
+			if (instruction == 0x0000) d.op = Op::End;
+			else if (instruction == 0x00E0) d.op = Op::Cls;
+			else if (instruction == 0x00EE) d.op = Op::Ret;
+			break;
+		case 0x1000: d.op = Op::Jp; break;
+		case 0x2000: d.op = Op::Call; break;
+		case 0x3000: d.op = Op::SeByte; break;
+		case 0x4000: d.op = Op::SneByte; break;
+		case 0x5000: d.op = Op::SeReg; break;
+		case 0x6000: d.op = Op::LdByte; break;
+		case 0x7000: d.op = Op::AddByte; break;
+		case 0x8000:
+			switch (instruction & 0xF)
+			{
+			case 0x0: d.op = Op::LdReg; break;
+			case 0x1: d.op = Op::Or; break;
+			case 0x2: d.op = Op::And; break;
+			case 0x3: d.op = Op::Xor; break;
+			case 0x4: d.op = Op::AddReg; break;
+			case 0x5: d.op = Op::Sub; break;
+			case 0x6: d.op = Op::Shr; break;
+			case 0x7: d.op = Op::Subn; break;
+			case 0xE: d.op = Op::Shl; break;
+			}
+			break;
+		case 0x9000: d.op = Op::SneReg; break;
+		case 0xA000: d.op = Op::LdI; break;
+		case 0xB000: d.op = Op::JpV0; break;
+		case 0xC000: d.op = Op::Rnd; break;
+		case 0xD000: d.op = Op::Drw; break;
+		case 0xE000:
+			if ((instruction & 0xFF) == 0x9E) d.op = Op::Skp;
+			else if ((instruction & 0xFF) == 0xA1) d.op = Op::Sknp;
+			break;
+		case 0xF000:
+			switch (instruction & 0xFF)
+			{
+			case 0x07: d.op = Op::LdVxDt; break;
+			case 0x0A: d.op = Op::LdVxKey; break;
+			case 0x15: d.op = Op::LdDtVx; break;
+			case 0x18: d.op = Op::LdStVx; break;
+			case 0x1E: d.op = Op::AddIVx; break;
+			case 0x29: d.op = Op::LdFVx; break;
+			case 0x33: d.op = Op::LdBcd; break;
+			case 0x55: d.op = Op::StoreRegs; break;
+			case 0x65: d.op = Op::LoadRegs; break;
+			}
+			break;
+		}
+		return d;
+	}
+
+	// Decodes for `target`. The plain CHIP-8 decoder stays separate so the hot loops keep inlining it.
+	DecodedInstruction decode_instruction(u16 instruction, Target target)
+	{
+		DecodedInstruction d = decode_instruction(instruction);
+		if (target != Target::Chip8)
+			decode_extension(instruction, target, d);
+		return d;
+	}
+
+	class Chip8Debugger;
+
+	// Native code back end that can be plugged into the debugger.
+	class JitBackend
+	{
+	public:
+		virtual ~JitBackend() = default;
+		virtual StopReason run(std::uint64_t max_instructions) = 0;
+		virtual void invalidate(unsigned address) = 0;
+		virtual void reset() = 0;
+	};
+
+	// Sees every instruction of an observed run before and after it executes (see rewind.hpp).
+	class ExecutionJournal
+	{
+	public:
+		virtual ~ExecutionJournal() = default;
+		virtual void beforeInstruction(const Chip8Debugger& debugger, const DecodedInstruction& instruction) = 0;
+		virtual void afterInstruction(const Chip8Debugger& debugger, bool executed) = 0;
+		virtual void reset() = 0;
+	};
+
+	// Source or sink of the nondeterministic input of a run: random bytes and key changes (see replay.hpp).
+	class InputChannel
+	{
+	public:
+		virtual ~InputChannel() = default;
+		virtual void beforeInstruction(Chip8Debugger& debugger) = 0;
+		// Returns the random byte CXNN uses instead of the one the generator produced.
+		virtual u8 random(const Chip8Debugger& debugger, u8 generated) = 0;
+		virtual void keyChanged(const Chip8Debugger& debugger, unsigned key, bool pressed) = 0;
+	};
+
+	// Stops a run after an instruction (see breakpoints.hpp).
+	class BreakCondition
+	{
+	public:
+		virtual ~BreakCondition() = default;
+		virtual bool armed() const = 0;
+		virtual void begin(const Chip8Debugger& debugger) = 0;
+		virtual bool hit(const Chip8Debugger& debugger) = 0;
+		virtual bool hitAddress(const Chip8Debugger& debugger) = 0;	// Only the address breakpoints.
+		// Set `traps[address]` for every address a breakpoint can stop at. False if one can stop anywhere.
+		virtual bool markAddresses(std::vector<u8>& traps) const = 0;
+	};
+
+	// Counts executed instructions, see profiler.hpp. Only called while attached, so it costs
+	// nothing when profiling is off.
+	class ExecutionCounter
+	{
+	public:
+		virtual ~ExecutionCounter() = default;
+		virtual void onExecuted(u16 pc, u16 instruction, u16 next_pc) = 0;
+	};
+
+	// Records every executed instruction together with the machine state after it, see trace.hpp.
+	class ExecutionTracer
+	{
+	public:
+		virtual ~ExecutionTracer() = default;
+		virtual void onExecuted(const Chip8Debugger& debugger, u16 pc, u16 instruction) = 0;
+	};
+
+	// Opt-in observer that is notified about every executed instruction.
+	class DebugObserver
+	{
+	public:
+		virtual ~DebugObserver() = default;
+		virtual void onInstruction(const Chip8Debugger& debugger, u16 pc, u16 instruction) = 0;
+		virtual void onStop(const Chip8Debugger&, StopReason) {}
+	};
+
+	class Chip8Debugger
+	{
+		friend class Chip8Jit;
+		friend class RewindJournal;
+
+		std::vector<u8> m_memory;	// `target_memory_size` bytes, PC and I wrap around at its end.
+		unsigned m_memoryMask;
+		u8  m_v[V_REGS_TOTAL];
+		u16 m_i;
+		u8  m_delayTimer;
+		u8  m_soundTimer;
+		u16 m_pc;
+		u8  m_sp;
+		u16 m_stack[STACK_SIZE];
+		u8  m_keypad[KEYPAD_SIZE];
+		// Planes of one bit per pixel, PLANE_WORDS apart. A row is one std::uint64_t in lores and two in
+		// hires, see `draw_sprite_words`. CHIP-8 only uses the first DISPLAY_H words, see `draw_sprite`.
+		std::uint64_t m_display[DISPLAY_PLANES * PLANE_WORDS];
+		Target m_target;
+		bool m_hires;
+		u8 m_planeMask;		// Planes that draw, scroll and clear, 1 outside of XO-CHIP.
+		u8 m_flags[FLAG_REGS_TOTAL];	// Of FX75 and FX85.
+		std::uint64_t m_cycles;
+		std::uint32_t m_instructionsPerFrame;
+		std::uint32_t m_frameCountdown;		// Instructions until the timers tick, 1 at the start of a frame.
+		StopReason m_stopReason;
+		DebugObserver* m_observer;
+		Engine m_engine;
+		std::unique_ptr<JitBackend> m_jit;
+		ExecutionJournal* m_journal;
+		InputChannel* m_input;
+		BreakCondition* m_breakpoints;
+		ExecutionCounter* m_profiler;
+		ExecutionTracer* m_tracer;
+		Quirks m_quirks;
+		bool m_sanitize;
+
+		// Instantiations for the selected quirks and sanitizer, see `selectPolicy`.
+		bool (Chip8Debugger::*m_execute)(const DecodedInstruction&);
+		StopReason (Chip8Debugger::*m_runSwitch)(std::uint64_t);
+		StopReason (Chip8Debugger::*m_runThreaded)(std::uint64_t);
+		StopReason (Chip8Debugger::*m_runSwitchTrapped)(std::uint64_t);
+		StopReason (Chip8Debugger::*m_runThreadedTrapped)(std::uint64_t);
+		std::uint64_t m_seed;
+		Xoshiro128 m_random;
+		LineTable m_lines;
+		std::vector<u8> m_lineStart;	// 1 at the first address of every statement in `m_lines`.
+
+		// One decoded instruction per memory address, filled on first execution.
+		std::vector<DecodedInstruction> m_decoded;
+
+		// While `m_trapping`, the engines stop before an instruction at an address marked in `m_traps`,
+		// see `runChecked`. The generation changes with the marks, so the JIT can drop blocks that run over one.
+		std::vector<u8> m_traps;
+		unsigned m_trapGeneration;
+		bool m_trapping;
+
+	public:
+		Chip8Debugger()
+			: m_memory(MEMORY_SIZE), m_memoryMask{ MEMORY_SIZE - 1 }, m_target{ Target::Chip8 }, m_instructionsPerFrame{ INSTRUCTIONS_PER_FRAME }, m_observer{ nullptr }, m_engine{ Engine::Cached }, m_journal{ nullptr }, m_input{ nullptr }, m_breakpoints{ nullptr }, m_profiler{ nullptr }, m_tracer{ nullptr },
+			m_quirks{ Quirks::Chip8 }, m_sanitize{ false }, m_seed{ default_seed() }, m_lineStart(MEMORY_SIZE), m_decoded(MEMORY_SIZE),
+			m_trapGeneration{ 0 }, m_trapping{ false }
+		{
+			selectPolicy();
+			initialize();
+		}
+
+		void initialize()
+		{
+			// Every load of a ROM draws the same random numbers.
+			m_random.seed(m_seed);
+
+			// Reset registers.
+			m_pc = 0;
+			m_sp = 0;
+			m_i = 0;
+			m_delayTimer = 0;
+			m_soundTimer = 0;
+			m_frameCountdown = 1;
+			std::fill(m_memory.begin(), m_memory.end(), u8(0));
+			for (unsigned j = 0; j < V_REGS_TOTAL; ++j) m_v[j] = 0;
+			for (unsigned j = 0; j < STACK_SIZE; ++j) m_stack[j] = 0;
+			for (unsigned j = 0; j < KEYPAD_SIZE; ++j) m_keypad[j] = 0;
+			for (unsigned j = 0; j < FLAG_REGS_TOTAL; ++j) m_flags[j] = 0;
+			std::memset(m_display, 0, sizeof(m_display));
+			m_hires = false;
+			m_planeMask = 1;
+			invalidateDecodeCache();
+			if (m_jit) m_jit->reset();
+
+			m_cycles = 0;
+			if (m_journal) m_journal->reset();
+			m_stopReason = StopReason::BudgetExhausted;
+
+			// Set program-counter to the start of most Chip-8 programs (0x200). 
+			m_pc = PROGRAM_START;
+
+			// Load fontset into memory (0x0 - 0x50), and the big one after it (0x50 - 0xF0).
+			for (unsigned j = 0; j < FONTSET_SIZE; ++j) m_memory[j] = FONTSET[j];
+			if (m_target != Target::Chip8)
+				for (unsigned j = 0; j < BIG_FONTSET_SIZE; ++j) m_memory[BIG_FONT_START + j] = BIG_FONTSET[j];
+
+		}
+
+		bool loadRom(const std::string fileName)
+		{
+			initialize();
+			std::ifstream fileIn(fileName, std::ifstream::binary);
+
+			if (!fileIn.is_open())
+				return false;
+
+			if (fileIn)
+			{
+				// Get length of file.
+				fileIn.seekg(0, fileIn.end);
+				int length = (int)fileIn.tellg();
+				fileIn.seekg(0, fileIn.beg);
+
+				// The ROM has to fit between the program start and the end of memory.
+				if (length < 0 || length > int(m_memory.size()) - PROGRAM_START)
+					return false;
+
+				// Allocate memory.
+				char* buffer = new char[length];
+
+				// Read data as a block.
+				fileIn.read(buffer, length);
+				fileIn.close();
+
+				// Copy buffer to chip8-memory.
+				for (int i = 0; i < length; ++i)
+					m_memory[i + PROGRAM_START] = buffer[i];
+
+				delete[] buffer;
+			}
+			return true;
+		}
+
+		// Load compiled opcodes directly into memory.
+		bool loadProgram(const std::vector<u16>& opcodes)
+		{
+			initialize();
+			if (opcodes.size() * 2 > m_memory.size() - PROGRAM_START)
+				return false;
+
+			for (unsigned j = 0; j < opcodes.size(); ++j)
+			{
+				m_memory[PROGRAM_START + j * 2] = opcodes[j] >> 8;
+				m_memory[PROGRAM_START + j * 2 + 1] = opcodes[j] & 0xFF;
+			}
+			return true;
+		}
+
+		// Attach an observer that is notified after every instruction, or detach it with `nullptr`.
+		void setObserver(DebugObserver* observer) { m_observer = observer; }
+
+		// Attach a journal that records every instruction, or detach it with `nullptr`.
+		void setJournal(ExecutionJournal* journal)
+		{
+			m_journal = journal;
+			if (m_journal) m_journal->reset();
+		}
+
+		// Attach breakpoints that `run` checks while any of them is armed, or detach them with `nullptr`.
+		void setBreakpoints(BreakCondition* breakpoints) { m_breakpoints = breakpoints; }
+
+		// Source lines of the loaded ROM, as written by the compiler next to it.
+		bool loadLineTable(const std::string& fileName)
+		{
+			LineTable lines;
+			if (!lines.load(fileName))
+				return false;
+			setLineTable(lines);
+			return true;
+		}
+
+		void setLineTable(const LineTable& lines)
+		{
+			m_lines = lines;
+			markLineStarts();
+		}
+
+		const LineTable& lineTable() const { return m_lines; }
+
+		// The source line of the instruction at PC, 0 without a line table.
+		unsigned sourceLine() const { return m_lines.lineAt(m_pc); }
+
+		// The timers tick at 60 Hz of emulated time, once every `instructions` instructions.
+		// 1 ticks them on every instruction. Limited to 1 - 0xFFFF.
+		void setInstructionsPerFrame(unsigned instructions)
+		{
+			m_instructionsPerFrame = instructions == 0 ? 1 : (instructions > 0xFFFF ? 0xFFFF : instructions);
+			if (m_frameCountdown > m_instructionsPerFrame) m_frameCountdown = m_instructionsPerFrame;
+		}
+		unsigned instructionsPerFrame() const { return m_instructionsPerFrame; }
+
+		// Attach a profiler, or detach it with `nullptr`. Can be switched at any time between runs.
+		void setProfiler(ExecutionCounter* profiler) { m_profiler = profiler; }
+
+		// Same for a trace recorder.
+		void setTracer(ExecutionTracer* tracer) { m_tracer = tracer; }
+
+		// Attach a recorder or player of the random bytes and key changes, or detach it with `nullptr`.
+		void setInput(InputChannel* input) { m_input = input; }
+
+		// Seed of the random generator, which restarts from it on every `initialize`.
+		void setSeed(std::uint64_t seed)
+		{
+			m_seed = seed;
+			m_random.seed(seed);
+		}
+		std::uint64_t seed() const { return m_seed; }
+
+		// Press or release a key of the keypad.
+		void setKey(unsigned key, bool pressed)
+		{
+			key &= 0xF;
+			if ((m_keypad[key] != 0) == pressed)
+				return;
+			m_keypad[key] = pressed ? 1 : 0;
+			if (m_input) m_input->keyChanged(*this, key, pressed);
+		}
+
+		// Select the interpreter back end. `Engine::Jit` runs like `Engine::Cached` until a back end is installed.
+		void setEngine(Engine engine) { m_engine = engine; }
+		Engine engine() const { return m_engine; }
+
+		// Select the machine, which resets it. The JIT only runs CHIP-8 and SUPER-CHIP code, on
+		// XO-CHIP `Engine::Jit` runs like `Engine::Cached`.
+		void setTarget(Target target)
+		{
+			m_target = target;
+			m_memory.assign(target_memory_size(target), 0);
+			m_memoryMask = unsigned(m_memory.size() - 1);
+			m_decoded.resize(m_memory.size());
+			markLineStarts();
+			initialize();
+		}
+		Target target() const { return m_target; }
+
+		// Select the quirks of the instructions, and whether accesses outside memory or the stack stop
+		// the run instead of wrapping around.
+		void setQuirks(Quirks quirks)
+		{
+			m_quirks = quirks;
+			selectPolicy();
+		}
+		Quirks quirks() const { return m_quirks; }
+		void setSanitizer(bool sanitize)
+		{
+			m_sanitize = sanitize;
+			selectPolicy();
+		}
+		bool sanitizer() const { return m_sanitize; }
+		void setJitBackend(std::unique_ptr<JitBackend> jit) { m_jit = std::move(jit); }
+		bool hasJitBackend() const { return m_jit != nullptr; }
+
+		// Execute a single instruction. Returns false once the machine stopped.
+		bool runCycle()
+		{
+			if (m_input) m_input->beforeInstruction(*this);
+			u16 pc = m_pc;
+			u16 instruction = fetch(pc);
+			if (m_journal) m_journal->beforeInstruction(*this, decode_instruction(instruction, m_target));
+			updateTimers();
+			bool running = executeInstruction();
+
+			// A FX0A that found no key took its cycle like any other instruction.
+			const bool executed = running || m_stopReason == StopReason::WaitingForKey;
+			if (m_journal) m_journal->afterInstruction(*this, executed);
+			if (m_profiler && executed) m_profiler->onExecuted(pc, instruction, m_pc);
+			if (m_tracer && executed) m_tracer->onExecuted(*this, pc, instruction);
+
+			if (m_observer)
+			{
+				if (executed) m_observer->onInstruction(*this, pc, instruction);
+				else m_observer->onStop(*this, m_stopReason);
+			}
+			return running;
+		}
+
+		// Execute up to `max_instructions` without any formatting or I/O, unless an observer, journal, input channel, profiler or tracer is attached.
+		StopReason run(std::uint64_t max_instructions)
+		{
+			if (m_breakpoints && m_breakpoints->armed())
+				return runChecked(max_instructions, false);
+			if (m_observer || m_journal || m_input || m_profiler || m_tracer)
+				return runObserved(max_instructions);
+			return runEngine(max_instructions);
+		}
+
+		// Keep a machine that waits in FX0A waiting for up to `n` cycles, as `n` calls of `run(1)`
+		// would. With nothing attached the cycles pass at once instead of one attempt at a time.
+		// Returns the cycles spent, fewer than `n` only if a key went down.
+		std::uint64_t idle(std::uint64_t n)
+		{
+			if (m_stopReason != StopReason::WaitingForKey)
+				return 0;
+			if (m_observer || m_journal || m_input || m_profiler || m_tracer)
+			{
+				std::uint64_t spent = 0;
+				while (spent < n && !anyKey() && cachedInstruction(m_pc).op == Op::LdVxKey)
+				{
+					runCycle();
+					++spent;
+				}
+				return spent;
+			}
+			if (anyKey())
+				return 0;
+
+			m_cycles += n;
+			if (n < m_frameCountdown)
+			{
+				m_frameCountdown -= std::uint32_t(n);
+				return n;
+			}
+			const std::uint64_t frames = 1 + (n - m_frameCountdown) / m_instructionsPerFrame;
+			m_frameCountdown = m_instructionsPerFrame - std::uint32_t((n - m_frameCountdown) % m_instructionsPerFrame);
+			m_delayTimer = u8(m_delayTimer > frames ? m_delayTimer - frames : 0);
+			m_soundTimer = u8(m_soundTimer > frames ? m_soundTimer - frames : 0);
+			return n;
+		}
+
+		// Run until PC reaches the first instruction of a source statement, at full speed and
+		// without calling the observer. Armed breakpoints still stop the run.
+		StopReason stepLine(std::uint64_t max_instructions)
+		{
+			DebugObserver* observer = m_observer;
+			m_observer = nullptr;
+			const StopReason reason = runChecked(max_instructions, true);
+			m_observer = observer;
+			return reason;
+		}
+
+		// Overwrite a register, e.g. to start several machines from different inputs.
+		void setV(unsigned index, u8 value) { m_v[index & 0xF] = value; }
+
+		// Read-only view of the machine state.
+		u16 pc() const { return m_pc; }
+		u8 sp() const { return m_sp; }
+		u16 i() const { return m_i; }
+		u8 v(unsigned index) const { return m_v[index & 0xF]; }
+		u16 stack(unsigned index) const { return m_stack[index % STACK_SIZE]; }
+		u8 delayTimer() const { return m_delayTimer; }
+		u8 soundTimer() const { return m_soundTimer; }
+		u8 memory(unsigned address) const { return m_memory[address & m_memoryMask]; }
+		unsigned memorySize() const { return unsigned(m_memory.size()); }
+		u8 flag(unsigned index) const { return m_flags[index % FLAG_REGS_TOTAL]; }
+		bool key(unsigned key) const { return m_keypad[key & 0xF] != 0; }
+		bool anyKey() const { return std::find(m_keypad, m_keypad + KEYPAD_SIZE, u8(1)) != m_keypad + KEYPAD_SIZE; }
+		// A pixel of the first plane in the current resolution.
+		bool pixel(unsigned x, unsigned y) const
+		{
+			x %= displayWidth();
+			y %= displayHeight();
+			return (m_display[y * rowWords() + x / 64] >> (63 - x % 64)) & 0x1;
+		}
+		// `displayHeight()` rows of `displayWidth() / 64` words, see `m_display`.
+		const std::uint64_t* display() const { return m_display; }
+		const std::uint64_t* plane(unsigned index) const { return m_display + (index % DISPLAY_PLANES) * PLANE_WORDS; }
+		unsigned displayWidth() const { return m_hires ? HIRES_W : DISPLAY_W; }
+		unsigned displayHeight() const { return m_hires ? HIRES_H : DISPLAY_H; }
+		bool hires() const { return m_hires; }
+		u8 planeMask() const { return m_planeMask; }
+		std::uint64_t cycles() const { return m_cycles; }
+		StopReason stopReason() const { return m_stopReason; }
+
+		// True if both machines are in exactly the same architectural state.
+		bool sameState(const Chip8Debugger& other) const
+		{
+			return m_memory == other.m_memory
+				&& std::memcmp(m_v, other.m_v, sizeof(m_v)) == 0
+				&& std::memcmp(m_stack, other.m_stack, sizeof(m_stack)) == 0
+				&& std::memcmp(m_keypad, other.m_keypad, sizeof(m_keypad)) == 0
+				&& std::memcmp(m_display, other.m_display, sizeof(m_display)) == 0
+				&& std::memcmp(m_flags, other.m_flags, sizeof(m_flags)) == 0
+				&& m_hires == other.m_hires && m_planeMask == other.m_planeMask
+				&& m_i == other.m_i && m_pc == other.m_pc && m_sp == other.m_sp
+				&& m_delayTimer == other.m_delayTimer && m_soundTimer == other.m_soundTimer
+				&& m_frameCountdown == other.m_frameCountdown && m_cycles == other.m_cycles;
+		}
+
+		// Hash of the architectural state, to compare runs across processes (see `AotMachine::stateHash`).
+		std::uint64_t stateHash() const
+		{
+			std::uint64_t hash = fnv1a(m_memory.data(), m_memory.size());
+			hash = fnv1a(m_v, sizeof(m_v), hash);
+			hash = fnv1a(&m_i, sizeof(m_i), hash);
+			hash = fnv1a(&m_pc, sizeof(m_pc), hash);
+			hash = fnv1a(&m_sp, sizeof(m_sp), hash);
+			hash = fnv1a(m_stack, sizeof(m_stack), hash);
+			hash = fnv1a(&m_delayTimer, sizeof(m_delayTimer), hash);
+			hash = fnv1a(&m_soundTimer, sizeof(m_soundTimer), hash);
+			hash = fnv1a(&m_frameCountdown, sizeof(m_frameCountdown), hash);
+			hash = fnv1a(m_keypad, sizeof(m_keypad), hash);
+			// CHIP-8 hashes like before the other targets existed.
+			if (m_target == Target::Chip8)
+				hash = fnv1a(m_display, DISPLAY_H * sizeof(std::uint64_t), hash);
+			else
+			{
+				hash = fnv1a(m_display, sizeof(m_display), hash);
+				hash = fnv1a(m_flags, sizeof(m_flags), hash);
+				hash = fnv1a(&m_hires, sizeof(m_hires), hash);
+				hash = fnv1a(&m_planeMask, sizeof(m_planeMask), hash);
+			}
+			return fnv1a(&m_cycles, sizeof(m_cycles), hash);
+		}
+
+	private:
+		StopReason runObserved(std::uint64_t max_instructions)
+		{
+			for (std::uint64_t n = 0; n < max_instructions; ++n)
+			{
+				if (!runCycle()) return m_stopReason;
+			}
+			m_stopReason = StopReason::BudgetExhausted;
+			return m_stopReason;
+		}
+
+		// Run the selected engine, which stops at the traps while `m_trapping`.
+		StopReason runEngine(std::uint64_t max_instructions)
+		{
+			if (m_engine == Engine::Jit && m_jit && m_target != Target::XoChip)
+				return m_jit->run(max_instructions);
+			if (m_engine == Engine::Switch)
+				return (this->*(m_trapping ? m_runSwitchTrapped : m_runSwitch))(max_instructions);
+			return (this->*(m_trapping ? m_runThreadedTrapped : m_runThreaded))(max_instructions);
+		}
+
+		// Mark the addresses `runChecked` has to look at before their instruction runs. False if
+		// a breakpoint can stop at any instruction.
+		bool setTraps(BreakCondition* breakpoints, bool stop_at_line)
+		{
+			std::vector<u8> traps = stop_at_line ? m_lineStart : std::vector<u8>(m_memory.size(), 0);
+			if (breakpoints && !breakpoints->markAddresses(traps))
+				return false;
+			if (traps != m_traps)
+			{
+				m_traps.swap(traps);
+				++m_trapGeneration;
+			}
+			return true;
+		}
+
+		// Stop `runChecked` after an instruction if a breakpoint hit or PC reached a statement.
+		bool stopsAfterInstruction(BreakCondition* breakpoints, bool stop_at_line)
+		{
+			if (breakpoints && breakpoints->hit(*this))
+				m_stopReason = StopReason::Breakpoint;
+			else if (stop_at_line && m_lineStart[m_pc & m_memoryMask])
+				m_stopReason = StopReason::LineReached;
+			else
+				return false;
+			return true;
+		}
+
+		// The only loop that looks at breakpoints. The other loops are used while none is armed.
+		// Breakpoints and statements tied to an address are trapped by the selected engine, which
+		// runs up to the next trap. The instruction at a trap runs alone, after the engine stopped.
+		StopReason runChecked(std::uint64_t max_instructions, bool stop_at_line)
+		{
+			BreakCondition* breakpoints = (m_breakpoints && m_breakpoints->armed()) ? m_breakpoints : nullptr;
+			if (breakpoints) breakpoints->begin(*this);
+
+			// Address breakpoints stop before their instruction runs, so the first one is checked
+			// here, unless the run resumes from that breakpoint or from a FX0A waiting there.
+			const bool resumes = m_stopReason == StopReason::Breakpoint || m_stopReason == StopReason::WaitingForKey;
+			if (breakpoints && !resumes && breakpoints->hitAddress(*this))
+			{
+				m_stopReason = StopReason::Breakpoint;
+				return m_stopReason;
+			}
+			const bool trapped = !(m_observer || m_journal || m_input || m_profiler || m_tracer) && setTraps(breakpoints, stop_at_line);
+			for (std::uint64_t n = 0; n < max_instructions;)
+			{
+				if (!runCycle()) return m_stopReason;
+				if (stopsAfterInstruction(breakpoints, stop_at_line)) return m_stopReason;
+				if (++n == max_instructions || !trapped)
+					continue;
+
+				const std::uint64_t cycles = m_cycles;
+				m_trapping = true;
+				const StopReason reason = runEngine(max_instructions - n);
+				m_trapping = false;
+				n += m_cycles - cycles;
+				if (reason != StopReason::Breakpoint) return reason;
+				if (stopsAfterInstruction(breakpoints, stop_at_line)) return m_stopReason;
+			}
+			m_stopReason = StopReason::BudgetExhausted;
+			return m_stopReason;
+		}
+
+		template<typename Policy>
+		void usePolicy()
+		{
+			m_execute = &Chip8Debugger::executeWith<Policy>;
+			m_runSwitch = &Chip8Debugger::runSwitch<Policy, false>;
+			m_runThreaded = &Chip8Debugger::runThreaded<Policy, false>;
+			m_runSwitchTrapped = &Chip8Debugger::runSwitch<Policy, true>;
+			m_runThreadedTrapped = &Chip8Debugger::runThreaded<Policy, true>;
+		}
+
+		// Pick the handlers and loops compiled for the quirks and the sanitizer in use.
+		void selectPolicy()
+		{
+			switch (m_quirks)
+			{
+			case Quirks::Cosmac:
+				if (m_sanitize) usePolicy<InterpreterPolicy<Quirks::Cosmac, true>>();
+				else usePolicy<InterpreterPolicy<Quirks::Cosmac, false>>();
+				break;
+			case Quirks::Schip:
+				if (m_sanitize) usePolicy<InterpreterPolicy<Quirks::Schip, true>>();
+				else usePolicy<InterpreterPolicy<Quirks::Schip, false>>();
+				break;
+			case Quirks::XoChip:
+				if (m_sanitize) usePolicy<InterpreterPolicy<Quirks::XoChip, true>>();
+				else usePolicy<InterpreterPolicy<Quirks::XoChip, false>>();
+				break;
+			default:
+				if (m_sanitize) usePolicy<InterpreterPolicy<Quirks::Chip8, true>>();
+				else usePolicy<InterpreterPolicy<Quirks::Chip8, false>>();
+				break;
+			}
+			// Translated code depends on the quirks.
+			if (m_jit) m_jit->reset();
+		}
+
+		// With `Traps`, every loop stops with StopReason::Breakpoint before an instruction at a trap.
+		template<typename Policy, bool Traps>
+		StopReason runSwitch(std::uint64_t max_instructions)
+		{
+			for (std::uint64_t n = 0; n < max_instructions; ++n)
+			{
+				if (Traps && m_traps[m_pc & m_memoryMask]) return trap();
+				updateTimers();
+				if (!executeWith<Policy>(decode_instruction(fetch(m_pc), m_target))) return m_stopReason;
+			}
+			m_stopReason = StopReason::BudgetExhausted;
+			return m_stopReason;
+		}
+
+		// Dispatch pre-decoded instructions. With GCC and Clang every handler jumps
+		// directly to the next one through a table of label addresses.
+		template<typename Policy, bool Traps>
+		StopReason runThreaded(std::uint64_t max_instructions)
+		{
+#if defined(__GNUC__)
+			static void* const handlers[] = {
+				&&op_undecoded, &&op_end, &&op_unknown, &&op_cls, &&op_ret, &&op_jp, &&op_call,
+				&&op_se_byte, &&op_sne_byte, &&op_se_reg, &&op_ld_byte, &&op_add_byte, &&op_ld_reg,
+				&&op_or, &&op_and, &&op_xor, &&op_add_reg, &&op_sub, &&op_shr, &&op_subn, &&op_shl,
+				&&op_sne_reg, &&op_ld_i, &&op_jp_v0, &&op_rnd, &&op_drw, &&op_skp, &&op_sknp,
+				&&op_ld_vx_dt, &&op_ld_vx_key, &&op_ld_dt_vx, &&op_ld_st_vx, &&op_add_i_vx,
+				&&op_ld_f_vx, &&op_ld_bcd, &&op_store_regs, &&op_load_regs,
+				&&op_scroll_down, &&op_scroll_right, &&op_scroll_left, &&op_lores, &&op_hires, &&op_drw_planes,
+				&&op_ld_hf_vx, &&op_store_flags, &&op_load_flags, &&op_scroll_up, &&op_save_range, &&op_load_range,
+				&&op_ld_i_long, &&op_plane, &&op_audio
+			};
+			static_assert(sizeof(handlers) / sizeof(handlers[0]) == static_cast<unsigned>(Op::Count), "Every `Op` needs a handler");
+
+			std::uint64_t remaining = max_instructions;
+			const DecodedInstruction* d;
+
+#define C8S_DISPATCH() \
+			do { \
+				if (remaining == 0) goto budget_exhausted; \
+				if (Traps && m_traps[m_pc & m_memoryMask]) return trap(); \
+				--remaining; \
+				updateTimers(); \
+				if (Policy::sanitize && !inBounds(cachedInstruction(m_pc))) goto bounds_violation; \
+				d = &m_decoded[m_pc & m_memoryMask]; \
+				goto *handlers[static_cast<unsigned>(d->op)]; \
+			} while (0)
+#define C8S_NEXT(call) call; ++m_cycles; C8S_DISPATCH()
+
+			C8S_DISPATCH();
+
+		op_undecoded:
+			m_decoded[m_pc & m_memoryMask] = decode_instruction(fetch(m_pc), m_target);
+			goto *handlers[static_cast<unsigned>(d->op)];
+		op_end:
+			m_stopReason = StopReason::EndOfProgram;
+			return m_stopReason;
+		op_unknown:
+			m_stopReason = StopReason::UnknownInstruction;
+			return m_stopReason;
+		op_cls: C8S_NEXT(opCls(*d));
+		op_ret: C8S_NEXT(opRet(*d));
+		op_jp: C8S_NEXT(opJp(*d));
+		op_call: C8S_NEXT(opCall(*d));
+		op_se_byte: C8S_NEXT(opSeByte(*d));
+		op_sne_byte: C8S_NEXT(opSneByte(*d));
+		op_se_reg: C8S_NEXT(opSeReg(*d));
+		op_ld_byte: C8S_NEXT(opLdByte(*d));
+		op_add_byte: C8S_NEXT(opAddByte(*d));
+		op_ld_reg: C8S_NEXT(opLdReg(*d));
+		op_or: C8S_NEXT(opOr(*d));
+		op_and: C8S_NEXT(opAnd(*d));
+		op_xor: C8S_NEXT(opXor(*d));
+		op_add_reg: C8S_NEXT(opAddReg(*d));
+		op_sub: C8S_NEXT(opSub(*d));
+		op_shr: C8S_NEXT(opShr<Policy>(*d));
+		op_subn: C8S_NEXT(opSubn(*d));
+		op_shl: C8S_NEXT(opShl<Policy>(*d));
+		op_sne_reg: C8S_NEXT(opSneReg(*d));
+		op_ld_i: C8S_NEXT(opLdI(*d));
+		op_jp_v0: C8S_NEXT(opJpV0<Policy>(*d));
+		op_rnd: C8S_NEXT(opRnd(*d));
+		op_drw: C8S_NEXT(opDrw<Policy>(*d));
+		op_skp: C8S_NEXT(opSkp(*d));
+		op_sknp: C8S_NEXT(opSknp(*d));
+		op_ld_vx_dt: C8S_NEXT(opLdVxDt(*d));
+		op_ld_vx_key:
+			if (!opLdVxKey(*d)) return waitForKey();
+			++m_cycles;
+			C8S_DISPATCH();
+		op_ld_dt_vx: C8S_NEXT(opLdDtVx(*d));
+		op_ld_st_vx: C8S_NEXT(opLdStVx(*d));
+		op_add_i_vx: C8S_NEXT(opAddIVx(*d));
+		op_ld_f_vx: C8S_NEXT(opLdFVx(*d));
+		op_ld_bcd: C8S_NEXT(opLdBcd(*d));
+		op_store_regs: C8S_NEXT(opStoreRegs<Policy>(*d));
+		op_load_regs: C8S_NEXT(opLoadRegs<Policy>(*d));
+		op_scroll_down: C8S_NEXT(opScrollDown(*d));
+		op_scroll_right: C8S_NEXT(opScrollRight(*d));
+		op_scroll_left: C8S_NEXT(opScrollLeft(*d));
+		op_lores: C8S_NEXT(opLores(*d));
+		op_hires: C8S_NEXT(opHires(*d));
+		op_drw_planes: C8S_NEXT(opDrwPlanes<Policy>(*d));
+		op_ld_hf_vx: C8S_NEXT(opLdHfVx(*d));
+		op_store_flags: C8S_NEXT(opStoreFlags(*d));
+		op_load_flags: C8S_NEXT(opLoadFlags(*d));
+		op_scroll_up: C8S_NEXT(opScrollUp(*d));
+		op_save_range: C8S_NEXT(opSaveRange(*d));
+		op_load_range: C8S_NEXT(opLoadRange(*d));
+		op_ld_i_long: C8S_NEXT(opLdILong(*d));
+		op_plane: C8S_NEXT(opPlane(*d));
+		op_audio: C8S_NEXT(opAudio(*d));
+
+		budget_exhausted:
+			m_stopReason = StopReason::BudgetExhausted;
+			return m_stopReason;
+		bounds_violation:
+			m_stopReason = StopReason::BoundsViolation;
+			return m_stopReason;
+
+#undef C8S_NEXT
+#undef C8S_DISPATCH
+#else
+			for (std::uint64_t n = 0; n < max_instructions; ++n)
+			{
+				if (Traps && m_traps[m_pc & m_memoryMask]) return trap();
+				updateTimers();
+				if (!executeWith<Policy>(cachedInstruction(m_pc))) return m_stopReason;
+			}
+			m_stopReason = StopReason::BudgetExhausted;
+			return m_stopReason;
+#endif
+		}
+
+		StopReason trap()
+		{
+			m_stopReason = StopReason::Breakpoint;
+			return m_stopReason;
+		}
+
+		u16 fetch(u16 address) const
+		{
+			return m_memory[address & m_memoryMask] << 8 | m_memory[(address + 1u) & m_memoryMask];
+		}
+
+		const DecodedInstruction& cachedInstruction(u16 address)
+		{
+			DecodedInstruction& d = m_decoded[address & m_memoryMask];
+			if (d.op == Op::Undecoded)
+				d = decode_instruction(fetch(address), m_target);
+			return d;
+		}
+
+		void invalidateDecodeCache()
+		{
+			for (DecodedInstruction& d : m_decoded) d.op = Op::Undecoded;
+		}
+
+		void markLineStarts()
+		{
+			m_lineStart.assign(m_memory.size(), 0);
+			for (const LineEntry& entry : m_lines.entries) m_lineStart[entry.address & m_memoryMask] = 1;
+		}
+
+		u8 readMemory(unsigned address) const
+		{
+			return m_memory[address & m_memoryMask];
+		}
+
+		// Every write drops the decoded instructions that overlap the written byte.
+		void writeMemory(unsigned address, u8 value)
+		{
+			address &= m_memoryMask;
+			m_memory[address] = value;
+			m_decoded[address].op = Op::Undecoded;
+			m_decoded[(address - 1) & m_memoryMask].op = Op::Undecoded;
+			if (m_jit) m_jit->invalidate(address);
+		}
+
+		unsigned rowWords() const { return m_hires ? 2 : 1; }
+		std::uint64_t* planeRows(unsigned index) { return m_display + index * PLANE_WORDS; }
+
+		// Clear the rows of the selected planes, which is the first DISPLAY_H words on CHIP-8.
+		void clearScreen()
+		{
+			for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+				if (m_planeMask & (1u << p)) std::memset(planeRows(p), 0, rowWords() * displayHeight() * sizeof(std::uint64_t));
+		}
+
+		// A taken skip also jumps over the second half of XO-CHIP's F000 NNNN.
+		u16 skipLength() const
+		{
+			return (m_target == Target::XoChip && fetch(m_pc + 2) == 0xF000) ? 6 : 4;
+		}
+		// Called before every instruction. The timers tick on the first instruction of each frame.
+		void updateTimers()
+		{
+			if (--m_frameCountdown != 0)
+				return;
+			m_frameCountdown = m_instructionsPerFrame;
+			m_delayTimer -= (m_delayTimer > 0 ? 1 : 0);
+			m_soundTimer -= (m_soundTimer > 0 ? 1 : 0);
+		}
+
+		bool executeInstruction()
+		{
+			if (m_engine == Engine::Switch)
+				return execute(decode_instruction(fetch(m_pc), m_target));
+			return execute(cachedInstruction(m_pc));
+		}
+
+		// Execute a decoded instruction with the selected policy. Returns false if the machine stopped.
+		bool execute(const DecodedInstruction& d)
+		{
+			return (this->*m_execute)(d);
+		}
+
+		// True if `d` at PC stays inside memory and the stack. Only checked by a sanitizing policy.
+		bool inBounds(const DecodedInstruction& d) const
+		{
+			if (m_pc > m_memory.size() - 2)
+				return false;
+			switch (d.op)
+			{
+			case Op::Call: return m_sp < STACK_SIZE;
+			case Op::Ret: return m_sp > 0 && m_sp <= STACK_SIZE;
+			case Op::Drw: return m_i + (d.kk & 0xFu) <= m_memory.size();
+			case Op::LdBcd: return m_i + 3u <= m_memory.size();
+			case Op::StoreRegs: case Op::LoadRegs: return m_i + d.x + 1u <= m_memory.size();
+			case Op::SaveRange: case Op::LoadRange: return m_i + (d.x < d.y ? d.y - d.x : d.x - d.y) + 1u <= m_memory.size();
+			case Op::LdILong: return m_pc + 4u <= m_memory.size();
+			case Op::DrwPlanes:
+			{
+				const unsigned planes = (m_planeMask & 1u) + (m_planeMask >> 1 & 1u);
+				return m_i + planes * ((d.kk & 0xFu) == 0 ? 32u : (d.kk & 0xFu)) <= m_memory.size();
+			}
+			default: return true;
+			}
+		}
+
+		template<typename Policy>
+		bool executeWith(const DecodedInstruction& d)
+		{
+			if (d.op == Op::Undecoded)
+				return executeWith<Policy>(cachedInstruction(m_pc));
+			if (Policy::sanitize && !inBounds(d))
+			{
+				m_stopReason = StopReason::BoundsViolation;
+				return false;
+			}
+			switch (d.op)
+			{
+			case Op::End: m_stopReason = StopReason::EndOfProgram; return false;
+			case Op::Unknown: m_stopReason = StopReason::UnknownInstruction; return false;
+			case Op::Cls: opCls(d); break;
+			case Op::Ret: opRet(d); break;
+			case Op::Jp: opJp(d); break;
+			case Op::Call: opCall(d); break;
+			case Op::SeByte: opSeByte(d); break;
+			case Op::SneByte: opSneByte(d); break;
+			case Op::SeReg: opSeReg(d); break;
+			case Op::LdByte: opLdByte(d); break;
+			case Op::AddByte: opAddByte(d); break;
+			case Op::LdReg: opLdReg(d); break;
+			case Op::Or: opOr(d); break;
+			case Op::And: opAnd(d); break;
+			case Op::Xor: opXor(d); break;
+			case Op::AddReg: opAddReg(d); break;
+			case Op::Sub: opSub(d); break;
+			case Op::Shr: opShr<Policy>(d); break;
+			case Op::Subn: opSubn(d); break;
+			case Op::Shl: opShl<Policy>(d); break;
+			case Op::SneReg: opSneReg(d); break;
+			case Op::LdI: opLdI(d); break;
+			case Op::JpV0: opJpV0<Policy>(d); break;
+			case Op::Rnd: opRnd(d); break;
+			case Op::Drw: opDrw<Policy>(d); break;
+			case Op::Skp: opSkp(d); break;
+			case Op::Sknp: opSknp(d); break;
+			case Op::LdVxDt: opLdVxDt(d); break;
+			case Op::LdVxKey: if (!opLdVxKey(d)) { waitForKey(); return false; } break;
+			case Op::LdDtVx: opLdDtVx(d); break;
+			case Op::LdStVx: opLdStVx(d); break;
+			case Op::AddIVx: opAddIVx(d); break;
+			case Op::LdFVx: opLdFVx(d); break;
+			case Op::LdBcd: opLdBcd(d); break;
+			case Op::StoreRegs: opStoreRegs<Policy>(d); break;
+			case Op::LoadRegs: opLoadRegs<Policy>(d); break;
+			case Op::ScrollDown: opScrollDown(d); break;
+			case Op::ScrollRight: opScrollRight(d); break;
+			case Op::ScrollLeft: opScrollLeft(d); break;
+			case Op::Lores: opLores(d); break;
+			case Op::Hires: opHires(d); break;
+			case Op::DrwPlanes: opDrwPlanes<Policy>(d); break;
+			case Op::LdHfVx: opLdHfVx(d); break;
+			case Op::StoreFlags: opStoreFlags(d); break;
+			case Op::LoadFlags: opLoadFlags(d); break;
+			case Op::ScrollUp: opScrollUp(d); break;
+			case Op::SaveRange: opSaveRange(d); break;
+			case Op::LoadRange: opLoadRange(d); break;
+			case Op::LdILong: opLdILong(d); break;
+			case Op::Plane: opPlane(d); break;
+			case Op::Audio: opAudio(d); break;
+			default: m_stopReason = StopReason::UnknownInstruction; return false;
+			}
+			++m_cycles;
+			return true;
+		}
+
+		// A FX0A without a key counts as a cycle, so waiting takes as long as spinning on it would.
+		StopReason waitForKey()
+		{
+			++m_cycles;
+			m_stopReason = StopReason::WaitingForKey;
+			return m_stopReason;
+		}
+
+		// Instruction handlers shared by all engines.
+		void opCls(const DecodedInstruction&) // Clear the screen.
+		{
+			clearScreen();
+			m_pc += 2;
+		}
+		// Without the sanitizer the stack pointer wraps around, like in the fleet and recompiled code.
+		void opRet(const DecodedInstruction&) // Return from subroutine.
+		{
+			--m_sp;
+			m_pc = m_stack[m_sp % STACK_SIZE];
+			m_pc += 2;
+		}
+		void opJp(const DecodedInstruction& d) // Jump to location nnn.
+		{
+			m_pc = d.nnn;
+		}
+		void opCall(const DecodedInstruction& d) // Call subroutine at nnn.
+		{
+			m_stack[m_sp % STACK_SIZE] = m_pc;
+			++m_sp;
+			m_pc = d.nnn;
+		}
+		void opSeByte(const DecodedInstruction& d) // Skip next instruction if Vx = kk.
+		{
+			m_pc += (m_v[d.x] == d.kk ? skipLength() : 2);
+		}
+		void opSneByte(const DecodedInstruction& d) // Skip next instruction if Vx != kk.
+		{
+			m_pc += (m_v[d.x] != d.kk ? skipLength() : 2);
+		}
+		void opSeReg(const DecodedInstruction& d) // Skip next instruction if Vx = Vy.
+		{
+			m_pc += (m_v[d.x] == m_v[d.y] ? skipLength() : 2);
+		}
+		void opLdByte(const DecodedInstruction& d) // Set Vx = kk.
+		{
+			m_v[d.x] = d.kk;
+			m_pc += 2;
+		}
+		void opAddByte(const DecodedInstruction& d) // Set Vx = Vx + kk.
+		{
+			m_v[d.x] += d.kk;
+			m_pc += 2;
+		}
+		void opLdReg(const DecodedInstruction& d) // Set Vx = Vy.
+		{
+			m_v[d.x] = m_v[d.y];
+			m_pc += 2;
+		}
+		void opOr(const DecodedInstruction& d) // Set Vx = Vx OR Vy.
+		{
+			m_v[d.x] |= m_v[d.y];
+			m_pc += 2;
+		}
+		void opAnd(const DecodedInstruction& d) // Set Vx = Vx AND Vy.
+		{
+			m_v[d.x] &= m_v[d.y];
+			m_pc += 2;
+		}
+		void opXor(const DecodedInstruction& d) // Set Vx = Vx XOR Vy.
+		{
+			m_v[d.x] ^= m_v[d.y];
+			m_pc += 2;
+		}
+		void opAddReg(const DecodedInstruction& d) // Set Vx = Vx + Vy, set VF = carry.
+		{
+			m_v[0xF] = (m_v[d.x] + m_v[d.y] > 0xFF) ? 1 : 0;
+			m_v[d.x] = (m_v[d.x] + m_v[d.y]) & 0xFF;
+			m_pc += 2;
+		}
+		void opSub(const DecodedInstruction& d) // Set Vx = Vx - Vy, set VF = NOT borrow.
+		{
+			m_v[0xF] = (m_v[d.x] > m_v[d.y]) ? 1 : 0;
+			m_v[d.x] -= m_v[d.y];
+			m_pc += 2;
+		}
+		template<typename Policy>
+		void opShr(const DecodedInstruction& d) // Set Vx = Vx SHR 1, or Vy SHR 1 with the COSMAC quirks.
+		{
+			const u8 source = Policy::shiftVy ? d.y : d.x;
+			m_v[0xF] = (m_v[source] & 0x1) != 0 ? 1 : 0;
+			m_v[d.x] = m_v[source] / 2;
+			m_pc += 2;
+		}
+		void opSubn(const DecodedInstruction& d) // Set Vx = Vy - Vx, set VF = NOT borrow.
+		{
+			m_v[0xF] = m_v[d.y] > m_v[d.x] ? 1 : 0;
+			m_v[d.x] = m_v[d.y] - m_v[d.x];
+			m_pc += 2;
+		}
+		template<typename Policy>
+		void opShl(const DecodedInstruction& d) // Set Vx = Vx SHL 1, or Vy SHL 1 with the COSMAC quirks.
+		{
+			const u8 source = Policy::shiftVy ? d.y : d.x;
+			m_v[0xF] = (m_v[source] & 0x80) != 0 ? 1 : 0;
+			m_v[d.x] = u8(m_v[source] * 2);
+			m_pc += 2;
+		}
+		void opSneReg(const DecodedInstruction& d) // Skip next instruction if Vx != Vy.
+		{
+			m_pc += m_v[d.x] != m_v[d.y] ? skipLength() : 2;
+		}
+		void opLdI(const DecodedInstruction& d) // Set I = nnn.
+		{
+			m_i = d.nnn;
+			m_pc += 2;
+		}
+		template<typename Policy>
+		void opJpV0(const DecodedInstruction& d) // Jump to location nnn + V0, or xnn + Vx with the SUPER-CHIP quirks.
+		{
+			m_pc = d.nnn + m_v[Policy::jumpVx ? d.x : 0];
+		}
+		void opRnd(const DecodedInstruction& d) // Set Vx = random byte AND kk.
+		{
+			u8 random = m_random.nextByte();
+			if (m_input) random = m_input->random(*this, random);
+			m_v[d.x] = d.kk & random;
+			m_pc += 2;
+		}
+		template<typename Policy>
+		void opDrw(const DecodedInstruction& d) // Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
+		{
+			const bool collision = Policy::clipSprites
+				? draw_sprite_clipped(m_display, m_memory.data(), m_i, m_v[d.x], m_v[d.y], d.kk & 0xF)
+				: draw_sprite(m_display, m_memory.data(), m_i, m_v[d.x], m_v[d.y], d.kk & 0xF);
+			m_v[0xF] = collision ? 0x1 : 0x0;
+			m_pc += 2;
+		}
+		void opSkp(const DecodedInstruction& d) // Skip next instruction if key with the value of Vx is pressed. 
+		{
+			m_pc += (m_keypad[m_v[d.x] & 0xF] != 0) ? skipLength() : 2;
+		}
+		void opSknp(const DecodedInstruction& d) // Skip next instruction if key with the value of Vx is not pressed.
+		{
+			m_pc += (m_keypad[m_v[d.x] & 0xF] == 0) ? skipLength() : 2;
+		}
+		void opLdVxDt(const DecodedInstruction& d) // Set Vx = delay timer value.
+		{
+			m_v[d.x] = m_delayTimer;
+			m_pc += 2;
+		}
+		bool opLdVxKey(const DecodedInstruction& d) // Wait for a key press, store the value of the key in Vx.
+		{
+			// The lowest key that is down. Without one PC stays and the caller stops the run.
+			for (unsigned i = 0; i < KEYPAD_SIZE; ++i)
+			{
+				if (m_keypad[i] != 0)
+				{
+					m_v[d.x] = i;
+					m_pc += 2;
+					return true;
+				}
+			}
+			return false;
+		}
+		void opLdDtVx(const DecodedInstruction& d) // Set delay timer = Vx.
+		{
+			m_delayTimer = m_v[d.x];
+			m_pc += 2;
+		}
+		void opLdStVx(const DecodedInstruction& d) // Set sound timer = Vx.
+		{
+			m_soundTimer = m_v[d.x];
+			m_pc += 2;
+		}
+		void opAddIVx(const DecodedInstruction& d) // Set I = I + Vx.
+		{
+			m_i += m_v[d.x];
+			m_pc += 2;
+		}
+		void opLdFVx(const DecodedInstruction& d) // Set I = location of sprite for digit Vx.
+		{
+			m_i = m_v[d.x] * 5; // Multiplied by sprite-size (5). 
+			m_pc += 2;
+		}
+		void opLdBcd(const DecodedInstruction& d) // Store BCD representation of Vx in memory locations I, I+1, and I+2.
+		{
+			// Ref: http://www.multigesture.net/wp-content/uploads/mirror/goldroad/chip8.shtml
+			writeMemory(m_i, m_v[d.x] / 100);
+			writeMemory(m_i + 1, (m_v[d.x] / 10) % 10);
+			writeMemory(m_i + 2, (m_v[d.x] % 100) % 10);
+			m_pc += 2;
+		}
+		template<typename Policy>
+		void opStoreRegs(const DecodedInstruction& d) // Store registers V0 through Vx in memory starting at location I.
+		{
+			for (unsigned j = 0; j <= d.x; ++j) writeMemory(m_i + j, m_v[j]);
+			if (Policy::incrementI) m_i += d.x + 1;
+			m_pc += 2;
+		}
+		template<typename Policy>
+		void opLoadRegs(const DecodedInstruction& d) // Read registers V0 through Vx from memory starting at location I.
+		{
+			for (unsigned j = 0; j <= d.x; ++j) m_v[j] = readMemory(m_i + j);
+			if (Policy::incrementI) m_i += d.x + 1;
+			m_pc += 2;
+		}
+
+		// SUPER-CHIP and XO-CHIP. Scrolls move whole words, and count pixels of the current resolution.
+		void opScrollDown(const DecodedInstruction& d) // Scroll the selected planes down by n rows.
+		{
+			const unsigned words = rowWords(), height = displayHeight(), n = d.kk & 0xF;
+			for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+			{
+				if ((m_planeMask & (1u << p)) == 0) continue;
+				std::uint64_t* rows = planeRows(p);
+				std::memmove(rows + n * words, rows, (height - n) * words * sizeof(std::uint64_t));
+				std::memset(rows, 0, n * words * sizeof(std::uint64_t));
+			}
+			m_pc += 2;
+		}
+		void opScrollUp(const DecodedInstruction& d) // Scroll the selected planes up by n rows.
+		{
+			const unsigned words = rowWords(), height = displayHeight(), n = d.kk & 0xF;
+			for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+			{
+				if ((m_planeMask & (1u << p)) == 0) continue;
+				std::uint64_t* rows = planeRows(p);
+				std::memmove(rows, rows + n * words, (height - n) * words * sizeof(std::uint64_t));
+				std::memset(rows + (height - n) * words, 0, n * words * sizeof(std::uint64_t));
+			}
+			m_pc += 2;
+		}
+		void opScrollRight(const DecodedInstruction&) // Scroll the selected planes right by 4 pixels.
+		{
+			for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+			{
+				if ((m_planeMask & (1u << p)) == 0) continue;
+				std::uint64_t* rows = planeRows(p);
+				if (!m_hires) for (unsigned y = 0; y < DISPLAY_H; ++y) rows[y] >>= 4;
+				else for (unsigned y = 0; y < HIRES_H; ++y) move_row_right(rows[2 * y], rows[2 * y + 1], 4, false);
+			}
+			m_pc += 2;
+		}
+		void opScrollLeft(const DecodedInstruction&) // Scroll the selected planes left by 4 pixels.
+		{
+			for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+			{
+				if ((m_planeMask & (1u << p)) == 0) continue;
+				std::uint64_t* rows = planeRows(p);
+				if (!m_hires) for (unsigned y = 0; y < DISPLAY_H; ++y) rows[y] <<= 4;
+				else for (unsigned y = 0; y < HIRES_H; ++y)
+				{
+					rows[2 * y] = (rows[2 * y] << 4) | (rows[2 * y + 1] >> 60);
+					rows[2 * y + 1] <<= 4;
+				}
+			}
+			m_pc += 2;
+		}
+		void opLores(const DecodedInstruction&) // Switch to 64x32 pixels and clear every plane.
+		{
+			m_hires = false;
+			std::memset(m_display, 0, sizeof(m_display));
+			m_pc += 2;
+		}
+		void opHires(const DecodedInstruction&) // Switch to 128x64 pixels and clear every plane.
+		{
+			m_hires = true;
+			std::memset(m_display, 0, sizeof(m_display));
+			m_pc += 2;
+		}
+		template<typename Policy>
+		void opDrwPlanes(const DecodedInstruction& d) // Display a sprite in every selected plane, 16x16 pixels for n = 0, set VF = collision.
+		{
+			// The data of the next selected plane follows the one of the previous plane.
+			const unsigned n = d.kk & 0xF, rows = n == 0 ? 16 : n, bytes = n == 0 ? 2 : 1;
+			unsigned i = m_i;
+			bool collision = false;
+			for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+			{
+				if ((m_planeMask & (1u << p)) == 0) continue;
+				collision |= draw_sprite_words(planeRows(p), rowWords(), displayHeight(), m_memory.data(), m_memoryMask,
+					i, m_v[d.x], m_v[d.y], rows, bytes, !Policy::clipSprites);
+				i += rows * bytes;
+			}
+			m_v[0xF] = collision ? 0x1 : 0x0;
+			m_pc += 2;
+		}
+		void opLdHfVx(const DecodedInstruction& d) // Set I = location of the big sprite for digit Vx.
+		{
+			m_i = BIG_FONT_START + (m_v[d.x] & 0xF) * 10;
+			m_pc += 2;
+		}
+		void opStoreFlags(const DecodedInstruction& d) // Store registers V0 through Vx in the flag registers.
+		{
+			for (unsigned j = 0; j <= d.x; ++j) m_flags[j] = m_v[j];
+			m_pc += 2;
+		}
+		void opLoadFlags(const DecodedInstruction& d) // Read registers V0 through Vx from the flag registers.
+		{
+			for (unsigned j = 0; j <= d.x; ++j) m_v[j] = m_flags[j];
+			m_pc += 2;
+		}
+		void opSaveRange(const DecodedInstruction& d) // Store registers Vx through Vy in memory starting at location I, I stays.
+		{
+			const unsigned count = (d.x < d.y ? d.y - d.x : d.x - d.y) + 1;
+			for (unsigned j = 0; j < count; ++j) writeMemory(m_i + j, m_v[d.x < d.y ? d.x + j : d.x - j]);
+			m_pc += 2;
+		}
+		void opLoadRange(const DecodedInstruction& d) // Read registers Vx through Vy from memory starting at location I, I stays.
+		{
+			const unsigned count = (d.x < d.y ? d.y - d.x : d.x - d.y) + 1;
+			for (unsigned j = 0; j < count; ++j) m_v[d.x < d.y ? d.x + j : d.x - j] = readMemory(m_i + j);
+			m_pc += 2;
+		}
+		void opLdILong(const DecodedInstruction&) // Set I = the 16 bits after the instruction.
+		{
+			m_i = fetch(m_pc + 2);
+			m_pc += 4;
+		}
+		void opPlane(const DecodedInstruction& d) // Select the planes in the bits of x.
+		{
+			m_planeMask = d.x & 0x3;
+			m_pc += 2;
+		}
+		void opAudio(const DecodedInstruction&) // Audio pattern and pitch, without sound output.
+		{
+			m_pc += 2;
+		}
+	};
+}
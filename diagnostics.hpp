@@ -0,0 +1,243 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <initializer_list>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace c8s
+{
+	// Severity of a diagnostic, ordered from most to least verbose.
+	enum class Severity
+	{
+		Trace,
+		Debug,
+		Info,
+		Warning,
+		Error,
+		Off	// Only used as threshold to disable all output.
+	};
+
+	const char* severity_name(Severity severity)
+	{
+		switch (severity)
+		{
+		case Severity::Trace: return "trace";
+		case Severity::Debug: return "debug";
+		case Severity::Info: return "info";
+		case Severity::Warning: return "warning";
+		case Severity::Error: return "error";
+		default: return "off";
+		}
+	}
+
+	// Returns false if `name` is not a known severity.
+	bool parse_severity(const std::string& name, Severity& severity)
+	{
+		for (Severity s : { Severity::Trace, Severity::Debug, Severity::Info, Severity::Warning, Severity::Error, Severity::Off })
+		{
+			if (name == severity_name(s))
+			{
+				severity = s;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Receives diagnostics that passed the threshold.
+	class DiagnosticSink
+	{
+	public:
+		virtual ~DiagnosticSink() = default;
+		virtual void write(Severity severity, const std::string& message) = 0;
+		virtual void flush() {}
+	};
+
+	// Discards everything.
+	class NullSink : public DiagnosticSink
+	{
+	public:
+		void write(Severity, const std::string&) override {}
+	};
+
+	// Collects lines of text and writes them in large blocks. Warnings and
+	// errors go to `error_os`, everything else to `os`.
+	class BufferedTextSink : public DiagnosticSink
+	{
+		std::ostream& m_os;
+		std::ostream& m_error_os;
+		std::string m_buffer;
+		std::string m_error_buffer;
+		std::size_t m_capacity;
+
+	public:
+		BufferedTextSink(std::ostream& os, std::ostream& error_os, std::size_t capacity = 0x4000)
+			: m_os{ os }, m_error_os{ error_os }, m_capacity{ capacity } {}
+
+		~BufferedTextSink() override { flush(); }
+
+		void write(Severity severity, const std::string& message) override
+		{
+			std::string& buffer = (severity >= Severity::Warning) ? m_error_buffer : m_buffer;
+			buffer += message;
+			if (message.empty() || message.back() != '\n')
+				buffer += '\n';
+
+			if (m_buffer.size() + m_error_buffer.size() >= m_capacity)
+				flush();
+		}
+
+		void flush() override
+		{
+			if (!m_buffer.empty())
+			{
+				m_os.write(m_buffer.data(), m_buffer.size());
+				m_os.flush();
+				m_buffer.clear();
+			}
+			if (!m_error_buffer.empty())
+			{
+				m_error_os.write(m_error_buffer.data(), m_error_buffer.size());
+				m_error_os.flush();
+				m_error_buffer.clear();
+			}
+		}
+	};
+
+	// Writes one JSON object per diagnostic: {"severity":"info","message":"..."}.
+	class JsonLinesSink : public DiagnosticSink
+	{
+		std::ostream& m_os;
+		std::string m_buffer;
+		std::size_t m_capacity;
+
+		void append_escaped(const std::string& text)
+		{
+			const char* hex = "0123456789abcdef";
+			for (char c : text)
+			{
+				switch (c)
+				{
+				case '"': m_buffer += "\\\""; break;
+				case '\\': m_buffer += "\\\\"; break;
+				case '\n': m_buffer += "\\n"; break;
+				case '\t': m_buffer += "\\t"; break;
+				case '\r': m_buffer += "\\r"; break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+					{
+						m_buffer += "\\u00";
+						m_buffer += hex[(c >> 4) & 0xF];
+						m_buffer += hex[c & 0xF];
+					}
+					else m_buffer += c;
+				}
+			}
+		}
+
+	public:
+		JsonLinesSink(std::ostream& os, std::size_t capacity = 0x4000)
+			: m_os{ os }, m_capacity{ capacity } {}
+
+		~JsonLinesSink() override { flush(); }
+
+		void write(Severity severity, const std::string& message) override
+		{
+			m_buffer += "{\"severity\":\"";
+			m_buffer += severity_name(severity);
+			m_buffer += "\",\"message\":\"";
+			append_escaped(message);
+			m_buffer += "\"}\n";
+
+			if (m_buffer.size() >= m_capacity)
+				flush();
+		}
+
+		void flush() override
+		{
+			if (m_buffer.empty())
+				return;
+			m_os.write(m_buffer.data(), m_buffer.size());
+			m_os.flush();
+			m_buffer.clear();
+		}
+	};
+
+	// Global diagnostics entry point. Messages are passed as callables that are only
+	// invoked if their severity passes the threshold, so a disabled trace costs one compare.
+	class diagnostics
+	{
+		static Severity m_threshold;
+		static DiagnosticSink* m_sink;
+		static BufferedTextSink m_default_sink;
+
+	public:
+		static void set_sink(DiagnosticSink* sink) { m_sink = (sink != nullptr) ? sink : &m_default_sink; }
+		static void set_threshold(Severity threshold) { m_threshold = threshold; }
+		static Severity threshold() { return m_threshold; }
+		static bool is_enabled(Severity severity) { return severity >= m_threshold; }
+		static void flush() { m_sink->flush(); }
+
+		// Emit the string returned by `format()`.
+		template<typename Format>
+		static void write(Severity severity, Format&& format)
+		{
+			if (is_enabled(severity))
+				m_sink->write(severity, format());
+		}
+
+		// Emit a constant message.
+		static void write(Severity severity, const char* message)
+		{
+			if (is_enabled(severity))
+				m_sink->write(severity, message);
+		}
+
+		// Emit everything `print(std::ostream&)` writes into the stream.
+		template<typename Print>
+		static void write_stream(Severity severity, Print&& print)
+		{
+			if (!is_enabled(severity))
+				return;
+			std::ostringstream oss;
+			print(oss);
+			m_sink->write(severity, oss.str());
+		}
+
+		template<typename Format> static void trace(Format&& format) { write(Severity::Trace, std::forward<Format>(format)); }
+		template<typename Format> static void debug(Format&& format) { write(Severity::Debug, std::forward<Format>(format)); }
+		template<typename Format> static void info(Format&& format) { write(Severity::Info, std::forward<Format>(format)); }
+		template<typename Format> static void warning(Format&& format) { write(Severity::Warning, std::forward<Format>(format)); }
+		template<typename Format> static void error(Format&& format) { write(Severity::Error, std::forward<Format>(format)); }
+	};
+
+	Severity diagnostics::m_threshold = Severity::Info;
+	BufferedTextSink diagnostics::m_default_sink{ std::cout, std::cerr };
+	DiagnosticSink* diagnostics::m_sink = &diagnostics::m_default_sink;
+}
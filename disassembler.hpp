@@ -0,0 +1,434 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <bitset>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compiler_log.hpp"
+#include "debugger.hpp"
+#include "opcode-table.hpp"
+
+// Longest text `disassemble` writes for two bytes of a ROM, label included.
+#define DISASSEMBLY_LINE_MAX 32
+
+namespace c8s
+{
+	// Characters `disassemble` needs at most for a ROM of `size` bytes.
+	std::size_t disassembly_capacity(std::size_t size)
+	{
+		return (size / 2 + 1) * DISASSEMBLY_LINE_MAX;
+	}
+
+	std::string to_upper(std::string text)
+	{
+		for (char& c : text) c = char(std::toupper(static_cast<unsigned char>(c)));
+		return text;
+	}
+
+	std::string trim(const std::string& text)
+	{
+		const auto first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos) return "";
+		return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+	}
+
+	// Splits a comma separated list and trims the items.
+	std::vector<std::string> split_list(const std::string& text)
+	{
+		std::vector<std::string> items;
+		for (std::size_t first = 0; first <= text.size();)
+		{
+			std::size_t comma = text.find(',', first);
+			if (comma == std::string::npos) comma = text.size();
+			items.push_back(trim(text.substr(first, comma - first)));
+			first = comma + 1;
+		}
+		return items;
+	}
+
+	// Kinds of operands in the syntax of OPCODE_TABLE.
+	enum class OperandKind : u8
+	{
+		Literal,	// Written as is, like `DT` or `[I]`.
+		Vx,
+		Vy,
+		Byte,
+		Nibble,
+		Planes,		// The X nibble of FN01.
+		Address,	// A label or a 12 bit number.
+		Long		// `long ` and a label or a 16 bit number, taken from the next word.
+	};
+
+	struct OperandFormat
+	{
+		OperandKind kind;
+		std::string literal;
+	};
+
+	// The operands of every entry of OPCODE_TABLE, parsed once.
+	const std::vector<std::vector<OperandFormat>>& operand_formats()
+	{
+		static const std::vector<std::vector<OperandFormat>> formats = []
+		{
+			std::vector<std::vector<OperandFormat>> all;
+			for (const OpcodeInfo& info : OPCODE_TABLE)
+			{
+				all.emplace_back();
+				if (*info.operands == '\0')
+					continue;
+				for (const std::string& name : split_list(info.operands))
+				{
+					OperandKind kind = OperandKind::Literal;
+					if (name == "Vx") kind = OperandKind::Vx;
+					else if (name == "Vy") kind = OperandKind::Vy;
+					else if (name == "byte") kind = OperandKind::Byte;
+					else if (name == "n") kind = OperandKind::Nibble;
+					else if (name == "planes") kind = OperandKind::Planes;
+					else if (name == "addr") kind = OperandKind::Address;
+					else if (name == "long") kind = OperandKind::Long;
+					all.back().push_back(OperandFormat{ kind, kind == OperandKind::Literal ? to_upper(name) : "" });
+				}
+			}
+			return all;
+		}();
+		return formats;
+	}
+
+	// JP, CALL and JP V0 get a label at their target.
+	bool is_branch(const OpcodeInfo& info)
+	{
+		return info.pattern == 0x1000 || info.pattern == 0x2000 || info.pattern == 0xB000;
+	}
+
+	// The instruction at `offset` of the ROM and its length in bytes. Words that are no
+	// instruction on `target` and a `F000` without the word after it are data.
+	const OpcodeInfo* instruction_at(const u8* rom, std::size_t size, std::size_t offset, Target target, unsigned& length)
+	{
+		if (offset + 1 >= size)
+		{
+			length = 1;
+			return nullptr;
+		}
+		const OpcodeInfo* info = find_opcode(u16(rom[offset] << 8 | rom[offset + 1]), target);
+		length = (info != nullptr && info->pattern == 0xF000) ? 4 : 2;
+		if (offset + length > size)
+		{
+			length = 2;
+			return nullptr;
+		}
+		return info;
+	}
+
+	void put_text(char*& out, const char* text)
+	{
+		while (*text != '\0') *out++ = *text++;
+	}
+
+	void put_hex(char*& out, unsigned value, unsigned digits)
+	{
+		*out++ = '0';
+		*out++ = 'x';
+		while (digits-- > 0) *out++ = "0123456789ABCDEF"[(value >> (digits * 4)) & 0xF];
+	}
+
+	void put_decimal(char*& out, unsigned value)
+	{
+		if (value >= 10) *out++ = char('0' + value / 10);
+		*out++ = char('0' + value % 10);
+	}
+
+	void put_label(char*& out, unsigned address)
+	{
+		*out++ = 'L';
+		for (int shift = 8; shift >= 0; shift -= 4) *out++ = "0123456789ABCDEF"[(address >> shift) & 0xF];
+	}
+
+	// Writes the mnemonic and operands of the instruction `info` at `offset` of the ROM. Branch
+	// targets in `labels` are written as labels, all other addresses as numbers.
+	void put_instruction(char*& out, const u8* rom, std::size_t offset, const OpcodeInfo& info, const std::bitset<MEMORY_SIZE>& labels)
+	{
+		const unsigned op = rom[offset] << 8 | rom[offset + 1];
+		put_text(out, info.mnemonic);
+		const auto& operands = operand_formats()[std::size_t(&info - OPCODE_TABLE)];
+		for (std::size_t j = 0; j < operands.size(); ++j)
+		{
+			put_text(out, j == 0 ? " " : ", ");
+			switch (operands[j].kind)
+			{
+			case OperandKind::Literal: put_text(out, operands[j].literal.c_str()); break;
+			case OperandKind::Vx: *out++ = 'V'; *out++ = "0123456789ABCDEF"[(op >> 8) & 0xF]; break;
+			case OperandKind::Vy: *out++ = 'V'; *out++ = "0123456789ABCDEF"[(op >> 4) & 0xF]; break;
+			case OperandKind::Byte: put_hex(out, op & 0xFF, 2); break;
+			case OperandKind::Nibble: put_decimal(out, op & 0xF); break;
+			case OperandKind::Planes: put_decimal(out, (op >> 8) & 0xF); break;
+			case OperandKind::Address:
+				if (is_branch(info) && labels[op & 0xFFF]) put_label(out, op & 0xFFF);
+				else put_hex(out, op & 0xFFF, 3);
+				break;
+			case OperandKind::Long:
+				put_text(out, "long ");
+				put_hex(out, unsigned(rom[offset + 2] << 8 | rom[offset + 3]), 4);
+				break;
+			}
+		}
+	}
+
+	// Writes the assembly of the ROM loaded at PROGRAM_START into `out` and returns the number of
+	// characters written, or 0 if `capacity` is below `disassembly_capacity(size)`. Jump and call
+	// targets get labels like `L2A4`, words that are no instruction become `DW 0x1234`.
+	std::size_t disassemble(const u8* rom, std::size_t size, char* out, std::size_t capacity, Target target = Target::Chip8)
+	{
+		if (capacity < disassembly_capacity(size))
+			return 0;
+
+		// Labels only go where an instruction starts, other targets stay numbers.
+		std::bitset<MEMORY_SIZE> starts, targets;
+		unsigned length = 0;
+		for (std::size_t offset = 0; offset < size; offset += length)
+		{
+			const OpcodeInfo* info = instruction_at(rom, size, offset, target, length);
+			if (PROGRAM_START + offset < MEMORY_SIZE) starts.set(PROGRAM_START + offset);
+			if (info != nullptr && is_branch(*info)) targets.set(((rom[offset] << 8) | rom[offset + 1]) & 0xFFF);
+		}
+		const std::bitset<MEMORY_SIZE> labels = starts & targets;
+
+		char* const begin = out;
+		for (std::size_t offset = 0; offset < size; offset += length)
+		{
+			const unsigned address = unsigned(PROGRAM_START + offset);
+			const OpcodeInfo* info = instruction_at(rom, size, offset, target, length);
+			if (address < MEMORY_SIZE && labels[address])
+			{
+				put_label(out, address);
+				put_text(out, ":\n");
+			}
+
+			*out++ = '\t';
+			if (info == nullptr)
+			{
+				put_text(out, length == 1 ? "DB " : "DW ");
+				put_hex(out, length == 1 ? rom[offset] : unsigned(rom[offset] << 8 | rom[offset + 1]), length * 2);
+				*out++ = '\n';
+				continue;
+			}
+
+			put_instruction(out, rom, offset, *info, labels);
+			*out++ = '\n';
+		}
+		return std::size_t(out - begin);
+	}
+
+	std::string disassemble(const std::vector<u8>& rom, Target target = Target::Chip8)
+	{
+		std::string text(disassembly_capacity(rom.size()), '\0');
+		text.resize(disassemble(rom.data(), rom.size(), &text[0], text.size(), target));
+		return text;
+	}
+
+	// Decimal or hex with `0x`. Returns false if `text` is no number or above `max`.
+	bool parse_number(const std::string& text, unsigned max, unsigned& value)
+	{
+		const bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+		const std::string digits = hex ? text.substr(2) : text;
+		if (digits.empty() || digits.size() > 5) return false;
+		for (char c : digits)
+			if (!(hex ? std::isxdigit(static_cast<unsigned char>(c)) : std::isdigit(static_cast<unsigned char>(c)))) return false;
+		value = unsigned(std::strtoul(digits.c_str(), nullptr, hex ? 16 : 10));
+		return value <= max;
+	}
+
+	bool is_label_name(const std::string& text)
+	{
+		if (text.empty() || !(std::isalpha(static_cast<unsigned char>(text[0])) || text[0] == '_')) return false;
+		for (char c : text)
+			if (!(std::isalnum(static_cast<unsigned char>(c)) || c == '_')) return false;
+		return true;
+	}
+
+	// A label operand that is resolved after all lines are read.
+	struct LabelFixup
+	{
+		std::size_t offset;	// Of the instruction in the ROM.
+		std::string label;
+		bool is_long;		// The label fills the word after `F000` instead of NNN.
+		unsigned line;
+	};
+
+	// Matches the upper case `text` against `format`. Numbers go to `value`, labels to `label`
+	// in the case of `original`.
+	bool match_operand(const OperandFormat& format, const std::string& text, const std::string& original, unsigned& value, std::string& label)
+	{
+		switch (format.kind)
+		{
+		case OperandKind::Literal: return text == format.literal;
+		case OperandKind::Vx:
+		case OperandKind::Vy: return text.size() == 2 && text[0] == 'V' && parse_number("0x" + text.substr(1), 0xF, value);
+		case OperandKind::Byte: return parse_number(text, 0xFF, value);
+		case OperandKind::Nibble:
+		case OperandKind::Planes: return parse_number(text, 0xF, value);
+		default: break;
+		}
+
+		std::string target = original;
+		if (format.kind == OperandKind::Long)
+		{
+			if (text.compare(0, 5, "LONG ") != 0) return false;
+			target = trim(original.substr(5));
+		}
+		if (parse_number(target, format.kind == OperandKind::Long ? 0xFFFF : 0xFFF, value)) return true;
+		if (!is_label_name(target)) return false;
+		value = 0;
+		label = target;
+		return true;
+	}
+
+	// Assembles the syntax `disassemble` writes into a ROM for PROGRAM_START. Mnemonics and registers
+	// are case insensitive, numbers decimal or hex with `0x`, `;` starts a comment and `name:` defines
+	// a label. `DB` and `DW` take a list of bytes or words. On errors the compiler log holds them
+	// and the ROM is empty.
+	std::vector<u8> assemble(const std::string& source, Target target = Target::Chip8)
+	{
+		compiler_log::reset_all();
+		std::vector<u8> rom;
+		std::map<std::string, unsigned> labels;
+		std::vector<LabelFixup> fixups;
+
+		std::istringstream lines{ source };
+		std::string line;
+		for (unsigned number = 1; std::getline(lines, line); ++number)
+		{
+			auto error = [&](const std::string& message) { compiler_log::write_error("Line " + std::to_string(number) + ": " + message); };
+
+			line = trim(line.substr(0, line.find(';')));
+			const auto colon = line.find(':');
+			if (colon != std::string::npos)
+			{
+				const std::string name = trim(line.substr(0, colon));
+				if (!is_label_name(name)) error("`" + name + "` is no valid label");
+				else if (!labels.emplace(name, unsigned(PROGRAM_START + rom.size())).second) error("Label `" + name + "` is defined twice");
+				line = trim(line.substr(colon + 1));
+			}
+			if (line.empty())
+				continue;
+
+			// Split into the mnemonic and the operands.
+			const auto space = line.find_first_of(" \t");
+			const std::string mnemonic = to_upper(line.substr(0, space));
+			const std::vector<std::string> operands = space == std::string::npos ? std::vector<std::string>{} : split_list(line.substr(space));
+			std::vector<std::string> upper;
+			for (const auto& operand : operands) upper.push_back(to_upper(operand));
+
+			if (mnemonic == "DB" || mnemonic == "DW")
+			{
+				const bool words = mnemonic == "DW";
+				for (const auto& operand : operands)
+				{
+					unsigned value = 0;
+					if (!parse_number(operand, words ? 0xFFFF : 0xFF, value))
+					{
+						error("`" + operand + "` is no " + (words ? "word" : "byte"));
+						continue;
+					}
+					if (words) rom.push_back(u8(value >> 8));
+					rom.push_back(u8(value));
+				}
+				continue;
+			}
+
+			// The first instruction of the table whose operands all match.
+			bool matched = false;
+			for (unsigned entry = 0; entry < OPCODE_COUNT; ++entry)
+			{
+				const OpcodeInfo& info = OPCODE_TABLE[entry];
+				const auto& formats = operand_formats()[entry];
+				if (info.mnemonic != mnemonic || info.target > target || formats.size() != operands.size())
+					continue;
+
+				u16 op = info.pattern, next = 0;
+				std::string label;
+				bool all = true;
+				for (unsigned j = 0; j < formats.size() && all; ++j)
+				{
+					unsigned value = 0;
+					all = match_operand(formats[j], upper[j], operands[j], value, label);
+					switch (formats[j].kind)
+					{
+					case OperandKind::Vx: case OperandKind::Planes: op |= value << 8; break;
+					case OperandKind::Vy: op |= value << 4; break;
+					case OperandKind::Byte: case OperandKind::Nibble: case OperandKind::Address: op |= value; break;
+					case OperandKind::Long: next = u16(value); break;
+					case OperandKind::Literal: break;
+					}
+				}
+				if (!all)
+					continue;
+
+				if (!label.empty()) fixups.push_back(LabelFixup{ rom.size(), label, info.pattern == 0xF000, number });
+				rom.push_back(u8(op >> 8));
+				rom.push_back(u8(op));
+				if (info.pattern == 0xF000)
+				{
+					rom.push_back(u8(next >> 8));
+					rom.push_back(u8(next));
+				}
+				matched = true;
+				break;
+			}
+			if (!matched) error("`" + line + "` is no instruction of the target");
+		}
+
+		for (const auto& fixup : fixups)
+		{
+			const auto label = labels.find(fixup.label);
+			if (label == labels.end())
+				compiler_log::write_error("Line " + std::to_string(fixup.line) + ": Label `" + fixup.label + "` is not defined");
+			else if (fixup.is_long)
+			{
+				rom[fixup.offset + 2] = u8(label->second >> 8);
+				rom[fixup.offset + 3] = u8(label->second);
+			}
+			else if (label->second > 0xFFF)
+				compiler_log::write_error("Line " + std::to_string(fixup.line) + ": Label `" + fixup.label + "` is out of reach of a jump");
+			else
+			{
+				rom[fixup.offset] |= u8(label->second >> 8);
+				rom[fixup.offset + 1] = u8(label->second);
+			}
+		}
+
+		if (rom.size() > target_memory_size(target) - PROGRAM_START)
+			compiler_log::write_error("The program needs " + std::to_string(rom.size()) + " bytes, more than fit into the memory of the target");
+		if (!compiler_log::read_errors().empty())
+			rom.clear();
+		return rom;
+	}
+}
@@ -0,0 +1,545 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "debugger.hpp"
+
+namespace c8s
+{
+	// Runs many instances of the same program in lockstep. Every register is stored as an array
+	// with one lane per machine, so an instruction is executed for all machines at the same PC by
+	// one loop over the lanes, which the compiler can vectorize. Lanes whose PC diverged wait under
+	// a mask: every step picks the lowest PC among the running lanes, so branches that meet again
+	// further down the program regroup their lanes there.
+	// All lanes read the memory image of the ROM until they write to memory for the first time,
+	// then they get a private copy.
+	class Chip8Fleet
+	{
+		unsigned m_lanes;
+		u8 m_image[MEMORY_SIZE];
+		std::vector<std::unique_ptr<u8[]>> m_memory;	// Private memory per lane, or null.
+		unsigned m_privateLanes;
+
+		std::vector<u8> m_v[V_REGS_TOTAL];
+		std::vector<u16> m_i;
+		std::vector<u16> m_pc;
+		std::vector<u8> m_sp;
+		std::vector<u16> m_stack[STACK_SIZE];
+		std::vector<u8> m_delayTimer;
+		std::vector<u8> m_soundTimer;
+		std::vector<u16> m_frameCountdown;	// Fits, the frame length is at most 0xFFFF.
+		std::uint32_t m_instructionsPerFrame;
+		std::vector<u8> m_keypad[KEYPAD_SIZE];
+		std::vector<std::uint64_t> m_display;	// DISPLAY_H rows per lane, see `draw_sprite`.
+		std::vector<std::uint64_t> m_cycles;
+		std::vector<std::uint64_t> m_seed;
+		std::vector<Xoshiro128> m_random;
+		std::vector<StopReason> m_stopReason;
+
+		std::vector<u8> m_stopped;
+		std::vector<u8> m_live;		// Running and budget left.
+		std::vector<u8> m_mask;		// Lanes of the current step.
+		std::vector<std::uint32_t> m_remaining;
+		std::uint64_t m_steps;
+
+	public:
+		explicit Chip8Fleet(unsigned lanes)
+			: m_lanes{ std::max(lanes, 1u) }, m_instructionsPerFrame{ INSTRUCTIONS_PER_FRAME }, m_steps{ 0 }
+		{
+			const unsigned n = m_lanes;
+			m_memory.resize(n);
+			for (auto& v : m_v) v.resize(n);
+			m_i.resize(n);
+			m_pc.resize(n);
+			m_sp.resize(n);
+			for (auto& slot : m_stack) slot.resize(n);
+			m_delayTimer.resize(n);
+			m_soundTimer.resize(n);
+			m_frameCountdown.resize(n);
+			for (auto& key : m_keypad) key.resize(n);
+			m_display.resize(std::size_t(n) * DISPLAY_H);
+			m_cycles.resize(n);
+			m_seed.resize(n);
+			for (auto& seed : m_seed) seed = default_seed();
+			m_random.resize(n);
+			m_stopReason.resize(n);
+			m_stopped.resize(n);
+			m_live.resize(n);
+			m_mask.resize(n);
+			m_remaining.resize(n);
+			initialize();
+		}
+
+		// Reset every lane to the power-on state.
+		void initialize()
+		{
+			std::memset(m_image, 0, sizeof(m_image));
+			std::memcpy(m_image, FONTSET, FONTSET_SIZE);
+			for (auto& memory : m_memory) memory.reset();
+			m_privateLanes = 0;
+			for (unsigned k = 0; k < m_lanes; ++k) m_random[k].seed(m_seed[k]);
+
+			for (auto& v : m_v) std::fill(v.begin(), v.end(), u8(0));
+			std::fill(m_i.begin(), m_i.end(), u16(0));
+			std::fill(m_pc.begin(), m_pc.end(), u16(PROGRAM_START));
+			std::fill(m_sp.begin(), m_sp.end(), u8(0));
+			for (auto& slot : m_stack) std::fill(slot.begin(), slot.end(), u16(0));
+			std::fill(m_delayTimer.begin(), m_delayTimer.end(), u8(0));
+			std::fill(m_soundTimer.begin(), m_soundTimer.end(), u8(0));
+			std::fill(m_frameCountdown.begin(), m_frameCountdown.end(), u16(1));
+			for (auto& key : m_keypad) std::fill(key.begin(), key.end(), u8(0));
+			std::fill(m_display.begin(), m_display.end(), std::uint64_t(0));
+			std::fill(m_cycles.begin(), m_cycles.end(), std::uint64_t(0));
+			std::fill(m_stopReason.begin(), m_stopReason.end(), StopReason::BudgetExhausted);
+			m_steps = 0;
+		}
+
+		// Load the same compiled opcodes into every lane.
+		bool loadProgram(const std::vector<u16>& opcodes)
+		{
+			initialize();
+			if (opcodes.size() * 2 > MEMORY_SIZE - PROGRAM_START)
+				return false;
+
+			for (unsigned j = 0; j < opcodes.size(); ++j)
+			{
+				m_image[PROGRAM_START + j * 2] = opcodes[j] >> 8;
+				m_image[PROGRAM_START + j * 2 + 1] = opcodes[j] & 0xFF;
+			}
+			return true;
+		}
+
+		// Same as `Chip8Debugger::setInstructionsPerFrame`, for all lanes.
+		void setInstructionsPerFrame(unsigned instructions)
+		{
+			m_instructionsPerFrame = instructions == 0 ? 1 : (instructions > 0xFFFF ? 0xFFFF : instructions);
+			for (auto& countdown : m_frameCountdown) countdown = u16(std::min<std::uint32_t>(countdown, m_instructionsPerFrame));
+		}
+
+		// Per-lane inputs, so the lanes take different paths through the program.
+		void setV(unsigned lane, unsigned index, u8 value) { m_v[index & 0xF][lane % m_lanes] = value; }
+		void setKey(unsigned lane, unsigned key, bool pressed) { m_keypad[key & 0xF][lane % m_lanes] = pressed ? 1 : 0; }
+		// Seed the generator of a lane. It draws the same numbers as a `Chip8Debugger` with that seed.
+		void setSeed(unsigned lane, std::uint64_t seed)
+		{
+			m_seed[lane % m_lanes] = seed;
+			m_random[lane % m_lanes].seed(seed);
+		}
+
+		// Execute up to `max_instructions` on every lane. Returns the number of instructions
+		// executed by all lanes together.
+		std::uint64_t run(std::uint64_t max_instructions)
+		{
+			// Like `Chip8Debugger::run`, a stopped lane tries its instruction again.
+			std::fill(m_stopped.begin(), m_stopped.end(), u8(0));
+			std::fill(m_stopReason.begin(), m_stopReason.end(), StopReason::BudgetExhausted);
+
+			// The budget of a lane is counted in 32 bits, which packs more lanes into a vector.
+			std::uint64_t executed = 0;
+			while (max_instructions > 0)
+			{
+				const std::uint32_t chunk = std::uint32_t(std::min<std::uint64_t>(max_instructions, 0xFFFFFFFF));
+				const std::uint64_t chunk_executed = runChunk(chunk);
+				executed += chunk_executed;
+				max_instructions -= chunk;
+				if (std::find(m_stopped.begin(), m_stopped.end(), u8(0)) == m_stopped.end())
+					break;
+			}
+			return executed;
+		}
+
+		unsigned lanes() const { return m_lanes; }
+
+		// Lockstep steps taken so far. Instructions per step tell how well the lanes stay together.
+		std::uint64_t steps() const { return m_steps; }
+
+		// Read-only view of one lane.
+		u16 pc(unsigned lane) const { return m_pc[lane % m_lanes]; }
+		u16 i(unsigned lane) const { return m_i[lane % m_lanes]; }
+		u8 v(unsigned lane, unsigned index) const { return m_v[index & 0xF][lane % m_lanes]; }
+		u8 memory(unsigned lane, unsigned address) const { return laneMemory(lane % m_lanes)[address % MEMORY_SIZE]; }
+		bool pixel(unsigned lane, unsigned x, unsigned y) const { return (display(lane % m_lanes)[y % DISPLAY_H] >> (63 - x % DISPLAY_W)) & 0x1; }
+		std::uint64_t cycles(unsigned lane) const { return m_cycles[lane % m_lanes]; }
+		StopReason stopReason(unsigned lane) const { return m_stopReason[lane % m_lanes]; }
+
+		// Same hash as `Chip8Debugger::stateHash` for the machine in `lane`.
+		std::uint64_t stateHash(unsigned lane) const
+		{
+			const unsigned k = lane % m_lanes;
+			u8 v[V_REGS_TOTAL];
+			u16 stack[STACK_SIZE];
+			u8 keypad[KEYPAD_SIZE];
+			for (unsigned j = 0; j < V_REGS_TOTAL; ++j) v[j] = m_v[j][k];
+			for (unsigned j = 0; j < STACK_SIZE; ++j) stack[j] = m_stack[j][k];
+			for (unsigned j = 0; j < KEYPAD_SIZE; ++j) keypad[j] = m_keypad[j][k];
+
+			std::uint64_t hash = fnv1a(laneMemory(k), MEMORY_SIZE);
+			hash = fnv1a(v, sizeof(v), hash);
+			hash = fnv1a(&m_i[k], sizeof(u16), hash);
+			hash = fnv1a(&m_pc[k], sizeof(u16), hash);
+			hash = fnv1a(&m_sp[k], sizeof(u8), hash);
+			hash = fnv1a(stack, sizeof(stack), hash);
+			hash = fnv1a(&m_delayTimer[k], sizeof(u8), hash);
+			hash = fnv1a(&m_soundTimer[k], sizeof(u8), hash);
+			const std::uint32_t countdown = m_frameCountdown[k];
+			hash = fnv1a(&countdown, sizeof(countdown), hash);
+			hash = fnv1a(keypad, sizeof(keypad), hash);
+			hash = fnv1a(display(k), DISPLAY_H * sizeof(std::uint64_t), hash);
+			return fnv1a(&m_cycles[k], sizeof(std::uint64_t), hash);
+		}
+
+	private:
+		std::uint64_t runChunk(std::uint32_t max_instructions)
+		{
+			const unsigned n = m_lanes;
+			const u8* stopped = m_stopped.data();
+			u8* live = m_live.data();
+			u8* mask = m_mask.data();
+			const u16* pc = m_pc.data();
+			u8* delay_timer = m_delayTimer.data();
+			u8* sound_timer = m_soundTimer.data();
+			u16* frame_countdown = m_frameCountdown.data();
+			const u16 frame = u16(m_instructionsPerFrame);
+			std::uint32_t* remaining = m_remaining.data();
+
+			for (unsigned k = 0; k < n; ++k)
+			{
+				remaining[k] = max_instructions;
+				live[k] = stopped[k] ? 0 : 1;
+			}
+
+			for (;;)
+			{
+				// Regroup: the live lanes at the lowest PC go next. Others count as 0xFFFF,
+				// so only a lane there needs the extra search.
+				u16 at = 0xFFFF;
+				for (unsigned k = 0; k < n; ++k)
+					at = std::min<u16>(at, u16(pc[k] | u16(live[k] - 1)));
+				if (at == 0xFFFF && std::find(live, live + n, u8(1)) == live + n)
+					break;
+
+				for (unsigned k = 0; k < n; ++k)
+					mask[k] = live[k] & (pc[k] == at ? 1 : 0);
+				const unsigned first = unsigned(std::find(mask, mask + n, u8(1)) - mask);
+
+				// Lanes that rewrote the instruction at PC wait for a step of their own.
+				const u16 instruction = fetch(first, at);
+				if (m_privateLanes > 0)
+				{
+					for (unsigned k = first + 1; k < n; ++k)
+						if (mask[k] && fetch(k, at) != instruction) mask[k] = 0;
+				}
+
+				// Lanes tick together once per frame, so the timers are only touched when one did.
+				u8 ticked = 0;
+				for (unsigned k = 0; k < n; ++k)
+				{
+					const u16 countdown = u16(frame_countdown[k] - mask[k]);
+					ticked |= (countdown == 0 ? 1 : 0);
+					frame_countdown[k] = (countdown == 0 ? frame : countdown);
+					remaining[k] -= mask[k];
+					live[k] &= (remaining[k] != 0 ? 1 : 0);
+				}
+				if (ticked)
+				{
+					for (unsigned k = 0; k < n; ++k)
+					{
+						const u8 tick = (mask[k] & (frame_countdown[k] == frame ? 1 : 0));
+						delay_timer[k] -= (tick & (delay_timer[k] != 0 ? 1 : 0));
+						sound_timer[k] -= (tick & (sound_timer[k] != 0 ? 1 : 0));
+					}
+				}
+				++m_steps;
+
+				if (!execute(decode_instruction(instruction)))
+				{
+					for (unsigned k = 0; k < n; ++k) live[k] &= u8(~mask[k]);
+				}
+			}
+
+			// The instruction a lane stopped at used up budget without completing, unless it waits
+			// for a key. Lanes that stopped in an earlier chunk used nothing.
+			std::uint64_t executed = 0;
+			for (unsigned k = 0; k < n; ++k)
+			{
+				const std::uint32_t used = max_instructions - remaining[k];
+				const bool incomplete = used > 0 && stopped[k] != 0 && m_stopReason[k] != StopReason::WaitingForKey;
+				const std::uint64_t lane_executed = used - (incomplete ? 1 : 0);
+				m_cycles[k] += lane_executed;
+				executed += lane_executed;
+			}
+			return executed;
+		}
+
+		const u8* laneMemory(unsigned k) const { return m_memory[k] ? m_memory[k].get() : m_image; }
+		std::uint64_t* display(unsigned k) { return &m_display[std::size_t(k) * DISPLAY_H]; }
+		const std::uint64_t* display(unsigned k) const { return &m_display[std::size_t(k) * DISPLAY_H]; }
+
+		u16 fetch(unsigned k, u16 address) const
+		{
+			const u8* memory = laneMemory(k);
+			return memory[address % MEMORY_SIZE] << 8 | memory[(address + 1) % MEMORY_SIZE];
+		}
+
+		void writeMemory(unsigned k, unsigned address, u8 value)
+		{
+			if (!m_memory[k])
+			{
+				m_memory[k].reset(new u8[MEMORY_SIZE]);
+				std::memcpy(m_memory[k].get(), m_image, MEMORY_SIZE);
+				++m_privateLanes;
+			}
+			m_memory[k][address % MEMORY_SIZE] = value;
+		}
+
+		// `a` in lanes of the current step, else `b`. Both are evaluated, so the loops over
+		// all lanes have no branches and can be vectorized.
+		static unsigned blend(u8 mask, unsigned a, unsigned b) { return mask ? a : b; }
+
+		// Call `f(k)` for every lane of the current step.
+		template<typename F>
+		void forEachLane(F f)
+		{
+			for (unsigned k = 0; k < m_lanes; ++k)
+				if (m_mask[k]) f(k);
+		}
+
+		// Execute `d` on the lanes of the current step. Returns false if they stopped.
+		// The arithmetic is written as selects over all lanes, so it has no branches.
+		bool execute(const DecodedInstruction& d)
+		{
+			const unsigned n = m_lanes;
+			const u8* mask = m_mask.data();
+			u16* pc = m_pc.data();
+			u8* vx = m_v[d.x].data();
+			u8* vy = m_v[d.y].data();
+			u8* vf = m_v[0xF].data();
+			const u8* v0 = m_v[0].data();
+			u16* i = m_i.data();
+			u8* delay_timer = m_delayTimer.data();
+			u8* sound_timer = m_soundTimer.data();
+			const u8 kk = d.kk;	// Copied, so stores through the u8 pointers can't change them.
+			const u16 nnn = d.nnn;
+			bool advance = true;
+
+			switch (d.op)
+			{
+			case Op::End:
+			case Op::Unknown:
+			default:
+				forEachLane([&](unsigned k)
+				{
+					m_stopped[k] = 1;
+					m_stopReason[k] = d.op == Op::End ? StopReason::EndOfProgram : StopReason::UnknownInstruction;
+				});
+				return false;
+			case Op::Cls:
+				forEachLane([&](unsigned k) { std::memset(display(k), 0, DISPLAY_H * sizeof(std::uint64_t)); });
+				break;
+			case Op::Ret:
+				forEachLane([&](unsigned k)
+				{
+					--m_sp[k];
+					pc[k] = u16(m_stack[m_sp[k] % STACK_SIZE][k] + 2);
+				});
+				advance = false;
+				break;
+			case Op::Jp:
+				for (unsigned k = 0; k < n; ++k) pc[k] = blend(mask[k], nnn, pc[k]);
+				advance = false;
+				break;
+			case Op::Call:
+				forEachLane([&](unsigned k)
+				{
+					m_stack[m_sp[k] % STACK_SIZE][k] = pc[k];
+					++m_sp[k];
+					pc[k] = d.nnn;
+				});
+				advance = false;
+				break;
+			case Op::SeByte:
+				for (unsigned k = 0; k < n; ++k) pc[k] += blend(mask[k], (vx[k] == kk ? 4 : 2), 0);
+				advance = false;
+				break;
+			case Op::SneByte:
+				for (unsigned k = 0; k < n; ++k) pc[k] += blend(mask[k], (vx[k] != kk ? 4 : 2), 0);
+				advance = false;
+				break;
+			case Op::SeReg:
+				for (unsigned k = 0; k < n; ++k) pc[k] += blend(mask[k], (vx[k] == vy[k] ? 4 : 2), 0);
+				advance = false;
+				break;
+			case Op::SneReg:
+				for (unsigned k = 0; k < n; ++k) pc[k] += blend(mask[k], (vx[k] != vy[k] ? 4 : 2), 0);
+				advance = false;
+				break;
+			case Op::LdByte:
+				for (unsigned k = 0; k < n; ++k) vx[k] = blend(mask[k], kk, vx[k]);
+				break;
+			case Op::AddByte:
+				for (unsigned k = 0; k < n; ++k) vx[k] += blend(mask[k], kk, 0);
+				break;
+			case Op::LdReg:
+				for (unsigned k = 0; k < n; ++k) vx[k] = blend(mask[k], vy[k], vx[k]);
+				break;
+			case Op::Or:
+				for (unsigned k = 0; k < n; ++k) vx[k] |= blend(mask[k], vy[k], 0);
+				break;
+			case Op::And:
+				for (unsigned k = 0; k < n; ++k) vx[k] &= blend(mask[k], vy[k], 0xFF);
+				break;
+			case Op::Xor:
+				for (unsigned k = 0; k < n; ++k) vx[k] ^= blend(mask[k], vy[k], 0);
+				break;
+			// VF is written first, and Vx and Vy read again afterwards, because either may be VF.
+			case Op::AddReg:
+				for (unsigned k = 0; k < n; ++k)
+				{
+					vf[k] = blend(mask[k], u8(vx[k] + vy[k] > 0xFF ? 1 : 0), vf[k]);
+					vx[k] = blend(mask[k], u8(vx[k] + vy[k]), vx[k]);
+				}
+				break;
+			case Op::Sub:
+				for (unsigned k = 0; k < n; ++k)
+				{
+					vf[k] = blend(mask[k], u8(vx[k] > vy[k] ? 1 : 0), vf[k]);
+					vx[k] = blend(mask[k], u8(vx[k] - vy[k]), vx[k]);
+				}
+				break;
+			case Op::Shr:
+				for (unsigned k = 0; k < n; ++k)
+				{
+					vf[k] = blend(mask[k], u8(vx[k] & 0x1), vf[k]);
+					vx[k] = blend(mask[k], u8(vx[k] / 2), vx[k]);
+				}
+				break;
+			case Op::Subn:
+				for (unsigned k = 0; k < n; ++k)
+				{
+					vf[k] = blend(mask[k], u8(vy[k] > vx[k] ? 1 : 0), vf[k]);
+					vx[k] = blend(mask[k], u8(vy[k] - vx[k]), vx[k]);
+				}
+				break;
+			case Op::Shl:
+				for (unsigned k = 0; k < n; ++k)
+				{
+					vf[k] = blend(mask[k], u8((vx[k] & 0x80) != 0 ? 1 : 0), vf[k]);
+					vx[k] = blend(mask[k], u8(vx[k] * 2), vx[k]);
+				}
+				break;
+			case Op::LdI:
+				for (unsigned k = 0; k < n; ++k) i[k] = blend(mask[k], nnn, i[k]);
+				break;
+			case Op::JpV0:
+				for (unsigned k = 0; k < n; ++k) pc[k] = blend(mask[k], u16(nnn + v0[k]), pc[k]);
+				advance = false;
+				break;
+			case Op::Rnd:
+				forEachLane([&](unsigned k) { vx[k] = d.kk & m_random[k].nextByte(); });
+				break;
+			case Op::Drw:
+				forEachLane([&](unsigned k)
+				{
+					vf[k] = draw_sprite(display(k), laneMemory(k), i[k], vx[k], vy[k], d.kk & 0xF) ? 0x1 : 0x0;
+				});
+				break;
+			case Op::Skp:
+			case Op::Sknp:
+			{
+				const u8 skip_if = (d.op == Op::Skp) ? 1 : 0;
+				for (unsigned k = 0; k < n; ++k) pc[k] += blend(mask[k], (m_keypad[vx[k] & 0xF][k] == skip_if ? 4 : 2), 0);
+				advance = false;
+				break;
+			}
+			case Op::LdVxDt:
+				for (unsigned k = 0; k < n; ++k) vx[k] = blend(mask[k], delay_timer[k], vx[k]);
+				break;
+			case Op::LdVxKey:
+				// Mirrors `Chip8Debugger::opLdVxKey`: the lowest key that is down, else the lane waits.
+				forEachLane([&](unsigned k)
+				{
+					for (unsigned j = 0; j < KEYPAD_SIZE; ++j)
+					{
+						if (m_keypad[j][k] != 0)
+						{
+							vx[k] = u8(j);
+							pc[k] += 2;
+							return;
+						}
+					}
+					m_stopped[k] = 1;
+					m_stopReason[k] = StopReason::WaitingForKey;
+					m_live[k] = 0;
+				});
+				advance = false;
+				break;
+			case Op::LdDtVx:
+				for (unsigned k = 0; k < n; ++k) delay_timer[k] = blend(mask[k], vx[k], delay_timer[k]);
+				break;
+			case Op::LdStVx:
+				for (unsigned k = 0; k < n; ++k) sound_timer[k] = blend(mask[k], vx[k], sound_timer[k]);
+				break;
+			case Op::AddIVx:
+				for (unsigned k = 0; k < n; ++k) i[k] += blend(mask[k], vx[k], 0);
+				break;
+			case Op::LdFVx:
+				for (unsigned k = 0; k < n; ++k) i[k] = blend(mask[k], u16(vx[k] * 5), i[k]);
+				break;
+			case Op::LdBcd:
+				forEachLane([&](unsigned k)
+				{
+					writeMemory(k, i[k], vx[k] / 100);
+					writeMemory(k, i[k] + 1, (vx[k] / 10) % 10);
+					writeMemory(k, i[k] + 2, vx[k] % 10);
+				});
+				break;
+			case Op::StoreRegs:
+				forEachLane([&](unsigned k)
+				{
+					for (unsigned j = 0; j <= d.x; ++j) writeMemory(k, i[k] + j, m_v[j][k]);
+				});
+				break;
+			case Op::LoadRegs:
+				forEachLane([&](unsigned k)
+				{
+					for (unsigned j = 0; j <= d.x; ++j) m_v[j][k] = laneMemory(k)[(i[k] + j) % MEMORY_SIZE];
+				});
+				break;
+			}
+
+			if (advance)
+			{
+				for (unsigned k = 0; k < n; ++k) pc[k] += blend(mask[k], 2, 0);
+			}
+			return true;
+		}
+	};
+}
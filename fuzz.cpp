@@ -0,0 +1,234 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+// Fuzzes the compiler front end. Built with `-DC8S_LIBFUZZER` (and clang's `-fsanitize=fuzzer`)
+// this file only provides `LLVMFuzzerTestOneInput` for the target in `C8S_FUZZ_TARGET`, otherwise
+// it is a standalone driver that mutates a corpus itself and needs no particular compiler.
+
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fuzz.hpp"
+#include "program-generator.hpp"
+
+#ifdef C8S_LIBFUZZER
+
+#ifndef C8S_FUZZ_TARGET
+#define C8S_FUZZ_TARGET Compile
+#endif
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+	c8s::run_fuzz_target(c8s::FuzzTarget::C8S_FUZZ_TARGET, data, size);
+	return 0;
+}
+
+#else
+
+namespace
+{
+	// The input that is being run, for the crash handler.
+	std::string current_input;
+	std::string artifacts = ".";
+
+	std::string hash_name(const std::string& prefix, const std::string& input)
+	{
+		std::uint64_t hash = 1469598103934665603ULL;
+		for (unsigned char c : input) hash = (hash ^ c) * 1099511628211ULL;
+		std::ostringstream name;
+		name << artifacts << '/' << prefix << std::hex << hash << ".c8s";
+		return name.str();
+	}
+
+	std::string save_artifact(const std::string& prefix, const std::string& input)
+	{
+		const std::string path = hash_name(prefix, input);
+		std::ofstream{ path, std::ios::binary } << input;
+		return path;
+	}
+
+	// Save the input that crashed before the process goes down. Not strictly signal safe,
+	// but the process is lost anyway.
+	void on_crash(int signal)
+	{
+		std::signal(signal, SIG_DFL);
+		if (std::FILE* file = std::fopen(hash_name("crash-", current_input).c_str(), "wb"))
+		{
+			std::fwrite(current_input.data(), 1, current_input.size(), file);
+			std::fclose(file);
+		}
+		std::fprintf(stderr, "\ncrash: signal %d, input written to %s\n", signal, hash_name("crash-", current_input).c_str());
+		std::raise(signal);
+	}
+
+	bool load_corpus(const std::string& path, std::vector<std::string>& corpus)
+	{
+		std::error_code error;
+		std::vector<std::filesystem::path> files;
+		if (std::filesystem::is_directory(path, error))
+		{
+			for (const auto& entry : std::filesystem::directory_iterator(path, error))
+				if (entry.is_regular_file(error)) files.push_back(entry.path());
+			std::sort(files.begin(), files.end());
+		}
+		else files.push_back(path);
+
+		for (const auto& file : files)
+		{
+			std::ifstream ifs{ file, std::ios::binary };
+			if (!ifs)
+			{
+				std::cout << "Unable to read `" << file.string() << "`\n";
+				return false;
+			}
+			corpus.emplace_back(std::istreambuf_iterator<char>{ ifs }, std::istreambuf_iterator<char>{});
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<c8s::FuzzTarget> targets{ c8s::FuzzTarget::Tokenize, c8s::FuzzTarget::Parse, c8s::FuzzTarget::Compile };
+	std::uint64_t runs = 100000;
+	std::uint32_t seed = 1;
+	std::size_t max_length = 4096;
+	unsigned scaling_every = 1000, corpus_limit = 4096;
+	double max_exponent = 1.5, timeout = 1.0;
+	std::vector<std::string> corpus;
+	bool valid = true;
+	for (int i = 1; i < argc && valid; ++i)
+	{
+		const std::string arg = argv[i];
+		auto value = [&](const char* option) { return arg.substr(std::string{ option }.size()); };
+		auto number = [&](const char* option) { return std::strtoull(value(option).c_str(), nullptr, 10); };
+		if (arg == "--target=all") targets = { c8s::FuzzTarget::Tokenize, c8s::FuzzTarget::Parse, c8s::FuzzTarget::Compile };
+		else if (arg.find("--target=") == 0)
+		{
+			targets.assign(1, c8s::FuzzTarget::Compile);
+			valid = c8s::parse_fuzz_target(value("--target="), targets.front());
+		}
+		else if (arg.find("--runs=") == 0) runs = number("--runs=");
+		else if (arg.find("--seed=") == 0) seed = std::uint32_t(number("--seed="));
+		else if (arg.find("--max-len=") == 0) valid = (max_length = std::size_t(number("--max-len="))) != 0;
+		else if (arg.find("--scaling-every=") == 0) scaling_every = unsigned(number("--scaling-every="));
+		else if (arg.find("--max-exponent=") == 0) valid = (max_exponent = std::strtod(value("--max-exponent=").c_str(), nullptr)) > 0;
+		else if (arg.find("--timeout-ms=") == 0) valid = (timeout = number("--timeout-ms=") / 1000.0) > 0;
+		else if (arg.find("--artifacts=") == 0) artifacts = value("--artifacts=");
+		else if (arg.find("--") == 0) valid = false;
+		else valid = load_corpus(arg, corpus);
+	}
+	if (!valid)
+	{
+		std::cout << "Usage: c8s_fuzz [--target=all|tokenize|parse|compile] [--runs=<n>] [--seed=<n>]\n"
+			"                [--max-len=<bytes>] [--scaling-every=<n>] [--max-exponent=<x>]\n"
+			"                [--timeout-ms=<n>] [--artifacts=<dir>] [corpus files or directories]\n";
+		return EXIT_FAILURE;
+	}
+
+	// Without a corpus, start from generated programs.
+	if (corpus.empty())
+	{
+		for (std::uint32_t s = 1; s <= 8; ++s)
+		{
+			c8s::GeneratorOptions options;
+			options.seed = s;
+			options.statements = 10 + s * 5;
+			corpus.push_back(c8s::generate_program(options));
+		}
+	}
+
+	for (int signal : { SIGSEGV, SIGABRT, SIGFPE, SIGILL })
+		std::signal(signal, on_crash);
+
+	unsigned flagged = 0;
+	auto run = [&](const std::string& input) {
+		current_input = input;
+		const auto start = std::chrono::steady_clock::now();
+		for (c8s::FuzzTarget target : targets)
+			c8s::run_fuzz_target(target, reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (seconds > timeout)
+		{
+			std::cout << "slow: " << seconds << " s for " << input.size() << " bytes, input written to " << save_artifact("slow-", input) << "\n";
+			++flagged;
+		}
+	};
+	auto check_scaling = [&](const std::string& input) {
+		current_input = input;
+		const c8s::CompileScaling scaling = c8s::measure_compile_scaling(input);
+		if (scaling.measured && scaling.exponent > max_exponent)
+		{
+			std::cout << "super-linear: compile time grows with bytes^" << scaling.exponent << ", input written to " << save_artifact("superlinear-", input) << "\n";
+			for (const auto& sample : scaling.samples)
+				std::cout << "  " << sample.bytes << " bytes: " << sample.seconds * 1e3 << " ms\n";
+			++flagged;
+		}
+	};
+
+	// Every input of the corpus has to pass before mutating it.
+	const std::size_t seeds = corpus.size();
+	for (const auto& input : corpus)
+	{
+		run(input);
+		if (scaling_every != 0) check_scaling(input);
+	}
+	std::cout << "#0 corpus: " << seeds << " inputs\n";
+
+	// Mutate inputs from the corpus. Those that compile become part of it, that keeps the
+	// mutations close to programs that get past the parser.
+	std::mt19937 rng{ seed };
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint64_t r = 1; r <= runs; ++r)
+	{
+		const std::string input = c8s::mutate_input(corpus[rng() % corpus.size()], corpus, rng, max_length);
+		run(input);
+		if (corpus.size() < corpus_limit && !input.empty() && c8s::compiler_log::read_errors().empty()
+			&& targets.back() == c8s::FuzzTarget::Compile)
+			corpus.push_back(input);
+		if (scaling_every != 0 && r % scaling_every == 0)
+			check_scaling(input);
+		if ((r & (r - 1)) == 0 || r == runs)
+		{
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "#" << r << " corpus: " << corpus.size() << " exec/s: " << unsigned(seconds > 0 ? r / seconds : 0) << "\n";
+		}
+	}
+
+	std::cout << (flagged == 0 ? "No crashes or slow inputs" : std::to_string(flagged) + " slow input(s) flagged") << "\n";
+	return flagged == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,223 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compiler.hpp"
+
+namespace c8s
+{
+	// The parts of the compiler a fuzzer can feed. Each takes arbitrary bytes and must neither
+	// crash nor hang, errors in the input only end up in `compiler_log`.
+	enum class FuzzTarget { Tokenize, Parse, Compile };
+
+	const char* fuzz_target_name(FuzzTarget target)
+	{
+		switch (target)
+		{
+		case FuzzTarget::Tokenize: return "tokenize";
+		case FuzzTarget::Parse: return "parse";
+		default: return "compile";
+		}
+	}
+
+	bool parse_fuzz_target(const std::string& name, FuzzTarget& target)
+	{
+		for (FuzzTarget candidate : { FuzzTarget::Tokenize, FuzzTarget::Parse, FuzzTarget::Compile })
+			if (name == fuzz_target_name(candidate))
+			{
+				target = candidate;
+				return true;
+			}
+		return false;
+	}
+
+	void fuzz_tokenize(const std::uint8_t* data, std::size_t size)
+	{
+		compiler_log::reset_all();
+		split_code_into_tokens(std::string(reinterpret_cast<const char*>(data), size));
+	}
+
+	void fuzz_parse(const std::uint8_t* data, std::size_t size)
+	{
+		compiler_log::reset_all();
+		auto tokens = split_code_into_tokens(std::string(reinterpret_cast<const char*>(data), size));
+		parse_tokens_to_ast(tokens);
+	}
+
+	void fuzz_compile(const std::uint8_t* data, std::size_t size)
+	{
+		compile(std::string(reinterpret_cast<const char*>(data), size));
+	}
+
+	void run_fuzz_target(FuzzTarget target, const std::uint8_t* data, std::size_t size)
+	{
+		switch (target)
+		{
+		case FuzzTarget::Tokenize: fuzz_tokenize(data, size); break;
+		case FuzzTarget::Parse: fuzz_parse(data, size); break;
+		default: fuzz_compile(data, size); break;
+		}
+	}
+
+	// Change `input` by a few random edits: flipped, inserted and erased bytes, words of the
+	// language, copied ranges and pieces of other inputs from `corpus`. The result is cut to `max_length`.
+	std::string mutate_input(std::string input, const std::vector<std::string>& corpus, std::mt19937& rng, std::size_t max_length)
+	{
+		static const char* const words[] = {
+			"VAR ", "IF ", "ENDIF", "FOR ", " TO ", " STEP ", "ENDFOR", "RAW ", "cls()", "(", ")",
+			"=", "==", "!=", "+=", "-=", "<<=", ">>=", "|=", "&=", "^=", ":", "\n", "\t", " ", ";", "0", "255", "a", "b"
+		};
+		auto below = [&](std::size_t n) { return n > 1 ? std::size_t(rng() % n) : std::size_t(0); };
+
+		const unsigned edits = 1 + unsigned(below(4));
+		for (unsigned e = 0; e < edits; ++e)
+		{
+			const std::size_t at = below(input.size() + 1);
+			switch (below(6))
+			{
+			case 0:
+				if (!input.empty()) input[below(input.size())] ^= char(1u << below(8));
+				break;
+			case 1:
+				input.insert(input.begin() + at, char(below(256)));
+				break;
+			case 2:
+				input.insert(at, words[below(sizeof(words) / sizeof(words[0]))]);
+				break;
+			case 3:
+				input.erase(at, 1 + below(8));
+				break;
+			case 4:
+			{
+				// Copy a range, mostly whole lines, somewhere else.
+				const std::size_t from = below(input.size() + 1);
+				input.insert(at, input.substr(from, 1 + below(64)));
+				break;
+			}
+			default:
+			{
+				if (corpus.empty()) break;
+				const std::string& other = corpus[below(corpus.size())];
+				const std::size_t from = below(other.size() + 1);
+				input.insert(at, other.substr(from, 1 + below(128)));
+				break;
+			}
+			}
+		}
+
+		if (input.size() > max_length) input.resize(max_length);
+		return input;
+	}
+
+	// How the compile time of an input grows when it is repeated.
+	struct ScalingSample
+	{
+		std::size_t bytes;
+		double seconds;		// Fastest of a few compiles.
+	};
+
+	struct CompileScaling
+	{
+		std::vector<ScalingSample> samples;
+		double exponent = 0.0;		// Of `seconds ~ bytes^exponent`, 1 is linear.
+		bool measured = false;		// Whether enough samples took long enough to time.
+	};
+
+	// Compile the lines of `input` repeated 1, 2, 4 ... times, until a compile takes `enough_seconds` or the
+	// input grows beyond `max_bytes`. The exponent is the slope of the log-log line fitted to the three
+	// largest samples, as long as they took at least `floor_seconds`. Shorter ones are mostly timer noise,
+	// and fixed costs make small inputs look linear.
+	CompileScaling measure_compile_scaling(const std::string& input, std::size_t max_bytes = 1 << 20,
+		double floor_seconds = 0.0002, double enough_seconds = 0.02)
+	{
+		CompileScaling scaling;
+		if (input.empty())
+			return scaling;
+
+		// Declarations are kept once in front, a second one would stop the compiler before code
+		// generation. The other lines are repeated.
+		std::string declarations, unit;
+		std::istringstream lines{ input };
+		for (std::string line; std::getline(lines, line);)
+		{
+			const auto first = line.find_first_not_of(" \t");
+			const bool declaration = first != std::string::npos && line.size() >= first + 4
+				&& std::tolower(static_cast<unsigned char>(line[first])) == 'v'
+				&& std::tolower(static_cast<unsigned char>(line[first + 1])) == 'a'
+				&& std::tolower(static_cast<unsigned char>(line[first + 2])) == 'r'
+				&& std::isblank(static_cast<unsigned char>(line[first + 3]));
+			(declaration ? declarations : unit) += line + '\n';
+		}
+		if (unit.empty())
+			return scaling;
+
+		std::string body = unit;
+		std::size_t timed = 0;
+		while (declarations.size() + body.size() <= max_bytes)
+		{
+			const std::string code = declarations + body;
+			double fastest = 0.0;
+			for (unsigned run = 0; run < 3; ++run)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				compile(code);
+				const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				if (run == 0 || seconds < fastest) fastest = seconds;
+			}
+			scaling.samples.push_back({ code.size(), fastest });
+			if (fastest >= floor_seconds) ++timed;
+			if (fastest >= enough_seconds && timed >= 3)
+				break;
+			body += body;
+		}
+
+		// Least squares over the logarithms of the largest samples.
+		double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+		for (std::size_t j = scaling.samples.size() - std::min<std::size_t>(scaling.samples.size(), 3); j < scaling.samples.size(); ++j)
+		{
+			const ScalingSample& sample = scaling.samples[j];
+			if (sample.seconds < floor_seconds) continue;
+			const double x = std::log(double(sample.bytes)), y = std::log(sample.seconds);
+			n += 1; sx += x; sy += y; sxx += x * x; sxy += x * y;
+		}
+		if (n >= 3 && n * sxx - sx * sx > 0)
+		{
+			scaling.exponent = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+			scaling.measured = true;
+		}
+		return scaling;
+	}
+}
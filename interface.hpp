@@ -1,114 +1,280 @@
-/*
-* MIT License
-*
-* Copyright(c) 2018 Paul Bernitz
-*
-* Permission is hereby granted, free of charge, to any person obtaining a copy
-* of this software and associated documentation files(the "Software"), to deal
-* in the Software without restriction, including without limitation the rights
-* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-* copies of the Software, and to permit persons to whom the Software is
-* furnished to do so, subject to the following conditions :
-*
-* The above copyright notice and this permission notice shall be included in all
-* copies or substantial portions of the Software.
-*
-* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
-* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-* SOFTWARE.
-*/
-
-#pragma once
-
-#include <iostream>
-#include <string>
-#include <vector>
-
-namespace c8s
-{
-	void print_intro()
-	{
-		std::cout << "Usage: c8s-compiler.exe [options] file\n";
-		std::cout << "Compile the chip-8 script source $file into chip-8 machinecode.\n";
-		
-		std::cout << "\nOptions:\n";
-		std::cout << "  -o, --output <file> output is saved in <file> instead of `out.c8s`\n";
-		std::cout << "  -h, --help          display this help and exit\n";
-		std::cout << "  -v, --version       print the version\n";
-		std::cout << "  -d, --debug         attach debugger after compilation\n";
-		std::cout << "  -t, --tests         run standard tests\n";
-		std::cout << "  -s, --silent        do not produce any output\n";
-		std::cout << "  -m, --steps         print intermediate steps (tokenization, AST creation etc.)\n";
-
-		std::cout << "\nFor more information please visit:\n";
-		std::cout << "<https://github.com/pauwell/chip8-script>";
-	}
-
-	struct Flag
-	{
-		char token;
-		std::string param;
-	};
-
-	std::vector<Flag> parse_flags(int argc, char** const & argv)
-	{
-		if (argc <= 1)
-			return {};
-
-		std::vector<Flag> flags;
-
-		for (int i = 0; i < argc; ++i)
-		{
-			std::string arg = argv[i];
-
-			// -o file, --output file
-			if (arg.find("-o") == 0 || arg.find("--output") == 0)
-			{
-				// Check if next arg is available and valid.
-				if (i + 1 >= (argc - 1) || argv[i + 1][0] == '-') return {};
-
-				// Get `file` param from next arg.
-				flags.push_back(Flag{ 'o', argv[i + 1] });
-				++i;
-			}
-			// -v, --version
-			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('v') != std::string::npos) || arg.find("--version") == 0)
-			{
-				return { Flag{ 'v', "" } };
-			}
-			// -d, --debug
-			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('d') != std::string::npos) || arg.find("--debug") == 0)
-			{
-				flags.push_back(Flag{ 'd', "" });
-			}
-			// -t, --tests
-			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('t') != std::string::npos) || arg.find("--tests") == 0)
-			{
-				return { Flag{ 't', "" } };
-			}
-			// -s, --silent
-			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('s') != std::string::npos) || arg.find("--silent") == 0)
-			{
-				flags.push_back(Flag{ 's', "" });
-			}
-			// -m, --print-steps
-			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('m') != std::string::npos) || arg.find("--steps") == 0)
-			{
-				flags.push_back(Flag{ 'm', "" });
-			}
-		}
-
-		// The last arg must be the specified input file.
-		if (argv[argc - 1][0] != '-')
-		{
-			flags.push_back(Flag{ 'i', argv[argc - 1] });
-			return flags;
-		}
-		
-		return {};
-	}
-}
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace c8s
+{
+	void print_intro()
+	{
+		std::cout << "Usage: c8s-compiler.exe [options] file\n";
+		std::cout << "Compile the chip-8 script source $file into chip-8 machinecode.\n";
+		
+		std::cout << "\nOptions:\n";
+		std::cout << "  -o, --output <file> output is saved in <file> instead of `out.c8s`\n";
+		std::cout << "  -h, --help          display this help and exit\n";
+		std::cout << "  -v, --version       print the version\n";
+		std::cout << "  -d, --debug         attach debugger after compilation\n";
+		std::cout << "  --rewind[=<KiB>]    record the debug session so it can step backward (default 1024 KiB)\n";
+		std::cout << "  --run[=<n>]         run the ROM headless for at most <n> instructions and report the speed\n";
+		std::cout << "  --ipf=<n>           instructions per 60 Hz frame, the CPU clock is 60 * <n> Hz (default 10)\n";
+		std::cout << "  --realtime          pace --run at 60 frames per second and report the frame times\n";
+		std::cout << "  --display[=<glyphs>] show the display during --run as braille (default) or blocks\n";
+		std::cout << "  --keys[=<file>]     feed the keypad of --run from the terminal (1234/qwer/asdf/zxcv) or from lines\n";
+		std::cout << "                      `<frame> <key> down|up` in <file>, a machine waiting for a key sleeps\n";
+		std::cout << "  --capture=<dir>     hash every frame of --run into <dir>/frames.log and save each distinct frame as PBM\n";
+		std::cout << "  --golden=<file>     compare the frame hashes of --run with a frames.log and report the first difference\n";
+		std::cout << "  --trace=<file>      write a binary trace of every instruction of --run or -d and the registers it wrote\n";
+		std::cout << "  --trace-query=<q>   answer <q> about the trace given as input file: `summary`, `history V3`,\n";
+		std::cout << "                      `at 0x24a`, `V3 before 0x24a` or `V3 before cycle 1000`\n";
+		std::cout << "  --engine=<engine>   interpreter used by the debugger (switch, cached, jit)\n";
+		std::cout << "  --target=<target>   machine to compile for and run on (chip8, schip, xochip)\n";
+		std::cout << "  --quirks=<profile>  behaviour of shifts, FX55/FX65, BNNN and sprites at the edge (chip8, cosmac, schip, xochip)\n";
+		std::cout << "  --sanitize          stop at memory or stack accesses out of bounds instead of wrapping around\n";
+		std::cout << "  --seed=<n>          seed of the random generator (default: from the clock)\n";
+		std::cout << "  --record=<file>     write the random numbers and key presses of --run or -d into <file>\n";
+		std::cout << "  --replay=<file>     repeat a recorded run headless and check that it ends in the same state\n";
+		std::cout << "  --profile[=<file>]  count the instructions of --run or -d, report the hotspots and write folded stacks to <file>\n";
+		std::cout << "  --recompile=<file>  translate the ROM into a standalone C++ program (build with aot-runtime.hpp)\n";
+		std::cout << "  --disassemble[=<file>] write the assembly of the ROM given as input file to <file> or the console\n";
+		std::cout << "  --assemble          assemble the input file instead of compiling it\n";
+		std::cout << "  --listing[=<file>]  write every instruction with its cycles and source line, and the best and worst\n";
+		std::cout << "                      cycles of every IF and FOR block, to <file> or the console\n";
+		std::cout << "  --cost-model=<spec> cycles per instruction for --listing as `DXYN=4,data=1` or a file of such lines (default 1)\n";
+		std::cout << "  --frame-budget=<n>  mark the blocks of --listing that may take more than <n> cycles\n";
+		std::cout << "  -t, --tests         run standard tests\n";
+		std::cout << "  -s, --silent        do not produce any output\n";
+		std::cout << "  -m, --steps         print intermediate steps (tokenization, AST creation etc.)\n";
+		std::cout << "  --time-report[=<file>] print time, item counts and allocations of every compiler phase, or\n";
+		std::cout << "                      write them as JSON to <file>\n";
+		std::cout << "  --log-level=<level> show diagnostics from <level> on (trace, debug, info, warning, error, off)\n";
+		std::cout << "  --log-json          write diagnostics as JSON lines\n";
+
+		std::cout << "\nFor more information please visit:\n";
+		std::cout << "<https://github.com/pauwell/chip8-script>";
+	}
+
+	struct Flag
+	{
+		char token;
+		std::string param;
+	};
+
+	std::vector<Flag> parse_flags(int argc, char** const & argv)
+	{
+		if (argc <= 1)
+			return {};
+
+		std::vector<Flag> flags;
+
+		for (int i = 0; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+
+			// -o file, --output file
+			if (arg.find("-o") == 0 || arg.find("--output") == 0)
+			{
+				// Check if next arg is available and valid.
+				if (i + 1 >= (argc - 1) || argv[i + 1][0] == '-') return {};
+
+				// Get `file` param from next arg.
+				flags.push_back(Flag{ 'o', argv[i + 1] });
+				++i;
+			}
+			// -v, --version
+			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('v') != std::string::npos) || arg.find("--version") == 0)
+			{
+				return { Flag{ 'v', "" } };
+			}
+			// -d, --debug
+			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('d') != std::string::npos) || arg.find("--debug") == 0)
+			{
+				flags.push_back(Flag{ 'd', "" });
+			}
+			// -t, --tests
+			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('t') != std::string::npos) || arg.find("--tests") == 0)
+			{
+				return { Flag{ 't', "" } };
+			}
+			// -s, --silent
+			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('s') != std::string::npos) || arg.find("--silent") == 0)
+			{
+				flags.push_back(Flag{ 's', "" });
+			}
+			// -m, --print-steps
+			else if ((arg[0] == '-' && arg[1] != '-' && arg.find('m') != std::string::npos) || arg.find("--steps") == 0)
+			{
+				flags.push_back(Flag{ 'm', "" });
+			}
+			// --time-report, --time-report=<file>
+			else if (arg == "--time-report" || arg.find("--time-report=") == 0)
+			{
+				flags.push_back(Flag{ 'r', arg.size() > 14 ? arg.substr(14) : "" });
+			}
+			// --run, --run=<n>
+			else if (arg == "--run" || arg.find("--run=") == 0)
+			{
+				flags.push_back(Flag{ 'x', arg.size() > 6 ? arg.substr(6) : "" });
+			}
+			// --rewind, --rewind=<KiB>
+			else if (arg == "--rewind" || arg.find("--rewind=") == 0)
+			{
+				flags.push_back(Flag{ 'w', arg.size() > 9 ? arg.substr(9) : "" });
+			}
+			// --recompile=<file>
+			else if (arg.find("--recompile=") == 0)
+			{
+				flags.push_back(Flag{ 'c', arg.substr(std::string{ "--recompile=" }.size()) });
+			}
+			// --disassemble, --disassemble=<file>
+			else if (arg == "--disassemble" || arg.find("--disassemble=") == 0)
+			{
+				flags.push_back(Flag{ 'D', arg.size() > 14 ? arg.substr(14) : "" });
+			}
+			// --assemble
+			else if (arg == "--assemble")
+			{
+				flags.push_back(Flag{ 'A', "" });
+			}
+			// --listing, --listing=<file>
+			else if (arg == "--listing" || arg.find("--listing=") == 0)
+			{
+				flags.push_back(Flag{ 'L', arg.size() > 10 ? arg.substr(10) : "" });
+			}
+			// --cost-model=<spec>
+			else if (arg.find("--cost-model=") == 0)
+			{
+				flags.push_back(Flag{ 'C', arg.substr(std::string{ "--cost-model=" }.size()) });
+			}
+			// --frame-budget=<n>
+			else if (arg.find("--frame-budget=") == 0)
+			{
+				flags.push_back(Flag{ 'F', arg.substr(std::string{ "--frame-budget=" }.size()) });
+			}
+			// --seed=<n>
+			else if (arg.find("--seed=") == 0)
+			{
+				flags.push_back(Flag{ 'n', arg.substr(std::string{ "--seed=" }.size()) });
+			}
+			// --record=<file>
+			else if (arg.find("--record=") == 0)
+			{
+				flags.push_back(Flag{ 'q', arg.substr(std::string{ "--record=" }.size()) });
+			}
+			// --replay=<file>
+			else if (arg.find("--replay=") == 0)
+			{
+				flags.push_back(Flag{ 'y', arg.substr(std::string{ "--replay=" }.size()) });
+			}
+			// --profile, --profile=<file>
+			else if (arg == "--profile" || arg.find("--profile=") == 0)
+			{
+				flags.push_back(Flag{ 'p', arg.size() > 10 ? arg.substr(10) : "" });
+			}
+			// --ipf=<n>
+			else if (arg.find("--ipf=") == 0)
+			{
+				flags.push_back(Flag{ 'f', arg.substr(std::string{ "--ipf=" }.size()) });
+			}
+			// --realtime
+			else if (arg == "--realtime")
+			{
+				flags.push_back(Flag{ 'u', "" });
+			}
+			// --display, --display=<glyphs>
+			else if (arg == "--display" || arg.find("--display=") == 0)
+			{
+				flags.push_back(Flag{ 'g', arg.size() > 10 ? arg.substr(10) : "" });
+			}
+			// --keys, --keys=<file>
+			else if (arg == "--keys" || arg.find("--keys=") == 0)
+			{
+				flags.push_back(Flag{ 'k', arg.size() > 7 ? arg.substr(7) : "" });
+			}
+			// --capture=<dir>
+			else if (arg.find("--capture=") == 0)
+			{
+				flags.push_back(Flag{ 'a', arg.substr(std::string{ "--capture=" }.size()) });
+			}
+			// --golden=<file>
+			else if (arg.find("--golden=") == 0)
+			{
+				flags.push_back(Flag{ 'z', arg.substr(std::string{ "--golden=" }.size()) });
+			}
+			// --trace=<file>
+			else if (arg.find("--trace=") == 0)
+			{
+				flags.push_back(Flag{ 'b', arg.substr(std::string{ "--trace=" }.size()) });
+			}
+			// --trace-query=<query>
+			else if (arg.find("--trace-query=") == 0)
+			{
+				flags.push_back(Flag{ 'B', arg.substr(std::string{ "--trace-query=" }.size()) });
+			}
+			// --engine=<engine>
+			else if (arg.find("--engine=") == 0)
+			{
+				flags.push_back(Flag{ 'e', arg.substr(std::string{ "--engine=" }.size()) });
+			}
+			// --target=<target>
+			else if (arg.find("--target=") == 0)
+			{
+				flags.push_back(Flag{ 'T', arg.substr(std::string{ "--target=" }.size()) });
+			}
+			// --quirks=<profile>
+			else if (arg.find("--quirks=") == 0)
+			{
+				flags.push_back(Flag{ 'Q', arg.substr(std::string{ "--quirks=" }.size()) });
+			}
+			// --sanitize
+			else if (arg == "--sanitize")
+			{
+				flags.push_back(Flag{ 'S', "" });
+			}
+			// --log-level=<level>
+			else if (arg.find("--log-level=") == 0)
+			{
+				flags.push_back(Flag{ 'l', arg.substr(std::string{ "--log-level=" }.size()) });
+			}
+			// --log-json
+			else if (arg.find("--log-json") == 0)
+			{
+				flags.push_back(Flag{ 'j', "" });
+			}
+		}
+
+		// The last arg must be the specified input file.
+		if (argv[argc - 1][0] != '-')
+		{
+			flags.push_back(Flag{ 'i', argv[argc - 1] });
+			return flags;
+		}
+		
+		return {};
+	}
+}
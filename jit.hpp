@@ -0,0 +1,461 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include "debugger.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The JIT emits x86-64 code for the System V calling convention into an mmap'd region.
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define C8S_JIT_AVAILABLE
+#include <sys/mman.h>
+#endif
+
+namespace c8s
+{
+#ifdef C8S_JIT_AVAILABLE
+	// Translates basic blocks of Chip-8 code to native x86-64 and chains them directly.
+	// Only register, I and control-flow instructions are translated; everything that touches
+	// the display, keypad, timers, the stack or memory ends a block and runs in the interpreter.
+	// Every block starts by charging its full length against the budget, the cycle counter and
+	// the frame countdown, ticking the timers if a frame starts within it, so the machine state
+	// after each block is the same as after interpreting it. A block that spans more than one
+	// frame boundary is left to the interpreter. While the debugger traps addresses, blocks end
+	// before a trap and never start at one, so every trap is seen by `run`.
+	class Chip8Jit : public JitBackend
+	{
+		typedef void(*BlockEntry)(Chip8Debugger* debugger, std::uint64_t* budget);
+
+		static constexpr std::size_t CODE_SIZE = 0x100000;
+		static constexpr unsigned MAX_BLOCK_INSTRUCTIONS = 64;
+		static constexpr std::size_t MAX_BLOCK_BYTES = 0x1000;
+
+		// Scratch registers used by the emitted code.
+		static constexpr u8 EAX = 0, ECX = 1, EDX = 2;
+
+		enum class BlockState : u8
+		{
+			Unknown,
+			Translated,
+			Interpreted	// The first instruction can't be translated.
+		};
+
+		// A jump at the end of a block whose target wasn't translated yet.
+		struct PendingExit
+		{
+			u8* rel32;
+			u16 target;
+		};
+
+		Chip8Debugger& m_debugger;
+		u8* m_code;
+		std::size_t m_used;
+		u8* m_returnStub;
+		std::uint64_t m_budget;
+		unsigned m_trapGeneration;	// Of the traps the blocks were translated for, 0 if none.
+
+		u8* m_entries[MEMORY_SIZE];
+		u16 m_lengths[MEMORY_SIZE];
+		BlockState m_states[MEMORY_SIZE];
+		bool m_covered[MEMORY_SIZE];	// Bytes that were read to translate a block.
+		std::vector<PendingExit> m_pending;
+
+		// Field offsets relative to the debugger, which is passed in rdi.
+		std::int32_t m_offV, m_offI, m_offPc, m_offDt, m_offSt, m_offCountdown, m_offFrame, m_offCycles;
+
+		template<typename T>
+		std::int32_t offsetOf(const T& field) const
+		{
+			return std::int32_t(reinterpret_cast<const char*>(&field) - reinterpret_cast<const char*>(&m_debugger));
+		}
+
+	public:
+		explicit Chip8Jit(Chip8Debugger& debugger)
+			: m_debugger{ debugger }, m_code{ nullptr }, m_used{ 0 }, m_returnStub{ nullptr }, m_budget{ 0 }, m_trapGeneration{ 0 }
+		{
+			m_offV = offsetOf(debugger.m_v[0]);
+			m_offI = offsetOf(debugger.m_i);
+			m_offPc = offsetOf(debugger.m_pc);
+			m_offDt = offsetOf(debugger.m_delayTimer);
+			m_offSt = offsetOf(debugger.m_soundTimer);
+			m_offCountdown = offsetOf(debugger.m_frameCountdown);
+			m_offFrame = offsetOf(debugger.m_instructionsPerFrame);
+			m_offCycles = offsetOf(debugger.m_cycles);
+
+			void* code = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (code != MAP_FAILED)
+				m_code = static_cast<u8*>(code);
+			reset();
+		}
+
+		~Chip8Jit() override
+		{
+			if (m_code) munmap(m_code, CODE_SIZE);
+		}
+
+		Chip8Jit(const Chip8Jit&) = delete;
+		Chip8Jit& operator=(const Chip8Jit&) = delete;
+
+		// False if the host refused to map executable memory.
+		bool valid() const { return m_code != nullptr; }
+
+		// Drop all translations.
+		void reset() override
+		{
+			for (unsigned j = 0; j < MEMORY_SIZE; ++j)
+			{
+				m_entries[j] = nullptr;
+				m_lengths[j] = 0;
+				m_states[j] = BlockState::Unknown;
+				m_covered[j] = false;
+			}
+			m_pending.clear();
+			m_used = 0;
+			if (!m_code)
+				return;
+
+			// Every unlinked exit jumps here and returns to `run`.
+			m_returnStub = m_code;
+			emit(0xC3); // ret
+		}
+
+		// A write into translated code flushes the whole cache. Code above MEMORY_SIZE is never translated.
+		void invalidate(unsigned address) override
+		{
+			if (address < MEMORY_SIZE && m_covered[address])
+				reset();
+		}
+
+		StopReason run(std::uint64_t max_instructions) override
+		{
+			Chip8Debugger& d = m_debugger;
+
+			// Blocks translated without these traps may run over one.
+			const unsigned generation = d.m_trapping ? d.m_trapGeneration : 0;
+			if (generation != m_trapGeneration)
+			{
+				if (generation != 0) reset();
+				m_trapGeneration = generation;
+			}
+
+			m_budget = max_instructions;
+			while (m_budget > 0)
+			{
+				if (d.m_trapping && d.m_traps[d.m_pc & d.m_memoryMask])
+				{
+					d.m_stopReason = StopReason::Breakpoint;
+					return d.m_stopReason;
+				}
+				if (m_code && d.m_pc < MEMORY_SIZE)
+				{
+					const u16 pc = d.m_pc;
+					if (m_states[pc] == BlockState::Unknown)
+						translate(pc);
+					if (m_states[pc] == BlockState::Translated && m_lengths[pc] <= m_budget && m_lengths[pc] < d.m_frameCountdown + d.m_instructionsPerFrame)
+					{
+						reinterpret_cast<BlockEntry>(m_entries[pc])(&d, &m_budget);
+						continue;
+					}
+				}
+
+				// Interpret a single instruction.
+				--m_budget;
+				d.updateTimers();
+				if (!d.execute(d.cachedInstruction(d.m_pc))) return d.m_stopReason;
+			}
+			d.m_stopReason = StopReason::BudgetExhausted;
+			return d.m_stopReason;
+		}
+
+	private:
+		static bool translatable(Op op)
+		{
+			switch (op)
+			{
+			case Op::LdByte: case Op::AddByte: case Op::LdReg: case Op::Or: case Op::And: case Op::Xor:
+			case Op::AddReg: case Op::Sub: case Op::Shr: case Op::Subn: case Op::Shl:
+			case Op::LdI: case Op::AddIVx: case Op::LdFVx:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		static bool isTerminator(Op op)
+		{
+			return op == Op::Jp || op == Op::SeByte || op == Op::SneByte || op == Op::SeReg || op == Op::SneReg;
+		}
+
+		void emit(u8 byte) { m_code[m_used++] = byte; }
+		void emit16(u16 value) { emit(u8(value)); emit(u8(value >> 8)); }
+		void emit32(std::uint32_t value) { for (unsigned j = 0; j < 4; ++j) emit(u8(value >> (j * 8))); }
+		void emitBytes(std::initializer_list<u8> bytes) { for (u8 b : bytes) emit(b); }
+
+		// Emit `opcode` with a ModRM operand [rdi + disp32] and `reg` in the reg field.
+		void emitMem(std::initializer_list<u8> opcode, u8 reg, std::int32_t disp)
+		{
+			emitBytes(opcode);
+			emit(u8(0x80 | (reg << 3) | 0x7));
+			emit32(std::uint32_t(disp));
+		}
+
+		void loadV(u8 reg, u8 index) { emitMem({ 0x0F, 0xB6 }, reg, m_offV + index); }	// movzx reg, byte [V + index]
+		void storeV(u8 reg, u8 index) { emitMem({ 0x88 }, reg, m_offV + index); }		// mov byte [V + index], reg8
+
+		// Point a rel32 field at `target`.
+		static void patch(u8* rel32, const u8* target)
+		{
+			std::int32_t rel = std::int32_t(target - (rel32 + 4));
+			for (unsigned j = 0; j < 4; ++j) rel32[j] = u8(std::uint32_t(rel) >> (j * 8));
+		}
+
+		// Leave the block with pc = target, directly entering the target block if it exists.
+		void emitExit(unsigned target)
+		{
+			emit(0x66); emitMem({ 0xC7 }, 0, m_offPc); emit16(u16(target));	// mov word [pc], target
+			emit(0xE9);															// jmp rel32
+			u8* rel32 = m_code + m_used;
+			emit32(0);
+			if (target < MEMORY_SIZE && m_states[target] == BlockState::Translated)
+				patch(rel32, m_entries[target]);
+			else
+			{
+				patch(rel32, m_returnStub);
+				if (target < MEMORY_SIZE) m_pending.push_back(PendingExit{ rel32, u16(target) });
+			}
+		}
+
+		// Saturating decrement of an 8 bit timer.
+		void emitTimerTick(std::int32_t offset)
+		{
+			emitMem({ 0x0F, 0xB6 }, EDX, offset);	// movzx edx, byte [timer]
+			emitBytes({ 0x83, 0xEA, 0x01 });		// sub edx, 1
+			emitBytes({ 0x83, 0xD2, 0x00 });		// adc edx, 0
+			emitMem({ 0x88 }, EDX, offset);			// mov byte [timer], dl
+		}
+
+		u8 shiftSource(const DecodedInstruction& d) const
+		{
+			return (m_debugger.m_quirks == Quirks::Cosmac || m_debugger.m_quirks == Quirks::XoChip) ? d.y : d.x;
+		}
+
+		void emitInstruction(const DecodedInstruction& d)
+		{
+			const std::int32_t vx = m_offV + d.x;
+			switch (d.op)
+			{
+			case Op::LdByte: emitMem({ 0xC6 }, 0, vx); emit(d.kk); break;	// mov byte [Vx], kk
+			case Op::AddByte: emitMem({ 0x80 }, 0, vx); emit(d.kk); break;	// add byte [Vx], kk
+			case Op::LdReg: loadV(EAX, d.y); storeV(EAX, d.x); break;
+			case Op::Or: loadV(EAX, d.y); emitMem({ 0x08 }, EAX, vx); break;	// or byte [Vx], al
+			case Op::And: loadV(EAX, d.y); emitMem({ 0x20 }, EAX, vx); break;	// and byte [Vx], al
+			case Op::Xor: loadV(EAX, d.y); emitMem({ 0x30 }, EAX, vx); break;	// xor byte [Vx], al
+
+			// The flag is written first and Vx, Vy are read again afterwards, like the interpreter does.
+			case Op::AddReg:
+				loadV(EAX, d.x); loadV(ECX, d.y);
+				emitBytes({ 0x01, 0xC8 });				// add eax, ecx
+				emit(0x3D); emit32(0xFF);				// cmp eax, 0xFF
+				emitBytes({ 0x0F, 0x97, 0xC2 });		// seta dl
+				storeV(EDX, 0xF);
+				loadV(EAX, d.x); loadV(ECX, d.y);
+				emitBytes({ 0x01, 0xC8 });				// add eax, ecx
+				storeV(EAX, d.x);
+				break;
+			case Op::Sub:
+			case Op::Subn:
+			{
+				const u8 a = (d.op == Op::Sub) ? d.x : d.y, b = (d.op == Op::Sub) ? d.y : d.x;
+				loadV(EAX, a); loadV(ECX, b);
+				emitBytes({ 0x39, 0xC8 });				// cmp eax, ecx
+				emitBytes({ 0x0F, 0x97, 0xC2 });		// seta dl
+				storeV(EDX, 0xF);
+				loadV(EAX, a); loadV(ECX, b);
+				emitBytes({ 0x29, 0xC8 });				// sub eax, ecx
+				storeV(EAX, d.x);
+				break;
+			}
+			// The COSMAC and XO-CHIP quirks shift Vy into Vx.
+			case Op::Shr:
+				loadV(EAX, shiftSource(d));
+				emitBytes({ 0x83, 0xE0, 0x01 });		// and eax, 1
+				storeV(EAX, 0xF);
+				loadV(EAX, shiftSource(d));
+				emitBytes({ 0xD1, 0xE8 });				// shr eax, 1
+				storeV(EAX, d.x);
+				break;
+			case Op::Shl:
+				loadV(EAX, shiftSource(d));
+				emitBytes({ 0xC1, 0xE8, 0x07 });		// shr eax, 7
+				storeV(EAX, 0xF);
+				loadV(EAX, shiftSource(d));
+				emitBytes({ 0x01, 0xC0 });				// add eax, eax
+				storeV(EAX, d.x);
+				break;
+			case Op::LdI: emit(0x66); emitMem({ 0xC7 }, 0, m_offI); emit16(d.nnn); break;	// mov word [I], nnn
+			case Op::AddIVx: loadV(EAX, d.x); emit(0x66); emitMem({ 0x01 }, EAX, m_offI); break;	// add word [I], ax
+			case Op::LdFVx:
+				loadV(EAX, d.x);
+				emitBytes({ 0x6B, 0xC0, 0x05 });		// imul eax, eax, 5
+				emit(0x66); emitMem({ 0x89 }, EAX, m_offI);	// mov word [I], ax
+				break;
+			default: break;
+			}
+		}
+
+		// Skip instructions leave the block through one of two exits.
+		void emitSkip(const DecodedInstruction& d, unsigned pc)
+		{
+			loadV(EAX, d.x);
+			if (d.op == Op::SeReg || d.op == Op::SneReg)
+				emitMem({ 0x3A }, EAX, m_offV + d.y);	// cmp al, byte [Vy]
+			else
+			{
+				emit(0x3C); emit(d.kk);					// cmp al, kk
+			}
+			const bool skipIfEqual = (d.op == Op::SeByte || d.op == Op::SeReg);
+			emitBytes({ 0x0F, u8(skipIfEqual ? 0x85 : 0x84) });	// jne/je no_skip
+			u8* noSkip = m_code + m_used;
+			emit32(0);
+			emitExit(pc + 4);
+			patch(noSkip, m_code + m_used);
+			emitExit(pc + 2);
+		}
+
+		void translate(u16 start)
+		{
+			Chip8Debugger& d = m_debugger;
+
+			// Collect the instructions of the block.
+			std::vector<DecodedInstruction> block;
+			unsigned pc = start;
+			bool terminated = false;
+			while (pc + 1 < MEMORY_SIZE && block.size() < MAX_BLOCK_INSTRUCTIONS && !(d.m_trapping && pc != start && d.m_traps[pc]))
+			{
+				const DecodedInstruction& instruction = d.cachedInstruction(u16(pc));
+				if (isTerminator(instruction.op))
+				{
+					block.push_back(instruction);
+					terminated = true;
+					break;
+				}
+				if (!translatable(instruction.op))
+					break;
+				block.push_back(instruction);
+				pc += 2;
+			}
+			if (block.empty())
+			{
+				m_states[start] = BlockState::Interpreted;
+				return;
+			}
+
+			if (m_used + MAX_BLOCK_BYTES > CODE_SIZE)
+				reset();
+
+			u8* entry = m_code + m_used;
+			const unsigned length = unsigned(block.size());
+
+			// Charge the budget, or leave without side effects if it doesn't cover the block.
+			emitBytes({ 0x48, 0x8B, 0x06 });				// mov rax, [rsi]
+			emitBytes({ 0x48, 0x3D }); emit32(length);		// cmp rax, length
+			emitBytes({ 0x0F, 0x82 });						// jb bail
+			u8* bail = m_code + m_used;
+			emit32(0);
+
+			// Count down the frame. If it ends within the block, start the next one and tick the
+			// timers, or leave if that one ends as well.
+			emitMem({ 0x8B }, ECX, m_offCountdown);			// mov ecx, [countdown]
+			emitBytes({ 0x81, 0xE9 }); emit32(length);		// sub ecx, length
+			emitBytes({ 0x0F, 0x8F });						// jg counted
+			u8* counted = m_code + m_used;
+			emit32(0);
+			emitMem({ 0x03 }, ECX, m_offFrame);				// add ecx, [instructions per frame]
+			emitBytes({ 0x0F, 0x8E });						// jle bail
+			u8* bail_frames = m_code + m_used;
+			emit32(0);
+			emitTimerTick(m_offDt);
+			emitTimerTick(m_offSt);
+			patch(counted, m_code + m_used);
+			emitMem({ 0x89 }, ECX, m_offCountdown);			// mov [countdown], ecx
+
+			emitBytes({ 0x48, 0x2D }); emit32(length);		// sub rax, length
+			emitBytes({ 0x48, 0x89, 0x06 });				// mov [rsi], rax
+			emit(0x48); emitMem({ 0x81 }, 0, m_offCycles); emit32(length);	// add qword [cycles], length
+
+			for (unsigned j = 0; j + (terminated ? 1 : 0) < length; ++j)
+				emitInstruction(block[j]);
+
+			const unsigned last = start + (length - 1) * 2;
+			if (!terminated)
+				emitExit(last + 2);
+			else if (block.back().op == Op::Jp)
+				emitExit(block.back().nnn);
+			else
+				emitSkip(block.back(), last);
+
+			patch(bail, m_code + m_used);
+			patch(bail_frames, m_code + m_used);
+			emit(0x66); emitMem({ 0xC7 }, 0, m_offPc); emit16(start);	// mov word [pc], start
+			emit(0xC3);													// ret
+
+			for (unsigned j = start; j <= last + 1; ++j) m_covered[j] = true;
+			m_entries[start] = entry;
+			m_lengths[start] = u16(length);
+			m_states[start] = BlockState::Translated;
+
+			// Link the exits that were waiting for this block.
+			for (unsigned j = 0; j < m_pending.size();)
+			{
+				if (m_pending[j].target == start)
+				{
+					patch(m_pending[j].rel32, entry);
+					m_pending[j] = m_pending.back();
+					m_pending.pop_back();
+				}
+				else ++j;
+			}
+		}
+	};
+#endif
+
+	// Install a JIT back end into `debugger`. Returns false if this host can't run it.
+	bool attach_jit(Chip8Debugger& debugger)
+	{
+#ifdef C8S_JIT_AVAILABLE
+		std::unique_ptr<Chip8Jit> jit{ new Chip8Jit{ debugger } };
+		if (!jit->valid())
+			return false;
+		debugger.setJitBackend(std::move(jit));
+		return true;
+#else
+		(void)debugger;
+		return false;
+#endif
+	}
+}
@@ -0,0 +1,348 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "debugger.hpp"
+
+// Keys are read through non-blocking file descriptors and poll(2).
+#if defined(__unix__) || defined(__APPLE__)
+#define C8S_KEYS_AVAILABLE
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace c8s
+{
+	// A key going down or up before frame `frame` runs.
+	struct KeyEvent
+	{
+		std::uint64_t frame;
+		u8 key;
+		bool pressed;
+	};
+
+	// Feeds key events to `FrameScheduler`. Only `wait` blocks, so a machine that waits in FX0A
+	// sleeps until input arrives instead of spinning.
+	class KeySource
+	{
+	public:
+		virtual ~KeySource() = default;
+		// Append the events due before `frame` runs, without blocking.
+		virtual void poll(std::uint64_t frame, std::vector<KeyEvent>& events) = 0;
+		// True if events were read that are not due yet, e.g. the release of a key that is down.
+		virtual bool pending() const = 0;
+		// True once the input ended and nothing is pending, so no key will change any more.
+		virtual bool finished() const = 0;
+		// Sleep until input arrives, for at most `timeout_ms` or forever if it is negative. Returns
+		// true if input arrived.
+		virtual bool wait(int timeout_ms) = 0;
+		// Why the input ended early, empty if it didn't.
+		virtual std::string error() const { return ""; }
+	};
+
+	// The keypad laid over the left side of a QWERTY keyboard:
+	//   1 2 3 C     1 2 3 4
+	//   4 5 6 D     q w e r
+	//   7 8 9 E     a s d f
+	//   A 0 B F     z x c v
+	// Returns -1 for a character that is no key.
+	int key_for_char(char c)
+	{
+		static const char layout[] = "x123qweasdzc4rfv";
+		for (unsigned key = 0; key < KEYPAD_SIZE; ++key)
+			if (layout[key] == std::tolower(static_cast<unsigned char>(c))) return int(key);
+		return -1;
+	}
+
+#ifdef C8S_KEYS_AVAILABLE
+	// Sleep until `fd` has input, for at most `timeout_ms` or forever if it is negative.
+	bool wait_readable(int fd, int timeout_ms)
+	{
+		pollfd request{ fd, POLLIN, 0 };
+		return ::poll(&request, 1, timeout_ms) > 0;
+	}
+
+	// Keys typed into the terminal on standard input, which is switched to non-canonical mode
+	// without echo while the source is open. Terminals report no releases, so a key goes up
+	// `holdFrames` frames after its last press; auto repeat keeps a held key down.
+	class TerminalKeys : public KeySource
+	{
+		unsigned m_holdFrames;
+		bool m_raw;
+		bool m_closed;
+		bool m_down[KEYPAD_SIZE];
+		std::uint64_t m_releaseAt[KEYPAD_SIZE];
+
+		// The mode to restore, also from a signal handler.
+		static termios& savedMode()
+		{
+			static termios mode;
+			return mode;
+		}
+
+		static void restoreAndRaise(int signal)
+		{
+			tcsetattr(STDIN_FILENO, TCSANOW, &savedMode());
+			std::signal(signal, SIG_DFL);
+			std::raise(signal);
+		}
+
+	public:
+		explicit TerminalKeys(unsigned hold_frames = 6)
+			: m_holdFrames{ hold_frames }, m_raw{ false }, m_closed{ false }, m_down{}, m_releaseAt{} {}
+		TerminalKeys(const TerminalKeys&) = delete;
+		TerminalKeys& operator=(const TerminalKeys&) = delete;
+		~TerminalKeys() override { close(); }
+
+		// Returns false if standard input is a terminal that can't be switched.
+		bool open()
+		{
+			if (!isatty(STDIN_FILENO))
+				return true;
+			if (tcgetattr(STDIN_FILENO, &savedMode()) != 0)
+				return false;
+			termios mode = savedMode();
+			mode.c_lflag &= ~tcflag_t(ICANON | ECHO);
+			mode.c_cc[VMIN] = 0;
+			mode.c_cc[VTIME] = 0;
+			if (tcsetattr(STDIN_FILENO, TCSANOW, &mode) != 0)
+				return false;
+			m_raw = true;
+			std::signal(SIGINT, restoreAndRaise);
+			std::signal(SIGTERM, restoreAndRaise);
+			return true;
+		}
+
+		void close()
+		{
+			if (!m_raw)
+				return;
+			tcsetattr(STDIN_FILENO, TCSANOW, &savedMode());
+			std::signal(SIGINT, SIG_DFL);
+			std::signal(SIGTERM, SIG_DFL);
+			m_raw = false;
+		}
+
+		void poll(std::uint64_t frame, std::vector<KeyEvent>& events) override
+		{
+			char buffer[64];
+			while (!m_closed && wait_readable(STDIN_FILENO, 0))
+			{
+				const ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+				if (count <= 0)
+				{
+					m_closed = true;
+					break;
+				}
+				for (ssize_t j = 0; j < count; ++j)
+				{
+					const int key = key_for_char(buffer[j]);
+					if (key < 0)
+						continue;
+					if (!m_down[key]) events.push_back(KeyEvent{ frame, u8(key), true });
+					m_down[key] = true;
+					m_releaseAt[key] = frame + m_holdFrames;
+				}
+			}
+			for (unsigned key = 0; key < KEYPAD_SIZE; ++key)
+			{
+				if (m_down[key] && m_releaseAt[key] <= frame)
+				{
+					m_down[key] = false;
+					events.push_back(KeyEvent{ frame, u8(key), false });
+				}
+			}
+		}
+
+		bool pending() const override
+		{
+			for (bool down : m_down)
+				if (down) return true;
+			return false;
+		}
+
+		bool finished() const override { return m_closed && !pending(); }
+
+		bool wait(int timeout_ms) override
+		{
+			return !m_closed && wait_readable(STDIN_FILENO, timeout_ms);
+		}
+	};
+
+	// Key events from a file, one per line: `<frame> <key> down|up` with the key as a hex digit
+	// and frames counted from 0. Lines are ordered by frame and `#` starts a comment. The file is
+	// read without blocking as the frames go by, so a FIFO can feed events to a running machine.
+	class ScriptedKeys : public KeySource
+	{
+		int m_fd;
+		bool m_closed;
+		std::string m_partial;
+		std::deque<KeyEvent> m_events;
+		std::uint64_t m_lastFrame;
+		unsigned m_line;
+		std::string m_error;
+
+	public:
+		ScriptedKeys() : m_fd{ -1 }, m_closed{ true }, m_lastFrame{ 0 }, m_line{ 0 } {}
+		ScriptedKeys(const ScriptedKeys&) = delete;
+		ScriptedKeys& operator=(const ScriptedKeys&) = delete;
+		~ScriptedKeys() override { close(); }
+
+		// Opening a FIFO waits for its writer.
+		bool open(const std::string& fileName)
+		{
+			close();
+			m_fd = ::open(fileName.c_str(), O_RDONLY);
+			if (m_fd < 0 || fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK) != 0)
+			{
+				close();
+				return false;
+			}
+			m_closed = false;
+			m_partial.clear();
+			m_events.clear();
+			m_lastFrame = 0;
+			m_line = 0;
+			m_error.clear();
+			return true;
+		}
+
+		void close()
+		{
+			if (m_fd >= 0) ::close(m_fd);
+			m_fd = -1;
+			m_closed = true;
+		}
+
+		void poll(std::uint64_t frame, std::vector<KeyEvent>& events) override
+		{
+			readAvailable();
+			while (!m_events.empty() && m_events.front().frame <= frame)
+			{
+				events.push_back(m_events.front());
+				m_events.pop_front();
+			}
+		}
+
+		bool pending() const override { return !m_events.empty(); }
+		bool finished() const override { return m_closed && m_events.empty(); }
+
+		bool wait(int timeout_ms) override
+		{
+			return !m_closed && wait_readable(m_fd, timeout_ms);
+		}
+
+		std::string error() const override { return m_error; }
+
+	private:
+		void readAvailable()
+		{
+			char buffer[256];
+			while (!m_closed)
+			{
+				const ssize_t count = read(m_fd, buffer, sizeof(buffer));
+				if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+					return;
+				if (count <= 0)
+				{
+					// The last line may lack its newline.
+					if (!m_partial.empty()) parseLine(m_partial);
+					close();
+					return;
+				}
+
+				m_partial.append(buffer, std::size_t(count));
+				std::size_t start = 0, end;
+				while (!m_closed && (end = m_partial.find('\n', start)) != std::string::npos)
+				{
+					parseLine(m_partial.substr(start, end - start));
+					start = end + 1;
+				}
+				m_partial.erase(0, start);
+			}
+		}
+
+		// A bad line ends the input.
+		void parseLine(std::string line)
+		{
+			++m_line;
+			line = line.substr(0, line.find('#'));
+			std::istringstream iss{ line };
+			std::string frame, key, state, rest;
+			if (!(iss >> frame))
+				return;
+			iss >> key >> state >> rest;
+
+			char* frame_end = nullptr;
+			const std::uint64_t at = std::strtoull(frame.c_str(), &frame_end, 10);
+			const bool valid = *frame_end == '\0' && std::isdigit(static_cast<unsigned char>(frame[0]))
+				&& key.size() == 1 && std::isxdigit(static_cast<unsigned char>(key[0]))
+				&& (state == "down" || state == "up") && rest.empty();
+			if (!valid || at < m_lastFrame)
+			{
+				m_error = "line " + std::to_string(m_line) + (valid ? ": frames must not decrease" : ": expected `<frame> <key> down|up`");
+				close();
+				return;
+			}
+			m_lastFrame = at;
+			m_events.push_back(KeyEvent{ at, u8(std::stoul(key, nullptr, 16)), state == "down" });
+		}
+	};
+#endif
+
+	// Keys typed into the terminal for an empty `fileName`, else the events of the file. Returns
+	// nothing if the input can't be opened or this host can't read keys without blocking.
+	std::unique_ptr<KeySource> open_key_source(const std::string& fileName)
+	{
+#ifdef C8S_KEYS_AVAILABLE
+		if (fileName.empty())
+		{
+			std::unique_ptr<TerminalKeys> keys{ new TerminalKeys };
+			if (!keys->open()) return nullptr;
+			return keys;
+		}
+		std::unique_ptr<ScriptedKeys> keys{ new ScriptedKeys };
+		if (!keys->open(fileName)) return nullptr;
+		return keys;
+#else
+		(void)fileName;
+		return nullptr;
+#endif
+	}
+}
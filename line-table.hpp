@@ -0,0 +1,128 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "binary-file.hpp"
+#include "types.hpp"
+
+namespace c8s
+{
+	// First ROM address of the instructions a source line was compiled to.
+	struct LineEntry
+	{
+		u16 address;
+		unsigned line;
+	};
+
+	// Maps ROM addresses to source lines, sorted by address. Every address up to the
+	// next entry belongs to the same line.
+	// Stored as "C8LT", a version byte and one pair per entry: the address delta as LEB128
+	// and the line delta zigzag encoded as LEB128, so a straight program costs two bytes per line.
+	struct LineTable
+	{
+		std::vector<LineEntry> entries;
+
+		// Entries have to be added in address order.
+		void add(u16 address, unsigned line)
+		{
+			if (!entries.empty() && entries.back().address == address) entries.back().line = line;
+			else entries.push_back(LineEntry{ address, line });
+		}
+
+		bool empty() const { return entries.empty(); }
+
+		// The line `address` belongs to, 0 if it comes before the first entry.
+		unsigned lineAt(unsigned address) const
+		{
+			auto it = std::upper_bound(entries.begin(), entries.end(), address, [](unsigned a, const LineEntry& e) { return a < e.address; });
+			return it == entries.begin() ? 0 : std::prev(it)->line;
+		}
+
+		// The lowest address compiled from `line`. Returns false if the line has no instructions.
+		bool addressOf(unsigned line, u16& address) const
+		{
+			auto it = std::find_if(entries.begin(), entries.end(), [&](const LineEntry& e) { return e.line == line; });
+			if (it == entries.end())
+				return false;
+			address = it->address;
+			return true;
+		}
+
+		std::vector<u8> encode() const
+		{
+			std::vector<u8> bytes = file_header("C8LT", 1);
+			LineEntry previous{ 0, 0 };
+			for (const LineEntry& entry : entries)
+			{
+				put_varint(bytes, entry.address - previous.address);
+				const std::int64_t delta = std::int64_t(entry.line) - previous.line;
+				put_varint(bytes, (std::uint64_t(delta) << 1) ^ std::uint64_t(delta < 0 ? -1 : 0));
+				previous = entry;
+			}
+			return bytes;
+		}
+
+		// Returns false if `bytes` is not a valid table.
+		bool decode(const std::vector<u8>& bytes)
+		{
+			entries.clear();
+			std::size_t p = FILE_HEADER_SIZE;
+			if (!has_file_header(bytes, "C8LT", 1))
+				return false;
+
+			std::uint64_t address = 0, line = 0;
+			while (p < bytes.size())
+			{
+				std::uint64_t address_delta, line_delta;
+				if (!get_varint(bytes, p, address_delta) || !get_varint(bytes, p, line_delta))
+					return false;
+				if ((address_delta == 0 && !entries.empty()) || address + address_delta > 0xFFFF)
+					return false;
+				address += address_delta;
+				line += (line_delta >> 1) ^ (0 - (line_delta & 1));
+				entries.push_back(LineEntry{ u16(address), unsigned(line) });
+			}
+			return true;
+		}
+
+		bool save(const std::string& fileName) const
+		{
+			return save_bytes(fileName, encode());
+		}
+
+		bool load(const std::string& fileName)
+		{
+			std::vector<u8> bytes;
+			return load_bytes(fileName, bytes) && decode(bytes);
+		}
+	};
+}
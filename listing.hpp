@@ -0,0 +1,397 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "control-flow.hpp"
+#include "disassembler.hpp"
+#include "line-table.hpp"
+#include "opcode-table.hpp"
+
+// Worst case of a path without an upper bound, like a loop with an unknown trip count.
+#define UNBOUNDED_CYCLES UINT64_MAX
+
+namespace c8s
+{
+	// Cycles of every entry of OPCODE_TABLE, by index, and of words that are no instruction.
+	struct CostModel
+	{
+		std::array<unsigned, OPCODE_COUNT> cycles;
+		unsigned data;
+
+		// Cycles of the instruction at `offset` of the ROM, its length goes to `length`.
+		unsigned cycles_at(const u8* rom, std::size_t size, std::size_t offset, Target target, unsigned& length) const
+		{
+			const OpcodeInfo* info = instruction_at(rom, size, offset, target, length);
+			return info != nullptr ? cycles[std::size_t(info - OPCODE_TABLE)] : data;
+		}
+	};
+
+	// Every instruction takes one cycle, the unit of `--ipf`.
+	CostModel uniform_cost_model()
+	{
+		CostModel model;
+		model.cycles.fill(1);
+		model.data = 1;
+		return model;
+	}
+
+	// Applies `NAME=cycles` items separated by commas or lines to `model`. NAME is an instruction
+	// of OPCODE_TABLE like `DXYN`, `data` for words that are no instruction or `*` for everything,
+	// `#` starts a comment. Returns false on an unknown name or a cycle count that is no number.
+	bool parse_cost_model(const std::string& text, CostModel& model)
+	{
+		std::string items;
+		std::istringstream lines{ text };
+		for (std::string line; std::getline(lines, line);)
+			items += line.substr(0, line.find('#')) + ',';
+
+		for (const std::string& item : split_list(items))
+		{
+			if (item.empty())
+				continue;
+			const std::size_t equals = item.find('=');
+			unsigned cycles = 0;
+			if (equals == std::string::npos || !parse_number(trim(item.substr(equals + 1)), 0xFFFF, cycles))
+				return false;
+
+			const std::string name = to_upper(trim(item.substr(0, equals)));
+			bool known = name == "*" || name == "DATA";
+			if (name == "*") model.cycles.fill(cycles);
+			if (name == "*" || name == "DATA") model.data = cycles;
+			for (unsigned j = 0; j < OPCODE_COUNT; ++j)
+			{
+				if (name != OPCODE_TABLE[j].name)
+					continue;
+				model.cycles[j] = cycles;
+				known = true;
+			}
+			if (!known)
+				return false;
+		}
+		return true;
+	}
+
+	// Cycles of the fastest and of the slowest path through some code.
+	struct CycleRange
+	{
+		std::uint64_t best;
+		std::uint64_t worst;	// UNBOUNDED_CYCLES if there is no upper bound.
+	};
+
+	std::uint64_t add_cycles(std::uint64_t a, std::uint64_t b)
+	{
+		return (a > UNBOUNDED_CYCLES - b) ? UNBOUNDED_CYCLES : a + b;
+	}
+
+	std::uint64_t multiply_cycles(std::uint64_t cycles, std::uint64_t times)
+	{
+		if (times == 0) return 0;
+		return (cycles > UNBOUNDED_CYCLES / times) ? UNBOUNDED_CYCLES : cycles * times;
+	}
+
+	CycleRange add_cycles(CycleRange a, CycleRange b)
+	{
+		return CycleRange{ add_cycles(a.best, b.best), add_cycles(a.worst, b.worst) };
+	}
+
+	enum class CodeBlockKind : u8
+	{
+		If,
+		For
+	};
+
+	// An IF or FOR statement, recognized by the instructions the compiler emits for it. An IF is a
+	// skip over a forward jump past its body. A FOR loop sets its counter, limit and step, runs the
+	// body, adds the step and jumps back unless the counter met the limit.
+	struct CodeBlock
+	{
+		CodeBlockKind kind;
+		u16 start, end;				// All instructions of the statement, the FOR header included.
+		u16 body_start, body_end;
+		unsigned trips;				// Passes through a FOR loop, 0 if they are not constant.
+		bool endless;				// The FOR counter never meets the limit.
+		CycleRange pass;			// The body of an IF, one iteration of a FOR loop.
+		CycleRange cycles;			// The whole statement.
+		bool over_budget;
+	};
+
+	struct CycleEstimate
+	{
+		std::vector<CodeBlock> blocks;	// Sorted by address, outer blocks before the ones they contain.
+		CycleRange program;				// From the first to the last instruction of the ROM.
+		std::uint64_t frame_budget;		// 0 if no block is checked.
+	};
+
+	// Estimates the cycles of every IF and FOR block of a ROM loaded at PROGRAM_START. The trip count
+	// of a loop is constant if only one `LD Vx, byte` reaches the loop for each of its counter, limit
+	// and step, which needs the CHIP-8 dataflow analysis. Other branches, calls included, are counted
+	// as plain instructions. A block is over the budget if its worst case is, for a loop without
+	// constant trip count the worst case of one iteration.
+	CycleEstimate estimate_cycles(const std::vector<u8>& rom, const CostModel& model, Target target = Target::Chip8, std::uint64_t frame_budget = 0)
+	{
+		CycleEstimate estimate{ {}, { 0, 0 }, frame_budget };
+		const std::size_t size = std::min<std::size_t>(rom.size(), MEMORY_SIZE - PROGRAM_START);
+		const unsigned rom_end = unsigned(PROGRAM_START + size);
+		std::vector<u8> memory(MEMORY_SIZE, 0);
+		std::copy(rom.begin(), rom.begin() + std::ptrdiff_t(size), memory.begin() + PROGRAM_START);
+		auto word = [&](unsigned address) { return address + 1 < rom_end ? fetch_opcode(memory.data(), address) : u16(0); };
+		auto sets = [](u16 op, unsigned reg) { return ((op & 0xF000) == 0x6000 || (op & 0xF00F) == 0x8000) && ((op >> 8) & 0xF) == reg; };
+
+		// Find the statements by their instructions.
+		std::vector<CodeBlock> found;
+		unsigned length = 0;
+		for (std::size_t offset = 0; offset < size; offset += length)
+		{
+			instruction_at(rom.data(), size, offset, target, length);
+			const unsigned address = unsigned(PROGRAM_START + offset);
+			const u16 op = word(address), next = word(address + 2), after = word(address + 4);
+			const bool is_skip = (op & 0xF000) == 0x3000 || (op & 0xF000) == 0x4000 || (op & 0xF00F) == 0x5000 || (op & 0xF00F) == 0x9000;
+			if (is_skip && (next & 0xF000) == 0x1000 && (next & 0xFFF) >= address + 4 && (next & 0xFFF) <= rom_end)
+				found.push_back(CodeBlock{ CodeBlockKind::If, u16(address), u16(next & 0xFFF), u16(address + 4), u16(next & 0xFFF), 0, false, {}, {}, false });
+
+			const unsigned counter = (op >> 8) & 0xF, step = (op >> 4) & 0xF, limit = (next >> 4) & 0xF, body = after & 0xFFF;
+			if ((op & 0xF00F) == 0x8004 && (next & 0xF00F) == 0x5000 && ((next >> 8) & 0xF) == counter
+				&& (after & 0xF000) == 0x1000 && body >= PROGRAM_START && body <= address)
+			{
+				const bool header = body >= PROGRAM_START + 6 && sets(word(body - 6), counter)
+					&& (word(body - 4) & 0xF000) == 0x6000 && sets(word(body - 4), limit)
+					&& (word(body - 2) & 0xF000) == 0x6000 && sets(word(body - 2), step);
+				found.push_back(CodeBlock{ CodeBlockKind::For, u16(header ? body - 6 : body), u16(address + 6), u16(body), u16(address), 0, false, {}, {}, false });
+			}
+		}
+
+		// Keep the blocks that nest into the body of the block around them.
+		std::sort(found.begin(), found.end(), [](const CodeBlock& a, const CodeBlock& b) { return a.start != b.start ? a.start < b.start : a.end > b.end; });
+		std::vector<CodeBlock>& blocks = estimate.blocks;
+		std::vector<unsigned> open;
+		for (const CodeBlock& block : found)
+		{
+			while (!open.empty() && blocks[open.back()].end <= block.start) open.pop_back();
+			if (!open.empty() && (block.start < blocks[open.back()].body_start || block.end > blocks[open.back()].body_end))
+				continue;
+			open.push_back(unsigned(blocks.size()));
+			blocks.push_back(block);
+		}
+
+		// Trip counts of the loops.
+		const bool has_loop = std::any_of(blocks.begin(), blocks.end(), [](const CodeBlock& b) { return b.kind == CodeBlockKind::For; });
+		if (has_loop && target == Target::Chip8)
+		{
+			const ControlFlowGraph cfg = build_control_flow_graph(memory.data());
+			const ReachingDefinitions rd = compute_reaching_definitions(cfg, memory.data());
+			auto constant = [&](unsigned address, unsigned reg, unsigned ignored, unsigned& value)
+			{
+				std::vector<u16> defs = reaching_definitions(cfg, rd, memory.data(), address, reg);
+				defs.erase(std::remove(defs.begin(), defs.end(), ignored), defs.end());
+				if (defs.size() != 1 || (word(defs[0]) & 0xF000) != 0x6000)
+					return false;
+				value = word(defs[0]) & 0xFF;
+				return true;
+			};
+			for (CodeBlock& block : blocks)
+			{
+				const unsigned increment = block.body_end, op = word(increment);
+				const unsigned counter = (op >> 8) & 0xF, step = (op >> 4) & 0xF, limit = (word(increment + 2) >> 4) & 0xF;
+				unsigned first = 0, last = 0, by = 0;
+				if (block.kind != CodeBlockKind::For || !constant(increment, counter, increment, first)
+					|| !constant(increment, step, MEMORY_SIZE, by) || !constant(increment + 2, limit, MEMORY_SIZE, last))
+					continue;
+
+				// The test follows the increment, so the body runs at least once.
+				for (unsigned trips = 1; trips <= 0x100 && block.trips == 0; ++trips)
+					if (u8(first + trips * by) == last) block.trips = trips;
+				block.endless = block.trips == 0;
+			}
+		}
+
+		// Blocks that start at an address, outer ones first.
+		std::vector<unsigned> first_at(MEMORY_SIZE, unsigned(blocks.size()));
+		for (unsigned j = unsigned(blocks.size()); j-- > 0;) first_at[blocks[j].start] = j;
+		auto cycles_at = [&](unsigned address)
+		{
+			unsigned ignored = 0;
+			return std::uint64_t(model.cycles_at(rom.data(), size, address - PROGRAM_START, target, ignored));
+		};
+		auto range = [&](unsigned begin, unsigned end)
+		{
+			CycleRange total{ 0, 0 };
+			for (unsigned address = begin; address < end;)
+			{
+				unsigned j = first_at[address];
+				while (j < blocks.size() && blocks[j].start == address && blocks[j].end > end) ++j;
+				if (j < blocks.size() && blocks[j].start == address)
+				{
+					total = add_cycles(total, blocks[j].cycles);
+					address = blocks[j].end;
+					continue;
+				}
+				unsigned instruction_length = 0;
+				const std::uint64_t cycles = model.cycles_at(rom.data(), size, address - PROGRAM_START, target, instruction_length);
+				total = add_cycles(total, CycleRange{ cycles, cycles });
+				address += instruction_length;
+			}
+			return total;
+		};
+
+		// Inner blocks come later, so going backward every block finds the ones it contains done.
+		for (unsigned j = unsigned(blocks.size()); j-- > 0;)
+		{
+			CodeBlock& block = blocks[j];
+			const CycleRange body = range(block.body_start, block.body_end);
+			if (block.kind == CodeBlockKind::If)
+			{
+				// The skip jumps over the jump into the body if the condition holds.
+				const std::uint64_t skip = cycles_at(block.start), jump = cycles_at(block.start + 2);
+				block.pass = body;
+				block.cycles = CycleRange{ add_cycles(skip, std::min(jump, body.best)), add_cycles(skip, std::max(jump, body.worst)) };
+				block.over_budget = frame_budget != 0 && block.cycles.worst > frame_budget;
+				continue;
+			}
+
+			// Every iteration adds the step and tests the counter, all but the last one jump back.
+			const CycleRange header = range(block.start, block.body_start);
+			const std::uint64_t test = cycles_at(block.body_end) + cycles_at(block.body_end + 2), jump = cycles_at(block.body_end + 4);
+			const CycleRange iteration = add_cycles(body, CycleRange{ test, test });
+			block.pass = add_cycles(iteration, CycleRange{ jump, jump });
+			if (block.trips != 0)
+			{
+				block.cycles.best = add_cycles(header.best, add_cycles(multiply_cycles(iteration.best, block.trips), multiply_cycles(jump, block.trips - 1)));
+				block.cycles.worst = add_cycles(header.worst, add_cycles(multiply_cycles(iteration.worst, block.trips), multiply_cycles(jump, block.trips - 1)));
+			}
+			else if (block.endless) block.cycles = CycleRange{ UNBOUNDED_CYCLES, UNBOUNDED_CYCLES };
+			else block.cycles = CycleRange{ add_cycles(header.best, iteration.best), UNBOUNDED_CYCLES };
+			block.over_budget = frame_budget != 0 && (block.trips != 0 ? block.cycles.worst : block.pass.worst) > frame_budget;
+		}
+		estimate.program = range(PROGRAM_START, rom_end);
+		return estimate;
+	}
+
+	// `5`, `3 - 8`, `3 - unbounded` or `unbounded`.
+	std::string format_cycles(CycleRange cycles)
+	{
+		if (cycles.best == UNBOUNDED_CYCLES) return "unbounded";
+		std::string text = std::to_string(cycles.best);
+		if (cycles.worst == cycles.best) return text;
+		return text + " - " + (cycles.worst == UNBOUNDED_CYCLES ? std::string{ "unbounded" } : std::to_string(cycles.worst));
+	}
+
+	// `IF block on lines 3-5` or `FOR block at 0x20C` without line table.
+	std::string describe_code_block(const CodeBlock& block, const LineTable& lines)
+	{
+		std::ostringstream oss;
+		oss << (block.kind == CodeBlockKind::If ? "IF" : "FOR") << " block ";
+		if (lines.empty()) oss << "at 0x" << std::hex << std::uppercase << block.start;
+		else oss << "on lines " << lines.lineAt(block.start) << '-' << lines.lineAt(block.end - 2u);
+		return oss.str();
+	}
+
+	// Prints every instruction of the ROM with its cycles and the source line it starts, then the
+	// cycles of every IF and FOR block, indented by nesting. `!` marks blocks over the frame budget.
+	void print_listing(std::ostream& os, const std::vector<u8>& rom, const CycleEstimate& estimate, const CostModel& model,
+		const LineTable& lines, const std::string& source, Target target = Target::Chip8)
+	{
+		std::vector<std::string> source_lines;
+		std::istringstream iss{ source };
+		for (std::string line; std::getline(iss, line);)
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			source_lines.push_back(line);
+		}
+
+		auto old_flags = os.flags();
+		auto old_fill = os.fill();
+		os << std::uppercase << std::left;
+		os << "address  opcode     instruction             cycles  line  source\n";
+
+		static const std::bitset<MEMORY_SIZE> no_labels;
+		const std::size_t size = std::min<std::size_t>(rom.size(), MEMORY_SIZE - PROGRAM_START);
+		std::size_t next_entry = 0;
+		unsigned length = 0;
+		for (std::size_t offset = 0; offset < size; offset += length)
+		{
+			const unsigned address = unsigned(PROGRAM_START + offset);
+			const OpcodeInfo* info = instruction_at(rom.data(), size, offset, target, length);
+			char text[DISASSEMBLY_LINE_MAX];
+			char* end = text;
+			if (info != nullptr) put_instruction(end, rom.data(), offset, *info, no_labels);
+			else
+			{
+				put_text(end, length == 1 ? "DB " : "DW ");
+				put_hex(end, length == 1 ? rom[offset] : unsigned(rom[offset] << 8 | rom[offset + 1]), length * 2);
+			}
+
+			std::ostringstream opcode;
+			opcode << std::hex << std::uppercase << std::setfill('0');
+			for (unsigned j = 0; j < length; ++j) opcode << (j != 0 && j % 2 == 0 ? " " : "") << std::setw(2) << unsigned(rom[offset + j]);
+
+			os << "0x" << std::hex << std::setw(7) << address << std::setw(11) << opcode.str()
+				<< std::setw(24) << std::string(text, end) << std::right << std::dec << std::setw(6) << (info != nullptr ? model.cycles[std::size_t(info - OPCODE_TABLE)] : model.data) << std::left;
+
+			// The source of the statement that starts here.
+			while (next_entry < lines.entries.size() && lines.entries[next_entry].address < address) ++next_entry;
+			if (next_entry < lines.entries.size() && lines.entries[next_entry].address == address)
+			{
+				const unsigned line = lines.entries[next_entry].line;
+				os << std::right << std::setw(6) << line << std::left << "  " << (line - 1 < source_lines.size() ? source_lines[line - 1] : "");
+			}
+			os << '\n';
+		}
+
+		os << "\nblock            lines      addresses        trips  pass [cycles]         total [cycles]\n";
+		std::vector<const CodeBlock*> open;
+		for (const CodeBlock& block : estimate.blocks)
+		{
+			while (!open.empty() && open.back()->end <= block.start) open.pop_back();
+			std::ostringstream kind, range, where;
+			kind << std::string(open.size() * 2, ' ') << (block.kind == CodeBlockKind::If ? "IF" : "FOR");
+			if (!lines.empty()) range << lines.lineAt(block.start) << '-' << lines.lineAt(block.end - 2u);
+			else range << '-';
+			where << std::hex << std::uppercase << "0x" << block.start << "-0x" << block.end;
+			const std::string trips = block.kind == CodeBlockKind::If ? "-" : block.endless ? "never" : block.trips != 0 ? std::to_string(block.trips) : "?";
+			os << (block.over_budget ? '!' : ' ') << std::setw(16) << kind.str() << std::setw(11) << range.str() << std::setw(17) << where.str()
+				<< std::setw(7) << trips << std::setw(22) << format_cycles(block.pass) << format_cycles(block.cycles) << '\n';
+			open.push_back(&block);
+		}
+		std::ostringstream where;
+		where << std::hex << std::uppercase << "0x" << PROGRAM_START << "-0x" << PROGRAM_START + size;
+		os << ' ' << std::setw(27) << "program" << std::setw(46) << where.str() << format_cycles(estimate.program) << '\n';
+		if (estimate.frame_budget != 0)
+			os << "\n! over the frame budget of " << std::dec << estimate.frame_budget << " cycles\n";
+
+		os.flags(old_flags);
+		os.fill(old_fill);
+	}
+}
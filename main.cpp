@@ -1,122 +1,688 @@
-/*
-* MIT License
-*
-* Copyright(c) 2018 Paul Bernitz
-*
-* Permission is hereby granted, free of charge, to any person obtaining a copy
-* of this software and associated documentation files(the "Software"), to deal
-* in the Software without restriction, including without limitation the rights
-* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-* copies of the Software, and to permit persons to whom the Software is
-* furnished to do so, subject to the following conditions :
-*
-* The above copyright notice and this permission notice shall be included in all
-* copies or substantial portions of the Software.
-*
-* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
-* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-* SOFTWARE.
-*/
-
-#include <iostream>
-#include <fstream>
-#include <vector>
-
-#include "test-compiler.hpp"
-#include "interface.hpp"
-#include "debugger.hpp"
-
-int main(int argc, char** argv)
-{
-	c8s::run_tests();// XX
-
-	// Parse arguments.
-	auto flags = c8s::parse_flags(argc, argv);
-
-	// Just print the introduction if no input is provided.
-	if (flags.empty())
-	{
-		c8s::print_intro();
-		return EXIT_SUCCESS;
-	}
-
-	// If version flag is set just print the version and exit.
-	if (std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'v'; }) != flags.end())
-	{
-		std::cout << "c8s-compiler v0.5\n";
-		return EXIT_SUCCESS;
-	}
-
-	// If the tests flag is set, run the tests and exit.
-	if (std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 't'; }) != flags.end())
-	{
-		return c8s::run_tests() ? EXIT_SUCCESS : EXIT_FAILURE;
-	}
-
-	// Read the input file.
-	if (flags.back().token != 'i' || flags.back().param.empty())
-	{
-		std::cout << "No input specified!\n";
-		return EXIT_FAILURE;
-	}
-	std::ifstream ifs{ flags.back().param };
-	if (!ifs.is_open())
-	{
-		std::cout << "Could not open input-file!\n";
-		return EXIT_FAILURE;
-	}
-	std::string line{};
-	std::string code_input{};
-	while (std::getline(ifs, line))
-	{
-		code_input += (line + '\n');
-	}
-
-	// Check which type of output should be produced.
-	bool is_silent = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 's'; }) != flags.end();
-	bool is_print_steps = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'm'; }) != flags.end();
-
-	// Compile.
-	std::cout << "Starting to compile..\n";
-	auto compiler_output = c8s::compile(code_input, !is_silent, !is_silent && is_print_steps);
-
-	// Check for errors in compiler result.
-	if (compiler_output.empty())
-	{
-		std::cout << "Failed...\n";
-		return EXIT_FAILURE;
-	}
-	else std::cout << "Finished!\n";
-
-	// Write result to output.
-	auto out_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'o'; });
-	std::string out_file = (out_flag != flags.end() && !out_flag->param.empty()) ? out_flag->param : "out.c8s";
-	c8s::write_opcodes_to_file(compiler_output, out_file);
-	std::cout << "Output written to `" << out_file << "`\n";
-
-	// Attach debugger to output file.
-	bool is_debug = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'd'; }) != flags.end();
-	if (is_debug)
-	{
-		// Load ROM into debugger.
-		c8s::Chip8Debugger debugger;
-		if (!debugger.loadRom(out_file))
-		{
-			std::cout << "Debugger unable to load the ROM\n";
-			return EXIT_FAILURE;
-		}
-
-		// Run debug process.
-		std::cout << "Start debugging..\n";
-		std::cout << "Press <return> to step to the next instruction\n";
-		while (debugger.runCycle());
-	}
-	
-	std::cout << "Success!\n";
-	std::cin.get();
-	return EXIT_SUCCESS;
-}
+/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+
+#include "test-compiler.hpp"
+#include "interface.hpp"
+#include "debugger.hpp"
+#include "debug-tracer.hpp"
+#include "rewind.hpp"
+#include "jit.hpp"
+#include "recompiler.hpp"
+#include "replay.hpp"
+#include "profiler.hpp"
+#include "scheduler.hpp"
+#include "keypad.hpp"
+#include "terminal-display.hpp"
+#include "capture.hpp"
+#include "trace.hpp"
+#include "disassembler.hpp"
+#include "listing.hpp"
+
+// Number of instructions `--run` executes if no budget is given.
+#define DEFAULT_RUN_BUDGET 100000000ULL
+
+int main(int argc, char** argv)
+{
+	// Parse arguments.
+	auto flags = c8s::parse_flags(argc, argv);
+
+	// Just print the introduction if no input is provided.
+	if (flags.empty())
+	{
+		c8s::print_intro();
+		return EXIT_SUCCESS;
+	}
+
+	// If version flag is set just print the version and exit.
+	if (std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'v'; }) != flags.end())
+	{
+		std::cout << "c8s-compiler v0.5\n";
+		return EXIT_SUCCESS;
+	}
+
+	// If the tests flag is set, run the tests and exit.
+	if (std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 't'; }) != flags.end())
+	{
+		bool passed = c8s::run_tests();
+		c8s::diagnostics::flush();
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Check which type of output should be produced.
+	bool is_silent = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 's'; }) != flags.end();
+	bool is_print_steps = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'm'; }) != flags.end();
+	bool is_json_log = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'j'; }) != flags.end();
+	auto log_level_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'l'; });
+
+	// Set up the diagnostics. A silent run does not write anything.
+	c8s::NullSink null_sink;
+	c8s::JsonLinesSink json_sink{ std::cout };
+	c8s::Severity threshold = c8s::Severity::Info;
+	if (log_level_flag != flags.end() && !c8s::parse_severity(log_level_flag->param, threshold))
+	{
+		c8s::diagnostics::error([&] { return "Unknown log level `" + log_level_flag->param + "`!"; });
+		return EXIT_FAILURE;
+	}
+	if (is_silent)
+	{
+		c8s::diagnostics::set_sink(&null_sink);
+		c8s::diagnostics::set_threshold(c8s::Severity::Off);
+	}
+	else
+	{
+		if (is_json_log) c8s::diagnostics::set_sink(&json_sink);
+		c8s::diagnostics::set_threshold(threshold);
+	}
+
+	// Select the interpreter of the debugger.
+	c8s::Engine engine = c8s::Engine::Cached;
+	auto engine_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'e'; });
+	if (engine_flag != flags.end() && !c8s::parse_engine(engine_flag->param, engine))
+	{
+		c8s::diagnostics::error([&] { return "Unknown engine `" + engine_flag->param + "`!"; });
+		return EXIT_FAILURE;
+	}
+	// Select the machine, SUPER-CHIP programs expect its quirks unless others are given.
+	c8s::Target target = c8s::Target::Chip8;
+	auto target_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'T'; });
+	if (target_flag != flags.end() && !c8s::parse_target(target_flag->param, target))
+	{
+		c8s::diagnostics::error([&] { return "Unknown target `" + target_flag->param + "`!"; });
+		return EXIT_FAILURE;
+	}
+	c8s::Quirks quirks = (target == c8s::Target::Schip) ? c8s::Quirks::Schip : (target == c8s::Target::XoChip) ? c8s::Quirks::XoChip : c8s::Quirks::Chip8;
+	auto quirks_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'Q'; });
+	if (quirks_flag != flags.end() && !c8s::parse_quirks(quirks_flag->param, quirks))
+	{
+		c8s::diagnostics::error([&] { return "Unknown quirks `" + quirks_flag->param + "`!"; });
+		return EXIT_FAILURE;
+	}
+	const bool is_sanitized = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'S'; }) != flags.end();
+
+	// Answer a question about a recorded trace. The input file is the trace.
+	auto query_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'B'; });
+	if (query_flag != flags.end())
+	{
+		c8s::TraceAnalyzer analyzer;
+		if (flags.back().token != 'i' || !analyzer.load(flags.back().param))
+		{
+			c8s::diagnostics::error("Unable to read the trace");
+			return EXIT_FAILURE;
+		}
+		if (!analyzer.query(query_flag->param, std::cout))
+		{
+			c8s::diagnostics::error([&] { return "Unknown trace query `" + query_flag->param + "`"; });
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// Write the assembly of a ROM. The input file is the ROM.
+	auto disassemble_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'D'; });
+	if (disassemble_flag != flags.end())
+	{
+		std::ifstream rom_ifs{ flags.back().param, std::ios::binary };
+		if (flags.back().token != 'i' || !rom_ifs.is_open())
+		{
+			c8s::diagnostics::error("Unable to read the ROM");
+			return EXIT_FAILURE;
+		}
+		const std::vector<c8s::u8> rom{ std::istreambuf_iterator<char>{ rom_ifs }, std::istreambuf_iterator<char>{} };
+		const std::string assembly = c8s::disassemble(rom, target);
+		if (disassemble_flag->param.empty())
+		{
+			c8s::diagnostics::flush();
+			std::cout << assembly;
+			return EXIT_SUCCESS;
+		}
+		std::ofstream ofs{ disassemble_flag->param };
+		if (!ofs.is_open() || !(ofs << assembly))
+		{
+			c8s::diagnostics::error("Unable to write the assembly");
+			return EXIT_FAILURE;
+		}
+		c8s::diagnostics::info([&] { return "Assembly written to `" + disassemble_flag->param + "`"; });
+		return EXIT_SUCCESS;
+	}
+
+	// Read the input file.
+	if (flags.back().token != 'i' || flags.back().param.empty())
+	{
+		c8s::diagnostics::error("No input specified!");
+		return EXIT_FAILURE;
+	}
+	std::ifstream ifs{ flags.back().param };
+	if (!ifs.is_open())
+	{
+		c8s::diagnostics::error("Could not open input-file!");
+		return EXIT_FAILURE;
+	}
+	std::string line{};
+	std::string code_input{};
+	while (std::getline(ifs, line))
+	{
+		code_input += (line + '\n');
+	}
+
+	// Measure the compiler phases if a time report was requested.
+	auto report_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'r'; });
+	c8s::CompileStats stats;
+	c8s::CompileStats* stats_ptr = (report_flag != flags.end()) ? &stats : nullptr;
+
+	// Compile, or assemble the input if asked to.
+	const bool is_assemble = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'A'; }) != flags.end();
+	c8s::diagnostics::info(is_assemble ? "Starting to assemble.." : "Starting to compile..");
+	c8s::LineTable line_table;
+	std::vector<c8s::u8> assembled;
+	std::vector<c8s::u16> compiler_output;
+	if (is_assemble)
+	{
+		assembled = c8s::assemble(code_input, target);
+		for (const auto& err_line : c8s::compiler_log::read_errors())
+			c8s::diagnostics::error([&] { return err_line; });
+		for (std::size_t j = 0; j < assembled.size(); j += 2)
+			compiler_output.push_back(c8s::u16(assembled[j] << 8 | (j + 1 < assembled.size() ? assembled[j + 1] : 0)));
+	}
+	else compiler_output = c8s::compile(code_input, !is_silent, !is_silent && is_print_steps, stats_ptr, &line_table, target);
+
+	// Check for errors in compiler result.
+	if (compiler_output.empty())
+	{
+		c8s::diagnostics::error("Failed...");
+		return EXIT_FAILURE;
+	}
+	else c8s::diagnostics::info("Finished!");
+
+	// Write result to output.
+	auto out_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'o'; });
+	std::string out_file = (out_flag != flags.end() && !out_flag->param.empty()) ? out_flag->param : "out.c8s";
+	if (is_assemble)
+	{
+		// An assembled ROM may end in a single byte.
+		std::ofstream rom_ofs{ out_file, std::ios::binary };
+		rom_ofs.write(reinterpret_cast<const char*>(assembled.data()), std::streamsize(assembled.size()));
+	}
+	else c8s::write_opcodes_to_file(compiler_output, out_file, stats_ptr);
+	c8s::diagnostics::info([&] { return "Output written to `" + out_file + "`"; });
+
+	// Write the source lines of the ROM next to it, for the debugger.
+	const std::string lines_file = out_file + ".lines";
+	if (!line_table.save(lines_file))
+		c8s::diagnostics::warning([&] { return "Unable to write the line table to `" + lines_file + "`"; });
+
+	// Write the listing with the cycles of every instruction and block.
+	auto listing_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'L'; });
+	if (listing_flag != flags.end())
+	{
+		c8s::CostModel model = c8s::uniform_cost_model();
+		auto cost_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'C'; });
+		if (cost_flag != flags.end())
+		{
+			// The spec is a file if one of that name exists.
+			std::string spec = cost_flag->param;
+			std::ifstream spec_ifs{ spec };
+			if (spec_ifs.is_open()) spec.assign(std::istreambuf_iterator<char>{ spec_ifs }, std::istreambuf_iterator<char>{});
+			if (!c8s::parse_cost_model(spec, model))
+			{
+				c8s::diagnostics::error([&] { return "Invalid cost model `" + cost_flag->param + "`, expected items like DXYN=4"; });
+				return EXIT_FAILURE;
+			}
+		}
+		auto budget_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'F'; });
+		const std::uint64_t frame_budget = (budget_flag != flags.end()) ? std::strtoull(budget_flag->param.c_str(), nullptr, 10) : 0;
+		if (budget_flag != flags.end() && frame_budget == 0)
+		{
+			c8s::diagnostics::error("The frame budget must be at least one cycle");
+			return EXIT_FAILURE;
+		}
+
+		std::vector<c8s::u8> rom = assembled;
+		if (!is_assemble)
+		{
+			for (auto op : compiler_output)
+			{
+				rom.push_back(op >> 8);
+				rom.push_back(op & 0xFF);
+			}
+		}
+		const c8s::CycleEstimate estimate = c8s::estimate_cycles(rom, model, target, frame_budget);
+		for (const c8s::CodeBlock& block : estimate.blocks)
+		{
+			if (block.over_budget)
+				c8s::diagnostics::warning([&] { return c8s::describe_code_block(block, line_table) + " may take " + c8s::format_cycles(block.trips != 0 ? block.cycles : block.pass)
+					+ " cycles" + (block.trips != 0 ? "" : " per iteration") + ", over the frame budget of " + std::to_string(frame_budget); });
+		}
+		if (listing_flag->param.empty())
+		{
+			c8s::diagnostics::flush();
+			c8s::print_listing(std::cout, rom, estimate, model, line_table, code_input, target);
+		}
+		else
+		{
+			std::ofstream ofs{ listing_flag->param };
+			c8s::print_listing(ofs, rom, estimate, model, line_table, code_input, target);
+			if (!ofs)
+			{
+				c8s::diagnostics::error("Unable to write the listing");
+				return EXIT_FAILURE;
+			}
+			c8s::diagnostics::info([&] { return "Listing written to `" + listing_flag->param + "`"; });
+		}
+	}
+
+	// Translate the ROM into C++.
+	auto recompile_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'c'; });
+	if (recompile_flag != flags.end())
+	{
+		if (target != c8s::Target::Chip8)
+		{
+			c8s::diagnostics::error("The recompiler only translates CHIP-8 ROMs");
+			return EXIT_FAILURE;
+		}
+		if (quirks != c8s::Quirks::Chip8 || is_sanitized)
+		{
+			c8s::diagnostics::error("Recompiled ROMs always use the CHIP-8 quirks and have no sanitizer, remove --quirks and --sanitize");
+			return EXIT_FAILURE;
+		}
+		std::vector<c8s::u8> rom;
+		for (auto op : compiler_output)
+		{
+			rom.push_back(op >> 8);
+			rom.push_back(op & 0xFF);
+		}
+		std::ofstream ofs{ recompile_flag->param };
+		if (recompile_flag->param.empty() || !ofs.is_open() || !c8s::recompile_to_cpp(rom, ofs))
+		{
+			c8s::diagnostics::error("Unable to recompile the ROM");
+			return EXIT_FAILURE;
+		}
+		c8s::diagnostics::info([&] { return "Recompiled ROM written to `" + recompile_flag->param + "`"; });
+	}
+
+	// Print the time report, or write it to a file so the JSON doesn't mix with other output.
+	if (stats_ptr && report_flag->param.empty())
+	{
+		c8s::diagnostics::flush();
+		stats.print_table(std::cout);
+	}
+	else if (stats_ptr)
+	{
+		std::ofstream ofs{ report_flag->param };
+		stats.print_json(ofs);
+		if (!ofs)
+		{
+			c8s::diagnostics::error("Unable to write the time report");
+			return EXIT_FAILURE;
+		}
+		c8s::diagnostics::info([&] { return "Time report written to `" + report_flag->param + "`"; });
+	}
+
+	// The CPU runs this many instructions per 60 Hz timer tick.
+	auto ipf_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'f'; });
+	unsigned instructions_per_frame = INSTRUCTIONS_PER_FRAME;
+	if (ipf_flag != flags.end())
+	{
+		instructions_per_frame = unsigned(std::strtoul(ipf_flag->param.c_str(), nullptr, 10));
+		if (instructions_per_frame == 0 || instructions_per_frame > 0xFFFF)
+		{
+			c8s::diagnostics::error("Instructions per frame must be between 1 and 65535");
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Show the display while running, in Braille by default.
+	auto display_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'g'; });
+	c8s::DisplayGlyphs glyphs = c8s::DisplayGlyphs::Braille;
+	if (display_flag != flags.end() && !display_flag->param.empty() && !c8s::parse_display_glyphs(display_flag->param, glyphs))
+	{
+		c8s::diagnostics::error([&] { return "Unknown display `" + display_flag->param + "`, expected blocks or braille"; });
+		return EXIT_FAILURE;
+	}
+
+	auto keys_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'k'; });
+	auto capture_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'a'; });
+	auto golden_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'z'; });
+
+	// Seed the random generator and record the input if requested.
+	auto seed_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'n'; });
+	std::uint64_t seed = (seed_flag != flags.end()) ? std::strtoull(seed_flag->param.c_str(), nullptr, 10) : c8s::default_seed();
+	auto record_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'q'; });
+	c8s::InputRecorder recorder{ seed };
+	auto save_recording = [&](const c8s::Chip8Debugger& debugger)
+	{
+		if (record_flag == flags.end())
+			return true;
+		if (record_flag->param.empty() || !recorder.finish(debugger).save(record_flag->param))
+		{
+			c8s::diagnostics::error("Unable to write the input log");
+			return false;
+		}
+		c8s::diagnostics::info([&] { return "Input log written to `" + record_flag->param + "`"; });
+		return true;
+	};
+
+	// Count the executed instructions if a profile was requested.
+	auto profile_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'p'; });
+	c8s::Profiler profiler;
+	auto print_profile = [&]()
+	{
+		if (profile_flag == flags.end())
+			return true;
+		c8s::diagnostics::flush();
+		profiler.printReport(std::cout, line_table);
+		if (profile_flag->param.empty())
+			return true;
+		std::ofstream ofs{ profile_flag->param };
+		profiler.printFolded(ofs, line_table);
+		if (!ofs)
+		{
+			c8s::diagnostics::error("Unable to write the folded stacks");
+			return false;
+		}
+		c8s::diagnostics::info([&] { return "Folded stacks written to `" + profile_flag->param + "`"; });
+		return true;
+	};
+
+	// Write a binary trace of the executed instructions if requested.
+	auto trace_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'b'; });
+	c8s::TraceRecorder trace_recorder;
+	auto start_trace = [&](c8s::Chip8Debugger& debugger)
+	{
+		if (trace_flag == flags.end())
+			return true;
+		if (!trace_recorder.open(trace_flag->param))
+		{
+			c8s::diagnostics::error([&] { return "Unable to write the trace `" + trace_flag->param + "`"; });
+			return false;
+		}
+		debugger.setTracer(&trace_recorder);
+		return true;
+	};
+	auto finish_trace = [&]()
+	{
+		if (trace_flag == flags.end())
+			return true;
+		if (!trace_recorder.close())
+		{
+			c8s::diagnostics::error("Unable to write the trace");
+			return false;
+		}
+		c8s::diagnostics::info([&] { return "Trace of " + std::to_string(trace_recorder.records()) + " records written to `" + trace_flag->param + "`"; });
+		return true;
+	};
+
+	auto print_run_report = [](const c8s::Chip8Debugger& debugger, c8s::StopReason reason, double seconds)
+	{
+		c8s::diagnostics::flush();
+		std::cout << "Executed " << debugger.cycles() << " instructions in " << seconds * 1000.0 << " ms ("
+			<< (seconds > 0.0 ? debugger.cycles() / seconds : 0.0) << " instructions/s)\n";
+		std::cout << "Stopped at 0x" << std::hex << debugger.pc() << std::dec << ": " << c8s::stop_reason_name(reason) << '\n';
+		std::cout << "State hash: 0x" << std::hex << debugger.stateHash() << std::dec << '\n';
+	};
+
+	// Repeat a recorded run without any interaction.
+	auto replay_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'y'; });
+	if (replay_flag != flags.end())
+	{
+		c8s::InputLog log;
+		if (!log.load(replay_flag->param))
+		{
+			c8s::diagnostics::error("Unable to read the input log");
+			return EXIT_FAILURE;
+		}
+		// The log knows the machine it was recorded on, flags may only repeat it.
+		if (!log.recordedWith(target_flag != flags.end() ? target : log.target, quirks_flag != flags.end() ? quirks : log.quirks, is_sanitized || log.sanitize))
+		{
+			c8s::diagnostics::error("The input log was recorded with another --target, --quirks or --sanitize, remove them to replay it");
+			return EXIT_FAILURE;
+		}
+		c8s::Chip8Debugger debugger;
+		debugger.setEngine(engine);
+		c8s::InputPlayer player{ log };
+		player.attach(debugger);
+		auto run_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'x'; });
+		std::uint64_t budget = player.budget();
+		if (budget == 0)
+			budget = (run_flag == flags.end() || run_flag->param.empty()) ? DEFAULT_RUN_BUDGET : std::strtoull(run_flag->param.c_str(), nullptr, 10);
+		if (!debugger.loadRom(out_file))
+		{
+			c8s::diagnostics::error("Unable to run the ROM");
+			return EXIT_FAILURE;
+		}
+
+		// A recorded wait for a key spans several runs, the log presses the key that ends it.
+		auto start = std::chrono::steady_clock::now();
+		auto reason = debugger.run(budget);
+		while (reason == c8s::StopReason::WaitingForKey && debugger.cycles() < budget)
+			reason = debugger.run(budget - debugger.cycles());
+		print_run_report(debugger, reason, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		if (!player.matches(debugger))
+		{
+			std::cout << "Replay diverged from the recording at cycle " << player.divergedAt() << '\n';
+			return EXIT_FAILURE;
+		}
+		std::cout << "Replay matches the recording\n";
+		return EXIT_SUCCESS;
+	}
+
+	// Run the ROM headless at full host speed, or paced at 60 frames per second.
+	auto run_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'x'; });
+	if (run_flag != flags.end())
+	{
+		c8s::SchedulerConfig schedule;
+		schedule.instructionsPerFrame = instructions_per_frame;
+		schedule.realtime = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'u'; }) != flags.end();
+
+		// Real time runs 10 seconds by default.
+		std::uint64_t budget = schedule.realtime ? std::uint64_t(10) * TIMER_HZ * instructions_per_frame : DEFAULT_RUN_BUDGET;
+		if (!run_flag->param.empty()) budget = std::strtoull(run_flag->param.c_str(), nullptr, 10);
+		c8s::Chip8Debugger debugger;
+		c8s::FrameScheduler scheduler{ debugger, schedule };
+		debugger.setEngine(engine);
+		debugger.setTarget(target);
+		debugger.setQuirks(quirks);
+		debugger.setSanitizer(is_sanitized);
+		debugger.setSeed(seed);
+		if (record_flag != flags.end()) debugger.setInput(&recorder);
+		if (profile_flag != flags.end()) debugger.setProfiler(&profiler);
+		if (!start_trace(debugger))
+			return EXIT_FAILURE;
+		if (engine == c8s::Engine::Jit && !c8s::attach_jit(debugger))
+			c8s::diagnostics::warning("The JIT is not available on this host, falling back to the interpreter");
+		if (budget == 0 || !debugger.loadRom(out_file))
+		{
+			c8s::diagnostics::error("Unable to run the ROM");
+			return EXIT_FAILURE;
+		}
+
+		// Feed the keypad from the terminal or a file.
+		std::unique_ptr<c8s::KeySource> keys;
+		if (keys_flag != flags.end())
+		{
+			keys = c8s::open_key_source(keys_flag->param);
+			if (!keys)
+			{
+				c8s::diagnostics::error([&] { return keys_flag->param.empty() ? std::string{ "Unable to read keys from the terminal" } : "Unable to read the keys `" + keys_flag->param + "`"; });
+				return EXIT_FAILURE;
+			}
+			scheduler.setKeySource(keys.get());
+		}
+
+		// Real time redraws the changed rows after every frame, headless shows the last frame.
+		c8s::TerminalDisplay screen{ glyphs };
+		const bool show_frames = display_flag != flags.end() && schedule.realtime;
+		if (show_frames) std::cout << "\x1b[2J";
+
+		// Hash every frame into `<dir>/frames.log` next to an image of each distinct frame,
+		// and compare the hashes with a golden log while they come in.
+		c8s::FrameCapture capture{ capture_flag != flags.end() ? capture_flag->param : "" };
+		std::ofstream frame_log;
+		std::ifstream golden;
+		if (capture_flag != flags.end())
+		{
+			std::error_code error;
+			std::filesystem::create_directories(capture_flag->param, error);
+			frame_log.open(capture_flag->param + "/frames.log");
+			if (!frame_log)
+			{
+				c8s::diagnostics::error([&] { return "Unable to write the frame log into `" + capture_flag->param + "`"; });
+				return EXIT_FAILURE;
+			}
+			capture.setLog(&frame_log);
+		}
+		if (golden_flag != flags.end())
+		{
+			golden.open(golden_flag->param);
+			if (!golden)
+			{
+				c8s::diagnostics::error([&] { return "Unable to read the golden log `" + golden_flag->param + "`"; });
+				return EXIT_FAILURE;
+			}
+			capture.setGolden(&golden);
+		}
+		const bool capture_frames = capture_flag != flags.end() || golden_flag != flags.end();
+		if (show_frames || capture_frames)
+		{
+			scheduler.setFrameCallback([&](const c8s::Chip8Debugger& d)
+			{
+				if (show_frames) screen.draw(std::cout, d.display(), d.displayWidth(), d.displayHeight());
+				if (capture_frames) capture.capture(d);
+			});
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto reason = scheduler.run(budget);
+		if (keys && !keys->error().empty())
+			c8s::diagnostics::warning([&] { return "Stopped reading keys at " + keys->error(); });
+		keys.reset();
+		if (display_flag != flags.end() && !schedule.realtime)
+			screen.print(std::cout, debugger.display(), debugger.displayWidth(), debugger.displayHeight());
+		print_run_report(debugger, reason, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		scheduler.printReport(std::cout);
+		if (show_frames)
+			std::cout << "Redrew " << screen.rowsDrawn() << " text rows in " << scheduler.frames() << " frames\n";
+		if (capture_flag != flags.end())
+		{
+			std::cout << "Captured " << capture.frames() << " frames, " << capture.distinctFrames() << " distinct, into `" << capture_flag->param << "`\n";
+			if (capture.writeFailed()) c8s::diagnostics::warning("Some frame images could not be written");
+		}
+		if (golden_flag != flags.end())
+		{
+			const bool matches = capture.finishGolden();
+			capture.printDivergence(std::cout);
+			if (!matches)
+				return EXIT_FAILURE;
+		}
+		return finish_trace() && print_profile() && save_recording(debugger) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Attach debugger to output file.
+	bool is_debug = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'd'; }) != flags.end();
+	if (is_debug)
+	{
+		// Load ROM into debugger.
+		c8s::Chip8Debugger debugger;
+		debugger.setEngine(engine);
+		debugger.setTarget(target);
+		debugger.setQuirks(quirks);
+		debugger.setSanitizer(is_sanitized);
+		debugger.setSeed(seed);
+		debugger.setInstructionsPerFrame(instructions_per_frame);
+		if (record_flag != flags.end()) debugger.setInput(&recorder);
+		if (profile_flag != flags.end()) debugger.setProfiler(&profiler);
+		if (!start_trace(debugger))
+			return EXIT_FAILURE;
+		if (!debugger.loadRom(out_file))
+		{
+			c8s::diagnostics::error("Debugger unable to load the ROM");
+			return EXIT_FAILURE;
+		}
+		if (!debugger.loadLineTable(lines_file))
+			c8s::diagnostics::warning([&] { return "Unable to read the line table `" + lines_file + "`, source lines are not shown"; });
+
+		// Record the session to step backward.
+		auto rewind_flag = std::find_if(flags.begin(), flags.end(), [](c8s::Flag f) { return f.token == 'w'; });
+		c8s::RewindConfig rewind_config;
+		if (rewind_flag != flags.end() && !rewind_flag->param.empty())
+			rewind_config.journalBytes = std::strtoull(rewind_flag->param.c_str(), nullptr, 10) * 1024;
+		c8s::RewindJournal journal{ debugger, rewind_config };
+
+		// Run debug process.
+		c8s::diagnostics::info("Start debugging..");
+		c8s::diagnostics::info("Press <return> to step to the next instruction");
+		c8s::diagnostics::info("Enter `c` to continue to the next breakpoint, `break <address> [if <condition>]`, `watch <address> [<length>]`, "
+			"`break line <line>`, `watch <register>` or `stop <condition>` to add one, `list` to show and `delete <id>` to remove them");
+		c8s::diagnostics::info("Enter `n` to run to the next source statement, `key <k> [up]` to press or release a key");
+		c8s::ConsoleTracer tracer;
+		c8s::BreakpointSet breakpoints;
+		debugger.setBreakpoints(&breakpoints);
+		tracer.setBreakpoints(&breakpoints);
+		tracer.setKeypad(&debugger);
+		if (rewind_flag != flags.end())
+		{
+			c8s::diagnostics::info("Enter `b` to step back, `g <cycle>` to jump to a cycle, `m` to show the journal size");
+			debugger.setJournal(&journal);
+			tracer.setJournal(&journal);
+		}
+		c8s::diagnostics::flush();
+		debugger.setObserver(&tracer);
+		while (true)
+		{
+			const c8s::Resume resume = tracer.takeResume();
+			if (resume == c8s::Resume::Step)
+			{
+				if (!debugger.runCycle() && debugger.stopReason() != c8s::StopReason::WaitingForKey) break;
+				continue;
+			}
+
+			// Run at full speed without the tracer until a breakpoint or the next statement is reached.
+			debugger.setObserver(nullptr);
+			auto reason = (resume == c8s::Resume::Continue) ? debugger.run(UINT64_MAX) : debugger.stepLine(UINT64_MAX);
+			debugger.setObserver(&tracer);
+			if (reason != c8s::StopReason::Breakpoint && reason != c8s::StopReason::LineReached && reason != c8s::StopReason::WaitingForKey)
+			{
+				tracer.onStop(debugger, reason);
+				break;
+			}
+			tracer.onBreak(debugger);
+		}
+		if (rewind_flag != flags.end()) tracer.printUsage(journal.usage());
+		if (!finish_trace() || !print_profile() || !save_recording(debugger))
+			return EXIT_FAILURE;
+	}
+	
+	c8s::diagnostics::info("Success!");
+	c8s::diagnostics::flush();
+	if (!is_silent) std::cin.get();
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <array>
+
+#include "target.hpp"
+#include "types.hpp"
+
+namespace c8s
+{
+	// One instruction of the table. An opcode matches if `opcode & mask == pattern`. The operands
+	// are named like the assembler syntax: `Vx`, `Vy`, `byte`, `n`, `planes` (the X nibble), `addr`
+	// and `long` (the next word) take their value from the opcode, every other word is written as is.
+	struct OpcodeInfo
+	{
+		u16 mask;
+		u16 pattern;
+		Target target;				// First target that knows the instruction.
+		const char* name;			// Like `8XY7`.
+		const char* mnemonic;
+		const char* operands;
+		const char* description;	// `{x}`, `{y}`, `{n}`, `{kk}` and `{nnn}` are replaced by the fields.
+	};
+
+	// Sorted by the highest nibble. `F000 NNNN` is the only instruction with a second word.
+	constexpr OpcodeInfo OPCODE_TABLE[] =
+	{
+		{ 0xFFFF, 0x00E0, Target::Chip8, "00E0", "CLS", "", "Clear the screen" },
+		{ 0xFFFF, 0x00EE, Target::Chip8, "00EE", "RET", "", "Return from a subroutine" },
+		{ 0xFFF0, 0x00C0, Target::Schip, "00CN", "SCD", "n", "Scroll the display down by {n} rows" },
+		{ 0xFFF0, 0x00D0, Target::XoChip, "00DN", "SCU", "n", "Scroll the display up by {n} rows" },
+		{ 0xFFFF, 0x00FB, Target::Schip, "00FB", "SCR", "", "Scroll the display right by 4 pixels" },
+		{ 0xFFFF, 0x00FC, Target::Schip, "00FC", "SCL", "", "Scroll the display left by 4 pixels" },
+		{ 0xFFFF, 0x00FD, Target::Schip, "00FD", "EXIT", "", "Exit the program" },
+		{ 0xFFFF, 0x00FE, Target::Schip, "00FE", "LOW", "", "Switch to the 64x32 display" },
+		{ 0xFFFF, 0x00FF, Target::Schip, "00FF", "HIGH", "", "Switch to the 128x64 display" },
+		{ 0xF000, 0x1000, Target::Chip8, "1NNN", "JP", "addr", "Jump to location {nnn}" },
+		{ 0xF000, 0x2000, Target::Chip8, "2NNN", "CALL", "addr", "Call subroutine at {nnn}" },
+		{ 0xF000, 0x3000, Target::Chip8, "3XNN", "SE", "Vx, byte", "Skip next instruction if V[{x}] = {kk}" },
+		{ 0xF000, 0x4000, Target::Chip8, "4XNN", "SNE", "Vx, byte", "Skip next instruction if V[{x}] != {kk}" },
+		{ 0xF00F, 0x5000, Target::Chip8, "5XY0", "SE", "Vx, Vy", "Skip next instruction if V[{x}] = V[{y}]" },
+		{ 0xF00F, 0x5002, Target::XoChip, "5XY2", "SAVE", "Vx, Vy", "Store registers V[{x}] -> V[{y}] in memory starting at location `I`" },
+		{ 0xF00F, 0x5003, Target::XoChip, "5XY3", "LOAD", "Vx, Vy", "Read registers V[{x}] -> V[{y}] from memory starting at location `I`" },
+		{ 0xF000, 0x6000, Target::Chip8, "6XNN", "LD", "Vx, byte", "Set V[{x}] = {kk}" },
+		{ 0xF000, 0x7000, Target::Chip8, "7XNN", "ADD", "Vx, byte", "Set V[{x}] += {kk}" },
+		{ 0xF00F, 0x8000, Target::Chip8, "8XY0", "LD", "Vx, Vy", "Set V[{x}] = V[{y}]" },
+		{ 0xF00F, 0x8001, Target::Chip8, "8XY1", "OR", "Vx, Vy", "Set V[{x}] |= V[{y}]" },
+		{ 0xF00F, 0x8002, Target::Chip8, "8XY2", "AND", "Vx, Vy", "Set V[{x}] &= V[{y}]" },
+		{ 0xF00F, 0x8003, Target::Chip8, "8XY3", "XOR", "Vx, Vy", "Set V[{x}] ^= V[{y}]" },
+		{ 0xF00F, 0x8004, Target::Chip8, "8XY4", "ADD", "Vx, Vy", "Set V[{x}] += V[{y}], set V[F] = carry" },
+		{ 0xF00F, 0x8005, Target::Chip8, "8XY5", "SUB", "Vx, Vy", "Set V[{x}] -= V[{y}], set V[F] = NOT borrow" },
+		{ 0xF00F, 0x8006, Target::Chip8, "8XY6", "SHR", "Vx, Vy", "Set V[{x}] >>= 1" },
+		{ 0xF00F, 0x8007, Target::Chip8, "8XY7", "SUBN", "Vx, Vy", "Set V[{x}] = V[{y}] - V[{x}], set V[F] = NOT borrow" },
+		{ 0xF00F, 0x800E, Target::Chip8, "8XYE", "SHL", "Vx, Vy", "Set V[{x}] <<= 1" },
+		{ 0xF00F, 0x9000, Target::Chip8, "9XY0", "SNE", "Vx, Vy", "Skip next instruction if V[{x}] != V[{y}]" },
+		{ 0xF000, 0xA000, Target::Chip8, "ANNN", "LD", "I, addr", "Set I = {nnn}" },
+		{ 0xF000, 0xB000, Target::Chip8, "BNNN", "JP", "V0, addr", "Jump to location {nnn} + V[0]" },
+		{ 0xF000, 0xC000, Target::Chip8, "CXNN", "RND", "Vx, byte", "Set V[{x}] = rand() & {kk}" },
+		{ 0xF000, 0xD000, Target::Chip8, "DXYN", "DRW", "Vx, Vy, n", "Display {n}-byte sprite from location `I` at (V[{x}], V[{y}]), set V[F] = collision" },
+		{ 0xF0FF, 0xE09E, Target::Chip8, "EX9E", "SKP", "Vx", "Skip next instruction if key with value of V[{x}] is pressed" },
+		{ 0xF0FF, 0xE0A1, Target::Chip8, "EXA1", "SKNP", "Vx", "Skip next instruction if key with value of V[{x}] is not pressed" },
+		{ 0xFFFF, 0xF000, Target::XoChip, "F000", "LD", "I, long", "Set I = the next 16 bits" },
+		{ 0xF0FF, 0xF001, Target::XoChip, "FN01", "PLANE", "planes", "Select the bit planes {x} for drawing" },
+		{ 0xFFFF, 0xF002, Target::XoChip, "F002", "AUDIO", "", "Load the audio pattern from location `I`" },
+		{ 0xF0FF, 0xF007, Target::Chip8, "FX07", "LD", "Vx, DT", "Set V[{x}] = delay timer value" },
+		{ 0xF0FF, 0xF00A, Target::Chip8, "FX0A", "LD", "Vx, K", "Wait for a key press, store the value of the key in V[{x}]" },
+		{ 0xF0FF, 0xF015, Target::Chip8, "FX15", "LD", "DT, Vx", "Set delay timer = V[{x}]" },
+		{ 0xF0FF, 0xF018, Target::Chip8, "FX18", "LD", "ST, Vx", "Set sound timer = V[{x}]" },
+		{ 0xF0FF, 0xF01E, Target::Chip8, "FX1E", "ADD", "I, Vx", "Set I += V[{x}]" },
+		{ 0xF0FF, 0xF029, Target::Chip8, "FX29", "LD", "F, Vx", "Set I = Location of sprite for digit V[{x}]" },
+		{ 0xF0FF, 0xF030, Target::Schip, "FX30", "LD", "HF, Vx", "Set I = Location of the big sprite for digit V[{x}]" },
+		{ 0xF0FF, 0xF033, Target::Chip8, "FX33", "LD", "B, Vx", "Store BCD representation of V[{x}] in memory locations I, I+1, I+2" },
+		{ 0xF0FF, 0xF03A, Target::XoChip, "FX3A", "PITCH", "Vx", "Set the audio pitch = V[{x}]" },
+		{ 0xF0FF, 0xF055, Target::Chip8, "FX55", "LD", "[I], Vx", "Store registers V[0] -> V[{x}] in memory starting at location `I`" },
+		{ 0xF0FF, 0xF065, Target::Chip8, "FX65", "LD", "Vx, [I]", "Read registers V[0] -> V[{x}] from memory starting at location `I`" },
+		{ 0xF0FF, 0xF075, Target::Schip, "FX75", "LD", "R, Vx", "Store registers V[0] -> V[{x}] in the flag registers" },
+		{ 0xF0FF, 0xF085, Target::Schip, "FX85", "LD", "Vx, R", "Read registers V[0] -> V[{x}] from the flag registers" }
+	};
+
+	constexpr unsigned OPCODE_COUNT = sizeof(OPCODE_TABLE) / sizeof(OPCODE_TABLE[0]);
+
+	// Index of the first table entry of every highest nibble, so a lookup only scans its group.
+	constexpr std::array<u8, 17> opcode_groups()
+	{
+		std::array<u8, 17> groups{};
+		unsigned entry = 0;
+		for (unsigned nibble = 0; nibble <= 16; ++nibble)
+		{
+			while (entry < OPCODE_COUNT && (OPCODE_TABLE[entry].pattern >> 12) < nibble) ++entry;
+			groups[nibble] = u8(entry);
+		}
+		return groups;
+	}
+	constexpr std::array<u8, 17> OPCODE_GROUPS = opcode_groups();
+
+	// The table entry of `opcode` on `target`, or nullptr if it isn't an instruction there.
+	const OpcodeInfo* find_opcode(u16 opcode, Target target)
+	{
+		const unsigned nibble = opcode >> 12;
+		for (unsigned entry = OPCODE_GROUPS[nibble]; entry < OPCODE_GROUPS[nibble + 1]; ++entry)
+		{
+			const OpcodeInfo& info = OPCODE_TABLE[entry];
+			if ((opcode & info.mask) == info.pattern && info.target <= target)
+				return &info;
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,230 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "debugger.hpp"
+#include "line-table.hpp"
+
+namespace c8s
+{
+	// An instruction and how often it ran.
+	struct AddressCount
+	{
+		u16 address;
+		std::uint64_t executed;
+		std::uint64_t taken;	// Skips and jumps that left the straight path.
+	};
+
+	// A loop found through a backward jump from `tail` to `head`.
+	struct LoopCount
+	{
+		u16 head;
+		u16 tail;
+		std::uint64_t iterations;	// Taken backward jumps.
+		std::uint64_t executed;		// Instructions executed in [head, tail].
+	};
+
+	// Counts every executed instruction of a debugger per address, the taken skips and jumps,
+	// the backward jumps of loops and the instructions per call stack. Attach it with
+	// `Chip8Debugger::setProfiler`, detached it costs nothing.
+	class Profiler : public ExecutionCounter
+	{
+		// One node of the call tree. Node 0 is the program itself.
+		struct Frame
+		{
+			unsigned parent;
+			u16 function;
+			std::uint64_t executed;
+		};
+
+		std::vector<std::uint64_t> m_executed;
+		std::vector<std::uint64_t> m_taken;
+		std::unordered_map<std::uint32_t, std::uint64_t> m_backJumps;	// tail << 16 | head.
+		std::vector<Frame> m_frames;
+		std::map<std::pair<unsigned, u16>, unsigned> m_children;
+		unsigned m_frame;
+		std::uint64_t m_instructions;
+
+	public:
+		Profiler() { reset(); }
+
+		void reset()
+		{
+			m_executed.assign(MEMORY_SIZE, 0);
+			m_taken.assign(MEMORY_SIZE, 0);
+			m_backJumps.clear();
+			m_frames.assign(1, Frame{ 0, PROGRAM_START, 0 });
+			m_children.clear();
+			m_frame = 0;
+			m_instructions = 0;
+		}
+
+		void onExecuted(u16 pc, u16 instruction, u16 next_pc) override
+		{
+			pc %= MEMORY_SIZE;
+			++m_executed[pc];
+			++m_frames[m_frame].executed;
+			++m_instructions;
+			if (next_pc == pc + 2)
+				return;
+
+			++m_taken[pc];
+			if ((instruction & 0xF000) == 0x2000) enter(next_pc);
+			else if (instruction == 0x00EE) m_frame = m_frames[m_frame].parent;
+			else if (next_pc <= pc) ++m_backJumps[std::uint32_t(pc) << 16 | next_pc];
+		}
+
+		std::uint64_t instructions() const { return m_instructions; }
+		std::uint64_t executed(unsigned address) const { return m_executed[address % MEMORY_SIZE]; }
+		std::uint64_t taken(unsigned address) const { return m_taken[address % MEMORY_SIZE]; }
+
+		// All executed addresses, most executed first.
+		std::vector<AddressCount> hotspots() const
+		{
+			std::vector<AddressCount> counts;
+			for (unsigned address = 0; address < MEMORY_SIZE; ++address)
+				if (m_executed[address] != 0) counts.push_back(AddressCount{ u16(address), m_executed[address], m_taken[address] });
+			std::stable_sort(counts.begin(), counts.end(), [](const AddressCount& a, const AddressCount& b) { return a.executed > b.executed; });
+			return counts;
+		}
+
+		// All loops, the ones that executed the most instructions first.
+		std::vector<LoopCount> loops() const
+		{
+			std::vector<LoopCount> counts;
+			for (const auto& jump : m_backJumps)
+			{
+				LoopCount loop{ u16(jump.first & 0xFFFF), u16(jump.first >> 16), jump.second, 0 };
+				for (unsigned address = loop.head; address <= loop.tail; ++address) loop.executed += m_executed[address];
+				counts.push_back(loop);
+			}
+			std::sort(counts.begin(), counts.end(), [](const LoopCount& a, const LoopCount& b) {
+				return a.executed != b.executed ? a.executed > b.executed : a.head < b.head;
+			});
+			return counts;
+		}
+
+		// Executed instructions per source line, most executed first.
+		std::vector<std::pair<unsigned, std::uint64_t>> lines(const LineTable& table) const
+		{
+			std::map<unsigned, std::uint64_t> per_line;
+			for (unsigned address = 0; address < MEMORY_SIZE; ++address)
+				if (m_executed[address] != 0) per_line[table.lineAt(address)] += m_executed[address];
+			std::vector<std::pair<unsigned, std::uint64_t>> counts{ per_line.begin(), per_line.end() };
+			std::stable_sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+			return counts;
+		}
+
+		// Print the `limit` hottest addresses, loops and source lines. Lines are left out if `table` is empty.
+		void printReport(std::ostream& os, const LineTable& table, std::size_t limit = 10) const
+		{
+			auto old_flags = os.flags();
+			auto percent = [&](std::uint64_t count) { return m_instructions == 0 ? 0.0 : 100.0 * count / m_instructions; };
+			os << std::dec << "Profiled " << m_instructions << " instructions\n";
+
+			os << "\n  address     executed        %        taken  line\n";
+			const std::vector<AddressCount> addresses = hotspots();
+			for (std::size_t j = 0; j < addresses.size() && j < limit; ++j)
+			{
+				const AddressCount& count = addresses[j];
+				os << "  0x" << std::hex << std::left << std::setw(6) << count.address << std::right << std::dec
+					<< std::setw(12) << count.executed << std::setw(8) << std::fixed << std::setprecision(2) << percent(count.executed) << '%'
+					<< std::setw(12) << count.taken;
+				if (!table.empty()) os << "  " << table.lineAt(count.address);
+				os << '\n';
+			}
+
+			const std::vector<LoopCount> hot_loops = loops();
+			if (!hot_loops.empty())
+			{
+				os << "\n  loop               iterations     executed        %\n";
+				for (std::size_t j = 0; j < hot_loops.size() && j < limit; ++j)
+				{
+					const LoopCount& loop = hot_loops[j];
+					os << "  0x" << std::hex << loop.head << " - 0x" << std::left << std::setw(9) << loop.tail << std::right << std::dec
+						<< std::setw(12) << loop.iterations << std::setw(13) << loop.executed
+						<< std::setw(8) << std::fixed << std::setprecision(2) << percent(loop.executed) << "%\n";
+				}
+			}
+
+			if (!table.empty())
+			{
+				os << "\n  line     executed        %\n";
+				const auto per_line = lines(table);
+				for (std::size_t j = 0; j < per_line.size() && j < limit; ++j)
+				{
+					os << "  " << std::left << std::setw(6) << per_line[j].first << std::right
+						<< std::setw(11) << per_line[j].second << std::setw(8) << std::fixed << std::setprecision(2) << percent(per_line[j].second) << "%\n";
+				}
+			}
+			os.flags(old_flags);
+		}
+
+		// Print the instructions per call stack in the folded format of flame graph tools,
+		// one `main;sub_0x240;sub_0x260 <count>` line per stack.
+		void printFolded(std::ostream& os, const LineTable& table) const
+		{
+			for (unsigned id = 0; id < m_frames.size(); ++id)
+			{
+				if (m_frames[id].executed == 0)
+					continue;
+				std::vector<std::string> names;
+				for (unsigned frame = id; frame != 0; frame = m_frames[frame].parent)
+					names.push_back(frameName(m_frames[frame].function, table));
+				os << "main";
+				for (auto it = names.rbegin(); it != names.rend(); ++it) os << ';' << *it;
+				os << ' ' << std::dec << m_frames[id].executed << '\n';
+			}
+		}
+
+	private:
+		void enter(u16 function)
+		{
+			auto inserted = m_children.emplace(std::make_pair(m_frame, function), unsigned(m_frames.size()));
+			if (inserted.second) m_frames.push_back(Frame{ m_frame, function, 0 });
+			m_frame = inserted.first->second;
+		}
+
+		static std::string frameName(u16 function, const LineTable& table)
+		{
+			const char* digits = "0123456789abcdef";
+			std::string name = "sub_0x";
+			for (int shift = 8; shift >= 0; shift -= 4) name += digits[(function >> shift) & 0xF];
+			if (!table.empty()) name += " (line " + std::to_string(table.lineAt(function)) + ")";
+			return name;
+		}
+	};
+}
@@ -0,0 +1,184 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+namespace c8s
+{
+	// Relative weights of the statements `generate_program` writes.
+	struct StatementMix
+	{
+		unsigned assign = 4;		// `b = 7`, `b = c`
+		unsigned arithmetic = 4;	// `b += c`, `b += 3`, `b <<= 1` and the bit operations
+		unsigned branch = 2;		// IF blocks
+		unsigned loop = 1;			// FOR blocks
+		unsigned clear = 0;			// `cls()`
+	};
+
+	struct GeneratorOptions
+	{
+		std::uint32_t seed = 1;
+		unsigned statements = 200;	// After the declarations, those in blocks and the IF and FOR lines included.
+		unsigned depth = 3;			// Deepest nesting of blocks.
+		unsigned variables = 6;		// Declared up front, 1 to 16.
+		StatementMix mix;
+		bool endless = false;		// Jump back to the start instead of stopping at the end.
+	};
+
+	// Writes a chip-8 script program that compiles and stops, or loops forever if `endless`. The
+	// same options give the same program on every platform. Variables are named `a` to `p`, the
+	// tokenizer takes no digits in names. Every FOR loop takes three registers of its own below VF,
+	// which arithmetic overwrites. Loops become IF blocks once those run out and inside other loops,
+	// because ENDFOR always steps the counter declared last.
+	std::string generate_program(const GeneratorOptions& options)
+	{
+		std::mt19937 rng{ options.seed };
+		auto below = [&](unsigned n) { return n > 1 ? unsigned(rng() % n) : 0u; };
+		const unsigned variables = options.variables < 1 ? 1 : options.variables > 16 ? 16 : options.variables;
+		unsigned loops_left = variables < 15 ? (15 - variables) / 3 : 0, loops = 0;
+		auto variable = [&] { return std::string(1, char('a' + below(variables))); };
+		auto number = [&] { return std::to_string(below(256)); };
+
+		std::string code;
+		for (unsigned j = 0; j < variables; ++j)
+			code += "VAR " + std::string(1, char('a' + j)) + " = " + number() + "\n";
+
+		const StatementMix& mix = options.mix;
+		const unsigned total = mix.assign + mix.arithmetic + mix.branch + mix.loop + mix.clear;
+		unsigned remaining = options.statements;
+		auto statement = [&](auto&& self, unsigned level, bool in_loop) -> void
+		{
+			const std::string indent(level, '\t');
+			--remaining;
+
+			unsigned pick = below(total == 0 ? 1 : total);
+			const bool can_nest = level < options.depth && remaining > 0;
+			if (total == 0 || pick < mix.assign)
+			{
+				code += indent + variable() + " = " + (below(2) == 0 ? number() : variable()) + "\n";
+				return;
+			}
+			pick -= mix.assign;
+			if (pick < mix.arithmetic)
+			{
+				static const char* const with_variable[] = { "+=", "-=", "|=", "&=", "^=" };
+				switch (below(4))
+				{
+				case 0: code += indent + variable() + " += " + number() + "\n"; break;
+				case 1: code += indent + variable() + (below(2) == 0 ? " <<= " : " >>= ") + std::to_string(1 + below(2)) + "\n"; break;
+				default: code += indent + variable() + " " + with_variable[below(5)] + " " + variable() + "\n"; break;
+				}
+				return;
+			}
+			pick -= mix.arithmetic;
+			if (pick >= mix.branch + mix.loop)
+			{
+				code += indent + "cls()\n";
+				return;
+			}
+
+			// A block, unless it would nest too deep.
+			if (!can_nest)
+			{
+				code += indent + variable() + " = " + number() + "\n";
+				return;
+			}
+			const unsigned body = 1 + below(remaining < 6 ? remaining : 6);
+			if (pick >= mix.branch && loops_left > 0 && !in_loop)
+			{
+				// Counters count up to a multiple of the step, so every loop ends.
+				const std::string counter = std::string("k") + char('a' + loops++);
+				const unsigned step = 1 + below(3), trips = 1 + below(4);
+				--loops_left;
+				code += indent + "FOR " + counter + "=0 TO " + std::to_string(step * trips) + " STEP " + std::to_string(step) + ":\n";
+				for (unsigned j = 0; j < body && remaining > 0; ++j) self(self, level + 1, true);
+				code += indent + "ENDFOR\n";
+				return;
+			}
+			code += indent + "IF " + variable() + (below(2) == 0 ? " == " : " != ") + (below(2) == 0 ? number() : variable()) + ":\n";
+			for (unsigned j = 0; j < body && remaining > 0; ++j) self(self, level + 1, in_loop);
+			code += indent + "ENDIF\n";
+		};
+		while (remaining > 0) statement(statement, 0, false);
+
+		if (options.endless) code += "RAW 1200\n";
+		return code;
+	}
+
+	// A random program for 0x200 of 8 to 47 instructions that are deterministic and stay in bounds.
+	// It mixes instructions the JIT translates, instructions that end a block and writes into the
+	// program. With `stops` it also waits for keys, jumps through `BNNN` and may run into `0000`,
+	// so a run can end early or, recompiled, reach untranslated code.
+	std::vector<u16> generate_rom(std::mt19937& rng, bool stops = false)
+	{
+		auto random = [&](unsigned n) { return unsigned(rng() % n); };
+		const unsigned length = 8 + random(40);
+		std::vector<u16> ops;
+		for (unsigned j = 0; j < length; ++j)
+		{
+			const unsigned x = random(16), y = random(16), kk = random(4) == 0 ? random(4) : random(256);
+			const unsigned target = 0x200 + 2 * random(length);
+			static const unsigned math[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+			switch (random(stops ? 21 : 18))
+			{
+			case 0: case 1: ops.push_back(u16(0x6000 | x << 8 | kk)); break;
+			case 2: case 3: ops.push_back(u16(0x7000 | x << 8 | kk)); break;
+			case 4: case 5: case 6: ops.push_back(u16(0x8000 | x << 8 | y << 4 | math[random(9)])); break;
+			case 7: ops.push_back(u16(0xA000 | (0x200 + random(2 * length)))); break;
+			case 8: ops.push_back(u16(0xF01E | x << 8)); break;
+			case 9: ops.push_back(u16(0xF029 | x << 8)); break;
+			case 10: ops.push_back(u16((random(2) ? 0x3000 : 0x4000) | x << 8 | kk)); break;
+			case 11: ops.push_back(u16((random(2) ? 0x5000 : 0x9000) | x << 8 | y << 4)); break;
+			case 12: ops.push_back(u16(0x1000 | target)); break;
+			case 13: ops.push_back(u16((random(2) ? 0xF033 : 0xF055) | x << 8)); break;
+			case 14:
+			{
+				static const unsigned timers[] = { 0xF015, 0xF018, 0xF007 };
+				ops.push_back(u16(timers[random(3)] | x << 8));
+				break;
+			}
+			case 15: ops.push_back(u16(0xD000 | x << 8 | y << 4 | random(16))); break;
+			case 16: ops.push_back(u16(0xC000 | x << 8 | kk)); break;
+			case 17: ops.push_back(u16(random(2) ? 0x00E0 : 0xF065 | x << 8)); break;
+			case 18: ops.push_back(u16(0xB200 | random(2 * length))); break;
+			case 19: ops.push_back(u16(random(8) == 0 ? 0x0000 : 0x6000 | x << 8 | kk)); break;
+			default:
+			{
+				static const unsigned keys[] = { 0xE09E, 0xE0A1, 0xF00A };
+				ops.push_back(u16(keys[random(3)] | x << 8));
+				break;
+			}
+			}
+		}
+		return ops;
+	}
+}
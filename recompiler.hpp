@@ -0,0 +1,290 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "control-flow.hpp"
+#include "conversion.hpp"
+#include "debugger.hpp"
+
+namespace c8s
+{
+	// Reachable instructions of a ROM and the addresses where basic blocks start.
+	struct ControlFlow
+	{
+		std::vector<bool> reachable;
+		std::vector<bool> leaders;
+	};
+
+	// True if the instruction after `op` has to start a new block. Besides branches these are
+	// the instructions that read or write the timers, write memory or wait for a key, because
+	// a block charges all its instructions against the timers when it is entered.
+	bool ends_block(Op op)
+	{
+		switch (op)
+		{
+		case Op::Jp: case Op::Call: case Op::Ret: case Op::JpV0:
+		case Op::SeByte: case Op::SneByte: case Op::SeReg: case Op::SneReg: case Op::Skp: case Op::Sknp:
+		case Op::End: case Op::Unknown: case Op::LdVxKey:
+		case Op::LdVxDt: case Op::LdDtVx: case Op::LdStVx:
+		case Op::LdBcd: case Op::StoreRegs:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// The blocks of the control flow graph, split further after every instruction that ends a
+	// block here. FX0A starts its own block as well, so a waiting machine can resume at it.
+	ControlFlow recover_control_flow(const u8* memory)
+	{
+		const ControlFlowGraph cfg = build_control_flow_graph(memory);
+		ControlFlow flow{ std::vector<bool>(MEMORY_SIZE, false), std::vector<bool>(MEMORY_SIZE, false) };
+		for (const BasicBlock& block : cfg.blocks)
+		{
+			flow.leaders[block.start] = true;
+			for (unsigned address = block.start; address < block.end; address += 2)
+			{
+				flow.reachable[address] = true;
+				const Op op = decode_instruction(fetch_opcode(memory, address)).op;
+				if (op == Op::LdVxKey) flow.leaders[address] = true;
+				if (ends_block(op) && !is_control_transfer(op) && address + 2 < MEMORY_SIZE) flow.leaders[address + 2] = true;
+			}
+		}
+		return flow;
+	}
+
+	namespace recompiler_detail
+	{
+		std::string hex(unsigned value)
+		{
+			return "0x" + u16_to_hex_string(u16(value));
+		}
+
+		std::string label(unsigned address)
+		{
+			return "L_" + u16_to_hex_string(u16(address));
+		}
+
+		// Statements of all instructions that don't change the control flow.
+		std::string body(const DecodedInstruction& d)
+		{
+			const std::string vx = "m.v[" + hex(d.x) + "]", vy = "m.v[" + hex(d.y) + "]", vf = "m.v[0xf]";
+			switch (d.op)
+			{
+			case Op::Cls: return "m.clearScreen();";
+			case Op::LdByte: return vx + " = " + hex(d.kk) + ";";
+			case Op::AddByte: return vx + " += " + hex(d.kk) + ";";
+			case Op::LdReg: return vx + " = " + vy + ";";
+			case Op::Or: return vx + " |= " + vy + ";";
+			case Op::And: return vx + " &= " + vy + ";";
+			case Op::Xor: return vx + " ^= " + vy + ";";
+			case Op::AddReg: return vf + " = (" + vx + " + " + vy + " > 0xff) ? 1 : 0; " + vx + " += " + vy + ";";
+			case Op::Sub: return vf + " = (" + vx + " > " + vy + ") ? 1 : 0; " + vx + " -= " + vy + ";";
+			case Op::Shr: return vf + " = " + vx + " & 0x1; " + vx + " /= 2;";
+			case Op::Subn: return vf + " = (" + vy + " > " + vx + ") ? 1 : 0; " + vx + " = c8s::u8(" + vy + " - " + vx + ");";
+			case Op::Shl: return vf + " = (" + vx + " & 0x80) != 0 ? 1 : 0; " + vx + " *= 2;";
+			case Op::LdI: return "m.i = " + hex(d.nnn) + ";";
+			case Op::Rnd: return vx + " = " + hex(d.kk) + " & m.random.nextByte();";
+			case Op::Drw: return "m.draw(" + hex(d.x) + ", " + hex(d.y) + ", " + hex(d.kk & 0xF) + ");";
+			case Op::LdVxDt: return vx + " = m.delayTimer;";
+			case Op::LdDtVx: return "m.delayTimer = " + vx + ";";
+			case Op::LdStVx: return "m.soundTimer = " + vx + ";";
+			case Op::AddIVx: return "m.i += " + vx + ";";
+			case Op::LdFVx: return "m.i = c8s::u16(" + vx + " * 5);";
+			case Op::LdBcd: return "m.storeBcd(" + hex(d.x) + ");";
+			case Op::StoreRegs: return "m.storeRegs(" + hex(d.x) + ");";
+			case Op::LoadRegs: return "m.loadRegs(" + hex(d.x) + ");";
+			default: return "";
+			}
+		}
+
+		std::string skip_condition(const DecodedInstruction& d)
+		{
+			const std::string vx = "m.v[" + hex(d.x) + "]", vy = "m.v[" + hex(d.y) + "]";
+			switch (d.op)
+			{
+			case Op::SeByte: return vx + " == " + hex(d.kk);
+			case Op::SneByte: return vx + " != " + hex(d.kk);
+			case Op::SeReg: return vx + " == " + vy;
+			case Op::Skp: return "m.keypad[" + vx + " & 0xf] != 0";
+			case Op::Sknp: return "m.keypad[" + vx + " & 0xf] == 0";
+			default: return vx + " != " + vy;
+			}
+		}
+
+		bool is_skip(Op op)
+		{
+			return op == Op::SeByte || op == Op::SneByte || op == Op::SeReg || op == Op::SneReg || op == Op::Skp || op == Op::Sknp;
+		}
+
+		// Instructions that use the timers see them after all instructions up to and including their own.
+		std::string sync_timers(Op op)
+		{
+			if (op == Op::LdVxDt || op == Op::LdDtVx || op == Op::LdStVx)
+				return "m.tick(timer_mark - budget); timer_mark = budget; ";
+			return "";
+		}
+
+		bool writes_memory(Op op)
+		{
+			return op == Op::LdBcd || op == Op::StoreRegs;
+		}
+	}
+
+	// Translate a ROM into a C++ source file that links against aot-runtime.hpp. Every basic block
+	// becomes a label that charges its length against the budget, the cycle counter and the timers
+	// on entry. Computed jumps (BNNN, RET) go through a switch over all block leaders. Blocks that
+	// don't fit the remaining budget run one instruction at a time, so budgets are exact.
+	bool recompile_to_cpp(const std::vector<u8>& rom, std::ostream& os)
+	{
+		using namespace recompiler_detail;
+
+		if (rom.size() > MEMORY_SIZE - PROGRAM_START)
+			return false;
+
+		u8 memory[MEMORY_SIZE] = {};
+		for (unsigned j = 0; j < FONTSET_SIZE; ++j) memory[j] = FONTSET[j];
+		for (unsigned j = 0; j < rom.size(); ++j) memory[PROGRAM_START + j] = rom[j];
+		const ControlFlow flow = recover_control_flow(memory);
+
+		os << "// Generated by chip8script --recompile. Build with the chip8script sources on the include path.\n";
+		os << "#include \"aot-runtime.hpp\"\n\n";
+		os << "namespace\n{\n\tconst c8s::u8 ROM[] = {";
+		for (unsigned j = 0; j < rom.size(); ++j) os << (j % 16 == 0 ? "\n\t\t" : " ") << hex(rom[j]) << ",";
+		os << "\n\t\t0x0\n\t};\n}\n\n";
+
+		os << "void aot_load(c8s::AotMachine& m)\n{\n";
+		os << "\tm.reset(ROM, " << rom.size() << ");\n";
+		for (unsigned address = 0; address < MEMORY_SIZE; ++address)
+			if (flow.reachable[address]) os << "\tm.markInstruction(" << hex(address) << ");\n";
+		os << "}\n\n";
+
+		// Cycles and timers follow from the consumed budget. They are brought up to date
+		// before instructions that use the timers and when the function returns.
+		os << "c8s::StopReason aot_run(c8s::AotMachine& m, std::uint64_t budget)\n{\n";
+		os << "\tconst std::uint64_t start = budget;\n\tstd::uint64_t timer_mark = budget;\n";
+		os << "\tc8s::StopReason reason;\n\n";
+
+		// Enter translated code at the block that starts at PC.
+		os << "dispatch:\n\tswitch (m.pc)\n\t{\n";
+		for (unsigned address = 0; address < MEMORY_SIZE; ++address)
+			if (flow.leaders[address] && flow.reachable[address]) os << "\tcase " << hex(address) << ": goto " << label(address) << ";\n";
+		os << "\tdefault: if (m.pc >= " << hex(MEMORY_SIZE) << " || !m.instruction[m.pc]) { reason = c8s::StopReason::UntranslatedCode; goto finish; }\n\t}\n\n";
+
+		// Execute the single instruction at PC.
+		os << "step:\n\tif (budget == 0) { reason = c8s::StopReason::BudgetExhausted; goto finish; }\n\t--budget;\n";
+		os << "\tswitch (m.pc)\n\t{\n";
+		for (unsigned address = 0; address < MEMORY_SIZE; ++address)
+		{
+			if (!flow.reachable[address]) continue;
+			const DecodedInstruction d = decode_instruction(fetch_opcode(memory, address));
+			os << "\tcase " << hex(address) << ": ";
+			switch (d.op)
+			{
+			case Op::End: os << "reason = c8s::StopReason::EndOfProgram; goto finish;\n"; continue;
+			case Op::Unknown: os << "reason = c8s::StopReason::UnknownInstruction; goto finish;\n"; continue;
+			case Op::Jp: os << "m.pc = " << hex(d.nnn) << ";"; break;
+			case Op::Call: os << "m.push(" << hex(address) << "); m.pc = " << hex(d.nnn) << ";"; break;
+			case Op::Ret: os << "m.pc = c8s::u16(m.pop() + 2);"; break;
+			case Op::JpV0: os << "m.pc = c8s::u16(" << hex(d.nnn) << " + m.v[0x0]);"; break;
+			case Op::LdVxKey: os << "if (!m.waitKey(" << hex(d.x) << ")) { reason = c8s::StopReason::WaitingForKey; goto finish; }"; break;
+			default:
+				if (is_skip(d.op)) os << "m.pc = (" << skip_condition(d) << ") ? " << hex(address + 4) << " : " << hex(address + 2) << ";";
+				else os << sync_timers(d.op) << body(d) << " m.pc = " << hex(address + 2) << ";";
+				if (writes_memory(d.op)) os << " if (m.codeModified) { reason = c8s::StopReason::UntranslatedCode; goto finish; }";
+				break;
+			}
+			os << " break;\n";
+		}
+		os << "\t}\n\tgoto dispatch;\n\n";
+
+		// One label per basic block.
+		auto jump = [&](unsigned target)
+		{
+			if (target < MEMORY_SIZE && flow.reachable[target]) return "goto " + label(target) + ";";
+			return "m.pc = " + hex(target) + "; goto dispatch;";
+		};
+		for (unsigned start = 0; start < MEMORY_SIZE; ++start)
+		{
+			if (!flow.leaders[start] || !flow.reachable[start]) continue;
+
+			std::vector<DecodedInstruction> block;
+			unsigned address = start;
+			for (;;)
+			{
+				block.push_back(decode_instruction(fetch_opcode(memory, address)));
+				address += 2;
+				if (ends_block(block.back().op) || address >= MEMORY_SIZE || flow.leaders[address]) break;
+			}
+			const DecodedInstruction& last = block.back();
+			const unsigned length = unsigned(block.size()), last_address = start + (length - 1) * 2;
+			
+			os << label(start) << ":\n";
+			os << "\tif (budget < " << length << ") { m.pc = " << hex(start) << "; goto step; }\n";
+			os << "\tbudget -= " << length << ";\n";
+			for (unsigned j = 0; j + 1 < length; ++j) os << "\t" << body(block[j]) << "\n";
+
+			switch (last.op)
+			{
+			case Op::End: os << "\tm.pc = " << hex(last_address) << ";\n\treason = c8s::StopReason::EndOfProgram;\n\tgoto finish;\n"; break;
+			case Op::Unknown: os << "\tm.pc = " << hex(last_address) << ";\n\treason = c8s::StopReason::UnknownInstruction;\n\tgoto finish;\n"; break;
+			case Op::Jp: os << "\t" << jump(last.nnn) << "\n"; break;
+			case Op::Call: os << "\tm.push(" << hex(last_address) << ");\n\t" << jump(last.nnn) << "\n"; break;
+			case Op::Ret: os << "\tm.pc = c8s::u16(m.pop() + 2);\n\tgoto dispatch;\n"; break;
+			case Op::JpV0: os << "\tm.pc = c8s::u16(" << hex(last.nnn) << " + m.v[0x0]);\n\tgoto dispatch;\n"; break;
+			case Op::LdVxKey:
+				os << "\tm.pc = " << hex(last_address) << ";\n";
+				os << "\tif (!m.waitKey(" << hex(last.x) << ")) { reason = c8s::StopReason::WaitingForKey; goto finish; }\n\tgoto dispatch;\n";
+				break;
+			default:
+				if (is_skip(last.op))
+				{
+					os << "\tif (" << skip_condition(last) << ") " << jump(last_address + 4) << "\n";
+					os << "\t" << jump(last_address + 2) << "\n";
+					break;
+				}
+				os << "\t" << sync_timers(last.op) << body(last) << "\n";
+				if (writes_memory(last.op))
+					os << "\tif (m.codeModified) { m.pc = " << hex(last_address + 2) << "; reason = c8s::StopReason::UntranslatedCode; goto finish; }\n";
+				os << "\t" << jump(last_address + 2) << "\n";
+				break;
+			}
+		}
+		// End and unknown instructions consume budget and tick the timers, but don't count as executed.
+		// A FX0A that found no key does.
+		os << "finish:\n\tm.tick(timer_mark - budget);\n";
+		os << "\tm.cycles += (start - budget) - ((reason == c8s::StopReason::EndOfProgram || reason == c8s::StopReason::UnknownInstruction) ? 1 : 0);\n";
+		os << "\treturn reason;\n}\n\n";
+
+		os << "#ifndef C8S_AOT_NO_MAIN\n";
+		os << "int main(int argc, char** argv)\n{\n\treturn c8s::aot_main(argc, argv, aot_load, aot_run);\n}\n";
+		os << "#endif\n";
+		return true;
+	}
+}
@@ -0,0 +1,305 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "binary-file.hpp"
+#include "debugger.hpp"
+
+namespace c8s
+{
+	enum class InputKind : u8
+	{
+		Random,		// CXNN drew `value`.
+		KeyDown,	// Key `value` was pressed.
+		KeyUp,		// Key `value` was released.
+	};
+
+	// A nondeterministic event, stamped with the cycle count at which it happened. Key changes
+	// happen before the instruction of their cycle, random draws during it.
+	struct InputEvent
+	{
+		std::uint64_t cycle;
+		InputKind kind;
+		u8 value;
+	};
+
+	// Everything needed to repeat a run exactly: the machine, the seed, the events and the state at the end.
+	// Stored as "C8IL", a version byte, the seed, the instructions per frame, a byte each for the target, the
+	// quirks and the sanitizer, and the events. Each event is the cycle
+	// delta as LEB128 and a byte with the kind in the upper and the key in the lower nibble,
+	// followed by the value of a random draw. The end marker (kind 0xF) carries the stop
+	// reason in its lower nibble and is followed by the final state hash.
+	struct InputLog
+	{
+		std::uint64_t seed = 0;
+		unsigned instructionsPerFrame = INSTRUCTIONS_PER_FRAME;
+		Target target = Target::Chip8;
+		Quirks quirks = Quirks::Chip8;
+		bool sanitize = false;
+		std::vector<InputEvent> events;
+		bool finished = false;
+		std::uint64_t endCycle = 0;
+		StopReason endReason = StopReason::BudgetExhausted;
+		std::uint64_t endHash = 0;
+
+		std::vector<u8> encode() const
+		{
+			std::vector<u8> bytes = file_header("C8IL", 3);
+			put64(bytes, seed);
+			bytes.push_back(u8(instructionsPerFrame));
+			bytes.push_back(u8(instructionsPerFrame >> 8));
+			bytes.push_back(u8(target));
+			bytes.push_back(u8(quirks));
+			bytes.push_back(sanitize ? 1 : 0);
+			std::uint64_t cycle = 0;
+			for (const InputEvent& event : events)
+			{
+				put_varint(bytes, event.cycle - cycle);
+				cycle = event.cycle;
+				if (event.kind == InputKind::Random)
+				{
+					bytes.push_back(u8(event.kind) << 4);
+					bytes.push_back(event.value);
+				}
+				else bytes.push_back(u8(u8(event.kind) << 4 | (event.value & 0xF)));
+			}
+			if (finished)
+			{
+				put_varint(bytes, endCycle - cycle);
+				bytes.push_back(u8(0xF0 | u8(endReason)));
+				put64(bytes, endHash);
+			}
+			return bytes;
+		}
+
+		// Returns false if `bytes` is not a valid log.
+		bool decode(const std::vector<u8>& bytes)
+		{
+			*this = InputLog{};
+			std::size_t p = FILE_HEADER_SIZE;
+			if (!has_file_header(bytes, "C8IL", 3) || bytes.size() < FILE_HEADER_SIZE + 13)	// The seed, the instructions per frame and the machine.
+				return false;
+			seed = get64(bytes, p);
+			instructionsPerFrame = unsigned(bytes[p] | bytes[p + 1] << 8);
+			p += 2;
+			if (bytes[p] > u8(Target::XoChip) || bytes[p + 1] > u8(Quirks::XoChip) || bytes[p + 2] > 1)
+				return false;
+			target = Target(bytes[p]);
+			quirks = Quirks(bytes[p + 1]);
+			sanitize = bytes[p + 2] != 0;
+			p += 3;
+
+			std::uint64_t cycle = 0;
+			while (p < bytes.size())
+			{
+				std::uint64_t delta;
+				if (!get_varint(bytes, p, delta) || p >= bytes.size())
+					return false;
+				cycle += delta;
+				const u8 tag = bytes[p++];
+				switch (tag >> 4)
+				{
+				case u8(InputKind::Random):
+					if (p >= bytes.size()) return false;
+					events.push_back(InputEvent{ cycle, InputKind::Random, bytes[p++] });
+					break;
+				case u8(InputKind::KeyDown):
+				case u8(InputKind::KeyUp):
+					events.push_back(InputEvent{ cycle, InputKind(tag >> 4), u8(tag & 0xF) });
+					break;
+				case 0xF:
+					if (p + 8 != bytes.size() || (tag & 0xF) > u8(StopReason::BoundsViolation)) return false;
+					finished = true;
+					endCycle = cycle;
+					endReason = StopReason(tag & 0xF);
+					endHash = get64(bytes, p);
+					break;
+				default:
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// True if a debugger with `target`, `quirks` and `sanitize` runs like the recorded one.
+		bool recordedWith(Target otherTarget, Quirks otherQuirks, bool otherSanitize) const
+		{
+			return target == otherTarget && quirks == otherQuirks && sanitize == otherSanitize;
+		}
+
+		bool save(const std::string& fileName) const
+		{
+			return save_bytes(fileName, encode());
+		}
+
+		bool load(const std::string& fileName)
+		{
+			std::vector<u8> bytes;
+			return load_bytes(fileName, bytes) && decode(bytes);
+		}
+
+	private:
+		static void put64(std::vector<u8>& bytes, std::uint64_t value)
+		{
+			for (unsigned j = 0; j < 8; ++j) bytes.push_back(u8(value >> (j * 8)));
+		}
+
+		static std::uint64_t get64(const std::vector<u8>& bytes, std::size_t& p)
+		{
+			std::uint64_t value = 0;
+			for (unsigned j = 0; j < 8; ++j) value |= std::uint64_t(bytes[p++]) << (j * 8);
+			return value;
+		}
+	};
+
+	// Writes the input of a run into an `InputLog`.
+	class InputRecorder : public InputChannel
+	{
+		InputLog m_log;
+
+	public:
+		explicit InputRecorder(std::uint64_t seed) { m_log.seed = seed; }
+
+		void beforeInstruction(Chip8Debugger&) override {}
+
+		u8 random(const Chip8Debugger& debugger, u8 generated) override
+		{
+			// A rewound debugger runs the cycle again, the old future is gone.
+			truncate(debugger.cycles(), true);
+			m_log.events.push_back(InputEvent{ debugger.cycles(), InputKind::Random, generated });
+			return generated;
+		}
+
+		void keyChanged(const Chip8Debugger& debugger, unsigned key, bool pressed) override
+		{
+			truncate(debugger.cycles(), false);
+			m_log.events.push_back(InputEvent{ debugger.cycles(), pressed ? InputKind::KeyDown : InputKind::KeyUp, u8(key) });
+		}
+
+		// Stamp the log with the final state of `debugger` and return it.
+		const InputLog& finish(const Chip8Debugger& debugger)
+		{
+			truncate(debugger.cycles(), false);
+			m_log.finished = true;
+			m_log.instructionsPerFrame = debugger.instructionsPerFrame();
+			m_log.target = debugger.target();
+			m_log.quirks = debugger.quirks();
+			m_log.sanitize = debugger.sanitizer();
+			m_log.endCycle = debugger.cycles();
+			m_log.endReason = debugger.stopReason();
+			m_log.endHash = debugger.stateHash();
+			return m_log;
+		}
+
+		const InputLog& log() const { return m_log; }
+
+	private:
+		void truncate(std::uint64_t cycle, bool including)
+		{
+			while (!m_log.events.empty() && (m_log.events.back().cycle > cycle
+				|| (including && m_log.events.back().cycle == cycle && m_log.events.back().kind == InputKind::Random)))
+				m_log.events.pop_back();
+		}
+	};
+
+	// Feeds the events of an `InputLog` back into a debugger. The random bytes are taken from
+	// the log, so a replay also notices if the program draws at other cycles than recorded.
+	class InputPlayer : public InputChannel
+	{
+		const InputLog& m_log;
+		std::size_t m_next;
+		bool m_diverged;
+		std::uint64_t m_divergedAt;
+
+	public:
+		explicit InputPlayer(const InputLog& log)
+			: m_log{ log }, m_next{ 0 }, m_diverged{ false }, m_divergedAt{ 0 } {}
+
+		// Prepare `debugger` for the replay, before the ROM is loaded.
+		void attach(Chip8Debugger& debugger)
+		{
+			debugger.setTarget(m_log.target);
+			debugger.setQuirks(m_log.quirks);
+			debugger.setSanitizer(m_log.sanitize);
+			debugger.setSeed(m_log.seed);
+			debugger.setInstructionsPerFrame(m_log.instructionsPerFrame);
+			debugger.setInput(this);
+		}
+
+		void beforeInstruction(Chip8Debugger& debugger) override
+		{
+			while (m_next < m_log.events.size() && m_log.events[m_next].kind != InputKind::Random
+				&& m_log.events[m_next].cycle <= debugger.cycles())
+			{
+				const InputEvent& event = m_log.events[m_next++];
+				debugger.setKey(event.value, event.kind == InputKind::KeyDown);
+			}
+		}
+
+		u8 random(const Chip8Debugger& debugger, u8 generated) override
+		{
+			if (m_next < m_log.events.size() && m_log.events[m_next].kind == InputKind::Random && m_log.events[m_next].cycle == debugger.cycles())
+				return m_log.events[m_next++].value;
+			diverge(debugger.cycles());
+			return generated;
+		}
+
+		void keyChanged(const Chip8Debugger&, unsigned, bool) override {}
+
+		// Instruction budget that repeats the recorded run, or 0 if the log has no end. The
+		// instruction a program stopped at takes budget without counting as a cycle.
+		std::uint64_t budget() const
+		{
+			if (!m_log.finished) return 0;
+			const bool stopped = m_log.endReason == StopReason::EndOfProgram || m_log.endReason == StopReason::UnknownInstruction;
+			return m_log.endCycle + (stopped ? 1 : 0);
+		}
+
+		// True if the replay used all events and, for a finished log, ended in the recorded state.
+		bool matches(Chip8Debugger& debugger)
+		{
+			// Keys changed after the last instruction belong to the final state.
+			beforeInstruction(debugger);
+			if (m_next < m_log.events.size())
+				diverge(m_log.events[m_next].cycle);
+			if (m_log.finished && (debugger.cycles() != m_log.endCycle || debugger.stateHash() != m_log.endHash))
+				diverge(debugger.cycles());
+			return !m_diverged;
+		}
+
+		std::uint64_t divergedAt() const { return m_divergedAt; }
+
+	private:
+		void diverge(std::uint64_t cycle)
+		{
+			if (!m_diverged) m_divergedAt = cycle;
+			m_diverged = true;
+		}
+	};
+}
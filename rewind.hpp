@@ -0,0 +1,402 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "debugger.hpp"
+
+namespace c8s
+{
+	static_assert(DISPLAY_PLANES * PLANE_WORDS <= 0x100, "A display word is recorded with a one byte index");
+
+	// Memory limits of a `RewindJournal`.
+	struct RewindConfig
+	{
+		std::size_t journalBytes = 0x100000;	// Ring buffer for the per-instruction deltas.
+		unsigned snapshotInterval = 0x400;		// Instructions between two full snapshots.
+		unsigned maxSnapshots = 0x40;
+	};
+
+	// Memory a `RewindJournal` currently holds.
+	struct RewindUsage
+	{
+		std::size_t journalCapacity;
+		std::size_t journalUsed;
+		std::size_t snapshots;
+		std::size_t snapshotBytes;
+		std::uint64_t oldestCycle;
+		std::uint64_t newestCycle;
+	};
+
+	// Records the old value of everything an instruction changes, so the debugger can step
+	// backward. The records live in a ring buffer that drops the oldest ones when it is full.
+	// A full snapshot is taken every `snapshotInterval` instructions, so jumping to any cycle
+	// restores at most one snapshot and undoes at most `snapshotInterval` records.
+	// Going back discards the history after the target; running again records a new one.
+	class RewindJournal : public ExecutionJournal
+	{
+		enum Tag : u8
+		{
+			TagV = 1,		// index, old value
+			TagI,			// old I
+			TagSp,			// old SP
+			TagStack,		// index, old entry
+			TagMemory,		// address, old byte
+			TagRow,			// word of the display, its old value
+			TagRandom,		// old generator state
+			TagMode,		// old resolution, old plane mask
+			TagFlag			// index, old flag register
+		};
+
+		struct Snapshot
+		{
+			std::uint64_t cycles;
+			std::size_t head;	// Journal head after the last record before the snapshot.
+			std::vector<u8> memory;
+			u8  v[V_REGS_TOTAL];
+			u16 i;
+			u8  delayTimer;
+			u8  soundTimer;
+			std::uint32_t frameCountdown;
+			u16 pc;
+			u8  sp;
+			u16 stack[STACK_SIZE];
+			std::uint64_t display[DISPLAY_PLANES * PLANE_WORDS];
+			bool hires;
+			u8 planeMask;
+			u8 flags[FLAG_REGS_TOTAL];
+			Xoshiro128 random;
+		};
+
+		Chip8Debugger& m_debugger;
+		RewindConfig m_config;
+
+		// Every record is [length][payload][length], so it can be walked from both ends.
+		std::vector<u8> m_ring;
+		std::size_t m_head, m_tail, m_used;
+		std::uint64_t m_oldestCycle;	// Cycle count before the oldest record.
+		std::vector<u8> m_record;		// Record of the running instruction.
+		std::deque<Snapshot> m_snapshots;
+
+	public:
+		RewindJournal(Chip8Debugger& debugger, RewindConfig config = RewindConfig{})
+			: m_debugger{ debugger }, m_config{ config }, m_ring(config.journalBytes < 0x100 ? 0x100 : config.journalBytes)
+		{
+			if (m_config.snapshotInterval == 0) m_config.snapshotInterval = 1;
+			if (m_config.maxSnapshots == 0) m_config.maxSnapshots = 1;
+			reset();
+		}
+
+		void reset() override
+		{
+			m_head = m_tail = m_used = 0;
+			m_oldestCycle = m_debugger.m_cycles;
+			m_record.clear();
+			m_snapshots.clear();
+		}
+
+		void beforeInstruction(const Chip8Debugger& d, const DecodedInstruction& instruction) override
+		{
+			m_record.clear();
+			put16(d.m_pc);
+			m_record.push_back(d.m_delayTimer);
+			m_record.push_back(d.m_soundTimer);
+			put16(u16(d.m_frameCountdown));
+
+			auto v = [&](unsigned index) { put(TagV); put(u8(index)); put(d.m_v[index]); };
+			auto memory = [&](unsigned address) { put(TagMemory); put16(u16(address & d.m_memoryMask)); put(d.m_memory[address & d.m_memoryMask]); };
+			auto row = [&](unsigned index)
+			{
+				put(TagRow);
+				put(u8(index));
+				for (unsigned j = 0; j < 8; ++j) put(u8(d.m_display[index] >> (j * 8)));
+			};
+			auto mode = [&] { put(TagMode); put(d.m_hires ? 1 : 0); put(d.m_planeMask); };
+
+			// Every word of `count` rows from `first` on in the selected planes.
+			auto rows = [&](unsigned first, unsigned count)
+			{
+				const unsigned words = d.rowWords(), height = d.displayHeight();
+				for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+				{
+					if ((d.m_planeMask & (1u << p)) == 0) continue;
+					for (unsigned line = 0; line < count && line < height; ++line)
+						for (unsigned w = 0; w < words; ++w) row(p * PLANE_WORDS + ((first + line) % height) * words + w);
+				}
+			};
+			// The words of the planes in `planes` that are about to be cleared and not empty yet.
+			auto cleared = [&](unsigned planes)
+			{
+				for (unsigned p = 0; p < DISPLAY_PLANES; ++p)
+				{
+					if ((planes & (1u << p)) == 0) continue;
+					for (unsigned j = 0; j < d.rowWords() * d.displayHeight(); ++j)
+						if (d.m_display[p * PLANE_WORDS + j] != 0) row(p * PLANE_WORDS + j);
+				}
+			};
+
+			const DecodedInstruction& in = instruction;
+			switch (in.op)
+			{
+			case Op::Cls: cleared(d.m_planeMask); break;
+			case Op::Ret: put(TagSp); put(d.m_sp); break;
+			case Op::Call:
+				put(TagSp); put(d.m_sp);
+				put(TagStack); put(u8(d.m_sp % STACK_SIZE)); put16(d.m_stack[d.m_sp % STACK_SIZE]);
+				break;
+			case Op::LdByte: case Op::AddByte: case Op::LdReg: case Op::Or: case Op::And: case Op::Xor:
+			case Op::LdVxDt: case Op::LdVxKey:
+				v(in.x);
+				break;
+			case Op::Rnd:
+				v(in.x);
+				put(TagRandom);
+				for (std::uint32_t word : d.m_random.s) { put16(u16(word >> 16)); put16(u16(word)); }
+				break;
+			case Op::AddReg: case Op::Sub: case Op::Shr: case Op::Subn: case Op::Shl: v(in.x); v(0xF); break;
+			case Op::LdI: case Op::AddIVx: case Op::LdFVx: case Op::LdHfVx: case Op::LdILong: put(TagI); put16(d.m_i); break;
+			case Op::Drw:
+				v(0xF);
+				for (unsigned line = 0; line < (in.kk & 0xFu) && line < DISPLAY_H; ++line) row((d.m_v[in.y] + line) % DISPLAY_H);
+				break;
+			case Op::LdBcd: for (unsigned j = 0; j < 3; ++j) memory(d.m_i + j); break;
+			// The COSMAC quirks also move I.
+			case Op::StoreRegs: for (unsigned j = 0; j <= in.x; ++j) memory(d.m_i + j); put(TagI); put16(d.m_i); break;
+			case Op::LoadRegs: for (unsigned j = 0; j <= in.x; ++j) v(j); put(TagI); put16(d.m_i); break;
+			case Op::ScrollDown: case Op::ScrollUp: case Op::ScrollRight: case Op::ScrollLeft: rows(0, d.displayHeight()); break;
+			case Op::Lores: case Op::Hires: mode(); cleared(0x3); break;
+			case Op::Plane: mode(); break;
+			case Op::DrwPlanes:
+				v(0xF);
+				rows(d.m_v[in.y] % d.displayHeight(), (in.kk & 0xFu) == 0 ? 16 : (in.kk & 0xFu));
+				break;
+			case Op::StoreFlags: for (unsigned j = 0; j <= in.x; ++j) { put(TagFlag); put(u8(j)); put(d.m_flags[j]); } break;
+			case Op::LoadFlags: for (unsigned j = 0; j <= in.x; ++j) v(j); break;
+			case Op::SaveRange: for (unsigned j = 0; j <= unsigned(std::max(in.x, in.y) - std::min(in.x, in.y)); ++j) memory(d.m_i + j); break;
+			case Op::LoadRange: for (unsigned j = std::min(in.x, in.y); j <= std::max(in.x, in.y); ++j) v(j); break;
+			default: break;
+			}
+		}
+
+		// Instructions that stopped the program only ticked the timers and are not recorded.
+		void afterInstruction(const Chip8Debugger& d, bool executed) override
+		{
+			if (!executed)
+				return;
+			append();
+			if (d.m_cycles % m_config.snapshotInterval == 0)
+				takeSnapshot();
+		}
+
+		std::uint64_t oldestCycle() const { return m_oldestCycle; }
+		std::uint64_t newestCycle() const { return m_debugger.m_cycles; }
+
+		// Undo the last instruction. Returns false if it was not recorded.
+		bool stepBack()
+		{
+			return newestCycle() > m_oldestCycle && jumpToCycle(newestCycle() - 1);
+		}
+
+		// Restore the state after `cycle` instructions. Returns false if it is not recorded.
+		bool jumpToCycle(std::uint64_t cycle)
+		{
+			if (cycle < m_oldestCycle || cycle > newestCycle())
+				return false;
+			if (cycle == newestCycle())
+				return true;
+
+			// Start from the nearest snapshot after the target, or from the current state.
+			while (!m_snapshots.empty() && m_snapshots.back().cycles > cycle)
+			{
+				const Snapshot& snapshot = m_snapshots.back();
+				const bool nearest = (m_snapshots.size() == 1 || m_snapshots[m_snapshots.size() - 2].cycles <= cycle);
+				if (nearest)
+				{
+					restore(snapshot);
+					m_used -= (m_head + m_ring.size() - snapshot.head) % m_ring.size();
+					m_head = snapshot.head;
+				}
+				m_snapshots.pop_back();
+			}
+			while (newestCycle() > cycle)
+				undo();
+			return true;
+		}
+
+		RewindUsage usage() const
+		{
+			const std::size_t snapshotBytes = sizeof(Snapshot) + m_debugger.m_memory.size();
+			return RewindUsage{ m_ring.size(), m_used, m_snapshots.size(), m_snapshots.size() * snapshotBytes, m_oldestCycle, newestCycle() };
+		}
+
+	private:
+		void put(u8 value) { m_record.push_back(value); }
+		void put16(u16 value) { put(u8(value >> 8)); put(u8(value)); }
+
+		u8 ringAt(std::size_t position) const { return m_ring[position % m_ring.size()]; }
+		u16 ringAt16(std::size_t position) const { return u16(ringAt(position) << 8 | ringAt(position + 1)); }
+		void ringPut(std::size_t& position, u8 value)
+		{
+			m_ring[position] = value;
+			position = (position + 1) % m_ring.size();
+		}
+
+		void dropOldest()
+		{
+			const std::size_t length = ringAt16(m_tail) + 4;
+			m_tail = (m_tail + length) % m_ring.size();
+			m_used -= length;
+			++m_oldestCycle;
+		}
+
+		void append()
+		{
+			const std::size_t length = m_record.size() + 4;
+			if (length > m_ring.size() || m_record.size() > 0xFFFF)
+			{
+				// Too large for the journal, the history ends here.
+				reset();
+				return;
+			}
+			while (m_used + length > m_ring.size())
+				dropOldest();
+
+			ringPut(m_head, u8(m_record.size() >> 8));
+			ringPut(m_head, u8(m_record.size()));
+			for (u8 byte : m_record) ringPut(m_head, byte);
+			ringPut(m_head, u8(m_record.size() >> 8));
+			ringPut(m_head, u8(m_record.size()));
+			m_used += length;
+
+			// Snapshots older than the history are useless.
+			while (!m_snapshots.empty() && m_snapshots.front().cycles < m_oldestCycle)
+				m_snapshots.pop_front();
+		}
+
+		// Apply the newest record backward.
+		void undo()
+		{
+			Chip8Debugger& d = m_debugger;
+			const std::size_t size = m_ring.size();
+			const std::size_t length = ringAt16(m_head + size - 2);
+			const std::size_t start = (m_head + size - 2 - length) % size;
+
+			std::size_t p = start;
+			d.m_pc = ringAt16(p); p += 2;
+			d.m_delayTimer = ringAt(p++);
+			d.m_soundTimer = ringAt(p++);
+			d.m_frameCountdown = ringAt16(p); p += 2;
+			while ((p + size - start) % size < length)
+			{
+				switch (ringAt(p++))
+				{
+				case TagV: d.m_v[ringAt(p) & 0xF] = ringAt(p + 1); p += 2; break;
+				case TagI: d.m_i = ringAt16(p); p += 2; break;
+				case TagSp: d.m_sp = ringAt(p++); break;
+				case TagStack: d.m_stack[ringAt(p) % STACK_SIZE] = ringAt16(p + 1); p += 3; break;
+				case TagMemory: d.writeMemory(ringAt16(p), ringAt(p + 2)); p += 3; break;
+				case TagMode: d.m_hires = ringAt(p) != 0; d.m_planeMask = ringAt(p + 1); p += 2; break;
+				case TagFlag: d.m_flags[ringAt(p) % FLAG_REGS_TOTAL] = ringAt(p + 1); p += 2; break;
+				case TagRandom:
+					for (unsigned j = 0; j < 4; ++j) d.m_random.s[j] = std::uint32_t(ringAt16(p + j * 4)) << 16 | ringAt16(p + j * 4 + 2);
+					p += 16;
+					break;
+				case TagRow:
+				{
+					std::uint64_t row = 0;
+					for (unsigned j = 0; j < 8; ++j) row |= std::uint64_t(ringAt(p + 1 + j)) << (j * 8);
+					d.m_display[ringAt(p)] = row;
+					p += 9;
+					break;
+				}
+				default: p = start + length; break;
+				}
+			}
+
+			--d.m_cycles;
+			m_head = (start + size - 2) % size;
+			m_used -= length + 4;
+		}
+
+		void takeSnapshot()
+		{
+			const Chip8Debugger& d = m_debugger;
+			m_snapshots.emplace_back();
+			Snapshot& snapshot = m_snapshots.back();
+			snapshot.cycles = d.m_cycles;
+			snapshot.head = m_head;
+			snapshot.memory = d.m_memory;
+			std::memcpy(snapshot.v, d.m_v, sizeof(snapshot.v));
+			std::memcpy(snapshot.stack, d.m_stack, sizeof(snapshot.stack));
+			std::memcpy(snapshot.display, d.m_display, sizeof(snapshot.display));
+			std::memcpy(snapshot.flags, d.m_flags, sizeof(snapshot.flags));
+			snapshot.hires = d.m_hires;
+			snapshot.planeMask = d.m_planeMask;
+			snapshot.i = d.m_i;
+			snapshot.delayTimer = d.m_delayTimer;
+			snapshot.soundTimer = d.m_soundTimer;
+			snapshot.frameCountdown = d.m_frameCountdown;
+			snapshot.pc = d.m_pc;
+			snapshot.sp = d.m_sp;
+			snapshot.random = d.m_random;
+
+			// The oldest cycles are only reachable while the snapshot after them exists.
+			if (m_snapshots.size() > m_config.maxSnapshots)
+			{
+				const std::uint64_t floor = m_snapshots.front().cycles;
+				m_snapshots.pop_front();
+				while (m_oldestCycle < floor && m_used > 0)
+					dropOldest();
+			}
+		}
+
+		void restore(const Snapshot& snapshot)
+		{
+			Chip8Debugger& d = m_debugger;
+			d.m_memory = snapshot.memory;
+			std::memcpy(d.m_v, snapshot.v, sizeof(snapshot.v));
+			std::memcpy(d.m_stack, snapshot.stack, sizeof(snapshot.stack));
+			std::memcpy(d.m_display, snapshot.display, sizeof(snapshot.display));
+			std::memcpy(d.m_flags, snapshot.flags, sizeof(snapshot.flags));
+			d.m_hires = snapshot.hires;
+			d.m_planeMask = snapshot.planeMask;
+			d.m_i = snapshot.i;
+			d.m_delayTimer = snapshot.delayTimer;
+			d.m_soundTimer = snapshot.soundTimer;
+			d.m_frameCountdown = snapshot.frameCountdown;
+			d.m_pc = snapshot.pc;
+			d.m_sp = snapshot.sp;
+			d.m_random = snapshot.random;
+			d.m_cycles = snapshot.cycles;
+			d.invalidateDecodeCache();
+			if (d.m_jit) d.m_jit->reset();
+		}
+	};
+}
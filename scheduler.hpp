@@ -0,0 +1,265 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "debugger.hpp"
+#include "keypad.hpp"
+
+namespace c8s
+{
+	// Distribution of frame times in buckets of 0.1 ms up to 50 ms, plus one for everything longer.
+	class FrameTimeHistogram
+	{
+		static const unsigned BUCKETS = 500;
+		static constexpr double BUCKET_MS = 0.1;
+
+		std::vector<std::uint64_t> m_buckets;
+		std::uint64_t m_count;
+		double m_total, m_min, m_max;
+
+	public:
+		FrameTimeHistogram() { reset(); }
+
+		void reset()
+		{
+			m_buckets.assign(BUCKETS + 1, 0);
+			m_count = 0;
+			m_total = m_max = 0.0;
+			m_min = 0.0;
+		}
+
+		void add(double milliseconds)
+		{
+			const unsigned bucket = milliseconds < 0.0 ? 0 : unsigned(std::min(milliseconds / BUCKET_MS, double(BUCKETS)));
+			++m_buckets[bucket];
+			m_min = (m_count == 0) ? milliseconds : std::min(m_min, milliseconds);
+			m_max = std::max(m_max, milliseconds);
+			m_total += milliseconds;
+			++m_count;
+		}
+
+		std::uint64_t count() const { return m_count; }
+		double mean() const { return m_count == 0 ? 0.0 : m_total / m_count; }
+		double min() const { return m_min; }
+		double max() const { return m_max; }
+
+		// Upper end of the bucket that holds the `fraction` quantile, e.g. 0.99, at most the maximum.
+		double percentile(double fraction) const
+		{
+			const std::uint64_t rank = std::uint64_t(fraction * m_count);
+			std::uint64_t seen = 0;
+			for (unsigned j = 0; j < BUCKETS; ++j)
+			{
+				seen += m_buckets[j];
+				if (seen > rank) return std::min((j + 1) * BUCKET_MS, m_max);
+			}
+			return m_max;
+		}
+
+		// One line of statistics, then a bar per used bucket.
+		void print(std::ostream& os, const std::string& name) const
+		{
+			auto old_flags = os.flags();
+			auto old_precision = os.precision();
+			os << std::fixed << std::setprecision(3) << name << ": " << std::dec << m_count << " frames, mean " << mean()
+				<< " ms, min " << m_min << " ms, p50 " << percentile(0.5) << " ms, p99 " << percentile(0.99) << " ms, max " << m_max << " ms\n";
+
+			std::uint64_t largest = 0;
+			for (std::uint64_t count : m_buckets) largest = std::max(largest, count);
+			for (unsigned j = 0; j <= BUCKETS; ++j)
+			{
+				if (m_buckets[j] == 0)
+					continue;
+				os << "  " << std::setprecision(1) << std::setw(5) << j * BUCKET_MS << (j == BUCKETS ? "+ ms " : " ms  ")
+					<< std::setw(8) << m_buckets[j] << ' ' << std::string(std::size_t(1 + 49 * m_buckets[j] / largest), '#') << '\n';
+			}
+			os.flags(old_flags);
+			os.precision(old_precision);
+		}
+	};
+
+	struct SchedulerConfig
+	{
+		unsigned instructionsPerFrame = INSTRUCTIONS_PER_FRAME;
+		bool realtime = true;	// Pace the frames at 60 Hz, or run as fast as possible.
+		std::chrono::microseconds spin{ 1500 };	// Busy wait for the last part of a frame, sleep before.
+	};
+
+	// Runs a debugger frame by frame: `instructionsPerFrame` instructions, then the timers tick.
+	// In real-time mode every frame starts 1/60 s after the previous one. The wait sleeps until
+	// shortly before the deadline and spins for the rest, because sleeping alone wakes up too late.
+	// Headless runs the frames back to back, or the whole budget in one go without a frame callback
+	// or key source. Key events are applied before the frame they are due in. A machine that waits
+	// for a key idles through the rest of its frame and then sleeps: headless until input arrives
+	// if no event is known, in real time until the next frame is due or a key wakes it up early.
+	class FrameScheduler
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		Chip8Debugger& m_debugger;
+		SchedulerConfig m_config;
+		std::function<void(const Chip8Debugger&)> m_onFrame;
+		KeySource* m_keys;
+		std::vector<KeyEvent> m_events;
+		FrameTimeHistogram m_frameTimes;	// From the start of one frame to the start of the next.
+		FrameTimeHistogram m_workTimes;		// Spent executing instructions.
+		std::uint64_t m_frames;
+		std::uint64_t m_lateFrames;
+
+	public:
+		FrameScheduler(Chip8Debugger& debugger, SchedulerConfig config = SchedulerConfig{})
+			: m_debugger{ debugger }, m_config{ config }, m_keys{ nullptr }, m_frames{ 0 }, m_lateFrames{ 0 }
+		{
+			m_debugger.setInstructionsPerFrame(m_config.instructionsPerFrame);
+		}
+
+		// Called after every frame, including the one the machine stopped in, e.g. to show the display.
+		void setFrameCallback(std::function<void(const Chip8Debugger&)> onFrame) { m_onFrame = std::move(onFrame); }
+		void setKeySource(KeySource* keys) { m_keys = keys; }
+
+		StopReason run(std::uint64_t max_instructions)
+		{
+			const unsigned frame = m_debugger.instructionsPerFrame();
+			if (!m_config.realtime && !m_onFrame && !m_keys)
+			{
+				const std::uint64_t start = m_debugger.cycles();
+				const StopReason reason = m_debugger.run(max_instructions);
+				m_frames += (m_debugger.cycles() - start + frame - 1) / frame;
+				return reason;
+			}
+
+			const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / TIMER_HZ));
+			Clock::time_point frame_start = Clock::now();
+			Clock::time_point deadline = frame_start + period;
+			StopReason reason = StopReason::BudgetExhausted;
+			while (max_instructions > 0)
+			{
+				applyKeys();
+				const std::uint64_t budget = std::min<std::uint64_t>(frame, max_instructions);
+				max_instructions -= budget;
+				const std::uint64_t start = m_debugger.cycles();
+				reason = m_debugger.run(budget);
+				if (reason == StopReason::WaitingForKey)
+					m_debugger.idle(budget - (m_debugger.cycles() - start));
+				if (m_config.realtime) m_workTimes.add(milliseconds(Clock::now() - frame_start));
+				++m_frames;
+				if (m_onFrame) m_onFrame(m_debugger);
+				if (reason == StopReason::WaitingForKey)
+				{
+					// Nothing can end the wait any more.
+					if (!m_keys || m_keys->finished())
+						break;
+					if (!m_config.realtime)
+					{
+						if (!m_keys->pending()) m_keys->wait(-1);
+						continue;
+					}
+
+					// A key that arrives before the deadline starts the next frame at once.
+					const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+					if (timeout.count() > 0 && m_keys->wait(int(timeout.count())))
+					{
+						const Clock::time_point now = Clock::now();
+						m_frameTimes.add(milliseconds(now - frame_start));
+						frame_start = now;
+						deadline = now + period;
+						continue;
+					}
+				}
+				else if (reason != StopReason::BudgetExhausted)
+					break;
+				if (!m_config.realtime)
+					continue;
+
+				waitUntil(deadline);
+				const Clock::time_point now = Clock::now();
+				m_frameTimes.add(milliseconds(now - frame_start));
+				frame_start = now;
+
+				// Catch up on a late frame, but start over after falling behind a lot.
+				deadline += period;
+				if (now > deadline + 4 * period)
+				{
+					++m_lateFrames;
+					deadline = now + period;
+				}
+			}
+			return reason;
+		}
+
+		std::uint64_t frames() const { return m_frames; }
+		const FrameTimeHistogram& frameTimes() const { return m_frameTimes; }
+		const FrameTimeHistogram& workTimes() const { return m_workTimes; }
+
+		void printReport(std::ostream& os) const
+		{
+			os << std::dec << "Emulated " << m_frames << " frames of " << m_debugger.instructionsPerFrame() << " instructions at " << TIMER_HZ << " Hz";
+			if (!m_config.realtime)
+			{
+				os << " (headless)\n";
+				return;
+			}
+			os << ", " << m_lateFrames << " times fell behind\n";
+			m_frameTimes.print(os, "frame time");
+			m_workTimes.print(os, "work time");
+		}
+
+	private:
+		void applyKeys()
+		{
+			if (!m_keys)
+				return;
+			m_events.clear();
+			m_keys->poll(m_frames, m_events);
+			for (const KeyEvent& event : m_events) m_debugger.setKey(event.key, event.pressed);
+		}
+
+		static double milliseconds(Clock::duration duration)
+		{
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+
+		void waitUntil(Clock::time_point deadline) const
+		{
+			const Clock::time_point now = Clock::now();
+			if (deadline - now > m_config.spin)
+				std::this_thread::sleep_for(deadline - now - m_config.spin);
+			while (Clock::now() < deadline)
+			{
+			}
+		}
+	};
+}
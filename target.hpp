@@ -0,0 +1,58 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <string>
+
+#include "types.hpp"
+
+namespace c8s
+{
+	// Machines the compiler and the debugger can target.
+	enum class Target
+	{
+		Chip8,	// 4 KB of memory and a 64x32 display.
+		Schip,	// SUPER-CHIP 1.1: adds the 128x64 hires mode, scrolling, 16x16 sprites and the big font.
+		XoChip	// XO-CHIP: SUPER-CHIP plus 64 KB of memory, two bitplanes and `F000 NNNN`.
+	};
+
+	// Returns false if `name` is not a known target.
+	bool parse_target(const std::string& name, Target& target)
+	{
+		if (name == "chip8") target = Target::Chip8;
+		else if (name == "schip") target = Target::Schip;
+		else if (name == "xochip") target = Target::XoChip;
+		else return false;
+		return true;
+	}
+
+	// Bytes of memory of the target, PC and I wrap around at its end. Jumps and calls only have
+	// 12 bits, so on XO-CHIP code above 4 KB is only reached by running on from below it.
+	unsigned target_memory_size(Target target)
+	{
+		return target == Target::XoChip ? 0x10000 : 0x1000;
+	}
+}
@@ -0,0 +1,187 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#include "debugger.hpp"
+
+namespace c8s
+{
+	// How the pixels are packed into terminal cells.
+	enum class DisplayGlyphs
+	{
+		HalfBlock,	// 1x2 pixels per cell, 64x16 cells (128x32 in hires).
+		Braille		// 2x4 pixels per cell, 32x8 cells (64x16 in hires).
+	};
+
+	// Returns false if `name` is neither "blocks" nor "braille".
+	bool parse_display_glyphs(const std::string& name, DisplayGlyphs& glyphs)
+	{
+		if (name == "blocks") glyphs = DisplayGlyphs::HalfBlock;
+		else if (name == "braille") glyphs = DisplayGlyphs::Braille;
+		else return false;
+		return true;
+	}
+
+	// Draws the display into an ANSI terminal. Each frame is compared with the one on screen
+	// by its packed rows (one std::uint64_t per pixel row, two in hires, see `draw_sprite_words`),
+	// and only text rows with a changed pixel are redrawn behind a cursor move. An unchanged
+	// frame costs one compare per word and writes nothing.
+	class TerminalDisplay
+	{
+		DisplayGlyphs m_glyphs;
+		unsigned m_top, m_left;			// Terminal position of the upper left cell, 1-based.
+		std::uint64_t m_shown[HIRES_H * 2];	// What the terminal currently shows.
+		unsigned m_width, m_height;		// Pixels of the frame on screen.
+		bool m_valid;
+		std::string m_out;
+		std::uint64_t m_rowsDrawn;
+
+	public:
+		TerminalDisplay(DisplayGlyphs glyphs = DisplayGlyphs::Braille, unsigned top = 1, unsigned left = 1)
+			: m_glyphs{ glyphs }, m_top{ top }, m_left{ left }, m_shown{}, m_width{ DISPLAY_W }, m_height{ DISPLAY_H }, m_valid{ false }, m_rowsDrawn{ 0 } {}
+
+		unsigned cellHeight() const { return m_glyphs == DisplayGlyphs::Braille ? 4 : 2; }
+		unsigned rows() const { return m_height / cellHeight(); }
+		unsigned columns() const { return m_glyphs == DisplayGlyphs::Braille ? m_width / 2 : m_width; }
+
+		// Text rows written since construction, to see how much a run redrew.
+		std::uint64_t rowsDrawn() const { return m_rowsDrawn; }
+
+		// Redraw every row on the next frame, e.g. after the screen was cleared.
+		void invalidate() { m_valid = false; }
+
+		// Escape sequences that bring the terminal from the last frame to `display` of `width` x
+		// `height` pixels, empty if nothing changed. The cursor is left on the line below the display.
+		const std::string& update(const std::uint64_t* display, unsigned width = DISPLAY_W, unsigned height = DISPLAY_H)
+		{
+			m_out.clear();
+			resize(width, height);
+			const unsigned words = cellHeight() * (m_width / 64);
+			for (unsigned row = 0; row < rows(); ++row)
+			{
+				const std::uint64_t* source = display + row * words;
+				std::uint64_t* shown = m_shown + row * words;
+				if (m_valid && std::memcmp(source, shown, words * sizeof(std::uint64_t)) == 0)
+					continue;
+				std::memcpy(shown, source, words * sizeof(std::uint64_t));
+				moveTo(m_top + row, m_left);
+				appendRow(source);
+				++m_rowsDrawn;
+			}
+			m_valid = true;
+			if (!m_out.empty())
+				moveTo(m_top + rows(), 1);
+			return m_out;
+		}
+
+		// Write the changes to `os`. Returns false if there were none.
+		bool draw(std::ostream& os, const std::uint64_t* display, unsigned width = DISPLAY_W, unsigned height = DISPLAY_H)
+		{
+			const std::string& out = update(display, width, height);
+			if (out.empty())
+				return false;
+			os.write(out.data(), out.size());
+			os.flush();
+			return true;
+		}
+
+		// Print the whole display as plain lines at the current cursor position.
+		void print(std::ostream& os, const std::uint64_t* display, unsigned width = DISPLAY_W, unsigned height = DISPLAY_H)
+		{
+			m_out.clear();
+			resize(width, height);
+			for (unsigned row = 0; row < rows(); ++row)
+			{
+				appendRow(display + row * cellHeight() * (m_width / 64));
+				m_out += '\n';
+			}
+			os.write(m_out.data(), m_out.size());
+		}
+
+	private:
+		// A new resolution redraws everything and erases what the old one left below.
+		void resize(unsigned width, unsigned height)
+		{
+			if (width == m_width && height == m_height)
+				return;
+			if (m_valid)
+			{
+				moveTo(m_top, 1);
+				m_out += "\x1b[J";
+			}
+			m_width = width;
+			m_height = height;
+			m_valid = false;
+		}
+
+		void moveTo(unsigned row, unsigned column)
+		{
+			m_out += "\x1b[";
+			m_out += std::to_string(row);
+			m_out += ';';
+			m_out += std::to_string(column);
+			m_out += 'H';
+		}
+
+		// Append one text row made from the `cellHeight()` pixel rows at `source`.
+		void appendRow(const std::uint64_t* source)
+		{
+			const unsigned words = m_width / 64;
+			if (m_glyphs == DisplayGlyphs::HalfBlock)
+			{
+				for (unsigned x = 0; x < m_width; ++x)
+				{
+					const unsigned top = (source[x / 64] >> (63 - x % 64)) & 0x1;
+					const unsigned bottom = (source[words + x / 64] >> (63 - x % 64)) & 0x1;
+					if (top == 0 && bottom == 0) m_out += ' ';
+					else m_out += (top && bottom) ? "\xE2\x96\x88" : (top ? "\xE2\x96\x80" : "\xE2\x96\x84");	// U+2588, U+2580, U+2584.
+				}
+				return;
+			}
+
+			// A Braille cell is U+2800 plus one bit per dot, numbered down the left column
+			// (0x01, 0x02, 0x04, 0x40) and then down the right one (0x08, 0x10, 0x20, 0x80).
+			static const unsigned left[4] = { 0x01, 0x02, 0x04, 0x40 };
+			static const unsigned right[4] = { 0x08, 0x10, 0x20, 0x80 };
+			for (unsigned x = 0; x < m_width; x += 2)
+			{
+				unsigned dots = 0;
+				for (unsigned y = 0; y < 4; ++y)
+				{
+					const unsigned pair = (source[y * words + x / 64] >> (62 - x % 64)) & 0x3;
+					dots |= ((pair & 0x2) ? left[y] : 0) | ((pair & 0x1) ? right[y] : 0);
+				}
+				m_out += char(0xE2);
+				m_out += char(0xA0 | (dots >> 6));
+				m_out += char(0x80 | (dots & 0x3F));
+			}
+		}
+	};
+}
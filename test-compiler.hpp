@@ -1,148 +1,1426 @@
-﻿/*
-* MIT License
-*
-* Copyright(c) 2018 Paul Bernitz
-*
-* Permission is hereby granted, free of charge, to any person obtaining a copy
-* of this software and associated documentation files(the "Software"), to deal
-* in the Software without restriction, including without limitation the rights
-* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-* copies of the Software, and to permit persons to whom the Software is
-* furnished to do so, subject to the following conditions :
-*
-* The above copyright notice and this permission notice shall be included in all
-* copies or substantial portions of the Software.
-*
-* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
-* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-* SOFTWARE.
-*/
-
-#pragma once
-
-#include "debug-output.hpp" 
-#include "compiler.hpp"
-
-namespace c8s
-{
-	// Run all tests.
-	bool run_tests()
-	{
-		if (
-			build_opcode("8XY3", 0, 0, 0x1, 0x2) != "8123" ||
-			build_opcode("1NNN", 0xF4) != "10f4" ||
-			build_opcode("3XNN", 0, 0, 0xA, 0, 0, 0xBB) != "3abb",
-			build_opcode("DXYN", 0, 0x3, 0x1, 0x2) != "d123"
-		) {
-			std::cout << "Failed building opcodes via `build_opcode(mask..)`\n";
-			return false;
-		}
-
-		auto raw_test_output = compile(
-			"VAR a = 10\n"\
-			"VAR b = 10\n"\
-			"RAW 6001\n",
-			true, true
-		);
-
-		if (compiler_log::read_errors().size() != 0
-			|| raw_test_output.size() != 3
-			|| raw_test_output[0] != 0x600A
-			|| raw_test_output[1] != 0x610A
-			|| raw_test_output[2] != 0x6001
-			) {
-			std::cout << "\n\raw_test_output failed!\n";
-			return false;
-		}
-
-		auto for_test_output = compile(
-			"VAR a = 1\n"\
-			"FOR i=4 TO 10 STEP 2:\n"\
-			"	IF a==1:\n"\
-			"		a+=2\n"\
-			"	ENDIF\n"\
-			"	a += 1\n"\
-			"ENDFOR\n"\
-			"VAR z=10;",
-			true, true
-		);
-
-		if ( compiler_log::read_errors().size() != 0
-			|| for_test_output.size() != 12
-			|| for_test_output[0] != 0x6001
-			|| for_test_output[1] != 0x6104
-			|| for_test_output[2] != 0x620A
-			|| for_test_output[3] != 0x6302
-			|| for_test_output[4] != 0x3001
-			|| for_test_output[5] != 0x120E
-			|| for_test_output[6] != 0x7002
-			|| for_test_output[7] != 0x7001
-			|| for_test_output[8] != 0x8134
-			|| for_test_output[9] != 0x5120
-			|| for_test_output[10]!= 0x1208
-			|| for_test_output[11]!= 0x640A
-			) {
-			std::cout << "\n\nfor_test_output failed!\n";
-			return false;
-		}
-
-		auto test_output = compile(
-			"VAR a = 4\n"\
-			"VAR b = 2\n"\
-			"IF a == 4:\n"\
-			"	IF a != 4:\n"\
-			"		a = 8\n"\
-			"	ENDIF\n"\
-			"ENDIF\n"\
-			"IF a == 3:\n"\
-			"	IF a != b:\n"\
-			"		a = b\n"\
-			"	ENDIF\n"\
-			"ENDIF\n"\
-			"a = 1\n"\
-			"b = a\n"\
-			"a |= b\n"\
-			"a &= b\n"\
-			"a ^= b\n"\
-			"a -= b\n"\
-			"a <<=2\n"\
-			"a >>=1\n",
-			true, true
-		);
-
-		if (compiler_log::read_errors().size() != 0
-			|| test_output.size() != 21
-			|| test_output[0] != 0x6004
-			|| test_output[1] != 0x6102
-			|| test_output[2] != 0x3004
-			|| test_output[3] != 0x120E
-			|| test_output[4] != 0x4004
-			|| test_output[5] != 0x120E
-			|| test_output[6] != 0x6008
-			|| test_output[7] != 0x3003
-			|| test_output[8] != 0x1218
-			|| test_output[9] != 0x9010
-			|| test_output[10]!= 0x1218
-			|| test_output[11]!= 0x8010
-			|| test_output[12]!= 0x6001
-			|| test_output[13]!= 0x8100
-			|| test_output[14]!= 0x8011
-			|| test_output[15]!= 0x8012
-			|| test_output[16]!= 0x8013
-			|| test_output[17]!= 0x8015
-			|| test_output[18]!= 0x800E
-			|| test_output[19]!= 0x800E
-			|| test_output[20]!= 0x8006
-		){
-			std::cout << "\n\ntest_output failed!\n";
-			return false;
-		}
-			
-		std::cout << "\n\nAll tests passed!\n";
-		return true;
-	}
-}
+﻿/*
+* MIT License
+*
+* Copyright(c) 2018 Paul Bernitz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include "debug-output.hpp" 
+#include "compiler.hpp"
+#include "debugger.hpp"
+#include "fleet.hpp"
+#include "jit.hpp"
+#include "recompiler.hpp"
+#include "replay.hpp"
+#include "breakpoints.hpp"
+#include "profiler.hpp"
+#include "scheduler.hpp"
+#include "terminal-display.hpp"
+#include "capture.hpp"
+#include "trace.hpp"
+#include "keypad.hpp"
+#include "rewind.hpp"
+#include "disassembler.hpp"
+#include "control-flow.hpp"
+#include "listing.hpp"
+#include "program-generator.hpp"
+#include "fuzz.hpp"
+
+#include <filesystem>
+#include <random>
+
+namespace c8s
+{
+	// Run random programs on the interpreter and the JIT and compare the machine state.
+	bool test_jit_differential()
+	{
+		std::mt19937 rng{ 0xC8 };
+		auto random = [&](unsigned n) { return unsigned(rng() % n); };
+
+		for (unsigned program = 0; program < 200; ++program)
+		{
+			// Frames shorter and longer than the blocks.
+			const std::vector<u16> ops = generate_rom(rng);
+			const unsigned frame = 1 + program % 24;
+			Chip8Debugger interpreter;
+			interpreter.setSeed(program);
+			interpreter.setInstructionsPerFrame(frame);
+			interpreter.loadProgram(ops);
+			Chip8Debugger jit;
+			jit.setEngine(Engine::Jit);
+			if (!attach_jit(jit))
+				return true;
+			jit.setSeed(program);
+			jit.setInstructionsPerFrame(frame);
+			jit.loadProgram(ops);
+
+			// Run in uneven slices so budgets end inside of blocks.
+			for (unsigned slice = 0; slice < 40; ++slice)
+			{
+				const std::uint64_t budget = 1 + random(300);
+				if (interpreter.run(budget) != jit.run(budget) || !interpreter.sameState(jit))
+				{
+					diagnostics::error([&] { return "JIT differs from the interpreter in random program " + std::to_string(program) + "!"; });
+					return false;
+				}
+				if (interpreter.stopReason() != StopReason::BudgetExhausted)
+					break;
+			}
+		}
+		return true;
+	}
+
+	// Step back and jump around in recorded runs and compare with the states seen on the way.
+	bool test_rewind()
+	{
+		std::mt19937 rng{ 0x33 };
+		std::vector<std::vector<u16>> programs;
+		for (unsigned j = 0; j < 20; ++j) programs.push_back(generate_rom(rng));
+		programs.push_back({ 0x6005, 0x2208, 0x7001, 0x1202, 0x7102, 0x00EE });	// CALL and RET
+
+		for (const auto& ops : programs)
+		{
+			// A small journal and few snapshots, so old records and snapshots get dropped.
+			Chip8Debugger debugger;
+			RewindConfig config;
+			config.journalBytes = 0x800;
+			config.snapshotInterval = 16;
+			config.maxSnapshots = 4;
+			RewindJournal journal{ debugger, config };
+			debugger.setJournal(&journal);
+			debugger.loadProgram(ops);
+
+			std::vector<std::uint64_t> hashes{ debugger.stateHash() };
+			while (hashes.size() < 400 && debugger.run(1) == StopReason::BudgetExhausted)
+				hashes.push_back(debugger.stateHash());
+
+			for (unsigned jump = 0; jump < 20 && debugger.cycles() > journal.oldestCycle(); ++jump)
+			{
+				const std::uint64_t newest = debugger.cycles();
+				const std::uint64_t target = journal.oldestCycle() + rng() % (newest - journal.oldestCycle());
+				const bool back = journal.stepBack() && debugger.stateHash() == hashes[newest - 1];
+				if (!back || !journal.jumpToCycle(target) || debugger.stateHash() != hashes[target])
+				{
+					diagnostics::error("rewind failed!");
+					return false;
+				}
+
+				// Running again records a new history.
+				for (unsigned step = 0; step < 5 && debugger.run(1) == StopReason::BudgetExhausted; ++step)
+				{
+					if (debugger.cycles() == hashes.size())
+						hashes.push_back(debugger.stateHash());	// Reruns may go past the first run.
+					else if (debugger.stateHash() != hashes[debugger.cycles()])
+					{
+						diagnostics::error("rerun after rewind failed!");
+						return false;
+					}
+				}
+			}
+			if (journal.usage().journalUsed > config.journalBytes || journal.usage().snapshots > config.maxSnapshots)
+			{
+				diagnostics::error("rewind journal exceeds its limits!");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Run random programs on a fleet whose lanes start with different registers, so they
+	// diverge, and compare every lane with an interpreter started the same way.
+	bool test_fleet()
+	{
+		std::mt19937 rng{ 0x34 };
+		auto random = [&](unsigned n) { return unsigned(rng() % n); };
+		const unsigned lanes = 13;
+
+		for (unsigned program = 0; program < 60; ++program)
+		{
+			const std::vector<u16> ops = generate_rom(rng);
+			Chip8Fleet fleet{ lanes };
+			fleet.setInstructionsPerFrame(1 + program % 16);
+			fleet.loadProgram(ops);
+			std::vector<Chip8Debugger> machines(lanes);
+			for (unsigned k = 0; k < lanes; ++k)
+			{
+				machines[k].setInstructionsPerFrame(1 + program % 16);
+				machines[k].loadProgram(ops);
+				machines[k].setSeed(k);
+				fleet.setSeed(k, k);
+				for (unsigned j = 0; j < V_REGS_TOTAL; ++j)
+				{
+					const u8 value = u8(random(4) == 0 ? random(4) : random(256));
+					machines[k].setV(j, value);
+					fleet.setV(k, j, value);
+				}
+			}
+
+			for (unsigned slice = 0; slice < 20; ++slice)
+			{
+				const std::uint64_t budget = 1 + random(200);
+				fleet.run(budget);
+				for (unsigned k = 0; k < lanes; ++k)
+				{
+					if (machines[k].run(budget) != fleet.stopReason(k) || machines[k].stateHash() != fleet.stateHash(k))
+					{
+						diagnostics::error([&] { return "fleet lane " + std::to_string(k) + " differs from the interpreter in random program " + std::to_string(program) + "!"; });
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// Record runs with key presses, replay them from the encoded log and check that a changed
+	// log is noticed.
+	bool test_replay()
+	{
+		std::mt19937 rng{ 0x35 };
+		for (unsigned program = 0; program < 20; ++program)
+		{
+			std::vector<u16> ops = generate_rom(rng);
+			ops.insert(ops.begin(), u16(0xC0FF | (program % 16) << 8));
+
+			Chip8Debugger recorded;
+			recorded.setTarget(Target(program % 3));
+			recorded.setQuirks(Quirks(program % 4));
+			recorded.setSanitizer(program % 5 == 0);
+			InputRecorder recorder{ rng() };
+			recorded.setSeed(recorder.log().seed);
+			recorded.setInput(&recorder);
+			recorded.loadProgram(ops);
+			for (unsigned slice = 0; slice < 10 && recorded.run(1 + rng() % 100) == StopReason::BudgetExhausted; ++slice)
+				recorded.setKey(rng() % 16, rng() % 2 == 0);
+
+			// The stop reason sits in the byte before the final state hash, the quirks after the target.
+			InputLog log;
+			const std::vector<u8> bytes = recorder.finish(recorded).encode();
+			std::vector<u8> unknown_reason = bytes, unknown_quirks = bytes;
+			unknown_reason[unknown_reason.size() - 9] = 0xFF;
+			unknown_quirks[FILE_HEADER_SIZE + 11] = 0xFF;
+			if (!log.decode(bytes) || log.events.size() != recorder.log().events.size() || InputLog{}.decode(unknown_reason) || InputLog{}.decode(unknown_quirks)
+				|| !log.recordedWith(recorded.target(), recorded.quirks(), recorded.sanitizer()))
+			{
+				diagnostics::error("input log round trip failed!");
+				return false;
+			}
+
+			Chip8Debugger replayed;
+			InputPlayer player{ log };
+			player.attach(replayed);
+			replayed.loadProgram(ops);
+			replayed.run(player.budget());
+			if (!player.matches(replayed))
+			{
+				diagnostics::error([&] { return "replay of program " + std::to_string(program) + " diverged at cycle " + std::to_string(player.divergedAt()) + "!"; });
+				return false;
+			}
+
+			// Another machine is a mismatch even if the program would not notice it.
+			if (replayed.target() != recorded.target() || replayed.quirks() != recorded.quirks() || replayed.sanitizer() != recorded.sanitizer()
+				|| log.recordedWith(recorded.target(), Quirks((program + 1) % 4), recorded.sanitizer()) || log.recordedWith(recorded.target(), recorded.quirks(), !recorded.sanitizer()))
+			{
+				diagnostics::error("replay did not restore or check the recorded machine!");
+				return false;
+			}
+
+			// The first instruction draws a random number, so the replay has to notice when the log
+			// has it at another cycle.
+			++log.events[0].cycle;
+			Chip8Debugger tampered;
+			InputPlayer tampered_player{ log };
+			tampered_player.attach(tampered);
+			tampered.loadProgram(ops);
+			tampered.run(tampered_player.budget());
+			if (tampered_player.matches(tampered))
+			{
+				diagnostics::error("replay did not notice a changed input log!");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Runs `ops` once with breakpoints on `engine` and once single-stepping until `stop(registers before, machine)`
+	// holds, and compares where both stopped. Address breakpoints are also checked before the first instruction.
+	template<typename Stop>
+	bool same_break(const std::vector<u16>& ops, std::uint64_t seed, BreakpointSet& breakpoints, Stop stop, bool check_first = false, Engine engine = Engine::Cached)
+	{
+		Chip8Debugger checked;
+		checked.setEngine(engine);
+		if (engine == Engine::Jit) attach_jit(checked);
+		checked.setSeed(seed);
+		checked.setBreakpoints(&breakpoints);
+		checked.loadProgram(ops);
+		const StopReason reason = checked.run(2000);
+
+		Chip8Debugger stepped;
+		stepped.setSeed(seed);
+		stepped.loadProgram(ops);
+		StopReason expected = StopReason::BudgetExhausted;
+		if (check_first && stop(nullptr, stepped)) expected = StopReason::Breakpoint;
+		for (unsigned n = 0; n < 2000 && expected != StopReason::Breakpoint; ++n)
+		{
+			u8 before[V_REGS_TOTAL];
+			for (unsigned j = 0; j < V_REGS_TOTAL; ++j) before[j] = stepped.v(j);
+			if (!stepped.runCycle())
+			{
+				expected = stepped.stopReason();
+				break;
+			}
+			if (stop(before, stepped))
+			{
+				expected = StopReason::Breakpoint;
+				break;
+			}
+		}
+		return reason == expected && checked.cycles() == stepped.cycles() && checked.stateHash() == stepped.stateHash()
+			&& (reason == StopReason::Breakpoint) == (breakpoints.lastHit() != nullptr);
+	}
+
+	bool test_breakpoints()
+	{
+		Chip8Debugger machine;
+		machine.loadProgram({ 0xA301, 0x6310 });
+		machine.run(2);
+		struct { const char* text; bool result; } conditions[] =
+		{
+			{ "V3 == 0x10 && I > 0x300", true },
+			{ "v3 == 16 && I > 0x301", false },
+			{ "!(V3 != 0x10) || 0", true },
+			{ "[0x200] == 0xA3 && [PC - 4 + 1] == 1", true },
+			{ "V3 & 0x30 | 1 == 0x11", true },
+			{ "V3 ^ 0x10 || DT || ST || SP", false }
+		};
+		for (const auto& condition : conditions)
+		{
+			Predicate predicate;
+			std::string error;
+			if (!predicate.compile(condition.text, error) || predicate.evaluate(machine) != condition.result)
+			{
+				diagnostics::error([&] { return std::string("condition `") + condition.text + "` failed!"; });
+				return false;
+			}
+		}
+		for (const char* invalid : { "V3 ==", "VG > 1", "(V1", "[I", "V1 = 2", "0x1z", "1 + 2 * 0" })
+		{
+			Predicate predicate;
+			std::string error;
+			if (predicate.compile(invalid, error) || error.empty())
+			{
+				diagnostics::error([&] { return std::string("invalid condition `") + invalid + "` was accepted!"; });
+				return false;
+			}
+		}
+
+		// A breakpoint on the first instruction stops before it, the next run steps over it.
+		BreakpointSet at_entry;
+		at_entry.addAddress(PROGRAM_START);
+		Chip8Debugger entry;
+		entry.setBreakpoints(&at_entry);
+		entry.loadProgram({ 0x6001, 0x1200 });
+		if (entry.run(10) != StopReason::Breakpoint || entry.cycles() != 0 || entry.run(10) != StopReason::Breakpoint || entry.cycles() != 2)
+		{
+			diagnostics::error("breakpoint on the first instruction failed!");
+			return false;
+		}
+
+		// A breakpoint set inside a loop that already ran stops there within one pass of the loop, even
+		// if the JIT translated it.
+		for (Engine engine : { Engine::Switch, Engine::Cached, Engine::Jit })
+		{
+			BreakpointSet in_loop;
+			Chip8Debugger looping;
+			looping.setEngine(engine);
+			if (engine == Engine::Jit) attach_jit(looping);
+			looping.setBreakpoints(&in_loop);
+			looping.loadProgram({ 0x6001, 0x7101, 0x7201, 0x1202 });
+			looping.run(99);
+			in_loop.addAddress(0x204);
+			const std::uint64_t cycles = looping.cycles();
+			if (looping.run(100) != StopReason::Breakpoint || looping.pc() != 0x204 || looping.cycles() > cycles + 3)
+			{
+				diagnostics::error("breakpoint in a running loop failed!");
+				return false;
+			}
+		}
+
+		std::mt19937 rng{ 0x36 };
+		for (unsigned program = 0; program < 40; ++program)
+		{
+			const std::vector<u16> ops = generate_rom(rng);
+			const std::uint64_t seed = rng();
+			const u16 address = u16(PROGRAM_START + 2 * (rng() % ops.size()));
+			const u8 reg = u8(rng() % 16);
+			const u8 limit = u8(rng());
+
+			BreakpointSet at_address, at_conditional_address, at_register, at_condition, unarmed;
+			at_address.addAddress(address);
+			at_register.addRegisterWatch(reg);
+			Predicate predicate;
+			std::string error;
+			predicate.compile("V" + std::to_string(reg % 10) + " > " + std::to_string(limit) + " && PC != 0", error);
+			at_conditional_address.addAddress(address, predicate);
+			at_condition.addCondition(predicate);
+			unarmed.remove(unarmed.addMemoryWatch(0x300, 4));
+
+			// Address breakpoints are trapped by the engine, which also has to step over those whose condition fails.
+			for (Engine engine : { Engine::Switch, Engine::Cached, Engine::Jit })
+			{
+				if (!same_break(ops, seed, at_address, [&](const u8*, const Chip8Debugger& m) { return m.pc() == address; }, true, engine)
+					|| !same_break(ops, seed, at_conditional_address, [&](const u8*, const Chip8Debugger& m) { return m.pc() == address && m.v(reg % 10) > limit; }, true, engine))
+				{
+					diagnostics::error([&] { return "address breakpoints of program " + std::to_string(program) + " stopped at the wrong instruction!"; });
+					return false;
+				}
+			}
+			if (!same_break(ops, seed, at_register, [&](const u8* before, const Chip8Debugger& m) { return before[reg] != m.v(reg); })
+				|| !same_break(ops, seed, at_condition, [&](const u8*, const Chip8Debugger& m) { return m.v(reg % 10) > limit; })
+				|| unarmed.armed()
+				|| !same_break(ops, seed, unarmed, [](const u8*, const Chip8Debugger&) { return false; }))
+			{
+				diagnostics::error([&] { return "breakpoints of program " + std::to_string(program) + " stopped at the wrong instruction!"; });
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool test_line_table()
+	{
+		LineTable lines;
+		const std::vector<u16> ops = compile(
+			"VAR a = 1\n"\
+			"VAR b = 2\n"\
+			"IF a == 1:\n"\
+			"  b += 3\n"\
+			"  a = 2\n"\
+			"ENDIF\n"\
+			"FOR i=0 TO 5 STEP 1:\n"\
+			" a += 1\n"\
+			"ENDFOR\n"\
+			"b = a\n",
+			true, false, nullptr, &lines
+		);
+
+		// ENDIF has no instructions of its own, the FOR loop increments on the ENDFOR line.
+		const std::vector<std::pair<u16, unsigned>> expected =
+		{
+			{ 0x200, 1 }, { 0x202, 2 }, { 0x204, 3 }, { 0x208, 4 }, { 0x20A, 5 },
+			{ 0x20C, 7 }, { 0x212, 8 }, { 0x214, 9 }, { 0x21A, 10 }, { 0x21C, 11 }
+		};
+		bool same = lines.entries.size() == expected.size();
+		for (unsigned j = 0; same && j < expected.size(); ++j)
+			same = lines.entries[j].address == expected[j].first && lines.entries[j].line == expected[j].second;
+		if (!same || lines.lineAt(0x20E) != 7 || lines.lineAt(0x1FE) != 0)
+		{
+			diagnostics::error("line table does not match the source!");
+			return false;
+		}
+
+		LineTable decoded;
+		LineTable unordered;
+		unordered.add(0x200, 40);
+		unordered.add(0x2A0, 3);
+		unordered.add(0x800, 700);
+		if (!decoded.decode(lines.encode()) || decoded.encode() != lines.encode()
+			|| !decoded.decode(unordered.encode()) || decoded.lineAt(0x2A2) != 3 || decoded.lineAt(0x900) != 700
+			|| decoded.decode({ 'C', '8', 'L', 'T', 1, 0x80 }))
+		{
+			diagnostics::error("line table round trip failed!");
+			return false;
+		}
+
+		// The loop body and its increment run five times.
+		Chip8Debugger debugger;
+		debugger.setLineTable(lines);
+		debugger.loadProgram(ops);
+		std::vector<unsigned> visited;
+		while (debugger.stepLine(100) == StopReason::LineReached) visited.push_back(debugger.sourceLine());
+		const std::vector<unsigned> statements = { 2, 3, 4, 5, 7, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 10, 11 };
+		if (visited != statements || debugger.stopReason() != StopReason::EndOfProgram)
+		{
+			diagnostics::error("stepping by source line failed!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_profiler()
+	{
+		// Calls a subroutine that counts V0 down from 5 and loops back until it reaches 0.
+		Chip8Debugger debugger;
+		Profiler profiler;
+		LineTable lines;
+		lines.add(0x200, 1);
+		lines.add(0x204, 2);
+		lines.add(0x20A, 3);
+		debugger.setProfiler(&profiler);
+		debugger.loadProgram({ 0x6005, 0x220A, 0x3000, 0x1202, 0x0000, 0x70FF, 0x00EE });
+		debugger.run(1000);
+		debugger.setProfiler(nullptr);
+		debugger.loadProgram({ 0x6005, 0x1200 });
+		debugger.run(1000);
+
+		std::ostringstream folded;
+		profiler.printFolded(folded, LineTable{});
+		const std::vector<LoopCount> loops = profiler.loops();
+		const auto per_line = profiler.lines(lines);
+		if (profiler.instructions() != 25 || profiler.executed(0x202) != 5 || profiler.executed(0x206) != 4
+			|| profiler.taken(0x202) != 5 || profiler.taken(0x204) != 1 || profiler.taken(0x206) != 4 || profiler.taken(0x20A) != 0
+			|| profiler.hotspots().size() != 6 || profiler.hotspots().back().address != 0x200
+			|| loops.size() != 1 || loops[0].head != 0x202 || loops[0].tail != 0x206 || loops[0].iterations != 4 || loops[0].executed != 14
+			|| per_line.size() != 3 || per_line[0] != std::make_pair(3u, std::uint64_t(10)) || per_line[2] != std::make_pair(1u, std::uint64_t(6))
+			|| folded.str() != "main 15\nmain;sub_0x20a 10\n")
+		{
+			diagnostics::error("profile does not match the program!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_scheduler()
+	{
+		// DT = 5 on the second instruction, then the timer ticks on the first instruction of every frame.
+		const std::vector<u16> ops = { 0x6005, 0xF015, 0x1204 };
+		Chip8Debugger per_frame, per_instruction;
+		per_instruction.setInstructionsPerFrame(1);
+		per_frame.loadProgram(ops);
+		per_instruction.loadProgram(ops);
+		per_frame.run(30);
+		per_instruction.run(4);
+		if (per_frame.delayTimer() != 3 || per_instruction.delayTimer() != 3)
+		{
+			diagnostics::error("timers do not tick once per frame!");
+			return false;
+		}
+
+		Chip8Debugger headless, realtime, direct;
+		SchedulerConfig config;
+		config.instructionsPerFrame = 7;
+		config.realtime = false;
+		FrameScheduler headless_scheduler{ headless, config };
+		config.realtime = true;
+		FrameScheduler realtime_scheduler{ realtime, config };
+		direct.setInstructionsPerFrame(7);
+		for (Chip8Debugger* debugger : { &headless, &realtime, &direct }) debugger->loadProgram(ops);
+
+		auto start = std::chrono::steady_clock::now();
+		realtime_scheduler.run(20);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		headless_scheduler.run(20);
+		direct.run(20);
+		if (realtime.stateHash() != direct.stateHash() || headless.stateHash() != direct.stateHash()
+			|| realtime_scheduler.frames() != 3 || headless_scheduler.frames() != 3
+			|| realtime_scheduler.frameTimes().count() != 3 || realtime_scheduler.workTimes().count() != 3
+			|| seconds < 3.0 / TIMER_HZ)
+		{
+			diagnostics::error("frame scheduler failed!");
+			return false;
+		}
+
+		FrameTimeHistogram histogram;
+		for (double ms : { 16.6, 16.7, 16.7, 16.8, 40.0, 80.0 }) histogram.add(ms);
+		if (histogram.count() != 6 || histogram.min() != 16.6 || histogram.max() != 80.0
+			|| histogram.percentile(0.5) < 16.7 || histogram.percentile(0.5) > 17.0 || histogram.percentile(0.99) != 80.0)
+		{
+			diagnostics::error("frame time histogram failed!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_terminal_display()
+	{
+		// Draw the font sprite of `0` (F0 90 90 90 F0) at the top left.
+		Chip8Debugger debugger;
+		debugger.loadProgram({ 0x6000, 0xF029, 0xD005, 0x1206 });
+		debugger.run(4);
+
+		// The top left Braille cell has the whole left column and the top right dot: U+284F.
+		TerminalDisplay braille{ DisplayGlyphs::Braille };
+		const std::string first = braille.update(debugger.display());
+		const bool unchanged = braille.update(debugger.display()).empty();
+		std::uint64_t frame[DISPLAY_H];
+		std::memcpy(frame, debugger.display(), sizeof(frame));
+		frame[9] ^= std::uint64_t(1);
+		const std::string changed = braille.update(frame);
+		if (first.find("\x1b[1;1H\xE2\xA1\x8F") != 0 || !unchanged || braille.rowsDrawn() != 9
+			|| changed.find("\x1b[3;1H") != 0 || changed.find("\x1b[", 1) != changed.find("\x1b[9;1H"))
+		{
+			diagnostics::error("braille display failed!");
+			return false;
+		}
+
+		std::ostringstream blocks;
+		TerminalDisplay{ DisplayGlyphs::HalfBlock }.print(blocks, debugger.display());
+		const std::string text = blocks.str();
+		if (text.find("\xE2\x96\x88\xE2\x96\x80\xE2\x96\x80\xE2\x96\x88 ") != 0 || std::count(text.begin(), text.end(), '\n') != 16)
+		{
+			diagnostics::error("half block display failed!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_capture()
+	{
+		// Two instructions per frame, then every frame toggles the sprite of `0`: 10 frames, 2 distinct.
+		const std::vector<u16> ops = { 0x6000, 0xF029, 0xD005, 0x1204 };
+		auto capture_run = [&](FrameCapture& capture, std::uint64_t instructions)
+		{
+			Chip8Debugger debugger;
+			SchedulerConfig config;
+			config.instructionsPerFrame = 2;
+			config.realtime = false;
+			FrameScheduler scheduler{ debugger, config };
+			scheduler.setFrameCallback([&](const Chip8Debugger& d) { capture.capture(d); });
+			debugger.loadProgram(ops);
+			scheduler.run(instructions);
+		};
+
+		std::ostringstream log;
+		FrameCapture recorded;
+		recorded.setLog(&log);
+		capture_run(recorded, 20);
+		if (recorded.frames() != 10 || recorded.distinctFrames() != 2 || log.str().find("5 12 0x") == std::string::npos)
+		{
+			diagnostics::error("frame capture failed!");
+			return false;
+		}
+
+		// Compare against the log itself, a log with one changed frame and logs of other lengths.
+		auto compare = [&](const std::string& golden_log, std::uint64_t instructions)
+		{
+			std::istringstream golden{ golden_log };
+			FrameCapture capture;
+			capture.setGolden(&golden);
+			capture_run(capture, instructions);
+			capture.finishGolden();
+			return std::make_pair(capture.divergence(), capture.divergedActual().frame);
+		};
+		std::string changed = log.str();
+		changed[changed.find("5 12 0x") + 7] ^= 1;
+		if (compare(log.str(), 20) != std::make_pair(Divergence::None, std::uint64_t(0))
+			|| compare(changed, 20) != std::make_pair(Divergence::Frame, std::uint64_t(5))
+			|| compare(log.str(), 24).first != Divergence::GoldenShorter
+			|| compare(log.str(), 12) != std::make_pair(Divergence::GoldenLonger, std::uint64_t(6)))
+		{
+			diagnostics::error("golden frame comparison failed!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_trace()
+	{
+		// V3 = 5, count V0 up to 5, V3 += 1, then V0 = 255 + V3 sets VF.
+		const std::vector<u16> ops = { 0x6305, 0x6000, 0x7001, 0x3005, 0x1204, 0x7301, 0x60FF, 0x8034, 0x1210 };
+		const std::string file_name = (std::filesystem::temp_directory_path() / "c8s_test.trace").string();
+		TraceRecorder recorder{ 4 };
+		Chip8Debugger debugger;
+		debugger.setTracer(&recorder);
+		debugger.loadProgram(ops);
+		if (!recorder.open(file_name) || debugger.run(22) != StopReason::BudgetExhausted || !recorder.close())
+		{
+			diagnostics::error("trace recording failed!");
+			return false;
+		}
+
+		TraceAnalyzer analyzer;
+		const bool loaded = analyzer.load(file_name);
+		std::filesystem::remove(file_name);
+		TraceRecord change{};
+		std::ostringstream answer;
+		if (!loaded || analyzer.records().size() != 22 || analyzer.instructions() != 22
+			|| analyzer.changes(0x0).size() != 7 || analyzer.executions(0x204).size() != 5
+			|| !analyzer.lastChange(0x0, 12, change) || change.cycle != 9 || change.value != 3
+			|| analyzer.changes(0xF).size() != 1 || analyzer.changes(0xF)[0].cycle != 19
+			|| !analyzer.query("V3 before 0x210", answer) || answer.str().find("cycle 17,") != 0
+			|| analyzer.query("V3 after 0x210", answer) || analyzer.query("history VG", answer))
+		{
+			diagnostics::error("trace analyzer failed!");
+			return false;
+		}
+		return true;
+	}
+
+	// FX0A stops every engine with its attempt counted until a key is down, EX9E and EXA1 follow
+	// the keypad, and scripted keys end a wait in the frame they are due.
+	bool test_keypad()
+	{
+		// V3 = lowest key down, then V0 = 1 unless key V3 is down and V1 = 2 unless it is up.
+		const std::vector<u16> ops = { 0xF30A, 0xE39E, 0x6001, 0xE3A1, 0x6102, 0x0000 };
+		Chip8Debugger spinning, engines[3];
+		spinning.loadProgram(ops);
+		for (unsigned n = 0; n < 50; ++n) spinning.run(1);
+		engines[0].setEngine(Engine::Switch);
+		engines[1].setEngine(Engine::Cached);
+		engines[2].setEngine(Engine::Jit);
+		attach_jit(engines[2]);
+		for (Chip8Debugger& machine : engines)
+		{
+			machine.loadProgram(ops);
+			const bool waits = machine.run(100) == StopReason::WaitingForKey && machine.cycles() == 1 && machine.pc() == 0x200
+				&& machine.idle(49) == 49 && machine.stateHash() == spinning.stateHash();
+			machine.setKey(0x9, true);
+			machine.setKey(0x7, true);
+			if (!waits || machine.run(100) != StopReason::EndOfProgram || machine.cycles() != 54
+				|| machine.v(0x3) != 0x7 || machine.v(0x0) != 0 || machine.v(0x1) != 2)
+			{
+				diagnostics::error("waiting for a key failed!");
+				return false;
+			}
+		}
+
+		Chip8Debugger waiting;
+		Chip8Fleet fleet{ 2 };
+		waiting.loadProgram(ops);
+		fleet.loadProgram(ops);
+		fleet.setKey(1, 0x9, true);
+		waiting.run(100);
+		fleet.run(100);
+		if (fleet.stopReason(0) != StopReason::WaitingForKey || fleet.stateHash(0) != waiting.stateHash()
+			|| fleet.stopReason(1) != StopReason::EndOfProgram || fleet.cycles(1) != 4 || fleet.v(1, 0x3) != 0x9 || fleet.v(1, 0x0) != 0)
+		{
+			diagnostics::error("fleet keypad failed!");
+			return false;
+		}
+
+#ifdef C8S_KEYS_AVAILABLE
+		// Wait for a key, spin while it is down, then wait for another one that never comes.
+		const std::string file_name = (std::filesystem::temp_directory_path() / "c8s_test.keys").string();
+		{
+			std::ofstream ofs{ file_name };
+			ofs << "# frame key state\n3 7 down\n5 7 up\n6 2 sideways\n";
+		}
+		ScriptedKeys keys;
+		const bool opened = keys.open(file_name);
+		Chip8Debugger scripted;
+		SchedulerConfig config;
+		config.realtime = false;
+		FrameScheduler scheduler{ scripted, config };
+		scheduler.setKeySource(&keys);
+		scripted.loadProgram({ 0xF30A, 0xE3A1, 0x1202, 0xF40A, 0x0000 });
+		const StopReason reason = opened ? scheduler.run(1000) : StopReason::BudgetExhausted;
+		std::filesystem::remove(file_name);
+		if (reason != StopReason::WaitingForKey || scheduler.frames() != 6 || scripted.cycles() != 6 * INSTRUCTIONS_PER_FRAME
+			|| scripted.pc() != 0x206 || scripted.v(0x3) != 0x7 || scripted.key(0x7) || keys.error().find("line 4:") != 0)
+		{
+			diagnostics::error("scripted keys failed!");
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	// The quirk profiles change shifts, FX55/FX65, BNNN and sprites at the edge the same way in
+	// every engine, and the sanitizer stops at accesses that would otherwise wrap around.
+	bool test_quirks()
+	{
+		const Quirks profiles[] = { Quirks::Chip8, Quirks::Cosmac, Quirks::Schip, Quirks::XoChip };
+		for (Quirks quirks : profiles)
+		{
+			// XO-CHIP shifts and stores like the COSMAC VIP, but wraps sprites like CHIP-8.
+			const bool cosmac = quirks == Quirks::Cosmac || quirks == Quirks::XoChip, schip = quirks == Quirks::Schip;
+			Chip8Debugger shift, store, jump, sprite;
+			for (Chip8Debugger* machine : { &shift, &store, &jump, &sprite }) machine->setQuirks(quirks);
+			shift.loadProgram({ 0x6181, 0x6203, 0x8126 });
+			store.loadProgram({ 0xA300, 0x6001, 0x6102, 0x6203, 0xF255 });
+			jump.loadProgram({ 0x6002, 0x6204, 0xB210 });
+			sprite.loadProgram({ 0xA000, 0x603E, 0x6100, 0xD015 });
+			for (Chip8Debugger* machine : { &shift, &store, &jump, &sprite }) machine->run(5);
+			if (shift.v(0x1) != (cosmac ? 0x01 : 0x40) || shift.v(0xF) != 1
+				|| store.memory(0x300) != 1 || store.memory(0x302) != 3 || store.memory(0x303) != 0 || store.i() != (cosmac ? 0x303 : 0x300)
+				|| jump.pc() != (schip ? 0x214 : 0x212)
+				|| !sprite.pixel(63, 0) || sprite.pixel(0, 0) != (quirks == Quirks::Chip8 || quirks == Quirks::XoChip))
+			{
+				diagnostics::error("quirks failed!");
+				return false;
+			}
+
+			std::mt19937 rng{ 0x44 };
+			for (unsigned program = 0; program < 50; ++program)
+			{
+				const std::vector<u16> ops = generate_rom(rng);
+				Chip8Debugger engines[3];
+				engines[0].setEngine(Engine::Switch);
+				engines[1].setEngine(Engine::Cached);
+				engines[2].setEngine(Engine::Jit);
+				attach_jit(engines[2]);
+				for (Chip8Debugger& machine : engines)
+				{
+					machine.setQuirks(quirks);
+					machine.setSeed(program);
+					machine.loadProgram(ops);
+					machine.run(500);
+				}
+				if (!engines[0].sameState(engines[1]) || !engines[0].sameState(engines[2]))
+				{
+					diagnostics::error([&] { return "engines differ with quirks in random program " + std::to_string(program) + "!"; });
+					return false;
+				}
+			}
+		}
+
+		// Endless recursion, RET on an empty stack and FX65 past the end of memory.
+		const std::vector<u16> faults[] = { { 0x2200 }, { 0x00EE }, { 0xAFFE, 0xF265 } };
+		for (const auto& ops : faults)
+		{
+			Chip8Debugger sanitized, wrapping;
+			sanitized.setSanitizer(true);
+			sanitized.loadProgram(ops);
+			wrapping.loadProgram(ops);
+			if (sanitized.run(100) != StopReason::BoundsViolation || wrapping.run(100) == StopReason::BoundsViolation)
+			{
+				diagnostics::error("sanitizer failed!");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool test_targets()
+	{
+		// SUPER-CHIP: a 16x16 sprite clipped at the corner of the hires screen, scrolled down and left,
+		// the big digits of FX30, the flag registers and 00FD.
+		const std::vector<u16> schip = {
+			0x00FF, 0xA21C, 0x607A, 0x6138, 0xD010, 0x00C4, 0x00FC, 0x6205, 0xF230, 0x6307, 0xF375, 0x6300, 0xF385, 0x00FD,
+			0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF };
+		// XO-CHIP: F000 NNNN, FX55 above 4 KB, 5XY2/5XY3, skipping a long instruction,
+		// a sprite in the second plane only and an ignored F002.
+		const std::vector<u16> xochip = {
+			0xF000, 0x1234, 0x6001, 0x6102, 0x6203, 0xF255, 0xF000, 0x2000, 0x5022, 0x6000, 0x6100, 0x6200, 0x5023,
+			0x6500, 0x3500, 0xF000, 0x0300, 0x6401, 0xF201, 0xF002, 0xA000, 0xD015, 0x00FD };
+
+		Chip8Debugger chip8, super, xo;
+		chip8.loadProgram(schip);
+		super.setTarget(Target::Schip);
+		super.setQuirks(Quirks::Schip);
+		super.loadProgram(schip);
+		xo.setTarget(Target::XoChip);
+		xo.loadProgram(xochip);
+		if (chip8.run(100) != StopReason::UnknownInstruction
+			|| super.run(100) != StopReason::EndOfProgram || !super.hires() || super.displayWidth() != HIRES_W
+			|| !super.pixel(118, 60) || !super.pixel(123, 63) || super.pixel(124, 60) || super.pixel(118, 59) || super.pixel(2, 60) || super.pixel(118, 0)
+			|| super.i() != BIG_FONT_START + 50 || super.v(0x3) != 7 || super.flag(0x3) != 7)
+		{
+			diagnostics::error("SUPER-CHIP target failed!");
+			return false;
+		}
+
+		const StopReason xo_stop = xo.run(100);
+		bool first_plane_empty = xo.planeMask() == 2, second_plane_drawn = false;
+		for (unsigned word = 0; word < PLANE_WORDS; ++word)
+		{
+			first_plane_empty = first_plane_empty && xo.plane(0)[word] == 0;
+			second_plane_drawn = second_plane_drawn || xo.plane(1)[word] != 0;
+		}
+		if (xo_stop != StopReason::EndOfProgram || !first_plane_empty || !second_plane_drawn
+			|| xo.memory(0x1236) != 3 || xo.memory(0x2002) != 3 || xo.v(0x2) != 3 || xo.v(0x4) != 1 || xo.memorySize() != 0x10000)
+		{
+			diagnostics::error("XO-CHIP target failed!");
+			return false;
+		}
+
+		// All engines agree on both targets, also for random programs.
+		std::mt19937 rng{ 0x45 };
+		for (unsigned program = 0; program < 40; ++program)
+		{
+			const Target target = program % 2 ? Target::XoChip : Target::Schip;
+			const std::vector<u16> ops = program < 2 ? (target == Target::Schip ? schip : xochip) : generate_rom(rng);
+			Chip8Debugger engines[3];
+			engines[0].setEngine(Engine::Switch);
+			engines[1].setEngine(Engine::Cached);
+			engines[2].setEngine(Engine::Jit);
+			attach_jit(engines[2]);
+			for (Chip8Debugger& machine : engines)
+			{
+				machine.setTarget(target);
+				machine.setSeed(program);
+				machine.loadProgram(ops);
+				machine.run(500);
+			}
+			if (!engines[0].sameState(engines[1]) || !engines[0].sameState(engines[2]))
+			{
+				diagnostics::error([&] { return "engines differ on a target in program " + std::to_string(program) + "!"; });
+				return false;
+			}
+		}
+
+		// Stepping back restores hires mode, scrolled rows and the flag registers.
+		Chip8Debugger debugger;
+		debugger.setTarget(Target::Schip);
+		RewindJournal journal{ debugger, RewindConfig{} };
+		debugger.setJournal(&journal);
+		debugger.loadProgram({ 0x00FF, 0xA000, 0xD010, 0x00C2, 0x00FB, 0x7003, 0xD015, 0x00FC, 0xF075, 0x00FE, 0x00FF, 0x1202 });
+		std::vector<std::uint64_t> hashes{ debugger.stateHash() };
+		while (hashes.size() < 200 && debugger.run(1) == StopReason::BudgetExhausted)
+			hashes.push_back(debugger.stateHash());
+		while (debugger.cycles() > journal.oldestCycle())
+		{
+			if (!journal.stepBack() || debugger.stateHash() != hashes[debugger.cycles()])
+			{
+				diagnostics::error("rewind on a target failed!");
+				return false;
+			}
+		}
+
+		// Programs that don't fit into 4 KB only compile for XO-CHIP, where PC runs on past 0x1000.
+		std::string large = "VAR a = 0\n";
+		for (unsigned line = 0; line < 1800; ++line) large += "a += 1\n";
+		compile(large, false, false, nullptr, nullptr, Target::Chip8);
+		const bool rejected = compiler_log::read_errors().size() != 0;
+		const auto ops = compile(large, false, false, nullptr, nullptr, Target::XoChip);
+		if (!rejected || compiler_log::read_errors().size() != 0 || ops.size() != 1801)
+		{
+			diagnostics::error("compiling for a target failed!");
+			return false;
+		}
+		const Engine large_engines[] = { Engine::Switch, Engine::Cached, Engine::Jit };
+		for (Engine engine : large_engines)
+		{
+			Chip8Debugger machine;
+			machine.setEngine(engine);
+			if (engine == Engine::Jit) attach_jit(machine);
+			machine.setTarget(Target::XoChip);
+			machine.setSanitizer(true);
+			machine.loadProgram(ops);
+			if (machine.run(5000) != StopReason::EndOfProgram || machine.pc() != PROGRAM_START + 1801 * 2 || machine.v(0) != u8(1800))
+			{
+				diagnostics::error("running code above 4 KB failed!");
+				return false;
+			}
+		}
+
+		// A breakpoint above 4 KB is not the one at the same address below it. The program ends at 0x1012.
+		Chip8Debugger high;
+		BreakpointSet breakpoints;
+		breakpoints.addAddress(0x1200);
+		breakpoints.addAddress(0x1010);
+		high.setTarget(Target::XoChip);
+		high.setBreakpoints(&breakpoints);
+		high.loadProgram(ops);
+		if (high.run(5000) != StopReason::Breakpoint || high.pc() != 0x1010)
+		{
+			diagnostics::error("breakpoint above 4 KB failed!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_disassembler()
+	{
+		// The table knows the instructions the debugger decodes. 0000 stops the machine, but is data, and the
+		// debugger ignores the lowest nibble of the other 5XY0 and 9XY0, which the table leaves to data as well.
+		const Target targets[] = { Target::Chip8, Target::Schip, Target::XoChip };
+		for (Target target : targets)
+		{
+			for (unsigned op = 1; op <= 0xFFFF; ++op)
+			{
+				const bool known = find_opcode(u16(op), target) != nullptr, decoded = decode_instruction(u16(op), target).op != Op::Unknown;
+				if (known != decoded && (known || ((op & 0xF000) != 0x5000 && (op & 0xF000) != 0x9000)))
+				{
+					diagnostics::error([&] { return "opcode table and decoder differ at " + u16_to_hex_string(u16(op)) + "!"; });
+					return false;
+				}
+			}
+		}
+
+		std::ostringstream analysis;
+		analyse_opcodes({ 0x8127 }, analysis);
+		const std::vector<u8> small = { 0x60, 0x05, 0x22, 0x06, 0x12, 0x02, 0x00, 0xEE, 0x81, 0x27, 0x81, 0x28, 0xAB };
+		if (analysis.str() != "8127 - 8XY7 - Set V[1] = V[2] - V[1], set V[F] = NOT borrow\n"
+			|| disassemble(small) != "\tLD V0, 0x05\nL202:\n\tCALL L206\n\tJP L202\nL206:\n\tRET\n\tSUBN V1, V2\n\tDW 0x8128\n\tDB 0xAB\n"
+			|| disassemble({ 0xF0, 0x00, 0x12, 0x34, 0xF1, 0x01 }, Target::XoChip) != "\tLD I, long 0x1234\n\tPLANE 1\n")
+		{
+			diagnostics::error("disassembler failed!");
+			return false;
+		}
+
+		// Any ROM survives a round trip through the assembly, including data and odd sizes.
+		std::mt19937 rng{ 0x46 };
+		for (unsigned program = 0; program < 60; ++program)
+		{
+			const Target target = targets[program % 3];
+			std::vector<u8> rom;
+			if (program < 30)
+			{
+				for (u16 op : generate_rom(rng)) { rom.push_back(u8(op >> 8)); rom.push_back(u8(op)); }
+			}
+			else
+			{
+				rom.resize(rng() % 0x800 + 1);
+				for (u8& byte : rom) byte = u8(rng());
+			}
+			if (assemble(disassemble(rom, target), target) != rom)
+			{
+				diagnostics::error([&] { return "assembler round trip failed for program " + std::to_string(program) + "!"; });
+				return false;
+			}
+		}
+
+		// Hand written assembly and its errors.
+		const std::vector<u8> written = assemble("start: ld v1, 10 ; count\n\tdrw V1, V2, 0xF\n\tjp start\n\tDW 0xF000, 0x0001\n");
+		if (written != std::vector<u8>{ 0x61, 0x0A, 0xD1, 0x2F, 0x12, 0x00, 0xF0, 0x00, 0x00, 0x01 }
+			|| !assemble("\tJP nowhere\n").empty() || !assemble("\tLD V1, 0x100\n").empty() || !assemble("\tHIGH\n").empty()
+			|| assemble("\tHIGH\n", Target::Schip).size() != 2)
+		{
+			diagnostics::error("assembler failed!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_control_flow()
+	{
+		// A loop that skips into a subroutine call, and a jump table.
+		u8 memory[MEMORY_SIZE] = {};
+		const std::vector<u16> ops = { 0x6001, 0x6102, 0x3001, 0x120C, 0x2210, 0x1202, 0x8014, 0x0000, 0x7101, 0x00EE, 0xB300 };
+		for (unsigned j = 0; j < ops.size(); ++j)
+		{
+			memory[PROGRAM_START + j * 2] = u8(ops[j] >> 8);
+			memory[PROGRAM_START + j * 2 + 1] = u8(ops[j]);
+		}
+		const ControlFlowGraph cfg = build_control_flow_graph(memory);
+		auto successors = [&](unsigned address)
+		{
+			std::vector<std::pair<unsigned, EdgeKind>> result;
+			const BasicBlock& block = cfg.blocks[cfg.block_at[address]];
+			for (unsigned j = 0; j < block.successor_count; ++j)
+			{
+				const ControlFlowEdge& edge = cfg.successors[block.first_successor + j];
+				result.emplace_back(cfg.blocks[edge.to].start, edge.kind);
+			}
+			return result;
+		};
+		using Edges = std::vector<std::pair<unsigned, EdgeKind>>;
+		const BasicBlock& loop = cfg.blocks[cfg.block_at[0x202]];
+		if (cfg.blocks.size() != 7 || cfg.block_at[0x204] != cfg.block_at[0x202] || cfg.reachable[0x214]
+			|| successors(0x204) != Edges{ { 0x206, EdgeKind::Fallthrough }, { 0x208, EdgeKind::Skip } }
+			|| successors(0x208) != Edges{ { 0x210, EdgeKind::Call } }
+			|| successors(0x212) != Edges{ { 0x20A, EdgeKind::Return } }
+			|| successors(0x20C).size() != 0 || loop.predecessor_count != 2)
+		{
+			diagnostics::error("control flow graph failed!");
+			return false;
+		}
+
+		// V0 stays live through the subroutine because the loop tests it again after the return.
+		const Liveness liveness = compute_liveness(cfg, memory);
+		const ReachingDefinitions rd = compute_reaching_definitions(cfg, memory);
+		if (live_before(cfg, liveness, memory, 0x200) != 0 || live_before(cfg, liveness, memory, 0x204) != 0x3
+			|| live_before(cfg, liveness, memory, 0x210) != 0x3 || live_before(cfg, liveness, memory, 0x20E) != 0
+			|| reaching_definitions(cfg, rd, memory, 0x20C, 0x1) != std::vector<u16>{ 0x202 }
+			|| reaching_definitions(cfg, rd, memory, 0x212, 0x1) != std::vector<u16>{ 0x210 }
+			|| reaching_definitions(cfg, rd, memory, 0x204, 0x0) != std::vector<u16>{ 0x200 }
+			|| !reaching_definitions(cfg, rd, memory, 0x20C, 0xF).empty())
+		{
+			diagnostics::error("dataflow analysis failed!");
+			return false;
+		}
+
+		// BNNN may land on any of the 256 addresses after NNN.
+		u8 table_memory[MEMORY_SIZE] = {};
+		table_memory[PROGRAM_START] = 0xB3;
+		const ControlFlowGraph table = build_control_flow_graph(table_memory);
+		if (table.blocks.size() != 257 || table.blocks[table.block_at[PROGRAM_START]].successor_count != 0x100)
+		{
+			diagnostics::error("jump table recovery failed!");
+			return false;
+		}
+
+		// Every reachable instruction belongs to exactly one block, and edges come in pairs.
+		std::mt19937 rng{ 0x47 };
+		for (unsigned program = 0; program < 50; ++program)
+		{
+			u8 random[MEMORY_SIZE] = {};
+			const std::vector<u16> random_ops = generate_rom(rng);
+			for (unsigned j = 0; j < random_ops.size(); ++j)
+			{
+				random[PROGRAM_START + j * 2] = u8(random_ops[j] >> 8);
+				random[PROGRAM_START + j * 2 + 1] = u8(random_ops[j]);
+			}
+			const ControlFlowGraph graph = build_control_flow_graph(random);
+			std::size_t covered = 0;
+			for (unsigned index = 0; index < graph.blocks.size(); ++index)
+				for (unsigned address = graph.blocks[index].start; address < graph.blocks[index].end; address += 2)
+					covered += graph.block_at[address] == index ? 1 : 0;
+			if (covered != graph.reachable.count() || graph.successors.size() != graph.predecessors.size())
+			{
+				diagnostics::error([&] { return "control flow graph of random program " + std::to_string(program) + " failed!"; });
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool test_listing()
+	{
+		LineTable lines;
+		const std::string source =
+			"VAR a = 1\n"\
+			"FOR i=4 TO 10 STEP 2:\n"\
+			"	IF a==1:\n"\
+			"		a+=2\n"\
+			"	ENDIF\n"\
+			"	a += 1\n"\
+			"ENDFOR\n"\
+			"VAR z=10\n";
+		const std::vector<u16> ops = compile(source, true, false, nullptr, &lines);
+		std::vector<u8> rom;
+		for (u16 op : ops)
+		{
+			rom.push_back(u8(op >> 8));
+			rom.push_back(u8(op));
+		}
+
+		// Three passes through the loop, the IF costs two cycles either way.
+		const CycleEstimate uniform = estimate_cycles(rom, uniform_cost_model(), Target::Chip8, 15);
+		Chip8Debugger debugger;
+		debugger.loadProgram(ops);
+		if (uniform.blocks.size() != 2 || uniform.blocks[0].kind != CodeBlockKind::For || uniform.blocks[0].trips != 3
+			|| uniform.blocks[0].start != 0x202 || uniform.blocks[0].end != 0x216 || uniform.blocks[1].kind != CodeBlockKind::If
+			|| uniform.blocks[1].cycles.best != 2 || uniform.blocks[1].cycles.worst != 2 || uniform.blocks[0].cycles.worst != 20
+			|| !uniform.blocks[0].over_budget || uniform.blocks[1].over_budget
+			|| debugger.run(1000) != StopReason::EndOfProgram || uniform.program.best != debugger.cycles() || uniform.program.worst != debugger.cycles())
+		{
+			diagnostics::error("cycle estimate of a loop failed!");
+			return false;
+		}
+
+		// A slower jump makes the IF cheaper when its condition holds.
+		CostModel model = uniform_cost_model();
+		if (!parse_cost_model("8XY4=3, 1nnn = 2 # jumps\ndata=0", model) || model.data != 0
+			|| parse_cost_model("FOO=1", model) || parse_cost_model("DXYN=x", model))
+		{
+			diagnostics::error("cost model parser failed!");
+			return false;
+		}
+		const CycleEstimate weighted = estimate_cycles(rom, model);
+		if (weighted.blocks[1].cycles.best != 2 || weighted.blocks[1].cycles.worst != 3
+			|| weighted.blocks[0].cycles.best != 28 || weighted.blocks[0].cycles.worst != 31 || weighted.blocks[0].pass.worst != 10)
+		{
+			diagnostics::error("weighted cycle estimate failed!");
+			return false;
+		}
+
+		// A counter that steps over its limit never stops, one the body changes has no constant trip count.
+		const std::vector<u16> loops = compile("VAR a = 0\nFOR j=0 TO 5 STEP 2:\n	a += 1\nENDFOR\nFOR k=0 TO 5 STEP 1:\n	k += 1\nENDFOR\n", true, false);
+		std::vector<u8> loops_rom;
+		for (u16 op : loops)
+		{
+			loops_rom.push_back(u8(op >> 8));
+			loops_rom.push_back(u8(op));
+		}
+		const CycleEstimate open_ended = estimate_cycles(loops_rom, uniform_cost_model());
+		if (open_ended.blocks.size() != 2 || open_ended.blocks[0].trips != 0 || !open_ended.blocks[0].endless
+			|| open_ended.blocks[1].trips != 0 || open_ended.blocks[1].endless
+			|| open_ended.blocks[1].cycles.best != 6 || open_ended.blocks[1].cycles.worst != UNBOUNDED_CYCLES)
+		{
+			diagnostics::error("cycle estimate of open ended loops failed!");
+			return false;
+		}
+
+		std::ostringstream listing;
+		print_listing(listing, rom, uniform, uniform_cost_model(), lines, source);
+		if (listing.str().find("0x20C    7002       ADD V0, 0x02                 1     4  		a+=2\n") == std::string::npos
+			|| listing.str().find("!FOR             2-7        0x202-0x216      3      6                     20\n") == std::string::npos)
+		{
+			diagnostics::error("listing does not match!");
+			return false;
+		}
+		return true;
+	}
+
+	bool test_program_generator()
+	{
+		// Every mix compiles into a program that stops, and a seed always gives the same program.
+		for (unsigned seed = 1; seed <= 20; ++seed)
+		{
+			GeneratorOptions options;
+			options.seed = seed;
+			options.statements = 20 + seed * 10;
+			options.depth = seed % 5;
+			options.variables = 1 + seed % 16;
+			options.mix.loop = seed % 4;
+			options.mix.clear = seed % 2;
+			const std::string code = generate_program(options);
+			const std::vector<u16> ops = compile(code);
+			Chip8Debugger debugger;
+			debugger.loadProgram(ops);
+			if (ops.empty() || code != generate_program(options) || debugger.run(1000000) != StopReason::EndOfProgram)
+			{
+				diagnostics::error([&] { return "generated program " + std::to_string(seed) + " failed!"; });
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool test_fuzz_regressions()
+	{
+		// Blocks nested too deep, a statement too long and more variables than registers.
+		std::string opened, closed, chained = "VAR a = 1\na", variables;
+		for (unsigned j = 0; j <= MAX_BLOCK_DEPTH; ++j)
+		{
+			opened += "IF a == 1:\n";
+			closed += "ENDIF\n";
+		}
+		for (unsigned j = 0; j < MAX_STATEMENT_TOKENS; ++j) chained += " = a";
+		for (char name = 'a'; name <= 'q'; ++name) variables += std::string("VAR ") + name + " = 1\n";
+
+		// Inputs that crashed the front end are rejected with an error instead.
+		const std::string rejected[] = {
+			"VAR a = 0\nFOR i = 0 TO 50:\n  a += 3\nENDFOR\n",
+			"cls(\n",
+			"VAR a = 1\nIF a:\n\ta = 2\nENDIF\n",
+			"VAR a = 1\nIF a += 1:\n\ta = 2\nENDIF\n",
+			"VAR a = 1\nENDIF\nIF a == 1:\n\ta = 2\n",
+			"VAR a = 1\nIF a == 1:\nFOR i = 0 TO 4 STEP 1:\na += 1\nENDIF\nENDFOR\n",
+			"VAR a = 1\n" + opened + "a += 1\n" + closed,
+			chained,
+			variables
+		};
+		for (const std::string& code : rejected)
+		{
+			if (!compile(code).empty() || compiler_log::read_errors().empty())
+			{
+				diagnostics::error([&] { return "fuzz regression not rejected: " + code.substr(0, 40); });
+				return false;
+			}
+		}
+
+		// A leading newline is fine, and a long shift stops at nine instructions.
+		const std::vector<u16> shifted = compile("\n\nVAR a = 1\na <<= 4000000000\n");
+		if (!compiler_log::read_errors().empty() || shifted.size() != 10 || shifted[9] != 0x800E)
+		{
+			diagnostics::error("fuzz regression failed to compile!");
+			return false;
+		}
+
+		// Mutated programs go through every fuzz target.
+		std::mt19937 rng{ 1 };
+		std::vector<std::string> corpus{ generate_program(GeneratorOptions{}) };
+		for (unsigned run = 0; run < 300; ++run)
+		{
+			const std::string input = mutate_input(corpus[rng() % corpus.size()], corpus, rng, 4096);
+			for (FuzzTarget target : { FuzzTarget::Tokenize, FuzzTarget::Parse, FuzzTarget::Compile })
+				run_fuzz_target(target, reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+			if (compiler_log::read_errors().empty()) corpus.push_back(input);
+		}
+		return true;
+	}
+
+	// Run all tests.
+	bool run_tests()
+	{
+		if (
+			build_opcode("8XY3", 0, 0, 0x1, 0x2) != "8123" ||
+			build_opcode("1NNN", 0xF4) != "10f4" ||
+			build_opcode("3XNN", 0, 0, 0xA, 0, 0, 0xBB) != "3abb",
+			build_opcode("DXYN", 0, 0x3, 0x1, 0x2) != "d123"
+		) {
+			diagnostics::error("Failed building opcodes via `build_opcode(mask..)`");
+			return false;
+		}
+
+		auto raw_test_output = compile(
+			"VAR a = 10\n"\
+			"VAR b = 10\n"\
+			"RAW 6001\n",
+			true, true
+		);
+
+		if (compiler_log::read_errors().size() != 0
+			|| raw_test_output.size() != 3
+			|| raw_test_output[0] != 0x600A
+			|| raw_test_output[1] != 0x610A
+			|| raw_test_output[2] != 0x6001
+			) {
+			diagnostics::error("raw_test_output failed!");
+			return false;
+		}
+
+		auto for_test_output = compile(
+			"VAR a = 1\n"\
+			"FOR i=4 TO 10 STEP 2:\n"\
+			"	IF a==1:\n"\
+			"		a+=2\n"\
+			"	ENDIF\n"\
+			"	a += 1\n"\
+			"ENDFOR\n"\
+			"VAR z=10;",
+			true, true
+		);
+
+		if ( compiler_log::read_errors().size() != 0
+			|| for_test_output.size() != 12
+			|| for_test_output[0] != 0x6001
+			|| for_test_output[1] != 0x6104
+			|| for_test_output[2] != 0x620A
+			|| for_test_output[3] != 0x6302
+			|| for_test_output[4] != 0x3001
+			|| for_test_output[5] != 0x120E
+			|| for_test_output[6] != 0x7002
+			|| for_test_output[7] != 0x7001
+			|| for_test_output[8] != 0x8134
+			|| for_test_output[9] != 0x5120
+			|| for_test_output[10]!= 0x1208
+			|| for_test_output[11]!= 0x640A
+			) {
+			diagnostics::error("for_test_output failed!");
+			return false;
+		}
+
+		auto test_output = compile(
+			"VAR a = 4\n"\
+			"VAR b = 2\n"\
+			"IF a == 4:\n"\
+			"	IF a != 4:\n"\
+			"		a = 8\n"\
+			"	ENDIF\n"\
+			"ENDIF\n"\
+			"IF a == 3:\n"\
+			"	IF a != b:\n"\
+			"		a = b\n"\
+			"	ENDIF\n"\
+			"ENDIF\n"\
+			"a = 1\n"\
+			"b = a\n"\
+			"a |= b\n"\
+			"a &= b\n"\
+			"a ^= b\n"\
+			"a -= b\n"\
+			"a <<=2\n"\
+			"a >>=1\n",
+			true, true
+		);
+
+		if (compiler_log::read_errors().size() != 0
+			|| test_output.size() != 21
+			|| test_output[0] != 0x6004
+			|| test_output[1] != 0x6102
+			|| test_output[2] != 0x3004
+			|| test_output[3] != 0x120E
+			|| test_output[4] != 0x4004
+			|| test_output[5] != 0x120E
+			|| test_output[6] != 0x6008
+			|| test_output[7] != 0x3003
+			|| test_output[8] != 0x1218
+			|| test_output[9] != 0x9010
+			|| test_output[10]!= 0x1218
+			|| test_output[11]!= 0x8010
+			|| test_output[12]!= 0x6001
+			|| test_output[13]!= 0x8100
+			|| test_output[14]!= 0x8011
+			|| test_output[15]!= 0x8012
+			|| test_output[16]!= 0x8013
+			|| test_output[17]!= 0x8015
+			|| test_output[18]!= 0x800E
+			|| test_output[19]!= 0x800E
+			|| test_output[20]!= 0x8006
+		){
+			diagnostics::error("test_output failed!");
+			return false;
+		}
+			
+		Chip8Debugger switch_debugger;
+		switch_debugger.setEngine(Engine::Switch);
+		switch_debugger.loadProgram(test_output);
+		Chip8Debugger cached_debugger;
+		cached_debugger.setEngine(Engine::Cached);
+		cached_debugger.loadProgram(test_output);
+		if (switch_debugger.run(1000) != cached_debugger.run(1000) || !switch_debugger.sameState(cached_debugger))
+		{
+			diagnostics::error("engine comparison failed!");
+			return false;
+		}
+
+		Chip8Debugger debugger;
+		if (!debugger.loadProgram(for_test_output)
+			|| debugger.run(1000) != StopReason::EndOfProgram
+			|| debugger.cycles() != 22
+			|| debugger.v(0) != 6
+			|| debugger.v(1) != 10
+			|| debugger.v(4) != 10
+			) {
+			diagnostics::error("headless run failed!");
+			return false;
+		}
+
+		// The digit 0 drawn at (62, 30) wraps around the right and the bottom edge, drawing it again erases it.
+		Chip8Debugger sprite_debugger;
+		sprite_debugger.loadProgram({ 0xA000, 0x603E, 0x611E, 0xD015 });
+		sprite_debugger.run(4);
+		bool drawn = sprite_debugger.pixel(63, 30) && sprite_debugger.pixel(0, 30) && sprite_debugger.pixel(1, 0)
+			&& !sprite_debugger.pixel(0, 0) && sprite_debugger.v(0xF) == 0;
+		sprite_debugger.loadProgram({ 0xA000, 0x603E, 0x611E, 0xD015, 0xD015 });
+		sprite_debugger.run(5);
+		if (!drawn || sprite_debugger.v(0xF) != 1 || sprite_debugger.pixel(63, 30) || sprite_debugger.pixel(1, 0))
+		{
+			diagnostics::error("sprite drawing failed!");
+			return false;
+		}
+
+		u8 for_test_memory[MEMORY_SIZE] = {};
+		for (unsigned j = 0; j < for_test_output.size(); ++j)
+		{
+			for_test_memory[PROGRAM_START + j * 2] = for_test_output[j] >> 8;
+			for_test_memory[PROGRAM_START + j * 2 + 1] = for_test_output[j] & 0xFF;
+		}
+		auto flow = recover_control_flow(for_test_memory);
+		unsigned leaders = 0;
+		for (unsigned address = 0; address < MEMORY_SIZE; ++address) leaders += flow.leaders[address] ? 1 : 0;
+		if (leaders != 7 || !flow.leaders[0x20c] || !flow.leaders[0x216] || !flow.reachable[0x218] || flow.reachable[0x21a])
+		{
+			diagnostics::error("control flow recovery failed!");
+			return false;
+		}
+
+		CompileStats stats;
+		compile("VAR a = 1\n", false, false, &stats);
+		if (stats.phases.size() != 5 || stats.phases[0].name != "tokenize" || stats.phases[4].items != 1)
+		{
+			diagnostics::error("compile stats failed!");
+			return false;
+		}
+
+		// Once the measured compile returned, allocations are no longer tracked.
+		const long long peak_bytes = allocation_stats::peak_bytes, current_bytes = allocation_stats::current_bytes;
+		static std::vector<std::string> after_compile;
+		after_compile.assign(100, std::string(200, 'x'));
+		after_compile.clear();
+		if (allocation_stats::tracking || allocation_stats::peak_bytes != peak_bytes || allocation_stats::current_bytes != current_bytes)
+		{
+			diagnostics::error("allocations after a measured compile were tracked!");
+			return false;
+		}
+
+		if (!test_jit_differential() || !test_rewind() || !test_fleet() || !test_replay() || !test_breakpoints() || !test_line_table() || !test_profiler() || !test_scheduler() || !test_terminal_display() || !test_capture() || !test_trace() || !test_keypad() || !test_quirks() || !test_targets() || !test_disassembler() || !test_control_flow() || !test_listing() || !test_program_generator() || !test_fuzz_regressions())
+			return false;
+			
+		diagnostics::info("All tests passed!");
+		return true;
+	}
+}
@@ -0,0 +1,435 @@
+/*
+*	MIT License
+*
+*	Copyright(c) 2018 Paul Bernitz
+*
+*	Permission is hereby granted, free of charge, to any person obtaining a copy
+*	of this software and associated documentation files(the "Software"), to deal
+*	in the Software without restriction, including without limitation the rights
+*	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*	copies of the Software, and to permit persons to whom the Software is
+*	furnished to do so, subject to the following conditions :
+*
+*	The above copyright notice and this permission notice shall be included in all
+*	copies or substantial portions of the Software.
+*
+*	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+*	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*	SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "debugger.hpp"
+
+#define TRACE_I 16			// Register number of I in a trace record.
+#define TRACE_NONE 0xFF		// The instruction wrote no register.
+
+namespace c8s
+{
+	// One executed instruction and the register it wrote. The ALU instructions that also set
+	// VF carry it in `flag`. FX65 and FX85 write more than one register, V1 to VX get records of their own.
+	struct TraceRecord
+	{
+		std::uint64_t cycle;	// Instructions executed, including this one.
+		u16 pc;
+		u16 instruction;
+		u8 reg;					// V0 to VF, `TRACE_I` or `TRACE_NONE`.
+		u8 flag;				// VF after 8XY4 to 8XYE, 0 otherwise.
+		u16 value;				// Of the register after the instruction.
+	};
+	static_assert(sizeof(TraceRecord) == 16, "Trace records are written as they are in memory");
+
+	// The register an instruction writes, the first one for FX65. `TRACE_NONE` if it writes none.
+	u8 traced_register(u16 instruction)
+	{
+		const u8 x = (instruction >> 8) & 0xF;
+		switch (instruction >> 12)
+		{
+		case 0x6: case 0x7: case 0x8: case 0xC: return x;
+		case 0xA: return TRACE_I;
+		case 0xD: return 0xF;
+		case 0xF:
+			switch (instruction & 0xFF)
+			{
+			case 0x07: case 0x0A: return x;
+			case 0x1E: case 0x29: case 0x30: return TRACE_I;
+			case 0x00: return instruction == 0xF000 ? TRACE_I : TRACE_NONE;	// XO-CHIP's F000 NNNN.
+			case 0x65: case 0x85: return 0x0;
+			default: return TRACE_NONE;
+			}
+		default: return TRACE_NONE;
+		}
+	}
+
+	// True for the instructions that write VF next to VX.
+	bool sets_flag(u16 instruction)
+	{
+		return (instruction >> 12) == 0x8 && (instruction & 0xF) >= 0x4 && (instruction & 0xF) != 0xF;
+	}
+
+	// Single producer, single consumer queue of trace records. The producer only touches the
+	// consumer's index when the ring looks full, so a push is a store and a release.
+	class TraceRing
+	{
+		std::vector<TraceRecord> m_records;
+		std::size_t m_mask;
+		alignas(64) std::atomic<std::size_t> m_head;	// Written by the producer.
+		alignas(64) std::atomic<std::size_t> m_tail;	// Written by the consumer.
+		alignas(64) std::size_t m_cachedTail;			// Producer's last view of `m_tail`.
+		std::uint64_t m_stalls;
+
+	public:
+		// `capacity` is rounded up to a power of two.
+		explicit TraceRing(std::size_t capacity)
+			: m_head{ 0 }, m_tail{ 0 }, m_cachedTail{ 0 }, m_stalls{ 0 }
+		{
+			std::size_t size = 2;
+			while (size < capacity) size *= 2;
+			m_records.resize(size);
+			m_mask = size - 1;
+		}
+
+		// Waits for the consumer while the ring is full.
+		void push(const TraceRecord& record)
+		{
+			const std::size_t head = m_head.load(std::memory_order_relaxed);
+			if (head - m_cachedTail == m_records.size())
+			{
+				m_cachedTail = m_tail.load(std::memory_order_acquire);
+				while (head - m_cachedTail == m_records.size())
+				{
+					++m_stalls;
+					std::this_thread::yield();
+					m_cachedTail = m_tail.load(std::memory_order_acquire);
+				}
+			}
+			m_records[head & m_mask] = record;
+			m_head.store(head + 1, std::memory_order_release);
+		}
+
+		// Hand the queued records to `consume(const TraceRecord*, count)`, in at most two
+		// contiguous pieces. Returns the number of records.
+		template<typename Consume>
+		std::size_t drain(Consume consume, std::size_t min_count = 1)
+		{
+			const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+			const std::size_t head = m_head.load(std::memory_order_acquire);
+			if (head - tail < std::max<std::size_t>(min_count, 1))
+				return 0;
+			const std::size_t start = tail & m_mask;
+			const std::size_t count = head - tail;
+			const std::size_t first = std::min(count, m_records.size() - start);
+			consume(&m_records[start], first);
+			if (first < count) consume(&m_records[0], count - first);
+			m_tail.store(head, std::memory_order_release);
+			return count;
+		}
+
+		std::size_t capacity() const { return m_records.size(); }
+		std::uint64_t stalls() const { return m_stalls; }
+	};
+
+	// Writes a binary trace of a run: "C8TR", a version byte, the record size and two zero
+	// bytes, then `TraceRecord`s in host byte order. The debugger thread only fills a ring that
+	// a background thread writes to the file.
+	class TraceRecorder : public ExecutionTracer
+	{
+		TraceRing m_ring;
+		std::FILE* m_file;
+		std::thread m_writer;
+		std::atomic<bool> m_stop;
+		bool m_failed;
+		std::uint64_t m_records;
+
+	public:
+		explicit TraceRecorder(std::size_t capacity = 0x10000)
+			: m_ring{ capacity }, m_file{ nullptr }, m_stop{ false }, m_failed{ false }, m_records{ 0 } {}
+
+		~TraceRecorder() override { close(); }
+
+		bool open(const std::string& fileName)
+		{
+			close();
+			m_file = std::fopen(fileName.c_str(), "wb");
+			if (!m_file)
+				return false;
+			const char header[8] = { 'C', '8', 'T', 'R', 1, char(sizeof(TraceRecord)), 0, 0 };
+			m_failed = std::fwrite(header, sizeof(header), 1, m_file) != 1;
+			m_stop = false;
+			m_writer = std::thread{ [this] { writeLoop(); } };
+			return true;
+		}
+
+		// Write the rest of the ring and close the file. Returns false if a write failed.
+		bool close()
+		{
+			if (!m_file)
+				return !m_failed;
+			m_stop = true;
+			m_writer.join();
+			m_failed |= std::fclose(m_file) != 0;
+			m_file = nullptr;
+			return !m_failed;
+		}
+
+		void onExecuted(const Chip8Debugger& debugger, u16 pc, u16 instruction) override
+		{
+			const u8 reg = traced_register(instruction);
+			TraceRecord record{ debugger.cycles(), pc, instruction, reg, 0, 0 };
+			if (reg == TRACE_I) record.value = debugger.i();
+			else if (reg != TRACE_NONE)
+			{
+				record.value = debugger.v(reg);
+				if (sets_flag(instruction)) record.flag = debugger.v(0xF);
+			}
+			m_ring.push(record);
+			++m_records;
+
+			// Taken to load V0 to VX, writes that did not change a register are filtered out by the analyzer.
+			if ((instruction & 0xF0FF) == 0xF065 || (instruction & 0xF0FF) == 0xF085)
+			{
+				for (unsigned x = 1; x <= ((instruction >> 8) & 0xFu); ++x)
+				{
+					record.reg = u8(x);
+					record.value = debugger.v(x);
+					m_ring.push(record);
+					++m_records;
+				}
+			}
+		}
+
+		std::uint64_t records() const { return m_records; }
+		// Times the debugger waited for the writer because the ring was full.
+		std::uint64_t stalls() const { return m_ring.stalls(); }
+
+	private:
+		void writeLoop()
+		{
+			auto write = [this](const TraceRecord* records, std::size_t count)
+			{
+				if (!m_failed && std::fwrite(records, sizeof(TraceRecord), count, m_file) != count)
+					m_failed = true;
+			};
+			for (;;)
+			{
+				const bool stop = m_stop.load();
+				if (m_ring.drain(write, stop ? 1 : m_ring.capacity() / 4) == 0)
+				{
+					if (stop) return;
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+			}
+		}
+	};
+
+	// Loads a trace written by `TraceRecorder` and answers questions about the run without
+	// executing the ROM again. A register changed at a record if its value differs from the
+	// register's previous record, or from 0 for its first one.
+	class TraceAnalyzer
+	{
+		std::vector<TraceRecord> m_records;
+
+	public:
+		// Returns false if `bytes` is not a trace.
+		bool decode(const std::vector<u8>& bytes)
+		{
+			if (bytes.size() < 8 || std::memcmp(bytes.data(), "C8TR", 4) != 0 || bytes[4] != 1 || bytes[5] != sizeof(TraceRecord)
+				|| (bytes.size() - 8) % sizeof(TraceRecord) != 0)
+				return false;
+			m_records.resize((bytes.size() - 8) / sizeof(TraceRecord));
+			if (!m_records.empty())
+				std::memcpy(m_records.data(), bytes.data() + 8, bytes.size() - 8);
+			return true;
+		}
+
+		bool load(const std::string& fileName)
+		{
+			std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(fileName.c_str(), "rb"), &std::fclose };
+			if (!file)
+				return false;
+			std::vector<u8> bytes;
+			u8 buffer[0x10000];
+			std::size_t read;
+			while ((read = std::fread(buffer, 1, sizeof(buffer), file.get())) > 0)
+				bytes.insert(bytes.end(), buffer, buffer + read);
+			return decode(bytes);
+		}
+
+		const std::vector<TraceRecord>& records() const { return m_records; }
+
+		std::uint64_t instructions() const
+		{
+			std::uint64_t count = 0;
+			for (std::size_t j = 0; j < m_records.size(); ++j)
+				count += (j == 0 || m_records[j].cycle != m_records[j - 1].cycle) ? 1 : 0;
+			return count;
+		}
+
+		// Cycles at which the instruction at `pc` was executed.
+		std::vector<std::uint64_t> executions(u16 pc) const
+		{
+			std::vector<std::uint64_t> cycles;
+			for (const auto& record : m_records)
+			{
+				if (record.pc == pc && (cycles.empty() || cycles.back() != record.cycle))
+					cycles.push_back(record.cycle);
+			}
+			return cycles;
+		}
+
+		// Records at which `reg` changed, oldest first.
+		std::vector<TraceRecord> changes(unsigned reg) const
+		{
+			std::vector<TraceRecord> result;
+			u16 value = 0;
+			for (const auto& record : m_records)
+			{
+				TraceRecord write = record;
+				if (reg == 0xF && record.reg != 0xF && sets_flag(record.instruction))
+				{
+					write.reg = 0xF;
+					write.value = record.flag;
+				}
+				if (write.reg != reg || write.value == value)
+					continue;
+				value = write.value;
+				result.push_back(write);
+			}
+			return result;
+		}
+
+		// The last change of `reg` by an instruction before `cycle`. Returns false if there is none.
+		bool lastChange(unsigned reg, std::uint64_t cycle, TraceRecord& change) const
+		{
+			bool found = false;
+			for (const auto& record : changes(reg))
+			{
+				if (record.cycle >= cycle)
+					break;
+				change = record;
+				found = true;
+			}
+			return found;
+		}
+
+		// Answer one of
+		//   summary
+		//   history <reg>
+		//   at <address>
+		//   <reg> before <address>		the last change before the last execution of <address>
+		//   <reg> before cycle <n>
+		// with <reg> one of V0 to VF and I. Returns false if the query is not understood.
+		bool query(const std::string& text, std::ostream& os) const
+		{
+			std::istringstream iss{ text };
+			std::string first, second, third, fourth;
+			iss >> first >> second >> third >> fourth;
+			unsigned reg = 0;
+			std::uint64_t number = 0;
+
+			if (first == "summary" && second.empty())
+			{
+				os << std::dec << m_records.size() << " records of " << instructions() << " instructions";
+				if (!m_records.empty()) os << ", cycles " << m_records.front().cycle << " - " << m_records.back().cycle;
+				os << '\n';
+				for (unsigned r = 0; r <= TRACE_I; ++r)
+					os << "  " << std::left << std::setw(3) << registerName(r) << std::right << std::setw(10) << changes(r).size() << " changes\n";
+				return true;
+			}
+			if (first == "history" && parseRegister(second, reg) && third.empty())
+			{
+				for (const auto& record : changes(reg)) printRecord(os, record);
+				return true;
+			}
+			if (first == "at" && parseNumber(second, number) && third.empty())
+			{
+				const auto cycles = executions(u16(number));
+				os << std::dec << "0x" << std::hex << number << std::dec << " executed " << cycles.size() << " times";
+				if (!cycles.empty()) os << ", first at cycle " << cycles.front() << ", last at cycle " << cycles.back();
+				os << '\n';
+				return true;
+			}
+			if (parseRegister(first, reg) && second == "before")
+			{
+				std::uint64_t cycle = 0;
+				if (third == "cycle" && parseNumber(fourth, number)) cycle = number;
+				else if (parseNumber(third, number) && fourth.empty())
+				{
+					const auto cycles = executions(u16(number));
+					if (cycles.empty())
+					{
+						os << "0x" << std::hex << number << std::dec << " was never executed\n";
+						return true;
+					}
+					cycle = cycles.back();
+				}
+				else return false;
+
+				TraceRecord change{};
+				if (lastChange(reg, cycle, change)) printRecord(os, change);
+				else os << registerName(reg) << " did not change before cycle " << std::dec << cycle << '\n';
+				return true;
+			}
+			return false;
+		}
+
+		static std::string registerName(unsigned reg)
+		{
+			if (reg == TRACE_I) return "I";
+			std::ostringstream oss;
+			oss << 'V' << std::uppercase << std::hex << (reg & 0xF);
+			return oss.str();
+		}
+
+	private:
+		static bool parseRegister(const std::string& text, unsigned& reg)
+		{
+			if (text == "I" || text == "i")
+			{
+				reg = TRACE_I;
+				return true;
+			}
+			if (text.size() != 2 || (text[0] != 'V' && text[0] != 'v') || !std::isxdigit(static_cast<unsigned char>(text[1])))
+				return false;
+			reg = unsigned(std::strtoul(text.c_str() + 1, nullptr, 16));
+			return true;
+		}
+
+		static bool parseNumber(const std::string& text, std::uint64_t& number)
+		{
+			if (text.empty())
+				return false;
+			char* end = nullptr;
+			number = std::strtoull(text.c_str(), &end, 0);
+			return *end == '\0';
+		}
+
+		static void printRecord(std::ostream& os, const TraceRecord& record)
+		{
+			os << "cycle " << std::dec << record.cycle << ", pc 0x" << std::hex << record.pc << ": "
+				<< std::setw(4) << std::setfill('0') << record.instruction << std::setfill(' ') << ' '
+				<< registerName(record.reg) << " = 0x" << record.value << std::dec << '\n';
+		}
+	};
+}